@@ -0,0 +1,360 @@
+#include "stm32l432xx.h"
+#include "GPIO.h"
+#include "Input.h"
+#include "LPTime.h"
+
+/*****************************************************************
+* Each pin is routed through its EXTI line and interrupts on both
+* edges. The first edge masks the line and starts a countdown on
+* the 1ms TIM6 tick, so the bounces that follow cost nothing. When
+* the countdown runs out the pin is read. If it settled at a new
+* level an event is queued and the line is unmasked again.
+*
+* TIM6 only runs while a line is debouncing, so an idle input
+* never wakes the core. Timestamps come from LPTIM1 instead, which
+* counts all the time, in Stop mode as well.
+*
+* Events are queued by the TIM6 interrupt and taken out by the
+* main loop, one producer and one consumer, so no locking is
+* needed.
+*****************************************************************/
+
+//port and settings of each EXTI line in use, 0 if unused
+static GPIO_TypeDef *linePort[16];
+static uint8_t lineEdges[16];
+
+//last debounced level of each line
+static uint8_t lineLevel[16];
+
+//ms left before each line is read, 0 if not debouncing
+static volatile uint8_t lineCountdown[16];
+
+//lineCountdown is 8 bits, and a countdown of 0 would never run out
+GPIO_STATIC_ASSERT((INPUT_DEBOUNCE_MS >= 1u) && (INPUT_DEBOUNCE_MS <= 255u), input_debounce_ms);
+
+//lines with a countdown running. TIM6 is stopped when it is 0
+static volatile uint32_t debouncing = 0;
+
+//time of the edge that started the debounce
+static uint32_t lineEdgeUs[16];
+
+//event queue. The indexes only count up and are masked when used
+static InputEvent queue[INPUT_QUEUE_SIZE];
+static volatile uint32_t queueHead = 0;
+static volatile uint32_t queueTail = 0;
+static volatile uint32_t dropped = 0;
+
+
+/*****************************************************************
+* initInput
+*
+* Enables SYSCFG for the EXTI routing, sets TIM6 up as the 1ms
+* debounce tick and starts LPTIM1 for the timestamps. TIM6 is left
+* stopped until the first edge.
+*****************************************************************/
+void initInput(void)
+{
+	initLPTime();
+
+	//enable SYSCFG and TIM6 clocks
+	RCC->APB2ENR |= (1U << 0);
+	RCC->APB1ENR1 |= (1U << 4);
+
+	//count microseconds, reset every millisecond
+	TIM6->PSC = (INPUT_TIMER_CLOCK_HZ / 1000000u) - 1u;
+	TIM6->ARR = 999u;
+	TIM6->EGR = (1U << 0);
+	TIM6->SR = 0;
+
+	//interrupt on every reset of the counter
+	TIM6->DIER |= (1U << 0);
+	NVIC_EnableIRQ(TIM6_DAC_IRQn);
+}
+
+/*****************************************************************
+* inputTimeUs
+*
+* Returns the microseconds since initInput, counted on LPTIM1 in
+* steps of one LSI tick (31.25us). Wraps after about 71 minutes.
+*****************************************************************/
+uint32_t inputTimeUs(void)
+{
+	return (uint32_t)LPTIME_TO_US(getLPTime());
+}
+
+/*****************************************************************
+* extiIrqOf
+*
+* Returns the interrupt shared by an EXTI line.
+*****************************************************************/
+static IRQn_Type extiIrqOf(uint8_t line)
+{
+	if(line <= 4u)
+	{
+		return (IRQn_Type)(EXTI0_IRQn + line);
+	}
+
+	return (line <= 9u) ? EXTI9_5_IRQn : EXTI15_10_IRQn;
+}
+
+/*****************************************************************
+* addInputPin
+*
+* Makes a pin an input, routes it through its EXTI line and starts
+* reporting debounced changes on the given edges. Only one port
+* can use each pin number, as they share the EXTI line.
+*
+* Returns 1 on success, 0 if the EXTI line is already taken by
+* another port.
+*****************************************************************/
+uint8_t addInputPin(GPIO_TypeDef *port, uint8_t pin, uint8_t pull, uint8_t edges)
+{
+	uint32_t portCode;
+
+	if((pin > 15u) || (linePort[pin] && (linePort[pin] != port)))
+	{
+		return 0;
+	}
+
+	//SYSCFG port numbers: A = 0, B = 1, C = 2, H = 7
+	if(port == GPIOA)
+	{
+		portCode = 0u;
+	}
+	else if(port == GPIOB)
+	{
+		portCode = 1u;
+	}
+	else if(port == GPIOC)
+	{
+		portCode = 2u;
+	}
+	else
+	{
+		portCode = 7u;
+	}
+
+	//input mode with the requested pull resistor
+	GPIO_WRITE_FIELD(port->MODER, GPIO_MODER_MSK(pin), GPIO_MODER_SET(pin, GPIO_MODE_INPUT));
+	GPIO_WRITE_FIELD(port->PUPDR, GPIO_PUPDR_MSK(pin), GPIO_PUPDR_SET(pin, pull));
+
+	linePort[pin] = port;
+	lineEdges[pin] = edges;
+	lineLevel[pin] = (port->IDR >> pin) & 1u;
+	lineCountdown[pin] = 0;
+
+	//route the pin to its EXTI line. Four lines per EXTICR register
+	SYSCFG->EXTICR[pin / 4u] = (SYSCFG->EXTICR[pin / 4u] & ~(15U << (4u * (pin % 4u))))
+	                         | (portCode << (4u * (pin % 4u)));
+
+	//both edges are always needed to see the pin settle
+	EXTI->RTSR1 |= (1U << pin);
+	EXTI->FTSR1 |= (1U << pin);
+	EXTI->PR1 = (1U << pin);
+	EXTI->IMR1 |= (1U << pin);
+
+	NVIC_EnableIRQ(extiIrqOf(pin));
+
+	return 1;
+}
+
+/*****************************************************************
+* readInput
+*
+* Takes the oldest event out of the queue.
+*
+* Returns 1 if an event was copied to 'event', 0 if the queue is
+* empty.
+*****************************************************************/
+uint8_t readInput(InputEvent *event)
+{
+	uint32_t tail = queueTail;
+
+	if(tail == queueHead)
+	{
+		return 0;
+	}
+
+	*event = queue[tail & (INPUT_QUEUE_SIZE - 1u)];
+	queueTail = tail + 1u;
+
+	return 1;
+}
+
+/*****************************************************************
+* inputPending
+*
+* Returns 1 if readInput has an event to give.
+*****************************************************************/
+uint8_t inputPending(void)
+{
+	return queueTail != queueHead;
+}
+
+/*****************************************************************
+* inputDebouncing
+*
+* Returns 1 while any line is debouncing. TIM6 stops in Stop mode,
+* so the core must only use Sleep until this is 0.
+*****************************************************************/
+uint8_t inputDebouncing(void)
+{
+	return debouncing != 0u;
+}
+
+/*****************************************************************
+* inputEventsDropped
+*
+* Returns the number of events lost because the queue was full.
+*****************************************************************/
+uint32_t inputEventsDropped(void)
+{
+	return dropped;
+}
+
+/*****************************************************************
+* handleExti
+*
+* Starts debouncing every line in 'lines' that has an edge
+* pending, starting TIM6 if it was stopped. The line stays masked
+* until the debounce is over.
+*****************************************************************/
+static void handleExti(uint32_t lines)
+{
+	uint32_t pending = EXTI->PR1 & lines & EXTI->IMR1;
+	uint32_t now = inputTimeUs();
+	uint8_t line;
+
+	for(line = 0; line < 16u; line++)
+	{
+		if(pending & (1U << line))
+		{
+			EXTI->IMR1 &= ~(1U << line);
+			EXTI->PR1 = (1U << line);
+
+			lineEdgeUs[line] = now;
+			lineCountdown[line] = INPUT_DEBOUNCE_MS;
+			debouncing |= (1U << line);
+		}
+	}
+
+	if(debouncing)
+	{
+		TIM6->CR1 |= (1U << 0);
+	}
+}
+
+/*****************************************************************
+* settleLine
+*
+* Called once a line's debounce is over. Queues an event if the
+* pin has settled at a new level and unmasks the line.
+*****************************************************************/
+static void settleLine(uint8_t line)
+{
+	uint8_t level = (linePort[line]->IDR >> line) & 1u;
+	uint8_t wanted;
+	uint32_t head;
+
+	if(level != lineLevel[line])
+	{
+		lineLevel[line] = level;
+		wanted = level ? (lineEdges[line] & INPUT_EDGE_RISING) : (lineEdges[line] & INPUT_EDGE_FALLING);
+		head = queueHead;
+
+		if(!wanted)
+		{
+			//edge not asked for
+		}
+		else if((head - queueTail) < INPUT_QUEUE_SIZE)
+		{
+			queue[head & (INPUT_QUEUE_SIZE - 1u)].pin = line;
+			queue[head & (INPUT_QUEUE_SIZE - 1u)].level = level;
+			queue[head & (INPUT_QUEUE_SIZE - 1u)].edgeUs = lineEdgeUs[line];
+			queue[head & (INPUT_QUEUE_SIZE - 1u)].reportUs = inputTimeUs();
+			queueHead = head + 1u;
+		}
+		else
+		{
+			dropped++;
+		}
+	}
+
+	//clear any edge seen while masked then listen again. If the pin
+	//moved after it was read the next edge starts a new debounce
+	EXTI->PR1 = (1U << line);
+	EXTI->IMR1 |= (1U << line);
+
+	//it may have changed between the read and the unmask
+	if(((linePort[line]->IDR >> line) & 1u) != level)
+	{
+		EXTI->SWIER1 = (1U << line);
+	}
+}
+
+/*****************************************************************
+* TIM6_DAC_IRQHandler
+*
+* 1ms tick. Counts down the lines that are debouncing and stops
+* once none are.
+*****************************************************************/
+void TIM6_DAC_IRQHandler(void)
+{
+	uint8_t line;
+
+	TIM6->SR &= ~(1U << 0);
+
+	for(line = 0; line < 16u; line++)
+	{
+		if(lineCountdown[line] && (--lineCountdown[line] == 0u))
+		{
+			debouncing &= ~(1U << line);
+			settleLine(line);
+		}
+	}
+
+	//an edge settleLine missed comes back through EXTI and starts
+	//TIM6 again
+	if(!debouncing)
+	{
+		TIM6->CR1 &= ~(1U << 0);
+	}
+}
+
+/*****************************************************************
+* EXTI interrupt handlers
+*****************************************************************/
+void EXTI0_IRQHandler(void)
+{
+	handleExti(1U << 0);
+}
+
+void EXTI1_IRQHandler(void)
+{
+	handleExti(1U << 1);
+}
+
+void EXTI2_IRQHandler(void)
+{
+	handleExti(1U << 2);
+}
+
+void EXTI3_IRQHandler(void)
+{
+	handleExti(1U << 3);
+}
+
+void EXTI4_IRQHandler(void)
+{
+	handleExti(1U << 4);
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+	handleExti(0x03E0u);
+}
+
+void EXTI15_10_IRQHandler(void)
+{
+	handleExti(0xFC00u);
+}
@@ -0,0 +1,43 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "stm32l432xx.h"
+
+//clock feeding TIM6. The STM32L432KC runs at 4MHz by default
+#ifndef INPUT_TIMER_CLOCK_HZ
+#define INPUT_TIMER_CLOCK_HZ	4000000u
+#endif
+
+//how long a pin has to stay put after an edge before it is believed
+#ifndef INPUT_DEBOUNCE_MS
+#define INPUT_DEBOUNCE_MS		20u
+#endif
+
+//number of events the queue can hold. Must be a power of 2
+#ifndef INPUT_QUEUE_SIZE
+#define INPUT_QUEUE_SIZE		16u
+#endif
+
+//edges to report
+#define INPUT_EDGE_RISING		(1u << 0)
+#define INPUT_EDGE_FALLING		(1u << 1)
+#define INPUT_EDGE_BOTH			(INPUT_EDGE_RISING | INPUT_EDGE_FALLING)
+
+//one debounced change of a pin
+typedef struct
+{
+	uint8_t pin;			//pin number, which is also the EXTI line
+	uint8_t level;			//new level, 1 = high
+	uint32_t edgeUs;		//time of the first edge of the bounce, in us since initInput
+	uint32_t reportUs;		//time the change was confirmed and queued, in us
+} InputEvent;
+
+void initInput(void);
+uint8_t addInputPin(GPIO_TypeDef *port, uint8_t pin, uint8_t pull, uint8_t edges);
+uint8_t readInput(InputEvent *event);
+uint8_t inputPending(void);
+uint8_t inputDebouncing(void);
+uint32_t inputTimeUs(void);
+uint32_t inputEventsDropped(void);
+
+#endif
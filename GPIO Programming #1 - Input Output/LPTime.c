@@ -0,0 +1,117 @@
+#include "stm32l432xx.h"
+#include "LPTime.h"
+
+
+/*****************************************************************
+ LPTIM1 counts LSI from 0 to 0xFFFF and round again, every 2.048
+ seconds. The ARRM interrupt counts the wraps, so getLPTime keeps
+ going through Sleep and Stop, where TIM2, the other timers and
+ DWT CYCCNT stop with their clocks. Interrupts must not be masked
+ for a whole wrap, or one is lost.
+*****************************************************************/
+
+//TIMES THE 16-BIT COUNT HAS WRAPPED
+static volatile uint32_t wraps = 0;
+
+
+ /*****************************************************************
+ initLPTime
+
+    Starts LSI and LPTIM1 counting it. Does nothing if LPTIM1 is
+    already counting, so every module that needs the time can
+    call it
+*****************************************************************/
+void initLPTime(void)
+{
+    if(LPTIM1->CR & (1u << 0))
+    {
+        return;
+    }
+    
+    RCC->CSR |= (1u << 0);                                  //LSI ON
+    while(!(RCC->CSR & (1u << 1)));                         //WAIT FOR LSIRDY
+    
+    RCC->CCIPR = (RCC->CCIPR & ~(3u << 18)) | (1u << 18);   //LPTIM1 CLOCKED FROM LSI
+    RCC->APB1ENR1 |= (1u << 31);                            //LPTIM1 CLOCK ON
+    
+    //CFGR AND IER CAN ONLY BE WRITTEN WHILE LPTIM1 IS DISABLED
+    LPTIM1->CFGR = 0;                                       //INTERNAL CLOCK, NO PRESCALER
+    LPTIM1->IER = (1u << 1);                                //ARRM INTERRUPT
+    
+    //ARR CAN ONLY BE WRITTEN ONCE IT IS ENABLED
+    LPTIM1->CR = (1u << 0);                                 //ENABLE
+    LPTIM1->ARR = 0xFFFFu;
+    while(!(LPTIM1->ISR & (1u << 4)));                      //WAIT FOR ARROK
+    LPTIM1->ICR = (1u << 4);
+    
+    wraps = 0;
+    LPTIM1->CR |= (1u << 2);                                //COUNT CONTINUOUSLY
+    
+    //LPTIM1 IS ON EXTI LINE 32, UNMASKED AFTER RESET, SO THE WRAP
+    //INTERRUPT ALSO ENDS STOP
+    NVIC_EnableIRQ(LPTIM1_IRQn);
+}
+
+ /*****************************************************************
+ readCount
+
+    LPTIM1 counts on LSI, not the bus clock, so CNT is only right
+    once two reads in a row agree
+*****************************************************************/
+static uint32_t readCount(void)
+{
+    uint32_t first;
+    uint32_t second = LPTIM1->CNT;
+    
+    do
+    {
+        first = second;
+        second = LPTIM1->CNT;
+    } while(first != second);
+    
+    return second;
+}
+
+ /*****************************************************************
+ getLPTime
+
+    Can be called with interrupts masked
+
+    Returns
+    the LPTIM1 ticks since initLPTime
+*****************************************************************/
+uint64_t getLPTime(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t count;
+    uint32_t high;
+    
+    __disable_irq();
+    
+    //ARRM IS SET AS THE COUNT REACHES 0xFFFF, A TICK BEFORE IT WRAPS.
+    //COUNTING FROM ONE TICK LATER LINES THE WRAPS UP WITH THE MATCHES
+    count = (readCount() + 1u) & 0xFFFFu;
+    high = wraps;
+    
+    //A MATCH THE INTERRUPT HASN'T COUNTED YET. WITH A LOW COUNT IT
+    //CAME BEFORE THE COUNT WAS READ
+    if((LPTIM1->ISR & (1u << 1)) && (count < 0x8000u))
+    {
+        high++;
+    }
+    
+    __set_PRIMASK(primask);
+    
+    return ((uint64_t)high << 16) | count;
+}
+
+ /*****************************************************************
+ LPTIM1_IRQHandler
+
+    Counts a wrap
+*****************************************************************/
+void LPTIM1_IRQHandler(void)
+{
+    LPTIM1->ICR = (1u << 1);
+    wraps++;
+}
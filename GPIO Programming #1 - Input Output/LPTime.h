@@ -0,0 +1,15 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+//LPTIM1 COUNTS LSI, WHICH KEEPS RUNNING IN STOP 1 AND STOP 2. LSI IS
+//ONLY TRIMMED TO ABOUT 5%, SO THIS IS FOR SHARES AND TIMESTAMPS,
+//NOT FOR KEEPING THE TIME OF DAY
+#define LPTIME_HZ               32000u
+
+//LPTIM1 TICKS TO MICROSECONDS
+#define LPTIME_TO_US(ticks)     (((uint64_t)(ticks) * 1000000u) / LPTIME_HZ)
+
+void initLPTime(void);
+uint64_t getLPTime(void);
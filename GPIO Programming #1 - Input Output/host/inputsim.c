@@ -0,0 +1,424 @@
+/*****************************************************************
+* inputsim
+*
+* Runs Input.c against the pin, EXTI, TIM6 and LPTIM1 models in
+* host/sim/ and feeds it bouncing edges, with the main loop taking
+* events out every microsecond.
+*
+*	bounce		a press and a release that each bounce for a few
+*				ms give one event each, at the level the pin
+*				settled at, INPUT_DEBOUNCE_MS after the first edge
+*				and with only the first edge interrupting. The
+*				timestamps follow the simulated time, idle time
+*				between the presses included
+*	glitch		a pulse that is over before the debounce ends
+*				gives no event
+*	long		bouncing that goes on past the debounce still
+*				ends with the level the pin settled at
+*	overlap		two lines bouncing at once both report, and TIM6
+*				runs until the later one has settled
+*	edges		a line that only asked for falling edges doesn't
+*				report rising ones
+*	full		events that don't fit the queue are counted as
+*				dropped and the rest come out in order
+*	idle		TIM6 is stopped and nothing but the LPTIM1 wrap
+*				interrupts while no line is debouncing
+*
+* Build:	cc -O2 -no-pie -I../../host/sim -I.. -o inputsim inputsim.c ../../host/sim/sim.c ../Input.c ../LPTime.c
+* Usage:	inputsim
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "GPIO.h"
+#include "Input.h"
+#include "LPTime.h"
+
+#define DEBOUNCE_US		(INPUT_DEBOUNCE_MS * 1000u)
+
+//time the handlers take on top of the debounce at the 4MHz the
+//sim starts on, in microseconds
+#define SLACK_US		50u
+
+//the timestamps are in whole LPTIM1 ticks
+#define TICK_US			((1000000u + LPTIME_HZ - 1u) / LPTIME_HZ)
+
+//pin changes that can be waiting at once
+#define MAX_CHANGES		64u
+
+//events the main loop can keep
+#define MAX_EVENTS		64u
+
+//a pin change at a set time
+typedef struct
+{
+	uint64_t atUs;
+	GPIO_TypeDef *port;
+	uint8_t pin;
+	uint8_t level;
+} Change;
+
+//an event and when the main loop got it
+typedef struct
+{
+	InputEvent event;
+	uint64_t readUs;
+} Received;
+
+static Change changes[MAX_CHANGES];
+static uint32_t changeCount = 0;
+
+static Received received[MAX_EVENTS];
+static uint32_t receivedCount = 0;
+static uint8_t reading = 1;
+
+//interrupts and LPTIM1 wraps when the scenario started
+static uint64_t irqsBefore = 0;
+static uint64_t wrapsBefore = 0;
+
+//simulated time when initInput started LPTIM1
+static uint64_t baseUs = 0;
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+	if(!ok)
+	{
+		printf("FAIL: %s\n", what);
+		errors++;
+	}
+}
+
+static uint64_t nowUs(void)
+{
+	return simTimePs() / SIM_PS_PER_US;
+}
+
+/*****************************************************************
+* irqs
+*
+* Returns the interrupts taken since the scenario started, less
+* the LPTIM1 wraps, which come every 2 seconds whatever the inputs
+* do.
+*****************************************************************/
+static uint32_t irqs(void)
+{
+	SimStats stats;
+
+	simGetStats(&stats);
+
+	return (uint32_t)((stats.interrupts - irqsBefore) - ((getLPTime() >> 16) - wrapsBefore));
+}
+
+static void addChange(uint64_t atUs, GPIO_TypeDef *port, uint8_t pin, uint8_t level)
+{
+	if(changeCount < MAX_CHANGES)
+	{
+		changes[changeCount].atUs = atUs;
+		changes[changeCount].port = port;
+		changes[changeCount].pin = pin;
+		changes[changeCount].level = level;
+		changeCount++;
+	}
+}
+
+/*****************************************************************
+* addBounce
+*
+* Toggles a pin 'count' times, 'gaps' microseconds apart, starting
+* at 'atUs'. An odd count leaves it at the other level.
+*****************************************************************/
+static void addBounce(uint64_t atUs, GPIO_TypeDef *port, uint8_t pin, uint8_t from, const uint32_t *gaps, uint32_t count)
+{
+	uint8_t level = from;
+	uint32_t i;
+
+	for(i = 0; i < count; i++)
+	{
+		level ^= 1u;
+		addChange(atUs, port, pin, level);
+		atUs += gaps[i];
+	}
+}
+
+/*****************************************************************
+* runUs
+*
+* Runs for 'us' microseconds, making the pin changes that are due
+* and taking events out as the main loop would.
+*****************************************************************/
+static void runUs(uint64_t us)
+{
+	uint64_t end = nowUs() + us;
+	uint32_t i;
+
+	while(nowUs() < end)
+	{
+		for(i = 0; i < changeCount; )
+		{
+			if(changes[i].atUs <= nowUs())
+			{
+				simSetPin(changes[i].port, changes[i].pin, changes[i].level);
+				changes[i] = changes[--changeCount];
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		simRunUs(1u);
+
+		while(reading && (receivedCount < MAX_EVENTS) && readInput(&received[receivedCount].event))
+		{
+			received[receivedCount].readUs = nowUs();
+			receivedCount++;
+		}
+	}
+}
+
+/*****************************************************************
+* checkEvent
+*
+* Checks event 'n' is the right pin and level, and came
+* INPUT_DEBOUNCE_MS after 'edgeUs', both by its own timestamps and
+* by the time the main loop saw it, and that edgeUs is the time of
+* 'edgeUs' since initInput. The first tick is short by what TIM6
+* had already counted if another line kept it running, the
+* handlers add up to SLACK_US and the timestamps are out by up to
+* a tick.
+*****************************************************************/
+static void checkEvent(uint32_t n, uint8_t pin, uint8_t level, uint64_t edgeUs)
+{
+	InputEvent *event = &received[n].event;
+	uint32_t latency = event->reportUs - event->edgeUs;
+	uint64_t seen = received[n].readUs - edgeUs;
+	uint64_t since = edgeUs - baseUs;
+
+	check(n < receivedCount, "event reported");
+	check((event->pin == pin) && (event->level == level), "event has the pin and the level it settled at");
+	check((event->edgeUs + TICK_US >= since) && (event->edgeUs <= since + SLACK_US + TICK_US),
+	      "edge timestamp is the time since initInput");
+	check((latency > (DEBOUNCE_US - 1000u - TICK_US)) && (latency <= DEBOUNCE_US + SLACK_US + TICK_US),
+	      "timestamps a debounce apart");
+	check((seen > (DEBOUNCE_US - 1000u)) && (seen <= DEBOUNCE_US + SLACK_US), "event seen a debounce after the first edge");
+}
+
+static void startScenario(void)
+{
+	SimStats stats;
+
+	simGetStats(&stats);
+	irqsBefore = stats.interrupts;
+	wrapsBefore = getLPTime() >> 16;
+	receivedCount = 0;
+	reading = 1;
+}
+
+static void checkStopped(const char *what)
+{
+	uint32_t before = irqs();
+
+	runUs(1000000u);
+	check(!(TIM6->CR1 & (1U << 0)), what);
+	check(irqs() == before, "no interrupts while idle");
+}
+
+static void checkBounce(void)
+{
+	static const uint32_t press[] = {80u, 120u, 150u, 550u, 600u, 1100u, 1};
+	static const uint32_t release[] = {300u, 200u, 900u, 400u, 1};
+	uint64_t pressUs;
+	uint64_t releaseUs;
+
+	startScenario();
+
+	//PB4 idles high. pressing pulls it low, after 7 edges
+	pressUs = nowUs() + 100u;
+	addBounce(pressUs, GPIOB, 4u, 1u, press, sizeof(press) / sizeof(press[0]));
+	runUs(DEBOUNCE_US + 5000u);
+
+	check(receivedCount == 1u, "one event per bouncing press");
+	checkEvent(0u, 4u, 0u, pressUs);
+	check(irqs() == 1u + INPUT_DEBOUNCE_MS, "only the first edge interrupts, then TIM6 for the debounce");
+	check(!(TIM6->CR1 & (1U << 0)), "TIM6 stopped after the debounce");
+
+	releaseUs = nowUs() + 100u;
+	addBounce(releaseUs, GPIOB, 4u, 0u, release, sizeof(release) / sizeof(release[0]));
+	runUs(DEBOUNCE_US + 5000u);
+
+	check(receivedCount == 2u, "one event per bouncing release");
+	checkEvent(1u, 4u, 1u, releaseUs);
+
+	printf("press and release: %u events, %u interrupts, %u and %u us\n", receivedCount, irqs(),
+	       received[0].event.reportUs - received[0].event.edgeUs,
+	       received[1].event.reportUs - received[1].event.edgeUs);
+
+	checkStopped("TIM6 stopped once both settled");
+}
+
+static void checkGlitch(void)
+{
+	static const uint32_t glitch[] = {300u, 1};
+
+	startScenario();
+
+	addBounce(nowUs() + 100u, GPIOB, 4u, 1u, glitch, 2u);
+	runUs(DEBOUNCE_US + 5000u);
+
+	check(receivedCount == 0u, "a glitch shorter than the debounce gives no event");
+	checkStopped("TIM6 stopped after a glitch");
+}
+
+static void checkLong(void)
+{
+	uint32_t gaps[40];
+	uint32_t i;
+
+	startScenario();
+
+	//bounces every 0.7ms for 28ms, settling low
+	for(i = 0; i < 40u; i++)
+	{
+		gaps[i] = 700u;
+	}
+	addBounce(nowUs() + 100u, GPIOB, 4u, 1u, gaps, 39u);
+	runUs(3u * DEBOUNCE_US + 30000u);
+
+	check(receivedCount >= 1u, "a long bounce reports");
+	check(received[receivedCount - 1u].event.level == 0u, "last event at the level the pin settled at");
+
+	for(i = 1; i < receivedCount; i++)
+	{
+		check(received[i].event.level != received[i - 1u].event.level, "events alternate");
+	}
+
+	//put it back
+	addChange(nowUs() + 1u, GPIOB, 4u, 1u);
+	runUs(DEBOUNCE_US + 5000u);
+
+	checkStopped("TIM6 stopped after a long bounce");
+}
+
+static void checkOverlap(void)
+{
+	static const uint32_t bounce[] = {150u, 250u, 400u, 1};
+	uint64_t firstUs;
+	uint64_t secondUs;
+
+	startScenario();
+
+	//PA0 starts bouncing half way through PB4's debounce
+	firstUs = nowUs() + 100u;
+	secondUs = firstUs + (DEBOUNCE_US / 2u);
+	addBounce(firstUs, GPIOB, 4u, 1u, bounce, 3u);
+	addBounce(secondUs, GPIOA, 0u, 0u, bounce, 3u);
+	runUs((DEBOUNCE_US / 2u) + DEBOUNCE_US + 5000u);
+
+	check(receivedCount == 2u, "both lines report");
+	checkEvent(0u, 4u, 0u, firstUs);
+	checkEvent(1u, 0u, 1u, secondUs);
+	//one EXTI interrupt each, TIM6 from the first edge to the last
+	//line settling
+	check((irqs() > 2u + INPUT_DEBOUNCE_MS) && (irqs() <= 2u + (INPUT_DEBOUNCE_MS * 3u / 2u) + 1u),
+	      "TIM6 runs until the later line settles");
+
+	//put them back
+	addChange(nowUs() + 1u, GPIOB, 4u, 1u);
+	addChange(nowUs() + 1u, GPIOA, 0u, 0u);
+	runUs(DEBOUNCE_US + 5000u);
+
+	checkStopped("TIM6 stopped after both lines settled");
+}
+
+static void checkEdges(void)
+{
+	startScenario();
+
+	//PB9 only reports falling edges
+	addChange(nowUs() + 100u, GPIOB, 9u, 0u);
+	addChange(nowUs() + 100u + (2u * DEBOUNCE_US), GPIOB, 9u, 1u);
+	runUs(4u * DEBOUNCE_US);
+
+	check(receivedCount == 1u, "only the edge asked for reported");
+	check((received[0].event.pin == 9u) && (received[0].event.level == 0u), "falling edge reported");
+}
+
+static void checkFull(void)
+{
+	uint32_t extra = 4u;
+	uint32_t count = INPUT_QUEUE_SIZE + extra;
+	uint64_t atUs = nowUs() + 100u;
+	uint32_t dropped = inputEventsDropped();
+	uint32_t i;
+
+	startScenario();
+	reading = 0;
+
+	//clean presses and releases, with nobody reading
+	for(i = 0; i < count; i++)
+	{
+		addChange(atUs, GPIOB, 4u, (uint8_t)(i & 1u));
+		atUs += DEBOUNCE_US + 2000u;
+		runUs(DEBOUNCE_US + 2000u);
+	}
+	runUs(DEBOUNCE_US);
+
+	check(inputEventsDropped() - dropped == extra, "events past the queue size dropped");
+
+	reading = 1;
+	runUs(1u);
+
+	check(receivedCount == INPUT_QUEUE_SIZE, "a full queue of events kept");
+	for(i = 0; i < receivedCount; i++)
+	{
+		check(received[i].event.level == (i & 1u), "queued events in order");
+	}
+
+	//end with the pin high, as it started
+	if(count & 1u)
+	{
+		addChange(nowUs() + 1u, GPIOB, 4u, 1u);
+		runUs(DEBOUNCE_US + 2000u);
+	}
+}
+
+int main(void)
+{
+	simInit();
+
+	//PB4 and PB9 idle high on their pull-ups, PA0 low
+	baseUs = nowUs();
+	initInput();
+	check(TIM6->PSC == (INPUT_TIMER_CLOCK_HZ / 1000000u) - 1u, "TIM6 counts microseconds");
+	check(!(TIM6->CR1 & (1U << 0)), "TIM6 stopped until the first edge");
+
+	check(addInputPin(GPIOB, 4u, GPIO_PULL_UP, INPUT_EDGE_BOTH), "PB4 added");
+	check(addInputPin(GPIOA, 0u, GPIO_PULL_DOWN, INPUT_EDGE_BOTH), "PA0 added");
+	check(addInputPin(GPIOB, 9u, GPIO_PULL_UP, INPUT_EDGE_FALLING), "PB9 added");
+	check(!addInputPin(GPIOA, 4u, GPIO_PULL_NONE, INPUT_EDGE_BOTH), "EXTI line taken by another port refused");
+	check(!addInputPin(GPIOA, 16u, GPIO_PULL_NONE, INPUT_EDGE_BOTH), "pin 16 refused");
+
+	checkStopped("TIM6 stopped with no edges");
+	checkBounce();
+	checkGlitch();
+	checkLong();
+	checkOverlap();
+	checkEdges();
+	checkFull();
+	checkStopped("TIM6 stopped at the end");
+
+	if(errors)
+	{
+		printf("%u check(s) failed\n", errors);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
@@ -1,4 +1,7 @@
 #include "stm32l432xx.h"
+#include "GPIO.h"
+#include "Input.h"
+#include "Power.h"
 
 void initGPIO(void);
 
@@ -13,27 +16,51 @@ void initGPIO(void)
 	//enable clock for GPIO B
 	RCC->AHB2ENR |= (1U << 1);
 
-	//set bits 6,7,8 and 9 to 0. Since bits 8 and 9 were set to 0, PB_4 already set to input mode
-	GPIOB->MODER &= ~(15U << 6);
+	//set PB_3 to output mode. PB_4 is set up by addInputPin
+	GPIO_WRITE_FIELD(GPIOB->MODER, GPIO_MODER_MSK(3), GPIO_MODER_SET(3, GPIO_MODE_OUTPUT));
+}
 
-	//set PB_3 to output mode
-	GPIOB->MODER |= (1U << 6);
+/*****************************************************************
+* queryPower
+*
+* Tells the power layer what is running. TIM6 stops in Stop mode,
+* so only Sleep is used while the button is debouncing. An event
+* already queued keeps the core awake.
+*****************************************************************/
+static void queryPower(PowerState *state)
+{
+	state->timerPending = 0;
+	state->ticksToDeadline = 0;
+	state->busy = inputDebouncing();
+	state->workPending = inputPending();
+	state->uartStopWake = 0;
 }
 
 int main(void)
 {		
-	int btnPressed = 0;		//state of button pin (PB_4) saved here
+	InputEvent event;		//debounced button changes are read into here
 
 	//initialise GPIO
 	initGPIO();
-	
-	//loop around checking if button was pressed.
-	while(!btnPressed)
+
+	//report debounced presses and releases of the button (PB_4)
+	initInput();
+	addInputPin(GPIOB, 4, GPIO_PULL_NONE, INPUT_EDGE_BOTH);
+
+	//only the button's EXTI line wakes us, so Stop 2 between presses
+	initPower(POWER_WAKE_EXTI, queryPower);
+
+	while(1)
 	{
-		//inspect the state of the button pin by checking bit 4 of GPIOB_IDR
-		btnPressed = (GPIOB->IDR & (1U << 4));
+		//sleep until the button changes. enterLowPower asks queryPower
+		//with interrupts masked, so an event queued just before it
+		//sleeps still keeps the core awake
+		while(!readInput(&event))
+		{
+			enterLowPower(0);
+		}
+
+		//LED on while the button is held. one store to BSRR either way
+		GPIO_WRITE_PINS(GPIOB, 1U << 3, event.level ? (1U << 3) : 0U);
 	}
-	
-	//button was pressed, turn LED on
-	GPIOB->ODR |= (1U << 3);
 }
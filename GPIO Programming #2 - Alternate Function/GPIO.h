@@ -0,0 +1,151 @@
+#ifndef GPIO_H
+#define GPIO_H
+
+/*****************************************************************
+ GPIO pin configuration masks
+
+    All of the macros below are constant expressions so the
+    compiler works out the final register masks. A peripheral's
+    pins on one port are listed once as a pin list:
+
+        #define SPI1_PORTA_PINS(PIN)  PIN(1, 5) PIN(11, 5) PIN(12, 5)
+
+    where each entry is PIN(pin number, alternate function). The
+    GPIO_AF_... macros merge every pin in a list into a single
+    mask/value pair so each register is updated with one
+    read-modify-write.
+
+    Output pins are driven through BSRR and BRR with the
+    GPIO_PIN_... and GPIO_WRITE_... macros near the end.
+*****************************************************************/
+
+//PIN MODES (MODER)
+#define GPIO_MODE_INPUT     0u
+#define GPIO_MODE_OUTPUT    1u
+#define GPIO_MODE_AF        2u
+#define GPIO_MODE_ANALOG    3u
+
+//OUTPUT TYPES (OTYPER)
+#define GPIO_OTYPE_PUSHPULL     0u
+#define GPIO_OTYPE_OPENDRAIN    1u
+
+//OUTPUT SPEEDS (OSPEEDR)
+#define GPIO_SPEED_LOW      0u
+#define GPIO_SPEED_MEDIUM   1u
+#define GPIO_SPEED_HIGH     2u
+#define GPIO_SPEED_VERYHIGH 3u
+
+//PULL-UP / PULL-DOWN (PUPDR)
+#define GPIO_PULL_NONE      0u
+#define GPIO_PULL_UP        1u
+#define GPIO_PULL_DOWN      2u
+
+
+//SINGLE PIN FIELDS. TWO BITS PER PIN IN MODER, OSPEEDR AND PUPDR
+#define GPIO_MODER_MSK(pin)             (3u << (2u * (pin)))
+#define GPIO_MODER_SET(pin, mode)       ((uint32_t)(mode) << (2u * (pin)))
+#define GPIO_OSPEEDR_MSK(pin)           (3u << (2u * (pin)))
+#define GPIO_OSPEEDR_SET(pin, speed)    ((uint32_t)(speed) << (2u * (pin)))
+#define GPIO_PUPDR_MSK(pin)             (3u << (2u * (pin)))
+#define GPIO_PUPDR_SET(pin, pull)       ((uint32_t)(pull) << (2u * (pin)))
+
+//ONE BIT PER PIN IN OTYPER
+#define GPIO_OTYPER_MSK(pin)            (1u << (pin))
+#define GPIO_OTYPER_SET(pin, type)      ((uint32_t)(type) << (pin))
+
+//FOUR BITS PER PIN. AFR[0] (AFRL) COVERS PINS 0 TO 7, AFR[1] (AFRH)
+//COVERS PINS 8 TO 15. A PIN IN THE OTHER HALF GIVES 0
+#define GPIO_AFRL_MSK(pin)              (((pin) < 8u) ? (15u << (4u * ((pin) & 7u))) : 0u)
+#define GPIO_AFRL_SET(pin, af)          (((pin) < 8u) ? ((uint32_t)(af) << (4u * ((pin) & 7u))) : 0u)
+#define GPIO_AFRH_MSK(pin)              (((pin) >= 8u) ? (15u << (4u * ((pin) & 7u))) : 0u)
+#define GPIO_AFRH_SET(pin, af)          (((pin) >= 8u) ? ((uint32_t)(af) << (4u * ((pin) & 7u))) : 0u)
+
+
+//PER PIN HELPERS USED TO EXPAND A PIN LIST. NOT USED DIRECTLY
+#define GPIO_PIN_MODER_MSK_(pin, af)    | GPIO_MODER_MSK(pin)
+#define GPIO_PIN_MODER_AF_(pin, af)     | GPIO_MODER_SET(pin, GPIO_MODE_AF)
+#define GPIO_PIN_AFRL_MSK_(pin, af)     | GPIO_AFRL_MSK(pin)
+#define GPIO_PIN_AFRL_SET_(pin, af)     | GPIO_AFRL_SET(pin, af)
+#define GPIO_PIN_AFRH_MSK_(pin, af)     | GPIO_AFRH_MSK(pin)
+#define GPIO_PIN_AFRH_SET_(pin, af)     | GPIO_AFRH_SET(pin, af)
+#define GPIO_PIN_OTYPER_MSK_(pin, af)   | GPIO_OTYPER_MSK(pin)
+#define GPIO_PIN_OSPEEDR_MSK_(pin, af)  | GPIO_OSPEEDR_MSK(pin)
+#define GPIO_PIN_OSPEEDR_ONE_(pin, af)  | GPIO_OSPEEDR_SET(pin, 1u)
+
+//MERGED MASKS AND VALUES FOR EVERY PIN IN A PIN LIST
+#define GPIO_AF_MODER_MSK(pins)         (0u pins(GPIO_PIN_MODER_MSK_))
+#define GPIO_AF_MODER_SET(pins)         (0u pins(GPIO_PIN_MODER_AF_))
+#define GPIO_AF_AFRL_MSK(pins)          (0u pins(GPIO_PIN_AFRL_MSK_))
+#define GPIO_AF_AFRL_SET(pins)          (0u pins(GPIO_PIN_AFRL_SET_))
+#define GPIO_AF_AFRH_MSK(pins)          (0u pins(GPIO_PIN_AFRH_MSK_))
+#define GPIO_AF_AFRH_SET(pins)          (0u pins(GPIO_PIN_AFRH_SET_))
+
+//ONE OUTPUT TYPE OR SPEED GIVEN TO EVERY PIN IN A PIN LIST. A 1 IN
+//EACH PIN'S FIELD TIMES 'speed' PUTS 'speed' IN EVERY FIELD
+#define GPIO_LIST_OTYPER_MSK(pins)              (0u pins(GPIO_PIN_OTYPER_MSK_))
+#define GPIO_LIST_OTYPER_SET(pins, type)        (GPIO_LIST_OTYPER_MSK(pins) * ((uint32_t)(type) & 1u))
+#define GPIO_LIST_OSPEEDR_MSK(pins)             (0u pins(GPIO_PIN_OSPEEDR_MSK_))
+#define GPIO_LIST_OSPEEDR_SET(pins, speed)      ((0u pins(GPIO_PIN_OSPEEDR_ONE_)) * ((uint32_t)(speed) & 3u))
+
+
+//UPDATE THE BITS OF 'reg' IN 'msk' TO 'val' WITH ONE READ-MODIFY-WRITE.
+//NOTHING IS WRITTEN WHEN THE MASK IS 0
+#define GPIO_WRITE_FIELD(reg, msk, val)                     \
+    do                                                      \
+    {                                                       \
+        if((msk) != 0u)                                     \
+        {                                                   \
+            (reg) = ((reg) & ~(uint32_t)(msk)) | (val);     \
+        }                                                   \
+    } while(0)
+
+//SET ALL PINS IN A PIN LIST TO ALTERNATE FUNCTION MODE
+#define GPIO_SET_AF_MODE(port, pins)    GPIO_WRITE_FIELD((port)->MODER, GPIO_AF_MODER_MSK(pins), GPIO_AF_MODER_SET(pins))
+
+//LOAD THE ALTERNATE FUNCTION OF ALL PINS IN A PIN LIST
+#define GPIO_SET_AF(port, pins)                                                         \
+    do                                                                                  \
+    {                                                                                   \
+        GPIO_WRITE_FIELD((port)->AFR[0], GPIO_AF_AFRL_MSK(pins), GPIO_AF_AFRL_SET(pins)); \
+        GPIO_WRITE_FIELD((port)->AFR[1], GPIO_AF_AFRH_MSK(pins), GPIO_AF_AFRH_SET(pins)); \
+    } while(0)
+
+//SET THE OUTPUT TYPE (GPIO_OTYPE_...) OR SPEED (GPIO_SPEED_...) OF
+//ALL PINS IN A PIN LIST, ONE READ-MODIFY-WRITE EACH
+#define GPIO_SET_OTYPE(port, pins, type)    GPIO_WRITE_FIELD((port)->OTYPER, GPIO_LIST_OTYPER_MSK(pins), GPIO_LIST_OTYPER_SET(pins, type))
+#define GPIO_SET_SPEED(port, pins, speed)   GPIO_WRITE_FIELD((port)->OSPEEDR, GPIO_LIST_OSPEEDR_MSK(pins), GPIO_LIST_OSPEEDR_SET(pins, speed))
+
+//OUTPUTS. WRITING A 1 TO THE LOW HALF OF BSRR SETS THAT PIN, A 1
+//IN THE HIGH HALF CLEARS IT (SET WINS IF BOTH ARE GIVEN), AND A 1
+//IN BRR CLEARS IT. ZEROS LEAVE PINS ALONE, SO EACH CHANGE IS ONE
+//STORE THAT CAN'T UNDO A CHANGE AN INTERRUPT MADE TO ANOTHER PIN
+//ON THE SAME PORT, UNLIKE A READ-MODIFY-WRITE OF ODR. 'pins' IS A
+//MASK WITH ONE BIT PER PIN
+#define GPIO_BSRR_SET(pins)             ((uint32_t)(pins) & 0xFFFFu)
+#define GPIO_BSRR_RESET(pins)           (((uint32_t)(pins) & 0xFFFFu) << 16)
+
+//BSRR VALUE THAT GIVES THE PINS IN 'pins' THE MATCHING BITS OF 'value'
+#define GPIO_BSRR_WRITE(pins, value)    (GPIO_BSRR_SET((pins) & (value)) | GPIO_BSRR_RESET((pins) & ~(uint32_t)(value)))
+
+//BSRR VALUE THAT PUTS 'value' ON 'width' PINS STARTING AT 'firstPin'
+#define GPIO_BSRR_BUS(firstPin, width, value)   \
+    GPIO_BSRR_WRITE(((1u << (width)) - 1u) << (firstPin), (uint32_t)(value) << (firstPin))
+
+#define GPIO_PIN_HIGH(port, pin)        ((port)->BSRR = (1u << (pin)))
+#define GPIO_PIN_LOW(port, pin)         ((port)->BRR = (1u << (pin)))
+#define GPIO_PINS_HIGH(port, pins)      ((port)->BSRR = GPIO_BSRR_SET(pins))
+#define GPIO_PINS_LOW(port, pins)       ((port)->BRR = (uint32_t)(pins))
+
+//SET SOME PINS AND CLEAR OTHERS IN ONE STORE, E.G. MOVE CHIP SELECT
+//FROM ONE SLAVE TO ANOTHER OR DRIVE A PARALLEL BUS
+#define GPIO_WRITE_PINS(port, pins, value)      ((port)->BSRR = GPIO_BSRR_WRITE(pins, value))
+#define GPIO_WRITE_BUS(port, firstPin, width, value)    ((port)->BSRR = GPIO_BSRR_BUS(firstPin, width, value))
+
+//INVERT PINS. ODR IS READ ONCE AND THE RESULT WRITTEN TO BSRR, SO AN
+//INTERRUPT CAN'T LOSE A CHANGE TO ANY OTHER PIN
+#define GPIO_TOGGLE_PINS(port, pins)    ((port)->BSRR = GPIO_BSRR_WRITE(pins, ~(port)->ODR))
+
+//FAILS TO COMPILE IF 'cond' IS FALSE
+#define GPIO_STATIC_ASSERT(cond, name)  typedef char gpio_assert_##name[(cond) ? 1 : -1]
+
+#endif
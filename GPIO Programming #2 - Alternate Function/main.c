@@ -1,5 +1,14 @@
 #include "stm32l432xx.h"
 #include "SPI.h"
+#include "GPIO.h"
+
+//THIS PROJECT HAS SPI1 ON PA5, PA6 AND PA7. SEE Board.h
+#define BOARD   BOARD_B
+#include "Board.h"
+
+//THE MERGED OUTPUT TYPE AND SPEED VALUES COVER PA7, PA6 AND PA5
+GPIO_STATIC_ASSERT(GPIO_LIST_OTYPER_SET(BOARD_SPI1_PORTA_PINS, GPIO_OTYPE_OPENDRAIN) == ((1u << 7) | (1u << 6) | (1u << 5)), spi1_otyper_set);
+GPIO_STATIC_ASSERT(GPIO_LIST_OSPEEDR_SET(BOARD_SPI1_PORTA_PINS, GPIO_SPEED_HIGH) == ((2u << (2 * 7)) | (2u << (2 * 6)) | (2u << (2 * 5))), spi1_ospeedr_set);
 
 void initTim2(void);
 void delay1Sec(void);
@@ -121,37 +130,17 @@ void setupSPIMaster(void)
 *****************************************************************/
 void configGpioSpiPins(void)
 {
-    GPIOA->MODER &= ~(
-                      (3u << (2 * 7))   //CLEAR PA7
-                     |(3u << (2 * 6))   //CLEAR PA6
-                     |(3u << (2 * 5))   //CLEAR PA5
-                     );
-    
-    GPIOB->MODER &= ~(3u << (2 * 0));   //CLEAR PB0
-    
-    GPIOA->MODER |= (
-                     (2u << (2 * 7))    //SET PA7 TO AF
-                    |(2u << (2 * 6))    //SET PA6 TO AF
-                    |(2u << (2 * 5))    //SET PA5 TO AF
-                    );
+    //SET MOSI, MISO AND SCLK TO AF. ONE READ-MODIFY-WRITE PER REGISTER
+    GPIO_SET_AF_MODE(GPIOA, BOARD_SPI1_PORTA_PINS);
     
-    GPIOB->MODER |= (2u << (2 * 0));    //SET PB0 TO AF
+    //SET SSEL TO AF
+    GPIO_SET_AF_MODE(GPIOB, BOARD_SPI1_PORTB_PINS);
     
-    GPIOA->AFR[0] &= ~(                     //ACCESS AF LOWER
-                       (15u << (4 * 7))     //CLEAR PA7 AF
-                      |(15u << (4 * 6))     //CLEAR PA6 AF
-                      |(15u << (4 * 5))     //CLEAR PA5 AF
-                      );
-                      
-    GPIOB->AFR[0] &= ~(15u << (4 * 0));     //CLEAR PB0 AF
+    //SET SPI1 MOSI, MISO AND SCLK
+    GPIO_SET_AF(GPIOA, BOARD_SPI1_PORTA_PINS);
     
-    GPIOA->AFR[0] |= (
-                      (5u << (4 * 7))       //SET SPI1 MOSI
-                     |(5u << (4 * 6))       //SET SPI1 MISO
-                     |(5u << (4 * 5))       //SET SPI1 SCLK
-                     );
-                     
-    GPIOB->AFR[0] |= (5u << (4 * 0));       //SET SPI1 SSEL (CHIP SELECT)
+    //SET SPI1 SSEL (CHIP SELECT)
+    GPIO_SET_AF(GPIOB, BOARD_SPI1_PORTB_PINS);
 }
 
 int main (void)
@@ -165,7 +154,7 @@ int main (void)
     //ENABLE GPIO PORT A AND B CLOCKS.
     enablePortClocks();
     
-    //CONFIGURE GPIO PINS PA7,6,5 AND PB0 TO SPI1 ALTERNATE FUNCTION
+    //CONFIGURE THE BOARD'S SPI1 PINS TO ALTERNATE FUNCTION
     configGpioSpiPins();
     
     //SETUP SPI MASTER
@@ -1,9 +1,14 @@
 #include "stm32l432xx.h"
+#include "GPIO.h"
 
 void initLED(void);
 void initTim2(void);
 void delay1Sec(void);
 void toggleLED(void);
+void TIM2_IRQHandler(void);
+
+//SET BY THE TIM2 INTERRUPT EVERY TIME THE COUNTER RESETS
+static volatile uint8_t secondPassed = 0;
 
 
 /*****************************************************************
@@ -45,10 +50,28 @@ void initTim2(void)
     //SET INITIAL COUNTER VALUE
     TIM2->CNT = 0;
     
+    //INTERRUPT EVERY TIME THE COUNTER RESETS SO THE CORE CAN SLEEP
+    //INSTEAD OF WATCHING CNT
+    TIM2->DIER |= (1u << 0);
+    NVIC_EnableIRQ(TIM2_IRQn);
+    
     //ENABLE TIM2 COUNTER
     TIM2->CR1 |= (1u << 0);
 }
 
+/*****************************************************************
+* TIM2_IRQHandler
+*
+* Runs once a second when the counter resets.
+*****************************************************************/
+void TIM2_IRQHandler(void)
+{
+    //CLEAR UPDATE INTERRUPT FLAG
+    TIM2->SR &= ~(1u << 0);
+    
+    secondPassed = 1;
+}
+
 /*****************************************************************
 * toggleLED
 *
@@ -57,7 +80,7 @@ void initTim2(void)
 void toggleLED(void)
 {
     //INVERT THE STATE OF THE LED
-    GPIOB->ODR ^= (1 << 3);
+    GPIO_TOGGLE_PINS(GPIOB, 1u << 3);
     
     //WAIT FOR 1 SECOND
     delay1Sec();
@@ -66,59 +89,26 @@ void toggleLED(void)
 /*****************************************************************
 * delay1Sec
 *
-* This function introduces a delay of 1 second approximately
-* by tracking the values in the CNT register of timer 2.
-* This function relies on the frequency of the microcontroller
-* to be accurate. The STM32L432KC runs at 4MHz by default so the
-* goalCount has been set to 4,000,000 to stop the count loop when
-* the counter variable reaches or exceeds that that number as 1
-* second (approx) would have passed.
-* The value of the goalCount therefore depends on the frequency
-* of the microcontroller.
+* This function waits until the TIM2 counter next resets, which
+* happens once a second. The core sleeps until the TIM2 interrupt
+* instead of polling the CNT register. Interrupts are masked
+* between the check and WFI so the interrupt can't be missed, a
+* pending interrupt still wakes the core.
 *****************************************************************/
 void delay1Sec(void)
 {
-    /*HOLDS THE TOTAL COUNT FROM TM2_CNT REGISTER TO RECORD HOW
-    MUCH TIME ELAPSED.*/
-    unsigned int counter = 0;
-    //HOLDS THE COUNT FOR THE COUNTER TO COUNT TO.
-    unsigned int goalCount = 4000000;
-    //HOLDS THE MOST RECENT VALUE OBTAINED FROM TIM2_CNT.
-    unsigned int currentCntVal = 0;
-    //HOLDS THE PREVIOUS VALUE OBTAINED FROM TIM2_CNT.
-    unsigned int prevCntVal = 0;
-    //HOLDS RESULT OF CALCULATION BETWEEN CURRENT AND PREVIOUS COUNTS.
-    unsigned int countToAdd = 0;
+    __disable_irq();
     
-    //GET INITIAL VALUE OF CNT
-    prevCntVal = TIM2->CNT; 
-    
-    //LOOP UNTIL COUNTER IS EQUAL OR EXCEED GOAL COUNT
-    while(counter < goalCount)
+    while(!secondPassed)
     {
-        //GET NEWEST COUNT
-        currentCntVal = TIM2->CNT;
-        
-        //HANDLE SITUATION WHERE TIM2_CNT RESET
-        if(currentCntVal < prevCntVal)
-        {
-            //GET THE COUNT BEFORE THE CNT REGISTER RESET AND THEN 
-            //ADD THE COUNT AFTER IT RESET TO GET ELAPSED COUNT
-            countToAdd = (4000000 - prevCntVal) + currentCntVal;
-        }
-        else
-        {
-            //SSUBTRACT CURRENT COUNT FROM PREVIOUS COUNT TO GET
-            //ELAPSED COUNT
-            countToAdd = currentCntVal - prevCntVal;
-        }
-        
-        //ADD ELAPSED COUNT TO THE COUNTER
-        counter += countToAdd;
-        
-        //CURRENT COUNT NOW BECOMES PREVIOUS COUNT
-        prevCntVal = currentCntVal;
+        __WFI();
+        __enable_irq();
+        __disable_irq();
     }
+    
+    secondPassed = 0;
+    
+    __enable_irq();
 }
 
 int main (void)
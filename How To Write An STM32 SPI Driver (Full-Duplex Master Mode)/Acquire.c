@@ -0,0 +1,322 @@
+#include "Acquire.h"
+
+typedef char acquire_queue_check[((ACQUIRE_MAX_QUEUED & (ACQUIRE_MAX_QUEUED - 1u)) == 0u) ? 1 : -1];
+
+
+/*****************************************************************
+* Full blocks wait in a ring of pointers with free-running counts,
+* the same way as the UART ring buffers. Only the producer writes
+* 'head' and only the consumer writes 'tail', so nothing needs
+* locking, and allocPool and freePool are safe from both sides.
+* The producer takes a block from the pool when the first frame
+* of it arrives, and only while the ring has room for it, so
+* publishing it never finds the ring full.
+*
+* Nothing here touches the hardware, so it also builds on the host
+* (see host/acqsim.c).
+*****************************************************************/
+
+
+/*****************************************************************
+* initAcquire
+*
+* Sets up 'acquire' to fill blocks of 'blockFrames' frames of
+* 'channels' values taken from 'pool', which initPool must have
+* set up. Blocks still held from an earlier run are not freed.
+* Removes all stages.
+*
+* Returns 1 on success, 0 if a size is out of range or a block
+* doesn't fit in the pool's blocks.
+*****************************************************************/
+uint8_t initAcquire(Acquire *acquire, Pool *pool, size_t blockFrames, uint8_t channels)
+{
+    if((blockFrames == 0u) || (channels == 0u) || (channels > ACQUIRE_MAX_CHANNELS)
+     || ((blockFrames * channels * sizeof(int16_t)) > poolBlockSize(pool)))
+    {
+        return 0;
+    }
+
+    acquire->pool = pool;
+    acquire->filling = 0;
+    acquire->blockFrames = blockFrames;
+    acquire->channels = channels;
+    acquire->head = 0;
+    acquire->tail = 0;
+    acquire->filled = 0;
+    acquire->dropping = 0;
+    acquire->stages = 0;
+    acquire->stats.frames = 0;
+    acquire->stats.framesDropped = 0;
+    acquire->stats.overruns = 0;
+    acquire->stats.blocks = 0;
+    acquire->stats.blocksProcessed = 0;
+
+    return 1;
+}
+
+/*****************************************************************
+* addAcquireStage
+*
+* Adds a stage to the end of the chain runAcquire runs over every
+* block. 'stage' must stay valid while the pipeline is used.
+*****************************************************************/
+void addAcquireStage(Acquire *acquire, AcquireStage *stage, AcquireStageFunction function, void *arg)
+{
+    AcquireStage **link = &acquire->stages;
+
+    stage->next = 0;
+    stage->function = function;
+    stage->arg = arg;
+
+    while(*link)
+    {
+        link = &(*link)->next;
+    }
+
+    *link = stage;
+}
+
+/*****************************************************************
+* getAcquireSlot
+*
+* Producer side. Finds where the next frames go so they can be
+* written straight into the buffer, by DMA or otherwise.
+*
+* Returns the place for the next frame and sets 'frames' to how
+* many fit before the block is full. Returns 0 if the pool is
+* empty or the ring is full, the frames should then be given to
+* dropAcquire.
+*****************************************************************/
+int16_t *getAcquireSlot(Acquire *acquire, size_t *frames)
+{
+    if(!acquire->filling)
+    {
+        if((acquire->head - acquire->tail) < ACQUIRE_MAX_QUEUED)
+        {
+            acquire->filling = (int16_t *)allocPool(acquire->pool);
+        }
+
+        if(!acquire->filling)
+        {
+            *frames = 0;
+            return 0;
+        }
+    }
+
+    acquire->dropping = 0;
+    *frames = acquire->blockFrames - acquire->filled;
+
+    return acquire->filling + (acquire->filled * acquire->channels);
+}
+
+/*****************************************************************
+* commitAcquire
+*
+* Producer side. Marks 'frames' frames written at the slot
+* getAcquireSlot gave, handing the block to the consumer once it
+* is full.
+*****************************************************************/
+void commitAcquire(Acquire *acquire, size_t frames)
+{
+    acquire->filled += frames;
+    acquire->stats.frames += (uint32_t)frames;
+
+    if(acquire->filled >= acquire->blockFrames)
+    {
+        acquire->queue[acquire->head & (ACQUIRE_MAX_QUEUED - 1u)] = acquire->filling;
+        acquire->filling = 0;
+        acquire->filled = 0;
+        acquire->stats.blocks++;
+
+        //PUBLISH THE BLOCK TO THE CONSUMER
+        acquire->head = acquire->head + 1u;
+    }
+}
+
+/*****************************************************************
+* dropAcquire
+*
+* Producer side. Counts 'frames' frames that had nowhere to go.
+*****************************************************************/
+void dropAcquire(Acquire *acquire, size_t frames)
+{
+    if(!acquire->dropping)
+    {
+        acquire->dropping = 1;
+        acquire->stats.overruns++;
+    }
+
+    acquire->stats.framesDropped += (uint32_t)frames;
+}
+
+/*****************************************************************
+* readAcquire
+*
+* Consumer side. The oldest full block stays the consumer's, in
+* place, until releaseAcquire or takeAcquire.
+*
+* Returns the block, blockFrames frames long, or 0 if none is full
+*****************************************************************/
+int16_t *readAcquire(Acquire *acquire)
+{
+    uint32_t tail = acquire->tail;
+
+    if(tail == acquire->head)
+    {
+        return 0;
+    }
+
+    return acquire->queue[tail & (ACQUIRE_MAX_QUEUED - 1u)];
+}
+
+/*****************************************************************
+* releaseAcquire
+*
+* Consumer side. Frees the block readAcquire gave back to the
+* pool.
+*****************************************************************/
+void releaseAcquire(Acquire *acquire)
+{
+    freePool(acquire->pool, takeAcquire(acquire));
+}
+
+/*****************************************************************
+* takeAcquire
+*
+* Consumer side. Takes the oldest full block out of the pipeline.
+* It is the caller's from then on, to pass on by pointer, and
+* must be given back with freePool on the pipeline's pool.
+*
+* Returns the block, blockFrames frames long, or 0 if none is full
+*****************************************************************/
+int16_t *takeAcquire(Acquire *acquire)
+{
+    int16_t *block = readAcquire(acquire);
+
+    if(block)
+    {
+        acquire->stats.blocksProcessed++;
+        acquire->tail = acquire->tail + 1u;
+    }
+
+    return block;
+}
+
+/*****************************************************************
+* runAcquire
+*
+* Consumer side. Runs the stage chain over the oldest full block
+* and releases it.
+*
+* Returns 1 if a block was processed, 0 if none was full
+*****************************************************************/
+uint8_t runAcquire(Acquire *acquire)
+{
+    int16_t *data = readAcquire(acquire);
+    size_t frames = acquire->blockFrames;
+    AcquireStage *stage;
+
+    if(!data)
+    {
+        return 0;
+    }
+
+    for(stage = acquire->stages; stage && (frames > 0u); stage = stage->next)
+    {
+        frames = stage->function(data, frames, acquire->channels, stage->arg);
+    }
+
+    releaseAcquire(acquire);
+
+    return 1;
+}
+
+/*****************************************************************
+* getAcquireStats
+*
+* Copies the counters. The producer may be part way through
+* updating them.
+*****************************************************************/
+void getAcquireStats(const Acquire *acquire, AcquireStats *stats)
+{
+    stats->frames = acquire->stats.frames;
+    stats->framesDropped = acquire->stats.framesDropped;
+    stats->overruns = acquire->stats.overruns;
+    stats->blocks = acquire->stats.blocks;
+    stats->blocksProcessed = acquire->stats.blocksProcessed;
+}
+
+/*****************************************************************
+* decimateAcquire
+*
+* Stage. Replaces every 'factor' frames with their average, in
+* place. Frames left over at the end of the block are dropped.
+* 'arg' is an AcquireDecimate.
+*****************************************************************/
+size_t decimateAcquire(int16_t *data, size_t frames, uint8_t channels, void *arg)
+{
+    const AcquireDecimate *decimate = (const AcquireDecimate *)arg;
+    size_t out = frames / decimate->factor;
+    size_t i;
+    size_t j;
+    uint8_t c;
+
+    for(i = 0; i < out; i++)
+    {
+        const int16_t *in = &data[i * decimate->factor * channels];
+
+        for(c = 0; c < channels; c++)
+        {
+            int32_t sum = 0;
+
+            for(j = 0; j < decimate->factor; j++)
+            {
+                sum += in[(j * channels) + c];
+            }
+
+            //THE OUTPUT NEVER GETS AHEAD OF THE INPUT, SO IN PLACE IS SAFE
+            data[(i * channels) + c] = (int16_t)(sum / (int32_t)decimate->factor);
+        }
+    }
+
+    return out;
+}
+
+/*****************************************************************
+* lowPassAcquire
+*
+* Stage. First order low-pass on every channel, in place. The
+* state carries on from one block to the next. 'arg' is an
+* AcquireLowPass.
+*****************************************************************/
+size_t lowPassAcquire(int16_t *data, size_t frames, uint8_t channels, void *arg)
+{
+    AcquireLowPass *filter = (AcquireLowPass *)arg;
+    size_t i;
+    uint8_t c;
+
+    //START FROM THE FIRST VALUE RATHER THAN RAMPING UP FROM 0
+    if(!filter->primed && (frames > 0u))
+    {
+        for(c = 0; c < channels; c++)
+        {
+            filter->state[c] = (int32_t)data[c] * 65536;
+        }
+        filter->primed = 1;
+    }
+
+    for(i = 0; i < frames; i++)
+    {
+        for(c = 0; c < channels; c++)
+        {
+            int32_t *y = &filter->state[c];
+
+            //A FULL SCALE STEP IS 2^32 - 2^16 IN Q16, ONE BIT TOO MANY
+            //FOR int32_t. y ITSELF STAYS BETWEEN ITS OLD VALUE AND x
+            *y += (int32_t)((((int64_t)data[(i * channels) + c] * 65536) - *y) >> filter->shift);
+            data[(i * channels) + c] = (int16_t)((*y + 32768) >> 16);
+        }
+    }
+
+    return frames;
+}
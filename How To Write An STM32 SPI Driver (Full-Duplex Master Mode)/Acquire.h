@@ -0,0 +1,103 @@
+#ifndef ACQUIRE_H
+#define ACQUIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Pool.h"
+
+/*****************************************************************
+* Block based acquisition. An interrupt (the producer) writes
+* frames of 'channels' int16_t values into a block taken from a
+* Pool while the main loop (the consumer) works on the blocks
+* already full. The consumer runs a chain of stages over each
+* block in place, each one free to shrink it (decimation) or
+* change it (filtering), and the last one usually sends it
+* somewhere. A consumer can also take a block out of the pipeline
+* and hand it on, to the UART say, without copying it. Whoever
+* has it last frees it to the pool.
+*
+* A pool of 2 blocks gives double buffering. If the producer
+* finishes a block while the pool is empty the frames that arrive
+* until the consumer frees one are dropped and counted.
+*****************************************************************/
+
+//MOST CHANNELS IN A FRAME
+#define ACQUIRE_MAX_CHANNELS    8u
+
+//MOST FULL BLOCKS WAITING FOR THE CONSUMER. MUST BE A POWER OF 2
+#ifndef ACQUIRE_MAX_QUEUED
+#define ACQUIRE_MAX_QUEUED      8u
+#endif
+
+//ONE STAGE. 'data' HOLDS 'frames' FRAMES OF 'channels' VALUES, WHICH
+//THE STAGE MAY CHANGE IN PLACE. RETURNS HOW MANY FRAMES ARE LEFT FOR
+//THE NEXT STAGE, 0 TO STOP THE CHAIN FOR THIS BLOCK
+typedef size_t (*AcquireStageFunction)(int16_t *data, size_t frames, uint8_t channels, void *arg);
+
+typedef struct AcquireStage AcquireStage;
+
+struct AcquireStage
+{
+    AcquireStage *next;
+    AcquireStageFunction function;
+    void *arg;
+};
+
+//COUNTERS FOR SIZING THE BLOCKS
+typedef struct
+{
+    uint32_t frames;                //FRAMES STORED
+    uint32_t framesDropped;         //FRAMES THAT ARRIVED WITH NO BLOCK TO GO IN
+    uint32_t overruns;              //TIMES THE PRODUCER RAN OUT OF BLOCKS
+    uint32_t blocks;                //BLOCKS FILLED
+    uint32_t blocksProcessed;       //BLOCKS THE CONSUMER HAS RELEASED OR TAKEN
+} AcquireStats;
+
+//ONE PIPELINE. ONLY TOUCH THROUGH THE FUNCTIONS BELOW
+typedef struct
+{
+    Pool *pool;                     //WHERE THE BLOCKS COME FROM
+    int16_t *filling;               //BLOCK BEING FILLED, 0 UNTIL THE NEXT FRAME
+    int16_t *volatile queue[ACQUIRE_MAX_QUEUED];    //FULL BLOCKS, OLDEST AT 'tail'
+    size_t blockFrames;             //FRAMES IN A BLOCK
+    uint8_t channels;               //VALUES IN A FRAME
+    volatile uint32_t head;         //BLOCKS FILLED, WRITTEN BY THE PRODUCER
+    volatile uint32_t tail;         //BLOCKS RELEASED, WRITTEN BY THE CONSUMER
+    size_t filled;                  //FRAMES IN 'filling'
+    uint8_t dropping;               //PRODUCER HAS NOWHERE TO WRITE
+    AcquireStage *stages;           //FIRST STAGE OF THE CHAIN
+    volatile AcquireStats stats;
+} Acquire;
+
+//AVERAGES EVERY 'factor' FRAMES INTO ONE. THE BLOCK SIZE MUST BE A
+//MULTIPLE OF 'factor'
+typedef struct
+{
+    uint16_t factor;
+} AcquireDecimate;
+
+//FIRST ORDER LOW-PASS ON EVERY CHANNEL, y += (x - y) / 2^shift
+typedef struct
+{
+    uint8_t shift;
+    uint8_t primed;                 //0 UNTIL THE FIRST FRAME HAS BEEN SEEN
+    int32_t state[ACQUIRE_MAX_CHANNELS];    //y, SCALED BY 2^16
+} AcquireLowPass;
+
+uint8_t initAcquire(Acquire *acquire, Pool *pool, size_t blockFrames, uint8_t channels);
+void addAcquireStage(Acquire *acquire, AcquireStage *stage, AcquireStageFunction function, void *arg);
+
+int16_t *getAcquireSlot(Acquire *acquire, size_t *frames);
+void commitAcquire(Acquire *acquire, size_t frames);
+void dropAcquire(Acquire *acquire, size_t frames);
+
+int16_t *readAcquire(Acquire *acquire);
+void releaseAcquire(Acquire *acquire);
+int16_t *takeAcquire(Acquire *acquire);
+uint8_t runAcquire(Acquire *acquire);
+void getAcquireStats(const Acquire *acquire, AcquireStats *stats);
+
+size_t decimateAcquire(int16_t *data, size_t frames, uint8_t channels, void *arg);
+size_t lowPassAcquire(int16_t *data, size_t frames, uint8_t channels, void *arg);
+
+#endif
@@ -0,0 +1,99 @@
+#include "CaptureMath.h"
+
+
+/*****************************************************************
+* Frequency and duty cycle from captured edge times. Edges
+* alternate between rising and falling, so only the first one's
+* direction is needed. Times are differences of a wrapping counter,
+* so each one must be shorter than a full count of the timer.
+*****************************************************************/
+
+
+/*****************************************************************
+* initCaptureStats
+*
+* Clears the totals. 'counterMask' is the largest count of the
+* timer the edges came from.
+*****************************************************************/
+void initCaptureStats(CaptureStats *stats, uint32_t counterMask)
+{
+    stats->counterMask = counterMask;
+    stats->haveRise = 0;
+    stats->lastRise = 0;
+    stats->periodTicks = 0;
+    stats->periods = 0;
+    stats->highTicks = 0;
+    stats->highs = 0;
+}
+
+/*****************************************************************
+* addCaptureEdges
+*
+* Adds 'count' edge times to the totals. 'firstRising' is 1 if
+* stamps[0] is a rising edge.
+*****************************************************************/
+void addCaptureEdges(CaptureStats *stats, const uint32_t *stamps, size_t count, uint8_t firstRising)
+{
+    uint8_t rising = firstRising ? 1u : 0u;
+    size_t i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(rising)
+        {
+            if(stats->haveRise)
+            {
+                stats->periodTicks += (stamps[i] - stats->lastRise) & stats->counterMask;
+                stats->periods++;
+            }
+
+            stats->lastRise = stamps[i];
+            stats->haveRise = 1;
+        }
+        else if(stats->haveRise)
+        {
+            stats->highTicks += (stamps[i] - stats->lastRise) & stats->counterMask;
+            stats->highs++;
+        }
+
+        rising ^= 1u;
+    }
+}
+
+/*****************************************************************
+* calcCaptureFrequency
+*
+* Returns the average frequency in mHz (1/1000 Hz), 0 if there
+* hasn't been a whole period yet.
+*****************************************************************/
+uint32_t calcCaptureFrequency(const CaptureStats *stats, uint32_t tickHz)
+{
+    if(stats->periodTicks == 0u)
+    {
+        return 0;
+    }
+
+    return (uint32_t)((((uint64_t)tickHz * 1000u * stats->periods) + (stats->periodTicks / 2u)) / stats->periodTicks);
+}
+
+/*****************************************************************
+* calcCaptureDuty
+*
+* Returns the average high time as a fraction of the average
+* period in 1/1000ths, 0 if there hasn't been a whole period yet.
+*****************************************************************/
+uint16_t calcCaptureDuty(const CaptureStats *stats)
+{
+    uint64_t duty;
+
+    if((stats->periodTicks == 0u) || (stats->highs == 0u))
+    {
+        return 0;
+    }
+
+    // (HIGH / HIGHS) / (PERIOD / PERIODS), KEPT IN INTEGERS
+    duty = ((stats->highTicks * stats->periods * 1000u) + ((stats->periodTicks * stats->highs) / 2u))
+         / (stats->periodTicks * stats->highs);
+
+    return (uint16_t)((duty > 1000u) ? 1000u : duty);
+}
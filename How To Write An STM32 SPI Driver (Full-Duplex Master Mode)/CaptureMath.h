@@ -0,0 +1,26 @@
+#ifndef CAPTURE_MATH_H
+#define CAPTURE_MATH_H
+
+// NO REGISTER ACCESS IN HERE SO THE SAME FILES BUILD ON THE HOST
+#include <stdint.h>
+#include <stddef.h>
+
+// RUNNING TOTALS FROM A STREAM OF CAPTURED EDGES. TIMES ARE IN
+// TIMER TICKS
+typedef struct
+{
+    uint32_t counterMask;       // 0xFFFF FOR 16-BIT TIMERS, 0xFFFFFFFF FOR TIM2
+    uint8_t haveRise;           // lastRise IS VALID
+    uint32_t lastRise;          // TIME OF THE LAST RISING EDGE
+    uint64_t periodTicks;       // SUM OF RISING EDGE TO RISING EDGE TIMES
+    uint32_t periods;
+    uint64_t highTicks;         // SUM OF RISING EDGE TO FALLING EDGE TIMES
+    uint32_t highs;
+} CaptureStats;
+
+void initCaptureStats(CaptureStats *stats, uint32_t counterMask);
+void addCaptureEdges(CaptureStats *stats, const uint32_t *stamps, size_t count, uint8_t firstRising);
+uint32_t calcCaptureFrequency(const CaptureStats *stats, uint32_t tickHz);
+uint16_t calcCaptureDuty(const CaptureStats *stats);
+
+#endif
@@ -0,0 +1,533 @@
+#include <string.h>
+#include "Filter.h"
+
+#if FILTER_USE_SIMD
+#if defined(__arm__) || defined(__ARM_ARCH)
+#include "stm32l432xx.h"
+
+#define smlad(x, y, acc)    __SMLAD((x), (y), (acc))
+#define smuad(x, y)         __SMUAD((x), (y))
+#define qsub16(x, y)        __QSUB16((x), (y))
+#define pkhbt(x, y)         __PKHBT((x), (y), 16)
+#define ssat16(x)           ((int16_t)__SSAT((x), 16))
+#else
+/*****************************************************************
+* C models of the DSP instructions (ARMv7-M Architecture Reference
+* Manual, A7.7) so the SIMD code can be run and checked on the host.
+*****************************************************************/
+static int16_t lo(uint32_t x) { return (int16_t)(x & 0xFFFFu); }
+static int16_t hi(uint32_t x) { return (int16_t)(x >> 16); }
+
+static int16_t ssat16(int32_t x)
+{
+    return (int16_t)((x > 32767) ? 32767 : ((x < -32768) ? -32768 : x));
+}
+
+//acc + x.lo * y.lo + x.hi * y.hi, WRAPPING AT 32 BITS
+static uint32_t smlad(uint32_t x, uint32_t y, uint32_t acc)
+{
+    return acc + (uint32_t)((int32_t)lo(x) * lo(y)) + (uint32_t)((int32_t)hi(x) * hi(y));
+}
+
+static uint32_t smuad(uint32_t x, uint32_t y)
+{
+    return smlad(x, y, 0);
+}
+
+static uint32_t qsub16(uint32_t x, uint32_t y)
+{
+    return (uint16_t)ssat16((int32_t)lo(x) - lo(y)) | ((uint32_t)(uint16_t)ssat16((int32_t)hi(x) - hi(y)) << 16);
+}
+
+static uint32_t pkhbt(uint32_t x, uint32_t y)
+{
+    return (x & 0xFFFFu) | (y << 16);
+}
+#endif
+
+//TWO int16_t FROM ANY HALFWORD ADDRESS. COMPILES TO ONE LDR
+static uint32_t read2(const int16_t *p)
+{
+    uint32_t word;
+
+    memcpy(&word, p, sizeof(word));
+
+    return word;
+}
+#endif
+
+
+/*****************************************************************
+* saturate16
+*
+* Clamps to the int16_t range, like SSAT #16.
+*****************************************************************/
+static int16_t saturate16(int32_t x)
+{
+    if(x > 32767)
+    {
+        return 32767;
+    }
+
+    if(x < -32768)
+    {
+        return -32768;
+    }
+
+    return (int16_t)x;
+}
+
+/*****************************************************************
+* initFir
+*
+* Loads 'taps' Q15 coefficients, h[0] first, and clears the delay
+* line. An odd number of taps gets a 0 tap added so they can be
+* taken two at a time.
+*
+* Returns 1 on success, 0 if there are too many taps.
+*****************************************************************/
+uint8_t initFir(Fir *fir, const int16_t *coeffs, size_t taps)
+{
+    size_t even = (taps + 1u) & ~(size_t)1u;
+    size_t i;
+
+    if((taps == 0u) || (even > FIR_MAX_TAPS))
+    {
+        return 0;
+    }
+
+    fir->taps = (uint16_t)even;
+
+    //REVERSED, SO coeffs[i] MULTIPLIES THE i'TH OLDEST SAMPLE
+    for(i = 0; i < even; i++)
+    {
+        fir->coeffs[i] = ((even - 1u - i) < taps) ? coeffs[even - 1u - i] : 0;
+    }
+
+    resetFir(fir);
+
+    return 1;
+}
+
+/*****************************************************************
+* resetFir
+*
+* Clears the delay line, as if every earlier sample was 0.
+*****************************************************************/
+void resetFir(Fir *fir)
+{
+    memset(fir->delay, 0, sizeof(fir->delay));
+    fir->pos = 0;
+}
+
+/*****************************************************************
+* pushFir
+*
+* Adds one sample to the delay line.
+*
+* Returns the last 'taps' samples, oldest first
+*****************************************************************/
+static const int16_t *pushFir(Fir *fir, int16_t x)
+{
+    uint16_t pos = fir->pos;
+
+    fir->delay[pos] = x;
+    fir->delay[pos + fir->taps] = x;
+    fir->pos = (uint16_t)((pos + 1u == fir->taps) ? 0u : (pos + 1u));
+
+    return &fir->delay[pos + 1u];
+}
+
+/*****************************************************************
+* runFir
+*
+* Filters 'count' samples from 'in' to 'out', which may be the
+* same. Both are 'stride' values from one sample to the next.
+*****************************************************************/
+void runFir(Fir *fir, const int16_t *in, int16_t *out, size_t count, size_t stride)
+{
+#if FILTER_USE_SIMD
+    const int16_t *coeffs = fir->coeffs;
+    size_t pairs = fir->taps / 2u;
+
+    while(count--)
+    {
+        const int16_t *window = pushFir(fir, *in);
+        uint32_t acc = 1u << 14;        //ROUND
+        size_t i;
+
+        //TWO TAPS PER SMLAD
+        for(i = 0; i < pairs; i++)
+        {
+            acc = smlad(read2(&window[2u * i]), read2(&coeffs[2u * i]), acc);
+        }
+
+        *out = ssat16((int32_t)acc >> 15);
+
+        in += stride;
+        out += stride;
+    }
+#else
+    runFirScalar(fir, in, out, count, stride);
+#endif
+}
+
+/*****************************************************************
+* runFirScalar
+*
+* runFir in plain C, one tap at a time. Gives the same output.
+*****************************************************************/
+void runFirScalar(Fir *fir, const int16_t *in, int16_t *out, size_t count, size_t stride)
+{
+    while(count--)
+    {
+        const int16_t *window = pushFir(fir, *in);
+        uint32_t acc = 1u << 14;
+        size_t i;
+
+        //UNSIGNED SO IT WRAPS LIKE SMLAD
+        for(i = 0; i < fir->taps; i++)
+        {
+            acc += (uint32_t)((int32_t)window[i] * fir->coeffs[i]);
+        }
+
+        *out = saturate16((int32_t)acc >> 15);
+
+        in += stride;
+        out += stride;
+    }
+}
+
+/*****************************************************************
+* initBiquad
+*
+* Loads 'sections' sections of Q14 coefficients, 5 per section in
+* the order b0, b1, b2, a1, a2 (a0 is 1), and clears their state.
+*
+* Returns 1 on success, 0 if there are too many sections or an 'a'
+* coefficient is -2.
+*****************************************************************/
+uint8_t initBiquad(Biquad *biquad, const int16_t *coeffs, uint8_t sections)
+{
+    uint8_t s;
+
+    if((sections == 0u) || (sections > BIQUAD_MAX_SECTIONS))
+    {
+        return 0;
+    }
+
+    for(s = 0; s < sections; s++)
+    {
+        const int16_t *c = &coeffs[5u * s];
+        BiquadSection *section = &biquad->sections[s];
+
+        //-a HAS TO FIT IN 16 BITS
+        if((c[3] == -32768) || (c[4] == -32768))
+        {
+            return 0;
+        }
+
+        section->b0 = c[0];
+        section->b12 = (uint16_t)c[1] | ((uint32_t)(uint16_t)c[2] << 16);
+        section->a12 = (uint16_t)(-c[3]) | ((uint32_t)(uint16_t)(-c[4]) << 16);
+    }
+
+    biquad->count = sections;
+    resetBiquad(biquad);
+
+    return 1;
+}
+
+/*****************************************************************
+* resetBiquad
+*
+* Clears the state of every section.
+*****************************************************************/
+void resetBiquad(Biquad *biquad)
+{
+    uint8_t s;
+
+    for(s = 0; s < biquad->count; s++)
+    {
+        biquad->sections[s].x12 = 0;
+        biquad->sections[s].y12 = 0;
+    }
+}
+
+/*****************************************************************
+* runBiquad
+*
+* Filters 'count' samples through every section in turn, from
+* 'in' to 'out', which may be the same. Both are 'stride' values
+* from one sample to the next.
+*****************************************************************/
+void runBiquad(Biquad *biquad, const int16_t *in, int16_t *out, size_t count, size_t stride)
+{
+#if FILTER_USE_SIMD
+    while(count--)
+    {
+        int16_t x = *in;
+        uint8_t s;
+
+        for(s = 0; s < biquad->count; s++)
+        {
+            BiquadSection *section = &biquad->sections[s];
+            uint32_t acc = (uint32_t)((int32_t)section->b0 * x) + (1u << 13);
+            int16_t y;
+
+            //b1 x1 + b2 x2 AND -a1 y1 - a2 y2, ONE SMLAD EACH
+            acc = smlad(section->x12, section->b12, acc);
+            acc = smlad(section->y12, section->a12, acc);
+            y = ssat16((int32_t)acc >> 14);
+
+            //SHIFT THE NEW VALUES INTO THE STATE
+            section->x12 = pkhbt((uint16_t)x, section->x12);
+            section->y12 = pkhbt((uint16_t)y, section->y12);
+
+            x = y;
+        }
+
+        *out = x;
+
+        in += stride;
+        out += stride;
+    }
+#else
+    runBiquadScalar(biquad, in, out, count, stride);
+#endif
+}
+
+/*****************************************************************
+* runBiquadScalar
+*
+* runBiquad in plain C, one term at a time. Gives the same output.
+*****************************************************************/
+void runBiquadScalar(Biquad *biquad, const int16_t *in, int16_t *out, size_t count, size_t stride)
+{
+    while(count--)
+    {
+        int16_t x = *in;
+        uint8_t s;
+
+        for(s = 0; s < biquad->count; s++)
+        {
+            BiquadSection *section = &biquad->sections[s];
+            int16_t x1 = (int16_t)(section->x12 & 0xFFFFu);
+            int16_t x2 = (int16_t)(section->x12 >> 16);
+            int16_t y1 = (int16_t)(section->y12 & 0xFFFFu);
+            int16_t y2 = (int16_t)(section->y12 >> 16);
+            uint32_t acc = 1u << 13;
+            int16_t y;
+
+            //UNSIGNED SO IT WRAPS LIKE SMLAD
+            acc += (uint32_t)((int32_t)section->b0 * x);
+            acc += (uint32_t)((int32_t)(int16_t)(section->b12 & 0xFFFFu) * x1);
+            acc += (uint32_t)((int32_t)(int16_t)(section->b12 >> 16) * x2);
+            acc += (uint32_t)((int32_t)(int16_t)(section->a12 & 0xFFFFu) * y1);
+            acc += (uint32_t)((int32_t)(int16_t)(section->a12 >> 16) * y2);
+            y = saturate16((int32_t)acc >> 14);
+
+            section->x12 = (uint16_t)x | ((uint32_t)(uint16_t)x1 << 16);
+            section->y12 = (uint16_t)y | ((uint32_t)(uint16_t)y1 << 16);
+
+            x = y;
+        }
+
+        *out = x;
+
+        in += stride;
+        out += stride;
+    }
+}
+
+/*****************************************************************
+* sqrtFilter
+*
+* Integer square root, rounded down.
+*****************************************************************/
+static uint32_t sqrtFilter(uint32_t x)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+
+    while(bit > x)
+    {
+        bit >>= 2;
+    }
+
+    while(bit)
+    {
+        if(x >= (root + bit))
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+/*****************************************************************
+* atan2Filter
+*
+* Angle of (x, y) in binary units, 32768 is half a turn. 'x' and
+* 'y' must be under 2^16 in size. Within 0.3 degrees.
+*****************************************************************/
+int16_t atan2Filter(int32_t y, int32_t x)
+{
+    uint32_t ax = (uint32_t)((x < 0) ? -x : x);
+    uint32_t ay = (uint32_t)((y < 0) ? -y : y);
+    uint32_t r;
+    int32_t angle;
+
+    if((ax == 0u) && (ay == 0u))
+    {
+        return 0;
+    }
+
+    //atan(r) FOR r = 0 TO 1 IS ABOUT r (pi/4 + 0.273 (1 - r))
+    if(ay <= ax)
+    {
+        r = (ay << 15) / ax;
+        angle = (int32_t)((r * (8192u + ((2847u * (32768u - r)) >> 15))) >> 15);
+    }
+    else
+    {
+        r = (ax << 15) / ay;
+        angle = 16384 - (int32_t)((r * (8192u + ((2847u * (32768u - r)) >> 15))) >> 15);
+    }
+
+    if(x < 0)
+    {
+        angle = 32768 - angle;
+    }
+
+    if(y < 0)
+    {
+        angle = -angle;
+    }
+
+    //HALF A TURN EITHER WAY IS THE SAME ANGLE
+    return (int16_t)(uint16_t)angle;
+}
+
+/*****************************************************************
+* initFusion
+*
+* Sets the gyro gain (see FUSION_GYRO_GAIN) and how much the accel
+* is trusted, 1 / 2^shift per frame. The first frame sets the
+* angles from the accel alone.
+*****************************************************************/
+void initFusion(Fusion *fusion, int32_t gyroGain, uint8_t shift)
+{
+    fusion->roll = 0;
+    fusion->pitch = 0;
+    fusion->gyroGain = gyroGain;
+    fusion->gyroBias = 0;
+    fusion->shift = shift;
+    fusion->primed = 0;
+}
+
+/*****************************************************************
+* setFusionGyroBias
+*
+* Sets the gyro readings at rest, taken off every frame.
+*****************************************************************/
+void setFusionGyroBias(Fusion *fusion, int16_t biasX, int16_t biasY)
+{
+    fusion->gyroBias = (uint16_t)biasX | ((uint32_t)(uint16_t)biasY << 16);
+}
+
+/*****************************************************************
+* blendFusion
+*
+* Moves the angles integrated from the gyro towards the ones from
+* the accel. Shared by both versions of runFusion.
+*****************************************************************/
+static void blendFusion(Fusion *fusion, int16_t gyroX, int16_t gyroY, uint32_t accelRoll, uint32_t accelPitch)
+{
+    uint32_t roll;
+    uint32_t pitch;
+
+    if(!fusion->primed)
+    {
+        fusion->roll = accelRoll;
+        fusion->pitch = accelPitch;
+        fusion->primed = 1;
+        return;
+    }
+
+    //UNSIGNED SO THE ANGLES WRAP ROUND
+    roll = fusion->roll + ((uint32_t)(int32_t)gyroX * (uint32_t)fusion->gyroGain);
+    pitch = fusion->pitch + ((uint32_t)(int32_t)gyroY * (uint32_t)fusion->gyroGain);
+
+    //THE DIFFERENCE AS SIGNED IS THE SHORT WAY ROUND
+    fusion->roll = roll + (uint32_t)((int32_t)(accelRoll - roll) >> fusion->shift);
+    fusion->pitch = pitch + (uint32_t)((int32_t)(accelPitch - pitch) >> fusion->shift);
+}
+
+/*****************************************************************
+* runFusion
+*
+* Updates the angles from one frame in MPU9250 order, accel X, Y,
+* Z, temp, gyro X, Y, Z. Roll is about X and pitch about Y.
+*****************************************************************/
+void runFusion(Fusion *fusion, const int16_t *frame)
+{
+#if FILTER_USE_SIMD
+    //ay^2 + az^2 IN ONE SMUAD. BOTH SQUARES ARE POSITIVE SO IT FITS
+    //UNSIGNED EVEN WHEN BOTH ARE -32768
+    uint32_t norm = smuad(read2(&frame[1]), read2(&frame[1]));
+
+    //BOTH GYRO BIASES OFF IN ONE QSUB16
+    uint32_t gyro = qsub16(read2(&frame[4]), fusion->gyroBias);
+
+    blendFusion(fusion, (int16_t)(gyro & 0xFFFFu), (int16_t)(gyro >> 16),
+                (uint32_t)atan2Filter(frame[1], frame[2]) << 16,
+                (uint32_t)atan2Filter(-frame[0], (int32_t)sqrtFilter(norm)) << 16);
+#else
+    runFusionScalar(fusion, frame);
+#endif
+}
+
+/*****************************************************************
+* runFusionScalar
+*
+* runFusion in plain C. Gives the same output.
+*****************************************************************/
+void runFusionScalar(Fusion *fusion, const int16_t *frame)
+{
+    uint32_t norm = (uint32_t)((int32_t)frame[1] * frame[1]) + (uint32_t)((int32_t)frame[2] * frame[2]);
+    int16_t gyroX = saturate16((int32_t)frame[4] - (int16_t)(fusion->gyroBias & 0xFFFFu));
+    int16_t gyroY = saturate16((int32_t)frame[5] - (int16_t)(fusion->gyroBias >> 16));
+
+    blendFusion(fusion, gyroX, gyroY,
+                (uint32_t)atan2Filter(frame[1], frame[2]) << 16,
+                (uint32_t)atan2Filter(-frame[0], (int32_t)sqrtFilter(norm)) << 16);
+}
+
+/*****************************************************************
+* getFusionRoll
+*
+* Returns the roll in binary units, 32768 is half a turn
+*****************************************************************/
+int16_t getFusionRoll(const Fusion *fusion)
+{
+    return (int16_t)(uint16_t)(fusion->roll >> 16);
+}
+
+/*****************************************************************
+* getFusionPitch
+*
+* Returns the pitch in binary units, 32768 is half a turn
+*****************************************************************/
+int16_t getFusionPitch(const Fusion *fusion)
+{
+    return (int16_t)(uint16_t)(fusion->pitch >> 16);
+}
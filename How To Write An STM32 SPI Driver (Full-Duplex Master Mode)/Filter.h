@@ -0,0 +1,109 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*****************************************************************
+* Fixed point filters for int16_t samples: FIR, biquad cascades and
+* a complementary filter turning MPU9250 frames into roll and
+* pitch.
+*
+* On the Cortex-M4 the inner loops work on pairs of samples packed
+* in a word with the DSP instructions (SMLAD, SMUAD, QSUB16, PKHBT,
+* SSAT). Every filter also has a plain C version, the ...Scalar
+* functions, which gives exactly the same output. That is the one
+* used where there are no DSP instructions, and the one the SIMD
+* version is tested against (see host/filtercheck.c).
+*
+* Samples can be spread out, 'stride' values apart, so one channel
+* of an interleaved block (such as an Acquire block) is filtered in
+* place without being copied out:
+*
+*   runFir(&fir, block + 4, block + 4, frames, 7);    //GYRO X
+*****************************************************************/
+
+//1 TO USE THE DSP INSTRUCTIONS, 0 FOR PLAIN C. ON THE HOST THE
+//INSTRUCTIONS ARE MODELLED IN C WHEN THIS IS SET TO 1
+#ifndef FILTER_USE_SIMD
+#if defined(__arm__) || defined(__ARM_ARCH)
+#define FILTER_USE_SIMD         1
+#else
+#define FILTER_USE_SIMD         0
+#endif
+#endif
+
+//MOST TAPS IN A FIR FILTER
+#define FIR_MAX_TAPS            64u
+
+//MOST SECOND ORDER SECTIONS IN A BIQUAD CASCADE
+#define BIQUAD_MAX_SECTIONS     4u
+
+//CONVERT A FRACTION TO Q15 (FIR) AND Q14 (BIQUAD) COEFFICIENTS
+#define Q15(x)                  ((int16_t)((x) * 32768.0 + (((x) < 0) ? -0.5 : 0.5)))
+#define Q14(x)                  ((int16_t)((x) * 16384.0 + (((x) < 0) ? -0.5 : 0.5)))
+
+//FIR FILTER. y[n] = SUM h[k] x[n - k], Q15 COEFFICIENTS. THE SUM OF
+//|h[k]| MUST NOT BE MORE THAN 1 OR THE ACCUMULATOR CAN OVERFLOW
+typedef struct
+{
+    int16_t coeffs[FIR_MAX_TAPS];       //h[taps - 1] FIRST, SO THEY LINE UP WITH THE DELAY LINE
+    int16_t delay[2u * FIR_MAX_TAPS];   //EACH SAMPLE WRITTEN TWICE SO THE LAST 'taps' ARE ALWAYS IN A ROW
+    uint16_t taps;                      //ROUNDED UP TO EVEN
+    uint16_t pos;                       //WHERE THE NEXT SAMPLE GOES
+} Fir;
+
+//ONE SECOND ORDER SECTION, DIRECT FORM I, Q14 COEFFICIENTS
+//y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2. |a1| MUST BE UNDER 2
+typedef struct
+{
+    int16_t b0;
+    uint32_t b12;                       //b1 | b2 << 16
+    uint32_t a12;                       //-a1 | -a2 << 16
+    uint32_t x12;                       //x1 | x2 << 16
+    uint32_t y12;                       //y1 | y2 << 16
+} BiquadSection;
+
+typedef struct
+{
+    BiquadSection sections[BIQUAD_MAX_SECTIONS];
+    uint8_t count;
+} Biquad;
+
+//GYRO GAIN FOR initFusion. 'lsbPerDps10' IS THE GYRO SENSITIVITY
+//IN LSB PER DEGREE PER SECOND TIMES 10 (1310 FOR +-250DPS) AND
+//'sampleHz' THE FRAME RATE
+#define FUSION_GYRO_GAIN(lsbPerDps10, sampleHz)    \
+    ((int32_t)((4294967296ull * 10u) / (360ull * (lsbPerDps10) * (sampleHz))))
+
+//COMPLEMENTARY FILTER. ANGLES ARE BINARY, 2^32 IS A FULL TURN, SO
+//THEY WRAP THE WAY ANGLES DO
+typedef struct
+{
+    uint32_t roll;
+    uint32_t pitch;
+    int32_t gyroGain;                   //ANGLE PER GYRO LSB PER FRAME
+    uint32_t gyroBias;                  //GYRO X | GYRO Y << 16, TAKEN OFF EVERY FRAME
+    uint8_t shift;                      //ACCEL WEIGHT IS 1 / 2^shift
+    uint8_t primed;                     //0 UNTIL THE FIRST FRAME
+} Fusion;
+
+uint8_t initFir(Fir *fir, const int16_t *coeffs, size_t taps);
+void resetFir(Fir *fir);
+void runFir(Fir *fir, const int16_t *in, int16_t *out, size_t count, size_t stride);
+void runFirScalar(Fir *fir, const int16_t *in, int16_t *out, size_t count, size_t stride);
+
+uint8_t initBiquad(Biquad *biquad, const int16_t *coeffs, uint8_t sections);
+void resetBiquad(Biquad *biquad);
+void runBiquad(Biquad *biquad, const int16_t *in, int16_t *out, size_t count, size_t stride);
+void runBiquadScalar(Biquad *biquad, const int16_t *in, int16_t *out, size_t count, size_t stride);
+
+void initFusion(Fusion *fusion, int32_t gyroGain, uint8_t shift);
+void setFusionGyroBias(Fusion *fusion, int16_t biasX, int16_t biasY);
+void runFusion(Fusion *fusion, const int16_t *frame);
+void runFusionScalar(Fusion *fusion, const int16_t *frame);
+int16_t getFusionRoll(const Fusion *fusion);
+int16_t getFusionPitch(const Fusion *fusion);
+int16_t atan2Filter(int32_t y, int32_t x);
+
+#endif
@@ -0,0 +1,384 @@
+#include "stm32l432xx.h"
+#include "SPIBus.h"
+#include "MPU9250.h"
+#include "Board.h"
+#include "Timer.h"
+
+
+//EVERY TRANSACTION STARTS WITH THE REGISTER ADDRESS. THE BYTES
+//AFTER IT ARE DON'T CARE WHEN READING SO THE REST STAYS 0
+static uint8_t mpuTx[1u + MPU9250_FIFO_BYTES];
+
+//RECEIVED BYTES. THE FIRST BYTE ARRIVES WHILE THE ADDRESS IS SENT
+//AND IS IGNORED
+static uint8_t mpuRx[1u + MPU9250_FIFO_BYTES];
+
+//THE MPU9250 ON THE SPI BUS. SLAVE SELECT FROM Board.h
+static SpiDevice mpuDevice;
+
+//THE LAST BURST QUEUED. ONLY ONE IS EVER IN FLIGHT AS THEY SHARE
+//THE BUFFERS ABOVE
+static SpiTransaction mpuTransaction = { 0, 0, 0, 0, 0, 0, 0, SPI_BUS_DONE };
+
+//BACKGROUND ACQUISITION. ITS OWN BUFFERS AND TRANSACTION SO THE
+//FUNCTIONS ABOVE CAN STILL BE USED WHILE IT RUNS
+static const uint8_t acquireTx[1u + MPU9250_SAMPLE_BYTES] = { MPU9250_ACCEL_XOUT_H | MPU9250_READ };
+static uint8_t acquireRx[1u + MPU9250_SAMPLE_BYTES];
+static SpiTransaction acquireTransaction = { 0, 0, 0, 0, 0, 0, 0, SPI_BUS_DONE };
+static SoftTimer acquireTimer;
+
+//TIMES THE FIFO FILLED UP AND HAD TO BE RESET
+static uint32_t fifoOverflows = 0;
+
+
+ /*****************************************************************
+ transferMpu9250
+ 
+    Sends the address byte followed by 'len' more bytes in one
+    chip select burst and waits for it to finish
+*****************************************************************/
+static void transferMpu9250(size_t len)
+{
+    queueSpiTransfer(&mpuTransaction, &mpuDevice, mpuTx, mpuRx, len + 1u, 0, 0);
+    
+    waitSpiTransfer(&mpuTransaction);
+}
+
+ /*****************************************************************
+ valueMpu9250
+ 
+    One 16-bit value, high byte first
+*****************************************************************/
+static int16_t valueMpu9250(const uint8_t *raw)
+{
+    return (int16_t)(((uint16_t)raw[0] << 8) | raw[1]);
+}
+
+ /*****************************************************************
+ resetFifoMpu9250
+ 
+    Stops the FIFO, throws away what it holds and starts it again.
+    FIFO_EN is left off, the caller sets it
+*****************************************************************/
+static void resetFifoMpu9250(void)
+{
+    writeRegMpu9250(MPU9250_FIFO_EN, 0);
+    writeRegMpu9250(MPU9250_USER_CTRL, ((1u << 4)       //KEEP I2C DISABLED
+                                       |(1u << 2)));    //RESET FIFO
+    
+    writeRegMpu9250(MPU9250_USER_CTRL, ((1u << 6)       //FIFO ENABLE
+                                       |(1u << 4)));    //KEEP I2C DISABLED
+}
+
+ /*****************************************************************
+ initMpu9250
+ 
+    Adds the MPU9250 to the SPI bus then wakes it and puts it in
+    SPI only mode. initSpiBus must have been called first. May be
+    called again to retry, the device is only added once
+    
+    Returns
+    1 if the MPU9250 answered with the right WHO_AM_I value
+*****************************************************************/
+uint8_t initMpu9250(void)
+{
+    uint8_t id = 0;
+    
+    //MODE 3, 8-BIT FRAMES. 1MHZ IS SAFE FOR ALL OF ITS REGISTERS
+    if(!mpuDevice.csPort)
+    {
+        if(!addSpiDevice(&mpuDevice, BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN, SPI_MODE_3, 1000000u, 8))
+        {
+            return 0;
+        }
+    }
+    
+    writeRegMpu9250(MPU9250_PWR_MGMT_1, 0x01u);     //WAKE UP, BEST AVAILABLE CLOCK SOURCE
+    writeRegMpu9250(MPU9250_USER_CTRL, (1u << 4));  //DISABLE I2C INTERFACE
+    
+    if(!readRegsMpu9250(MPU9250_WHO_AM_I, &id, 1))
+    {
+        return 0;
+    }
+    
+    return id == MPU9250_ID;
+}
+
+ /*****************************************************************
+ writeRegMpu9250
+ 
+    Writes one register
+*****************************************************************/
+void writeRegMpu9250(uint8_t reg, uint8_t value)
+{
+    mpuTx[0] = reg;
+    mpuTx[1] = value;
+    
+    transferMpu9250(1);
+    
+    mpuTx[1] = 0;
+}
+
+ /*****************************************************************
+ readRegsMpu9250
+ 
+    Reads 'len' consecutive registers starting at 'reg' in one
+    burst
+    
+    Returns
+    1 if read, 0 if 'len' is more than MPU9250_FIFO_BYTES, the
+    most the burst buffers hold
+*****************************************************************/
+uint8_t readRegsMpu9250(uint8_t reg, uint8_t *data, size_t len)
+{
+    size_t i;
+    
+    if(len > MPU9250_FIFO_BYTES)
+    {
+        return 0;
+    }
+    
+    mpuTx[0] = reg | MPU9250_READ;
+    
+    transferMpu9250(len);
+    
+    for(i = 0; i < len; i++)
+    {
+        data[i] = mpuRx[i + 1u];
+    }
+    
+    return 1;
+}
+
+ /*****************************************************************
+ decodeMpu9250
+ 
+    Turns raw big-endian accel/temp/gyro bytes, as read from
+    register 59 onwards or from the FIFO, into samples
+*****************************************************************/
+void decodeMpu9250(const uint8_t *raw, Mpu9250Sample *samples, size_t count)
+{
+    while(count--)
+    {
+        samples->accelX = valueMpu9250(&raw[0]);
+        samples->accelY = valueMpu9250(&raw[2]);
+        samples->accelZ = valueMpu9250(&raw[4]);
+        samples->temp   = valueMpu9250(&raw[6]);
+        samples->gyroX  = valueMpu9250(&raw[8]);
+        samples->gyroY  = valueMpu9250(&raw[10]);
+        samples->gyroZ  = valueMpu9250(&raw[12]);
+        
+        raw += MPU9250_SAMPLE_BYTES;
+        samples++;
+    }
+}
+
+ /*****************************************************************
+ readSampleMpu9250
+ 
+    Reads ACCEL, TEMP and GYRO (registers 59 to 72) in a single
+    burst instead of one transaction per register
+*****************************************************************/
+void readSampleMpu9250(Mpu9250Sample *sample)
+{
+    mpuTx[0] = MPU9250_ACCEL_XOUT_H | MPU9250_READ;
+    
+    transferMpu9250(MPU9250_SAMPLE_BYTES);
+    
+    decodeMpu9250(&mpuRx[1], sample, 1);
+}
+
+ /*****************************************************************
+ enableFifoMpu9250
+ 
+    Starts collecting accel, temp and gyro samples in the hardware
+    FIFO at 1kHz / (1 + sampleRateDiv). Once full the oldest
+    samples are overwritten
+*****************************************************************/
+void enableFifoMpu9250(uint8_t sampleRateDiv)
+{
+    uint8_t status;
+    
+    writeRegMpu9250(MPU9250_SMPLRT_DIV, sampleRateDiv);
+    writeRegMpu9250(MPU9250_CONFIG, 0x01u);             //184HZ DLPF SO THE 1KHZ INTERNAL RATE APPLIES
+    writeRegMpu9250(MPU9250_INT_ENABLE, MPU9250_INT_FIFO_OVERFLOW);
+    
+    resetFifoMpu9250();
+    
+    //A SET OVERFLOW FLAG FROM BEFORE THE RESET IS CLEARED BY READING IT
+    readRegsMpu9250(MPU9250_INT_STATUS, &status, 1);
+    
+    writeRegMpu9250(MPU9250_FIFO_EN, MPU9250_FIFO_SAMPLE_EN);
+}
+
+ /*****************************************************************
+ readFifoMpu9250
+ 
+    Reads as many whole samples as are waiting in the FIFO, up to
+    'maxSamples', using three bursts: one for INT_STATUS, one for
+    FIFO_COUNT and one for all of the samples.
+    If the FIFO has overflowed the oldest bytes have been written
+    over, so what it holds no longer starts on a sample. It is
+    reset instead of read and the overflow is counted
+    
+    Returns
+    the number of samples written to 'samples'
+*****************************************************************/
+size_t readFifoMpu9250(Mpu9250Sample *samples, size_t maxSamples)
+{
+    uint8_t status;
+    uint8_t countBytes[2];
+    size_t count;
+    
+    //READING INT_STATUS ALSO CLEARS IT
+    readRegsMpu9250(MPU9250_INT_STATUS, &status, 1);
+    
+    if(status & MPU9250_INT_FIFO_OVERFLOW)
+    {
+        fifoOverflows++;
+        
+        resetFifoMpu9250();
+        writeRegMpu9250(MPU9250_FIFO_EN, MPU9250_FIFO_SAMPLE_EN);
+        
+        return 0;
+    }
+    
+    //FIFO_COUNTH AND FIFO_COUNTL HOLD THE NUMBER OF BYTES WAITING
+    readRegsMpu9250(MPU9250_FIFO_COUNTH, countBytes, 2);
+    count = ((((size_t)countBytes[0] & 0x1Fu) << 8) | countBytes[1]) / MPU9250_SAMPLE_BYTES;
+    
+    if(count > maxSamples)
+    {
+        count = maxSamples;
+    }
+    
+    if(count > MPU9250_FIFO_SAMPLES)
+    {
+        count = MPU9250_FIFO_SAMPLES;
+    }
+    
+    if(count == 0u)
+    {
+        return 0;
+    }
+    
+    //FIFO_R_W DOES NOT AUTO-INCREMENT SO EVERY BYTE COMES FROM THE FIFO
+    mpuTx[0] = MPU9250_FIFO_R_W | MPU9250_READ;
+    
+    transferMpu9250(count * MPU9250_SAMPLE_BYTES);
+    
+    decodeMpu9250(&mpuRx[1], samples, count);
+    
+    return count;
+}
+
+ /*****************************************************************
+ fifoOverflowsMpu9250
+ 
+    Returns
+    how many times readFifoMpu9250 found the FIFO had overflowed
+    and threw its contents away
+*****************************************************************/
+uint32_t fifoOverflowsMpu9250(void)
+{
+    return fifoOverflows;
+}
+
+ /*****************************************************************
+ acquireDoneMpu9250
+ 
+    Transaction callback, from the DMA interrupt. Stores the sample
+    just read as one frame of the pipeline, or counts it as dropped
+    if the pipeline has no block for it
+*****************************************************************/
+static void acquireDoneMpu9250(SpiTransaction *transaction)
+{
+    Acquire *acquire = (Acquire *)transaction->arg;
+    int16_t *frame;
+    size_t room;
+    size_t i;
+    
+    if(transaction->status != SPI_BUS_DONE)
+    {
+        dropAcquire(acquire, 1);
+        return;
+    }
+    
+    frame = getAcquireSlot(acquire, &room);
+    
+    if(!frame)
+    {
+        dropAcquire(acquire, 1);
+        return;
+    }
+    
+    //SEVEN 16-BIT VALUES STRAIGHT INTO THE BUFFER, IN THE ORDER OF
+    //THE Mpu9250Sample FIELDS
+    for(i = 0; i < MPU9250_CHANNELS; i++)
+    {
+        frame[i] = valueMpu9250(&acquireRx[(2u * i) + 1u]);
+    }
+    
+    commitAcquire(acquire, 1);
+}
+
+ /*****************************************************************
+ acquireTickMpu9250
+ 
+    Timer callback, from the TIM2 interrupt. Queues the burst read
+    of the next sample. If the last one is still on the bus the
+    sample is missed and counted as dropped
+*****************************************************************/
+static void acquireTickMpu9250(void *arg)
+{
+    Acquire *acquire = (Acquire *)arg;
+    uint8_t status = acquireTransaction.status;
+    
+    if((status == SPI_BUS_QUEUED) || (status == SPI_BUS_ACTIVE))
+    {
+        dropAcquire(acquire, 1);
+        return;
+    }
+    
+    if(!queueSpiTransfer(&acquireTransaction, &mpuDevice, acquireTx, acquireRx, sizeof(acquireRx), acquireDoneMpu9250, acquire))
+    {
+        dropAcquire(acquire, 1);
+    }
+}
+
+ /*****************************************************************
+ startAcquireMpu9250
+ 
+    Reads accel, temp and gyro every 'periodTicks' timer ticks in
+    the background and feeds them to 'acquire' as frames of
+    MPU9250_CHANNELS values. Nothing waits, the read is queued from
+    the TIM2 interrupt and stored from the DMA interrupt, so the
+    main loop only has to run the pipeline. Both interrupts are at
+    the default priority so they never interrupt each other as
+    producer.
+    initMpu9250 and initTim2 must have been called first
+    
+    Returns
+    1 if started, 0 if 'acquire' doesn't have MPU9250_CHANNELS
+    channels or no timer was free
+*****************************************************************/
+uint8_t startAcquireMpu9250(Acquire *acquire, uint32_t periodTicks)
+{
+    if(acquire->channels != MPU9250_CHANNELS)
+    {
+        return 0;
+    }
+    
+    return startTimer(&acquireTimer, periodTicks, periodTicks, acquireTickMpu9250, acquire);
+}
+
+ /*****************************************************************
+ stopAcquireMpu9250
+ 
+    Stops the background reads. A read already queued still
+    finishes and stores its frame
+*****************************************************************/
+void stopAcquireMpu9250(void)
+{
+    stopTimer(&acquireTimer);
+}
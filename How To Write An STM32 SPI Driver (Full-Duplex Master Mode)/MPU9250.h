@@ -0,0 +1,67 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+#include <stddef.h>
+#include "Acquire.h"
+
+//MPU9250 REGISTER ADDRESSES
+#define MPU9250_SMPLRT_DIV      25u
+#define MPU9250_CONFIG          26u
+#define MPU9250_FIFO_EN         35u
+#define MPU9250_INT_ENABLE      56u
+#define MPU9250_INT_STATUS      58u
+#define MPU9250_ACCEL_XOUT_H    59u
+#define MPU9250_USER_CTRL       106u
+#define MPU9250_PWR_MGMT_1      107u
+#define MPU9250_FIFO_COUNTH     114u
+#define MPU9250_FIFO_R_W        116u
+#define MPU9250_WHO_AM_I        117u
+
+//SET IN THE ADDRESS BYTE TO READ INSTEAD OF WRITE
+#define MPU9250_READ            0x80u
+
+//FIFO OVERFLOW BIT OF INT_ENABLE AND INT_STATUS
+#define MPU9250_INT_FIFO_OVERFLOW   (1u << 4)
+
+//FIFO_EN BITS FOR TEMP, GYRO X, Y AND Z AND ACCEL, ONE WHOLE SAMPLE
+#define MPU9250_FIFO_SAMPLE_EN  0xF8u
+
+//VALUE OF WHO_AM_I
+#define MPU9250_ID              0x71u
+
+//BYTES IN ONE ACCEL + TEMP + GYRO SAMPLE (REGISTERS 59 TO 72)
+#define MPU9250_SAMPLE_BYTES    14u
+
+//VALUES IN ONE SAMPLE, THE CHANNELS OF AN ACQUISITION FRAME
+#define MPU9250_CHANNELS        (MPU9250_SAMPLE_BYTES / 2u)
+
+//SIZE OF THE MPU9250 HARDWARE FIFO
+#define MPU9250_FIFO_BYTES      512u
+
+//MOST WHOLE SAMPLES THE FIFO CAN HOLD
+#define MPU9250_FIFO_SAMPLES    (MPU9250_FIFO_BYTES / MPU9250_SAMPLE_BYTES)
+
+//ONE DECODED SAMPLE, IN THE ORDER THE REGISTERS ARE READ
+typedef struct
+{
+    int16_t accelX;
+    int16_t accelY;
+    int16_t accelZ;
+    int16_t temp;
+    int16_t gyroX;
+    int16_t gyroY;
+    int16_t gyroZ;
+} Mpu9250Sample;
+
+uint8_t initMpu9250(void);
+void writeRegMpu9250(uint8_t reg, uint8_t value);
+uint8_t readRegsMpu9250(uint8_t reg, uint8_t *data, size_t len);
+void readSampleMpu9250(Mpu9250Sample *sample);
+void enableFifoMpu9250(uint8_t sampleRateDiv);
+size_t readFifoMpu9250(Mpu9250Sample *samples, size_t maxSamples);
+uint32_t fifoOverflowsMpu9250(void);
+void decodeMpu9250(const uint8_t *raw, Mpu9250Sample *samples, size_t count);
+uint8_t startAcquireMpu9250(Acquire *acquire, uint32_t periodTicks);
+void stopAcquireMpu9250(void);
@@ -0,0 +1,196 @@
+#include "Pool.h"
+
+#if POOL_USE_EXCLUSIVE
+#include "stm32l432xx.h"
+#endif
+
+
+/*****************************************************************
+* The free blocks form a stack. The first word of each free block
+* holds the index of the next one, and 'head' holds the index of
+* the top block. Allocating pops the top block and freeing pushes
+* a block back, each with a single compare and swap on 'head'.
+*
+* The top 16 bits of 'head' count the changes made to it. Without
+* them a pop could be interrupted after reading the next index, the
+* block popped and pushed back by the interrupt with a different
+* block under it, and the pop would then put a block that is in use
+* back on the top. On the Cortex-M4 the exclusive monitor is also
+* cleared by every interrupt so STREX fails anyway, but the count
+* keeps the host build (real threads) just as safe.
+*****************************************************************/
+
+//NO BLOCK, MARKS THE BOTTOM OF THE STACK
+#define POOL_NONE           0xFFFFu
+
+#define POOL_INDEX_MASK     0xFFFFu
+#define POOL_CHANGE_ONE     0x10000u
+
+
+/*****************************************************************
+* compareSwap
+*
+* Sets '*word' to 'desired' if it still holds 'expected'.
+*
+* Returns 1 if it was set, 0 if something else changed it first
+*****************************************************************/
+static uint8_t compareSwap(volatile uint32_t *word, uint32_t expected, uint32_t desired)
+{
+#if POOL_USE_EXCLUSIVE
+    //MAKE SURE WRITES TO THE BLOCK HAPPEN BEFORE IT IS PUBLISHED
+    __DMB();
+
+    if(__LDREXW(word) != expected)
+    {
+        __CLREX();
+        return 0;
+    }
+
+    return (__STREXW(desired, word) == 0u) ? 1u : 0u;
+#else
+    return __atomic_compare_exchange_n(word, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ? 1u : 0u;
+#endif
+}
+
+/*****************************************************************
+* addAtomic
+*
+* Adds 'delta' to '*word' without losing changes made by
+* interrupts.
+*
+* Returns the new value
+*****************************************************************/
+static uint32_t addAtomic(volatile uint32_t *word, uint32_t delta)
+{
+    uint32_t value;
+
+    do
+    {
+        value = *word;
+    } while(!compareSwap(word, value, value + delta));
+
+    return value + delta;
+}
+
+/*****************************************************************
+* initPool
+*
+* Puts every block of 'pool' on the free stack. Must not be called
+* while any block is in use.
+*****************************************************************/
+void initPool(Pool *pool)
+{
+    uint32_t i;
+
+    for(i = 0; i < pool->count; i++)
+    {
+        pool->storage[i * pool->blockWords] = ((i + 1u) < pool->count) ? (i + 1u) : POOL_NONE;
+    }
+
+    pool->head = 0;
+    pool->available = pool->count;
+    pool->lowWater = pool->count;
+    pool->failures = 0;
+}
+
+/*****************************************************************
+* allocPool
+*
+* Takes a block out of 'pool'. Safe to call from interrupts.
+*
+* Returns the block, or 0 if the pool is empty
+*****************************************************************/
+void *allocPool(Pool *pool)
+{
+    uint32_t head;
+    uint32_t index;
+    uint32_t next;
+    uint32_t left;
+
+    do
+    {
+        head = pool->head;
+        index = head & POOL_INDEX_MASK;
+
+        if(index == POOL_NONE)
+        {
+            addAtomic(&pool->failures, 1u);
+            return 0;
+        }
+
+        //IF THE BLOCK WAS TAKEN MEANWHILE THIS MAY BE ITS DATA, BUT
+        //THEN 'head' HAS CHANGED AND THE SWAP FAILS
+        next = ((volatile uint32_t *)pool->storage)[index * pool->blockWords];
+
+    } while(!compareSwap(&pool->head, head, ((head + POOL_CHANGE_ONE) & ~POOL_INDEX_MASK) | next));
+
+    //ONLY A GUIDE, AN INTERRUPT CAN GET IN BETWEEN THE TWO LINES
+    left = addAtomic(&pool->available, (uint32_t)-1);
+    if(left < pool->lowWater)
+    {
+        pool->lowWater = left;
+    }
+
+    return &pool->storage[index * pool->blockWords];
+}
+
+/*****************************************************************
+* freePool
+*
+* Gives a block back to 'pool'. Safe to call from interrupts.
+*
+* Returns 1 on success, 0 if 'block' isn't the start of a block in
+* 'pool'
+*****************************************************************/
+uint8_t freePool(Pool *pool, void *block)
+{
+    uint32_t offset;
+    uint32_t index;
+    uint32_t head;
+
+    if(((uint32_t *)block < pool->storage)
+     || ((uint32_t *)block >= &pool->storage[(uint32_t)pool->count * pool->blockWords]))
+    {
+        return 0;
+    }
+
+    offset = (uint32_t)((uint32_t *)block - pool->storage);
+    index = offset / pool->blockWords;
+
+    if((index * pool->blockWords) != offset)
+    {
+        return 0;
+    }
+
+    do
+    {
+        head = pool->head;
+        ((volatile uint32_t *)pool->storage)[offset] = head & POOL_INDEX_MASK;
+
+    } while(!compareSwap(&pool->head, head, ((head + POOL_CHANGE_ONE) & ~POOL_INDEX_MASK) | index));
+
+    addAtomic(&pool->available, 1u);
+
+    return 1;
+}
+
+/*****************************************************************
+* poolBlockSize
+*
+* Returns the number of bytes in each block of 'pool'
+*****************************************************************/
+size_t poolBlockSize(const Pool *pool)
+{
+    return (size_t)pool->blockWords * 4u;
+}
+
+/*****************************************************************
+* poolAvailable
+*
+* Returns the number of free blocks in 'pool'. May already be out
+* of date if interrupts use the pool
+*****************************************************************/
+uint32_t poolAvailable(const Pool *pool)
+{
+    return pool->available;
+}
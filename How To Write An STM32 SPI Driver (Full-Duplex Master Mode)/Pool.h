@@ -0,0 +1,69 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*****************************************************************
+* Fixed size blocks handed out from static storage. Allocating and
+* freeing take the same short time whatever state the pool is in,
+* never fragment, and are safe from interrupts and the main loop at
+* once without turning interrupts off.
+*
+* A block belongs to whoever allocated it until it is freed, and
+* can be passed on by pointer in between. A DMA buffer filled by a
+* driver can be handed to the code that processes it and then to
+* the UART without being copied, the last owner frees it.
+*
+*   POOL_DEFINE(framePool, 64, 8);      //8 BLOCKS OF 64 BYTES
+*
+*   initPool(&framePool);
+*   uint8_t *frame = allocPool(&framePool);
+*   ...
+*   freePool(&framePool, frame);
+*****************************************************************/
+
+//1 TO USE LDREX/STREX, 0 FOR THE COMPILER'S ATOMICS. THE HOST
+//ALWAYS USES THE COMPILER'S SO THE HOST TOOLS BUILD UNCHANGED
+#ifndef POOL_USE_EXCLUSIVE
+#if defined(__arm__) || defined(__ARM_ARCH)
+#define POOL_USE_EXCLUSIVE      1
+#else
+#define POOL_USE_EXCLUSIVE      0
+#endif
+#endif
+
+//MOST BLOCKS ONE POOL CAN HOLD
+#define POOL_MAX_BLOCKS         0xFFFEu
+
+//WORDS IN A BLOCK OF 'size' BYTES. BLOCKS ARE WORD ALIGNED
+#define POOL_BLOCK_WORDS(size)  (((uint32_t)(size) + 3u) / 4u)
+
+//ONE POOL. ONLY TOUCH THROUGH THE FUNCTIONS BELOW
+typedef struct
+{
+    uint32_t *storage;              //THE BLOCKS, ONE AFTER ANOTHER
+    uint16_t blockWords;            //SIZE OF A BLOCK IN WORDS
+    uint16_t count;                 //NUMBER OF BLOCKS
+    volatile uint32_t head;         //CHANGE COUNT << 16 | FIRST FREE BLOCK
+    volatile uint32_t available;    //BLOCKS FREE NOW
+    volatile uint32_t lowWater;     //FEWEST BLOCKS THAT HAVE BEEN FREE
+    volatile uint32_t failures;     //ALLOCATIONS THAT FOUND THE POOL EMPTY
+} Pool;
+
+//DEFINES POOL 'name' OF 'blockCount' BLOCKS OF AT LEAST 'blockSize'
+//BYTES, WITH ITS STORAGE. initPool MUST BE CALLED BEFORE IT IS USED
+#define POOL_DEFINE(name, blockSize, blockCount)                                \
+    typedef char name##_size_check[(((blockSize) > 0u) && ((blockCount) > 0u)  \
+                                    && ((blockCount) <= POOL_MAX_BLOCKS)       \
+                                    && (POOL_BLOCK_WORDS(blockSize) <= 0xFFFFu)) ? 1 : -1]; \
+    static uint32_t name##_storage[(blockCount) * POOL_BLOCK_WORDS(blockSize)]; \
+    Pool name = { name##_storage, POOL_BLOCK_WORDS(blockSize), (blockCount), 0, 0, 0, 0 }
+
+void initPool(Pool *pool);
+void *allocPool(Pool *pool);
+uint8_t freePool(Pool *pool, void *block);
+size_t poolBlockSize(const Pool *pool);
+uint32_t poolAvailable(const Pool *pool);
+
+#endif
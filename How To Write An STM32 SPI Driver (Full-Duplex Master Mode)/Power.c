@@ -0,0 +1,235 @@
+#include "stm32l432xx.h"
+#include "Power.h"
+#include "Clock.h"
+#include "LPTime.h"
+
+
+/*****************************************************************
+ Stop modes turn off every clock apart from LSI/LSE (and HSI16 if
+ a peripheral asks for it). TIM2, TIM6, TIM7 and DMA stop with
+ them, so the application's PowerQuery says what is running and a
+ stop mode is only chosen when nothing is. The time in each mode
+ is measured on LPTIM1, which runs from LSI and keeps counting in
+ Stop.
+*****************************************************************/
+
+//WAKE-UP SOURCES THE APPLICATION ASKED FOR
+static uint32_t wakeSources = 0;
+
+//TELLS US WHAT THE APPLICATION HAS RUNNING, 0 IF NOTHING EVER IS
+static PowerQuery query = 0;
+
+//STATISTICS
+static PowerStats stats;
+
+//LPTIM1 TIME WHEN THE STATISTICS WERE LAST UPDATED
+static uint64_t lastTicks = 0;
+
+
+ /*****************************************************************
+ initPower
+ 
+    Clears the statistics, starts LPTIM1 to time them and
+    remembers which wake-up sources must keep working while
+    asleep. 'check' is called before every sleep to find out what
+    is running. For UART1 to wake us from Stop 1 the application
+    also calls enableUart1WakeFromStop
+*****************************************************************/
+void initPower(uint32_t sources, PowerQuery check)
+{
+    uint32_t i;
+    
+    wakeSources = sources;
+    query = check;
+    
+    //ENABLE PWR CLOCK SO THE STOP MODE CAN BE SELECTED
+    RCC->APB1ENR1 |= (1u << 28);
+    
+    for(i = 0; i < POWER_MODES; i++)
+    {
+        stats.entries[i] = 0;
+        stats.ticks[i] = 0;
+        stats.lastRestoreCycles[i] = 0;
+        stats.maxRestoreCycles[i] = 0;
+    }
+    
+    stats.totalTicks = 0;
+    
+    initLPTime();
+    lastTicks = getLPTime();
+    
+    //START THE CYCLE COUNTER USED TO TIME THE CLOCK RESTORE
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+ /*****************************************************************
+ choosePowerMode
+ 
+    Picks the deepest mode that keeps everything in 'state'
+    working. Has no side effects
+    
+    Returns
+    one of the POWER_MODE_... values
+*****************************************************************/
+uint8_t choosePowerMode(const PowerState *state)
+{
+    //THERE IS WORK OR A TIMER IS DUE, DEAL WITH IT FIRST
+    if(state->workPending || (state->timerPending && (state->ticksToDeadline == 0u)))
+    {
+        return POWER_MODE_RUN;
+    }
+    
+    //TIMERS AND DMA NEED THEIR CLOCKS
+    if(state->timerPending || state->busy)
+    {
+        return POWER_MODE_SLEEP;
+    }
+    
+    //UART1 NEEDS STOP 1, AND ONLY WORKS AT ALL FROM HSI16
+    if(state->wakeSources & POWER_WAKE_UART1)
+    {
+        return state->uartStopWake ? POWER_MODE_STOP1 : POWER_MODE_SLEEP;
+    }
+    
+    //NOTHING NEEDS A CLOCK, EXTI STILL WORKS IN STOP 2
+    return POWER_MODE_STOP2;
+}
+
+ /*****************************************************************
+ updateTicks
+ 
+    Adds the LPTIM1 ticks since the last call to the total and
+    returns them
+*****************************************************************/
+static uint64_t updateTicks(void)
+{
+    uint64_t now = getLPTime();
+    uint64_t elapsed = now - lastTicks;
+    
+    lastTicks = now;
+    stats.totalTicks += elapsed;
+    
+    return elapsed;
+}
+
+ /*****************************************************************
+ enterLowPower
+ 
+    Puts the core in the deepest mode allowed right now and
+    returns once an interrupt has woken it and the clocks are
+    back. Call from the main loop whenever there is nothing to do.
+    'ready' (may be 0) is the flag an interrupt sets when there is
+    work. It is checked with interrupts masked so a wake-up can't be
+    missed between the check and WFI
+    
+    Returns
+    the mode that was used
+*****************************************************************/
+uint8_t enterLowPower(const volatile uint8_t *ready)
+{
+    PowerState state = {0};
+    uint8_t mode;
+    uint32_t restoreStart;
+    uint32_t restoreCycles;
+    
+    //INTERRUPTS ARE MASKED SO NOTHING CAN CHANGE BETWEEN THE CHOICE
+    //AND WFI. A PENDING INTERRUPT STILL ENDS THE WFI
+    __disable_irq();
+    
+    if(query)
+    {
+        query(&state);
+    }
+    state.wakeSources = wakeSources;
+    
+    mode = choosePowerMode(&state);
+    
+    if((mode == POWER_MODE_RUN) || (ready && *ready))
+    {
+        __enable_irq();
+        return POWER_MODE_RUN;
+    }
+    
+    stats.ticks[POWER_MODE_RUN] += updateTicks();
+    
+    if(mode == POWER_MODE_SLEEP)
+    {
+        SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    }
+    else
+    {
+        //SELECT STOP 1 OR STOP 2
+        PWR->CR1 = (PWR->CR1 & ~PWR_CR1_LPMS)
+                 | ((mode == POWER_MODE_STOP1) ? PWR_CR1_LPMS_STOP1 : PWR_CR1_LPMS_STOP2);
+        SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    }
+    
+    __DSB();
+    __WFI();
+    
+    //LPTIM1 KEPT COUNTING WHATEVER THE MODE
+    stats.ticks[mode] += updateTicks();
+    
+    restoreStart = DWT->CYCCNT;
+    
+    if(mode != POWER_MODE_SLEEP)
+    {
+        //STOP MODE WAKES UP ON MSI WITH THE PLL OFF. ONLY SYSCLK IS
+        //PUT BACK, THE FREQUENCIES HAVEN'T CHANGED SO NOTHING NEEDS
+        //RE-TIMING
+        SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+        restoreClock();
+    }
+    
+    restoreCycles = DWT->CYCCNT - restoreStart;
+    
+    stats.entries[mode]++;
+    stats.lastRestoreCycles[mode] = restoreCycles;
+    
+    if(restoreCycles > stats.maxRestoreCycles[mode])
+    {
+        stats.maxRestoreCycles[mode] = restoreCycles;
+    }
+    
+    //LET THE INTERRUPT THAT WOKE US RUN
+    __enable_irq();
+    
+    return mode;
+}
+
+ /*****************************************************************
+ getPowerStats
+ 
+    Takes a copy of the statistics
+*****************************************************************/
+void getPowerStats(PowerStats *copy)
+{
+    uint32_t primask = __get_PRIMASK();
+    
+    __disable_irq();
+    stats.ticks[POWER_MODE_RUN] += updateTicks();
+    *copy = stats;
+    __set_PRIMASK(primask);
+}
+
+ /*****************************************************************
+ getSleepPermille
+ 
+    Returns
+    the share of the time since initPower spent in Sleep or Stop,
+    in tenths of a percent
+*****************************************************************/
+uint32_t getSleepPermille(void)
+{
+    PowerStats copy;
+    
+    getPowerStats(&copy);
+    
+    if(copy.totalTicks == 0u)
+    {
+        return 0;
+    }
+    
+    return (uint32_t)(((copy.totalTicks - copy.ticks[POWER_MODE_RUN]) * 1000u) / copy.totalTicks);
+}
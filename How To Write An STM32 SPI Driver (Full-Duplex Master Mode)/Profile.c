@@ -0,0 +1,257 @@
+#include "stm32l432xx.h"
+#include "Profile.h"
+#include "Clock.h"
+
+
+//STATISTICS FOR EVERY ZONE
+static ProfileZone zones[PROFILE_MAX_ZONES];
+
+//CYCLES TAKEN BY AN EMPTY PROFILE_BEGIN/PROFILE_END PAIR. TAKEN OFF
+//EVERY MEASUREMENT
+static uint32_t overhead = 0;
+
+//DUMP BEING SENT BY pumpProfile
+static uint8_t dump[PROFILE_DUMP_BYTES];
+static size_t dumpLen = 0;
+static size_t dumpSent = 0;
+
+
+ /*****************************************************************
+ initProfile
+ 
+    Starts the DWT cycle counter, measures the cost of an empty
+    zone and clears all statistics
+*****************************************************************/
+void initProfile(void)
+{
+    uint32_t start;
+    uint32_t end;
+    
+    //ENABLE TRACE SO THE DWT CAN BE USED THEN START CYCCNT
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    
+    //TIME BACK-TO-BACK READS THE SAME WAY PROFILE_BEGIN/END DO
+    start = DWT->CYCCNT;
+    end = DWT->CYCCNT;
+    overhead = end - start;
+    
+    resetProfile();
+}
+
+ /*****************************************************************
+ resetProfile
+ 
+    Clears the statistics of every zone
+*****************************************************************/
+void resetProfile(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t i;
+    uint32_t j;
+    
+    __disable_irq();
+    
+    for(i = 0; i < PROFILE_MAX_ZONES; i++)
+    {
+        zones[i].count = 0;
+        zones[i].min = 0xFFFFFFFFu;
+        zones[i].max = 0;
+        zones[i].total = 0;
+        
+        for(j = 0; j < PROFILE_HIST_BINS; j++)
+        {
+            zones[i].hist[j] = 0;
+        }
+    }
+    
+    __set_PRIMASK(primask);
+}
+
+ /*****************************************************************
+ recordProfile
+ 
+    Adds one measurement to a zone. Safe to call from interrupts
+*****************************************************************/
+void recordProfile(uint32_t zone, uint32_t cycles)
+{
+    ProfileZone *z;
+    uint32_t primask;
+    uint32_t bin;
+    
+    if(zone >= PROFILE_MAX_ZONES)
+    {
+        return;
+    }
+    
+    z = &zones[zone];
+    cycles = (cycles > overhead) ? (cycles - overhead) : 0u;
+    
+    //FLOOR(LOG2(CYCLES)), 0 AND 1 CYCLE SHARE BIN 0
+    bin = (cycles == 0u) ? 0u : (31u - __CLZ(cycles));
+    if(bin >= PROFILE_HIST_BINS)
+    {
+        bin = PROFILE_HIST_BINS - 1u;
+    }
+    
+    primask = __get_PRIMASK();
+    __disable_irq();
+    
+    z->count++;
+    z->total += cycles;
+    z->hist[bin]++;
+    
+    if(cycles < z->min)
+    {
+        z->min = cycles;
+    }
+    
+    if(cycles > z->max)
+    {
+        z->max = cycles;
+    }
+    
+    __set_PRIMASK(primask);
+}
+
+ /*****************************************************************
+ readProfile
+ 
+    Takes a consistent copy of a zone's statistics. The mean is
+    total / count
+*****************************************************************/
+void readProfile(uint32_t zone, ProfileZone *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+    
+    if(zone >= PROFILE_MAX_ZONES)
+    {
+        return;
+    }
+    
+    __disable_irq();
+    *stats = zones[zone];
+    __set_PRIMASK(primask);
+}
+
+ /*****************************************************************
+ putLE
+ 
+    Writes the low 'bytes' bytes of 'value' little-endian
+*****************************************************************/
+static uint8_t *putLE(uint8_t *p, uint64_t value, uint32_t bytes)
+{
+    while(bytes--)
+    {
+        *p++ = (uint8_t)value;
+        value >>= 8;
+    }
+    
+    return p;
+}
+
+ /*****************************************************************
+ serializeProfile
+ 
+    Writes every zone that has measurements into 'buf' in the
+    compact dump format described in Profile.h
+    
+    Returns
+    the number of bytes written, 0 if 'buf' is too small
+*****************************************************************/
+size_t serializeProfile(uint8_t *buf, size_t size)
+{
+    ProfileZone z;
+    uint8_t *p = buf + PROFILE_HEADER_BYTES;
+    uint8_t used = 0;
+    uint16_t sum = 0;
+    uint32_t i;
+    uint32_t j;
+    
+    if(size < PROFILE_DUMP_BYTES)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < PROFILE_MAX_ZONES; i++)
+    {
+        readProfile(i, &z);
+        
+        if(z.count == 0u)
+        {
+            continue;
+        }
+        
+        *p++ = (uint8_t)i;
+        p = putLE(p, z.count, 4);
+        p = putLE(p, z.min, 4);
+        p = putLE(p, z.max, 4);
+        p = putLE(p, z.total, 8);
+        
+        for(j = 0; j < PROFILE_HIST_BINS; j++)
+        {
+            p = putLE(p, z.hist[j], 4);
+        }
+        
+        used++;
+    }
+    
+    //HEADER GOES IN LAST ONCE THE ZONE COUNT IS KNOWN
+    buf[0] = 'P';
+    buf[1] = 'R';
+    buf[2] = 'O';
+    buf[3] = 'F';
+    buf[4] = PROFILE_DUMP_VERSION;
+    buf[5] = used;
+    buf[6] = PROFILE_HIST_BINS;
+    buf[7] = 0;
+    putLE(&buf[8], getHclkHz(), 4);
+    putLE(&buf[12], overhead, 4);
+    
+    for(i = 0; i < (uint32_t)(p - buf); i++)
+    {
+        sum = (uint16_t)(sum + buf[i]);
+    }
+    
+    p = putLE(p, sum, 2);
+    
+    return (size_t)(p - buf);
+}
+
+ /*****************************************************************
+ sendProfile
+ 
+    Takes a snapshot of every zone and starts sending it through
+    'write' (normally uartWrite). Keep calling pumpProfile until
+    it returns 1 to send the rest
+    
+    Returns
+    1 if the whole dump was sent straight away
+*****************************************************************/
+uint8_t sendProfile(ProfileWriter write)
+{
+    dumpLen = serializeProfile(dump, sizeof(dump));
+    dumpSent = 0;
+    
+    return pumpProfile(write);
+}
+
+ /*****************************************************************
+ pumpProfile
+ 
+    Sends as much of the current dump as 'write' will take
+    without waiting
+    
+    Returns
+    1 once the whole dump has been sent
+*****************************************************************/
+uint8_t pumpProfile(ProfileWriter write)
+{
+    if(dumpSent < dumpLen)
+    {
+        dumpSent += write(&dump[dumpSent], dumpLen - dumpSent);
+    }
+    
+    return dumpSent >= dumpLen;
+}
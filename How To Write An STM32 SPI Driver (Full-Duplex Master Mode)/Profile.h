@@ -0,0 +1,52 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+#include <stddef.h>
+
+//NUMBER OF TIMING ZONES. ZONE NUMBERS RUN FROM 0 TO PROFILE_MAX_ZONES - 1
+#ifndef PROFILE_MAX_ZONES
+#define PROFILE_MAX_ZONES       16u
+#endif
+
+//HISTOGRAM BIN n COUNTS DURATIONS OF 2^n TO 2^(n+1) - 1 CYCLES.
+//THE LAST BIN ALSO COUNTS EVERYTHING LONGER
+#define PROFILE_HIST_BINS       24u
+
+//DUMP FORMAT. ALL VALUES LITTLE-ENDIAN
+//  HEADER  "PROF", VERSION (1), ZONE COUNT (1), HIST BINS (1), 0 (1),
+//          CORE CLOCK HZ (4), OVERHEAD CYCLES (4)
+//  ZONE    ID (1), COUNT (4), MIN (4), MAX (4), TOTAL (8),
+//          HIST (4 EACH)
+//  TRAILER 16-BIT SUM OF EVERY BYTE BEFORE IT (2)
+#define PROFILE_DUMP_VERSION    1u
+#define PROFILE_HEADER_BYTES    16u
+#define PROFILE_ZONE_BYTES      (1u + 4u + 4u + 4u + 8u + (4u * PROFILE_HIST_BINS))
+#define PROFILE_DUMP_BYTES      (PROFILE_HEADER_BYTES + (PROFILE_MAX_ZONES * PROFILE_ZONE_BYTES) + 2u)
+
+//STATISTICS FOR ONE ZONE. DURATIONS ARE IN CORE CYCLES
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[PROFILE_HIST_BINS];
+} ProfileZone;
+
+//SAME SIGNATURE AS uartWrite. RETURNS HOW MANY BYTES WERE TAKEN
+typedef size_t (*ProfileWriter)(const uint8_t *buf, size_t len);
+
+//TIME THE CODE BETWEEN PROFILE_BEGIN AND PROFILE_END (IN THE SAME
+//SCOPE) AND ADD IT TO A ZONE
+#define PROFILE_BEGIN(zone)     uint32_t profileStart##zone = DWT->CYCCNT
+#define PROFILE_END(zone)       recordProfile((zone), DWT->CYCCNT - profileStart##zone)
+
+void initProfile(void);
+void resetProfile(void);
+void recordProfile(uint32_t zone, uint32_t cycles);
+void readProfile(uint32_t zone, ProfileZone *stats);
+size_t serializeProfile(uint8_t *buf, size_t size);
+uint8_t sendProfile(ProfileWriter write);
+uint8_t pumpProfile(ProfileWriter write);
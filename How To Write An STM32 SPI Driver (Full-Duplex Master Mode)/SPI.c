@@ -1,5 +1,8 @@
 #include "stm32l432xx.h"
 #include "SPI.h"
+#include "Clock.h"
+#include "GPIO.h"
+#include "Board.h"
 
 
  /*****************************************************************
@@ -16,6 +19,44 @@ void initClocks(void)
   RCC->APB2ENR |= (1u << 12);    //ENABLE SPI1 CLOCK
 }
 
+ /*****************************************************************
+ calcSpiBaudRate
+ 
+    Works out the CR1 BR value (0 TO 7, DIVIDE BY 2 TO 256) that
+    gives the fastest SCK not above 'maxSckHz'
+    
+    Returns
+    the BR value, 7 if even divide by 256 is too fast
+*****************************************************************/
+uint8_t calcSpiBaudRate(uint32_t pclkHz, uint32_t maxSckHz)
+{
+    uint8_t br = 0;
+    
+    //EACH STEP DOUBLES THE DIVIDER
+    while((br < 7u) && ((pclkHz >> (br + 1u)) > maxSckHz))
+    {
+        br++;
+    }
+    
+    return br;
+}
+
+ /*****************************************************************
+ retimeSpi1
+ 
+    Reloads the baud rate prescaler after a clock change so SCK
+    stays at or below SPI1_MAX_SCK_HZ
+*****************************************************************/
+void retimeSpi1(void)
+{
+    uint32_t spe = SPI1->CR1 & (1u << 6);
+    
+    //BR CAN ONLY BE CHANGED WHILE SPI IS DISABLED
+    SPI1->CR1 &= ~(1u << 6);
+    SPI1->CR1 = (SPI1->CR1 & ~(7u << 3)) | ((uint32_t)calcSpiBaudRate(getPclk2Hz(), SPI1_MAX_SCK_HZ) << 3);
+    SPI1->CR1 |= spe;
+}
+
 
 /**********************************************************************************/
 /************************Hardware Slave Management SPI Code************************/
@@ -26,9 +67,19 @@ void initClocks(void)
  initSPI_HSM
  
     Initialises SPI1 peripheral with hardware slave management
+    
+    Returns
+    1 on success, 0 if the clock listener table is full
 *****************************************************************/
- void initSPI_HSM(void)
+ uint8_t initSPI_HSM(void)
 {
+    //KEEP SCK IN RANGE WHEN THE CLOCKS CHANGE. REGISTERED FIRST SO
+    //A FULL TABLE LEAVES NOTHING HALF SET UP
+    if(!addClockListener(retimeSpi1))
+    {
+        return 0;
+    }
+    
     //INIT ALL REQUIRED CLOCKS FOR SPI1
     initClocks();
     
@@ -37,6 +88,8 @@ void initClocks(void)
     
     //CONFIGURE SPI1
     configSpi_HSM();
+    
+    return 1;
 }
 
 /*****************************************************************
@@ -47,22 +100,11 @@ void initClocks(void)
 *****************************************************************/
 void setPinMode_HSM(void)
 {
-    //RESET PIN MODES
-    GPIOA->MODER &= ~((3u << (2 * 1))       //CLEAR PA1
-                     |(3u << (2 * 11))      //CLEAR PA11
-                     |(3u << (2 * 12))      //CLEAR PA12
-                     );
+    //SET SCLK, MISO AND MOSI TO AF
+    GPIO_SET_AF_MODE(GPIOA, BOARD_SPI1_PORTA_PINS);
     
-    GPIOB->MODER &= ~(3u << (2 * 0));       //CLEAR PB0
-    
-    
-    //CONFIGURE PIN MODES
-    GPIOA->MODER |= ((2u << (2 * 1))        //SET PA1 TO AF
-                    |(2u << (2 * 11))       //SET PA11 TO AF
-                    |(2u << (2 * 12))       //SET PA12 TO AF
-                    );
-    
-    GPIOB->MODER |= (2u << (2 * 0));        //SET PB0 TO AF
+    //SET SSEL TO AF
+    GPIO_SET_AF_MODE(GPIOB, BOARD_SPI1_PORTB_PINS);
 }
 
 /*****************************************************************
@@ -73,30 +115,11 @@ void setPinMode_HSM(void)
 *****************************************************************/
 void setAF_HSM(void)
 {
-    //RESET PIN ALTERNATE FUNCTION
-    GPIOA->AFR[0] &= ~(                     //ACCESS AF LOWER. COVERS PINS 0 TO 7
-                       (15u << (4 * 1))     //CLEAR PA1 AF
-                      );
-    
-    GPIOA->AFR[1] &= ~(                     //ACCESS AF UPPER. COVERS PINS 8 TO 15
-                       (15u << (4 * 3))     //CLEAR PA11 AF
-                      |(15u << (4 * 4))     //CLEAR PA12 AF
-                      );
-    
-    GPIOB->AFR[0] &= ~(15u << (4 * 0));     //CLEAR PB0 AF
-    
-    
-    //SET PIN ALTERNATE FUNCTION
-    GPIOA->AFR[0] |= (                      //ACCESS AF LOWER. COVERS PINS 0 TO 7
-                      (5u << (4 * 1))       //SET SPI1 SCLK (PA1)
-                     );
+    //SET SPI1 SCLK, MISO AND MOSI
+    GPIO_SET_AF(GPIOA, BOARD_SPI1_PORTA_PINS);
     
-    GPIOA->AFR[1] |= (                      //ACCESS AF UPPER. COVERS PINS 8 TO 15
-                      (5u << (4 * 3))       //SET SPI1 MISO (PA11)
-                     |(5u << (4 * 4))       //SET SPI1 MOSI (PA12)
-                     );
-                     
-    GPIOB->AFR[0] |= (5u << (4 * 0));       //SET SPI1 SSEL (PB0);
+    //SET SPI1 SSEL
+    GPIO_SET_AF(GPIOB, BOARD_SPI1_PORTB_PINS);
 }
 
 /*****************************************************************
@@ -134,7 +157,7 @@ void setAF_HSM(void)
                   );
     
     //SET BITS
-    SPI1->CR1 |= ((5u << 3)             //DIVIDE SPI FREQUENCY BY 64
+    SPI1->CR1 |= (((uint32_t)calcSpiBaudRate(getPclk2Hz(), SPI1_MAX_SCK_HZ) << 3)  //DIVIDE SPI FREQUENCY DOWN TO SPI1_MAX_SCK_HZ
                  |(1u << 2)             //MASTER MODE
                  |(1u << 1)             //CLOCK POLARITY OF 1
                  |(1u << 0)             //CLOCK PHASE OF 1
@@ -214,22 +237,11 @@ uint8_t transferSPI_HSM(uint8_t tx_data)    //HOLDS THE MPU9250 REGISTER ADDRESS
 *****************************************************************/
 void setPinMode_SSM(void)
 {
-    //RESET PIN MODES
-    GPIOA->MODER &= ~((3u << (2 * 1))       //CLEAR PA1
-                     |(3u << (2 * 11))      //CLEAR PA11
-                     |(3u << (2 * 12))      //CLEAR PA12
-                     );
-    
-    GPIOB->MODER &= ~(3u << (2 * 0));       //CLEAR PB0
-    
-    
-    //CONFIGURE PIN MODES
-    GPIOA->MODER |= ((2u << (2 * 1))        //SET PA1 TO AF
-                    |(2u << (2 * 11))       //SET PA11 TO AF
-                    |(2u << (2 * 12))       //SET PA12 TO AF
-                    );
+    //SET SCLK, MISO AND MOSI TO AF
+    GPIO_SET_AF_MODE(GPIOA, BOARD_SPI1_PORTA_PINS);
     
-    GPIOB->MODER |= (1u << (2 * 0));        //SET PB0 TO OUTPUT MODE
+    //SET SLAVE SELECT TO OUTPUT MODE
+    GPIO_WRITE_FIELD(BOARD_SPI1_CS_PORT->MODER, GPIO_MODER_MSK(BOARD_SPI1_CS_PIN), GPIO_MODER_SET(BOARD_SPI1_CS_PIN, GPIO_MODE_OUTPUT));
 }
 
 /*****************************************************************
@@ -240,35 +252,27 @@ void setPinMode_SSM(void)
 *****************************************************************/
 void setAF_SSM(void)
 {
-    //RESET PIN ALTERNATE FUNCTION
-    GPIOA->AFR[0] &= ~(                     //ACCESS AF LOWER. COVERS PINS 0 TO 7
-                       (15u << (4 * 1))     //CLEAR PA1 AF
-                      );
-    
-    GPIOA->AFR[1] &= ~(                     //ACCESS AF UPPER. COVERS PINS 8 TO 15
-                       (15u << (4 * 3))     //CLEAR PA11 AF
-                      |(15u << (4 * 4))     //CLEAR PA12 AF
-                      );
-    
-    
-    //SET PIN ALTERNATE FUNCTION
-    GPIOA->AFR[0] |= (                      //ACCESS AF LOWER. COVERS PINS 0 TO 7
-                      (5u << (4 * 1))       //SET SPI1 SCLK (PA1)
-                     );
-    
-    GPIOA->AFR[1] |= (                      //ACCESS AF UPPER. COVERS PINS 8 TO 15
-                      (5u << (4 * 3))       //SET SPI1 MISO (PA11)
-                     |(5u << (4 * 4))       //SET SPI1 MOSI (PA12)
-                     );
+    //SET SPI1 SCLK, MISO AND MOSI
+    GPIO_SET_AF(GPIOA, BOARD_SPI1_PORTA_PINS);
 }
 
 /*****************************************************************
  initSPI_SSM
  
     Initialises SPI1 peripheral with software slave management
+    
+    Returns
+    1 on success, 0 if the clock listener table is full
 *****************************************************************/
- void initSPI_SSM(void)
+ uint8_t initSPI_SSM(void)
 {
+    //KEEP SCK IN RANGE WHEN THE CLOCKS CHANGE. REGISTERED FIRST SO
+    //A FULL TABLE LEAVES NOTHING HALF SET UP
+    if(!addClockListener(retimeSpi1))
+    {
+        return 0;
+    }
+    
     //INIT ALL REQUIRED CLOCKS FOR SPI1
     initClocks();
     
@@ -276,10 +280,12 @@ void setAF_SSM(void)
     configSpi1Pins_SSM();
     
     //INITIALISE SLAVE SELECT HIGH
-    GPIOB->ODR |= (1u << 0);
+    GPIO_PIN_HIGH(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN);
     
     //CONFIGURE SPI1
     configSpi_SSM();
+    
+    return 1;
 }
 
  /*****************************************************************
@@ -302,7 +308,7 @@ void setAF_SSM(void)
     //SET BITS
     SPI1->CR1 |= ((1u << 9)             //SOFTWARE SLAVE MANAGEMENT
                  |(1u << 8)             //INTERNAL SLAVE SELECT
-                 |(5u << 3)             //DIVIDE SPI FREQUENCY BY 64
+                 |((uint32_t)calcSpiBaudRate(getPclk2Hz(), SPI1_MAX_SCK_HZ) << 3)   //DIVIDE SPI FREQUENCY DOWN TO SPI1_MAX_SCK_HZ
                  |(1u << 2)             //MASTER MODE
                  |(1u << 1)             //CLOCK POLARITY OF 1
                  |(1u << 0)             //CLOCK PHASE OF 1
@@ -336,7 +342,7 @@ uint8_t transferSPI_SSM(uint8_t tx_data)    //HOLDS THE MPU9250 REGISTER ADDRESS
     uint8_t rx_data = 0;
     
     //SET SLAVE SELECT LOW
-    GPIOB->ODR &= ~(1u << 0);
+    GPIO_PIN_LOW(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN);
     
     //WRITE DATA AND DUMMY BYTE TO DATA REGISTER
     SPI1->DR = (uint16_t)(tx_data << 8);
@@ -348,7 +354,456 @@ uint8_t transferSPI_SSM(uint8_t tx_data)    //HOLDS THE MPU9250 REGISTER ADDRESS
     rx_data = (uint8_t)SPI1->DR;
     
     //SET SLAVE SELECT HIGH
-    GPIOB->ODR |= (1u << 0);
+    GPIO_PIN_HIGH(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN);
     
     return rx_data;
 }
+
+
+/*****************************************************************
+ setFrameSize_SSM
+ 
+    Switches SPI1 between 8-bit and 16-bit frames. FRXTH is set
+    for 8-bit frames so RXNE goes up for every byte
+*****************************************************************/
+static void setFrameSize_SSM(uint8_t frameBits)
+{
+    //DISABLE SPI WHILE THE FRAME FORMAT IS CHANGED
+    SPI1->CR1 &= ~(1u << 6);
+    
+    SPI1->CR2 &= ~((15u << 8)               //CLEAR DATA SIZE
+                  |(1u << 12)               //RXNE AT 1/2 (16-BIT) RX FIFO LEVEL
+                  );
+    
+    if(frameBits == SPI_FRAME_8BIT)
+    {
+        SPI1->CR2 |= ((7u << 8)             //8-BIT DATA TRANSFERS
+                     |(1u << 12)            //RXNE AT 1/4 (8-BIT) RX FIFO LEVEL
+                     );
+    }
+    else
+    {
+        SPI1->CR2 |= (15u << 8);            //16-BIT DATA TRANSFERS
+    }
+    
+    //ENABLE SPI1
+    SPI1->CR1 |= (1u << 6);
+}
+
+/*****************************************************************
+ transferSPIStream_SSM
+ 
+    Moves 'count' frames of 8 or 16 bits in one slave select
+    burst. The TX FIFO is kept topped up while the RX FIFO is
+    drained so there is no gap on the bus between frames. At most
+    one RX FIFO's worth of frames (4 bytes or 2 half-words) is in
+    flight at once so the RX FIFO can never overrun.
+    'tx' may be 0 to send all ones and 'rx' may be 0 to throw the
+    received frames away. Buffers hold uint8_t for 8-bit frames
+    and uint16_t for 16-bit frames.
+    
+    Returns
+    1 if the frames were moved, 0 if 'frameBits' isn't
+    SPI_FRAME_8BIT or SPI_FRAME_16BIT
+*****************************************************************/
+uint8_t transferSPIStream_SSM(const void *tx, void *rx, size_t count, uint8_t frameBits)
+{
+    const uint8_t *tx8 = (const uint8_t *)tx;
+    const uint16_t *tx16 = (const uint16_t *)tx;
+    uint8_t *rx8 = (uint8_t *)rx;
+    uint16_t *rx16 = (uint16_t *)rx;
+    uint8_t wide = (frameBits == SPI_FRAME_16BIT);
+    size_t depth = wide ? 2u : 4u;
+    size_t txCount = 0;
+    size_t rxCount = 0;
+    uint16_t data;
+    
+    //THE BUFFERS ARE ONLY EVER uint8_t OR uint16_t
+    if((frameBits != SPI_FRAME_8BIT) && (frameBits != SPI_FRAME_16BIT))
+    {
+        return 0;
+    }
+    
+    if(count == 0u)
+    {
+        return 1;
+    }
+    
+    setFrameSize_SSM(frameBits);
+    
+    //SET SLAVE SELECT LOW
+    GPIO_PIN_LOW(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN);
+    
+    while(rxCount < count)
+    {
+        //QUEUE ANOTHER FRAME IF THERE IS ROOM AND IT WON'T OVERRUN RX
+        if((txCount < count) && ((txCount - rxCount) < depth) && ((SPI1->SR)&(1u << 1)))
+        {
+            if(wide)
+            {
+                SPI1->DR = tx ? tx16[txCount] : 0xFFFFu;
+            }
+            else
+            {
+                //BYTE-WIDE ACCESS SO ONLY ONE FRAME IS PACKED INTO THE FIFO
+                *(volatile uint8_t *)&SPI1->DR = tx ? tx8[txCount] : 0xFFu;
+            }
+            
+            txCount++;
+        }
+        
+        //TAKE A FRAME OUT OF THE RX FIFO
+        if((SPI1->SR)&(1u << 0))
+        {
+            if(wide)
+            {
+                data = (uint16_t)SPI1->DR;
+                
+                if(rx)
+                {
+                    rx16[rxCount] = data;
+                }
+            }
+            else
+            {
+                data = *(volatile uint8_t *)&SPI1->DR;
+                
+                if(rx)
+                {
+                    rx8[rxCount] = (uint8_t)data;
+                }
+            }
+            
+            rxCount++;
+        }
+    }
+    
+    //WAIT UNTIL THE LAST FRAME HAS LEFT THE SHIFT REGISTER
+    while((SPI1->SR)&(1u << 7));
+    
+    //SET SLAVE SELECT HIGH
+    GPIO_PIN_HIGH(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN);
+    
+    //BACK TO THE 16-BIT FRAMES USED BY transferSPI_SSM
+    setFrameSize_SSM(SPI_FRAME_16BIT);
+    
+    return 1;
+}
+
+
+/**********************************************************************************/
+/******************************DMA Burst SPI Code**********************************/
+/**********************************************************************************/
+
+
+//SET WHILE A DMA BURST IS IN PROGRESS
+static volatile uint8_t spiDmaBusy = 0;
+
+//CALLED FROM THE DMA INTERRUPT ONCE THE BURST HAS FINISHED
+static SpiDmaCallback spiDmaCallback = 0;
+
+//SET WHILE THE BURST WAS STARTED BY transferSPI_DMA, WHICH LOOKS
+//AFTER THE FRAME SIZE AND SLAVE SELECT ITSELF
+static uint8_t spiDmaOwnsSlave = 0;
+
+//SENT WHEN THE CALLER HAS NOTHING TO TRANSMIT. 16 BITS WIDE SO
+//IT ALSO WORKS FOR 16-BIT FRAMES
+static const uint16_t spiDmaTxDummy = 0xFFFFu;
+
+//RECEIVES THE INCOMING FRAMES WHEN THE CALLER DOES NOT WANT THEM
+static uint16_t spiDmaRxDummy = 0;
+
+
+static uint8_t beginSPI_DMA(const void *tx, void *rx, size_t count, uint8_t frameBits, SpiDmaCallback callback, uint8_t ownsSlave);
+
+
+/*****************************************************************
+ initSPI_DMA
+ 
+    Initialises SPI1 with software slave management and prepares
+    DMA1 channels 2 (SPI1_RX) and 3 (SPI1_TX) for burst transfers
+    
+    Returns
+    1 on success, 0 if the clock listener table is full
+*****************************************************************/
+ uint8_t initSPI_DMA(void)
+{
+    //SET UP SPI1 THE SAME WAY AS FOR SINGLE TRANSFERS
+    if(!initSPI_SSM())
+    {
+        return 0;
+    }
+    
+    //CONFIGURE DMA1 FOR SPI1
+    configDma_SPI();
+    
+    return 1;
+}
+
+/*****************************************************************
+ configDma_SPI
+ 
+    Configures DMA1 channel 2 to move bytes from SPI1_DR into
+    memory and DMA1 channel 3 to move bytes from memory into
+    SPI1_DR. The channels are only enabled by transferSPI_DMA
+*****************************************************************/
+ void configDma_SPI(void)
+{
+    //ENABLE DMA1 CLOCK
+    RCC->AHB1ENR |= (1u << 0);
+    
+    //MAKE SURE BOTH CHANNELS ARE OFF BEFORE CONFIGURING THEM
+    DMA1_Channel2->CCR &= ~(1u << 0);
+    DMA1_Channel3->CCR &= ~(1u << 0);
+    
+    //ROUTE SPI1 REQUESTS TO CHANNELS 2 AND 3
+    DMA1_CSELR->CSELR &= ~((15u << 4)       //CLEAR CHANNEL 2 REQUEST SELECTION
+                          |(15u << 8)       //CLEAR CHANNEL 3 REQUEST SELECTION
+                          );
+    
+    DMA1_CSELR->CSELR |= ((1u << 4)         //CHANNEL 2 = SPI1_RX
+                         |(1u << 8)         //CHANNEL 3 = SPI1_TX
+                         );
+    
+    //BOTH CHANNELS TALK TO THE SPI1 DATA REGISTER
+    DMA1_Channel2->CPAR = (uint32_t)&SPI1->DR;
+    DMA1_Channel3->CPAR = (uint32_t)&SPI1->DR;
+    
+    //RX CHANNEL. 8-BIT PERIPHERAL AND MEMORY SIZES (BITS 8 TO 11 LEFT AT 0)
+    DMA1_Channel2->CCR = ((2u << 12)        //HIGH PRIORITY SO RX NEVER FALLS BEHIND TX
+                         |(1u << 3)         //TRANSFER ERROR INTERRUPT
+                         |(1u << 1)         //TRANSFER COMPLETE INTERRUPT
+                         );                 //DIRECTION: READ FROM PERIPHERAL
+    
+    //TX CHANNEL. 8-BIT PERIPHERAL AND MEMORY SIZES (BITS 8 TO 11 LEFT AT 0)
+    DMA1_Channel3->CCR = ((1u << 12)        //MEDIUM PRIORITY
+                         |(1u << 4)         //DIRECTION: READ FROM MEMORY
+                         |(1u << 3)         //TRANSFER ERROR INTERRUPT
+                         );
+    
+    //THE RX CHANNEL FINISHES LAST SO IT SIGNALS THE END OF THE BURST
+    NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+    NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+}
+
+/*****************************************************************
+ transferSPI_DMA
+ 
+    Starts a full-duplex burst of 'len' bytes on SPI1 and returns
+    straight away. The slave select is held low for the whole
+    burst. 'tx' may be 0 to send 0xFF dummy bytes and 'rx' may be
+    0 to throw the received bytes away. 'callback' (may be 0) is
+    called from the DMA interrupt once the burst has finished.
+    
+    Returns
+    1 if the burst was started, 0 if a burst is already running
+    or 'len' is out of range (1 to 65535 bytes)
+*****************************************************************/
+uint8_t transferSPI_DMA(const uint8_t *tx, uint8_t *rx, size_t len, SpiDmaCallback callback)
+{
+    if(spiDmaBusy || (len == 0u) || (len > 0xFFFFu))
+    {
+        return 0;
+    }
+    
+    //DISABLE SPI WHILE THE FRAME FORMAT IS CHANGED
+    SPI1->CR1 &= ~(1u << 6);
+    
+    //SWITCH TO 8-BIT FRAMES SO EACH DMA REQUEST MOVES ONE BYTE
+    SPI1->CR2 &= ~(15u << 8);               //CLEAR DATA SIZE
+    SPI1->CR2 |= ((7u << 8)                 //8-BIT DATA TRANSFERS
+                 |(1u << 12)                //RXNE EVENT TRIGGERED AT 1/4 (8-BIT) RX FIFO LEVEL
+                 );
+    
+    //SET SLAVE SELECT LOW
+    GPIO_PIN_LOW(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN);
+    
+    //THE BURST MAY END IN ERROR AS SOON AS THE CHANNELS ARE ENABLED,
+    //SO THE SLAVE IS HANDED OVER BEFORE, NOT AFTER
+    return beginSPI_DMA(tx, rx, len, SPI_FRAME_8BIT, callback, 1);
+}
+
+/*****************************************************************
+ startSPI_DMA
+ 
+    Starts a burst of 'count' frames with SPI1 exactly as it is
+    configured. SPI1 must be disabled, with the frame size already
+    set. Nothing is done with any slave select. Once the burst is
+    over SPI1 is left disabled with DMA requests off and 'callback'
+    (may be 0) is called from the DMA interrupt.
+    Used by the SPI bus manager, which keeps its own configuration
+    for every device.
+    
+    Returns
+    1 if the burst was started, 0 if a burst is already running
+    or 'count' is out of range (1 to 65535 frames)
+*****************************************************************/
+uint8_t startSPI_DMA(const void *tx, void *rx, size_t count, uint8_t frameBits, SpiDmaCallback callback)
+{
+    return beginSPI_DMA(tx, rx, count, frameBits, callback, 0);
+}
+
+/*****************************************************************
+ beginSPI_DMA
+ 
+    Starts the burst for startSPI_DMA and transferSPI_DMA. Who
+    looks after slave select and the frame size afterwards is set
+    before anything is enabled, as a transfer error can end the
+    burst straight away
+*****************************************************************/
+static uint8_t beginSPI_DMA(const void *tx, void *rx, size_t count, uint8_t frameBits, SpiDmaCallback callback, uint8_t ownsSlave)
+{
+    //BITS 8 TO 11 SET THE PERIPHERAL AND MEMORY SIZES. 8-BIT FOR
+    //FRAMES UP TO 8 BITS, OTHERWISE 16-BIT
+    uint32_t sizes = (frameBits > 8u) ? ((1u << 10) | (1u << 8)) : 0u;
+    
+    if(spiDmaBusy || (count == 0u) || (count > 0xFFFFu))
+    {
+        return 0;
+    }
+    
+    spiDmaBusy = 1;
+    spiDmaOwnsSlave = ownsSlave;
+    spiDmaCallback = callback;
+    
+    //RX DMA REQUESTS MUST BE ENABLED FIRST
+    SPI1->CR2 |= (1u << 0);
+    
+    //RX CHANNEL. ONLY STEP THROUGH MEMORY WHEN THERE IS A BUFFER
+    DMA1_Channel2->CCR = (DMA1_Channel2->CCR & ~(15u << 8)) | sizes;
+    DMA1_Channel2->CNDTR = (uint32_t)count;
+    if(rx)
+    {
+        DMA1_Channel2->CMAR = (uint32_t)rx;
+        DMA1_Channel2->CCR |= (1u << 7);
+    }
+    else
+    {
+        DMA1_Channel2->CMAR = (uint32_t)&spiDmaRxDummy;
+        DMA1_Channel2->CCR &= ~(1u << 7);
+    }
+    
+    //TX CHANNEL. ONLY STEP THROUGH MEMORY WHEN THERE IS A BUFFER
+    DMA1_Channel3->CCR = (DMA1_Channel3->CCR & ~(15u << 8)) | sizes;
+    DMA1_Channel3->CNDTR = (uint32_t)count;
+    if(tx)
+    {
+        DMA1_Channel3->CMAR = (uint32_t)tx;
+        DMA1_Channel3->CCR |= (1u << 7);
+    }
+    else
+    {
+        DMA1_Channel3->CMAR = (uint32_t)&spiDmaTxDummy;
+        DMA1_Channel3->CCR &= ~(1u << 7);
+    }
+    
+    //CLEAR ANY OLD FLAGS FOR CHANNELS 2 AND 3 THEN ENABLE THEM
+    DMA1->IFCR = ((15u << 4) | (15u << 8));
+    DMA1_Channel2->CCR |= (1u << 0);
+    DMA1_Channel3->CCR |= (1u << 0);
+    
+    //TX DMA REQUESTS ARE ENABLED ONCE BOTH CHANNELS ARE READY
+    SPI1->CR2 |= (1u << 1);
+    
+    //ENABLE SPI. THE FIRST TX REQUEST STARTS THE BURST
+    SPI1->CR1 |= (1u << 6);
+    
+    return 1;
+}
+
+/*****************************************************************
+ busySPI_DMA
+ 
+    Returns
+    1 while a DMA burst is in progress, otherwise 0
+*****************************************************************/
+uint8_t busySPI_DMA(void)
+{
+    return spiDmaBusy;
+}
+
+/*****************************************************************
+ finishSPI_DMA
+ 
+    Stops both DMA channels and disables SPI1. A burst started by
+    transferSPI_DMA also puts SPI1 back into the 16-bit
+    configuration used by transferSPI_SSM and releases the slave
+*****************************************************************/
+static void finishSPI_DMA(uint8_t status)
+{
+    SpiDmaCallback callback = spiDmaCallback;
+    
+    //STOP BOTH CHANNELS
+    DMA1_Channel2->CCR &= ~(1u << 0);
+    DMA1_Channel3->CCR &= ~(1u << 0);
+    
+    //WAIT UNTIL THE LAST FRAME HAS LEFT THE SHIFT REGISTER
+    while((SPI1->SR)&(1u << 7));
+    
+    //DISABLE SPI AND DMA REQUEST GENERATION
+    SPI1->CR1 &= ~(1u << 6);
+    SPI1->CR2 &= ~(3u << 0);
+    
+    if(spiDmaOwnsSlave)
+    {
+        //GO BACK TO 16-BIT FRAMES
+        SPI1->CR2 &= ~((15u << 8)           //CLEAR DATA SIZE
+                      |(1u << 12)           //RXNE EVENT TRIGGERED AT 1/2 (16-BIT) RX FIFO LEVEL
+                      );
+        SPI1->CR2 |= (15u << 8);            //16-BIT DATA TRANSFERS
+        
+        //SET SLAVE SELECT HIGH
+        GPIO_PIN_HIGH(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN);
+        
+        //ENABLE SPI1 AGAIN FOR transferSPI_SSM
+        SPI1->CR1 |= (1u << 6);
+    }
+    
+    spiDmaBusy = 0;
+    
+    if(callback)
+    {
+        callback(status);
+    }
+}
+
+/*****************************************************************
+ DMA1_Channel2_IRQHandler
+ 
+    SPI1_RX channel. The burst is over once the last byte has been
+    received
+*****************************************************************/
+void DMA1_Channel2_IRQHandler(void)
+{
+    uint32_t isr = DMA1->ISR;
+    
+    //CLEAR ALL CHANNEL 2 FLAGS
+    DMA1->IFCR = (15u << 4);
+    
+    if(isr & (1u << 7))                     //TRANSFER ERROR
+    {
+        finishSPI_DMA(SPI_DMA_ERROR);
+    }
+    else if(isr & (1u << 5))                //TRANSFER COMPLETE
+    {
+        finishSPI_DMA(SPI_DMA_OK);
+    }
+}
+
+/*****************************************************************
+ DMA1_Channel3_IRQHandler
+ 
+    SPI1_TX channel. Only used to abort the burst on an error
+*****************************************************************/
+void DMA1_Channel3_IRQHandler(void)
+{
+    uint32_t isr = DMA1->ISR;
+    
+    //CLEAR ALL CHANNEL 3 FLAGS
+    DMA1->IFCR = (15u << 8);
+    
+    if(isr & (1u << 11))                    //TRANSFER ERROR
+    {
+        finishSPI_DMA(SPI_DMA_ERROR);
+    }
+}
@@ -3,17 +3,38 @@
 #include "stm32l432xx.h"
 #endif
 
+#include <stddef.h>
+
+//FASTEST SCK THE SLAVE IS DRIVEN AT. THE BAUD RATE PRESCALER IS
+//CHOSEN FROM PCLK2 SO SCK NEVER GOES ABOVE THIS. THE MPU9250
+//ACCEPTS 1MHZ FOR ALL OF ITS REGISTERS
+#ifndef SPI1_MAX_SCK_HZ
+#define SPI1_MAX_SCK_HZ 1000000u
+#endif
+
+//FRAME SIZES FOR transferSPIStream_SSM
+#define SPI_FRAME_8BIT  8
+#define SPI_FRAME_16BIT 16
+
+#define SPI_DMA_OK      0
+#define SPI_DMA_ERROR   1
+
+typedef void (*SpiDmaCallback)(uint8_t status);
+
 void initClocks(void);
+uint8_t calcSpiBaudRate(uint32_t pclkHz, uint32_t maxSckHz);
+void retimeSpi1(void);
 
-void initSPI_SSM(void);
+uint8_t initSPI_SSM(void);
 void configSpi1Pins_SSM(void);
 void setPinMode_SSM(void);
 void setAF_SSM(void);
 void configSpi_SSM(void);
 uint8_t transferSPI_SSM(uint8_t tx_data);
+uint8_t transferSPIStream_SSM(const void *tx, void *rx, size_t count, uint8_t frameBits);
 
 
-void initSPI_HSM(void);
+uint8_t initSPI_HSM(void);
 void configSpi1Pins_HSM(void);
 void setPinMode_HSM(void);
 void setAF_HSM(void);
@@ -21,4 +42,8 @@ void configSpi_HSM(void);
 uint8_t transferSPI_HSM(uint8_t tx_data);
 
 
-
+uint8_t initSPI_DMA(void);
+void configDma_SPI(void);
+uint8_t transferSPI_DMA(const uint8_t *tx, uint8_t *rx, size_t len, SpiDmaCallback callback);
+uint8_t startSPI_DMA(const void *tx, void *rx, size_t count, uint8_t frameBits, SpiDmaCallback callback);
+uint8_t busySPI_DMA(void);
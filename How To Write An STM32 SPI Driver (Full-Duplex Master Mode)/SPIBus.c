@@ -0,0 +1,369 @@
+#include "stm32l432xx.h"
+#include "SPI.h"
+#include "SPIBus.h"
+#include "Clock.h"
+#include "GPIO.h"
+
+
+/*****************************************************************
+ SPI1 is shared by several slaves, each with its own slave select
+ pin and frame format. Every device keeps CR1 and CR2 images built
+ once by addSpiDevice, so moving the bus to another device is two
+ register writes and staying on the same device is none.
+ 
+ Transactions are queued per device and the bus takes one from
+ each device in turn, so a device with a long queue can't hold
+ the others off. The next burst is started from the DMA interrupt
+ of the last one, so the bus never waits on the main loop.
+ 
+ Once initSpiBus has been called SPI1 belongs to the bus and the
+ SSM, HSM and transferSPI_DMA functions must not be used.
+*****************************************************************/
+
+
+//REGISTERED DEVICES, IN ROUND ROBIN ORDER
+static SpiDevice *devices[SPI_BUS_MAX_DEVICES];
+static uint8_t deviceCount = 0;
+
+//DEVICE WHOSE IMAGES ARE IN CR1 AND CR2, 0 IF NONE
+static SpiDevice *loadedDevice = 0;
+
+//TRANSACTION ON THE BUS, 0 IF IDLE
+static SpiTransaction *activeTransaction = 0;
+
+//INDEX OF THE DEVICE THAT WENT LAST
+static uint8_t lastDevice = 0;
+
+static SpiBusStats stats;
+
+
+static void completeTransfer(uint8_t status);
+static void startNextTransfer(void);
+
+
+ /*****************************************************************
+ buildImages
+ 
+    Works out the CR1 and CR2 values for a device at the current
+    PCLK2
+*****************************************************************/
+static void buildImages(SpiDevice *device)
+{
+    device->cr1 = (uint16_t)((1u << 9)          //SOFTWARE SLAVE MANAGEMENT
+                            |(1u << 8)          //INTERNAL SLAVE SELECT
+                            |((uint32_t)calcSpiBaudRate(getPclk2Hz(), device->maxSckHz) << 3)
+                            |(1u << 2)          //MASTER MODE
+                            |(device->mode & 3u)    //CLOCK POLARITY AND PHASE
+                            );
+    
+    device->cr2 = (uint16_t)((uint32_t)(device->frameBits - 1u) << 8);  //DATA SIZE
+    
+    //RXNE FOR EVERY BYTE WHEN FRAMES FIT IN ONE BYTE
+    if(device->frameBits <= 8u)
+    {
+        device->cr2 |= (1u << 12);
+    }
+}
+
+ /*****************************************************************
+ initSpiBus
+ 
+    Sets up the SPI1 clocks, the SCLK, MISO and MOSI pins and the
+    DMA channels. Devices are added afterwards with addSpiDevice
+    
+    Returns
+    1 on success, 0 if the clock listener table is full
+*****************************************************************/
+uint8_t initSpiBus(void)
+{
+    //KEEP SCK IN RANGE WHEN THE CLOCKS CHANGE. REGISTERED FIRST SO
+    //A FULL TABLE LEAVES NOTHING HALF SET UP
+    if(!addClockListener(retimeSpiBus))
+    {
+        return 0;
+    }
+    
+    //INIT ALL REQUIRED CLOCKS FOR SPI1
+    initClocks();
+    
+    //SET SPI1 SCLK, MISO AND MOSI TO ALTERNATE FUNCTION 5
+    configSpi1Pins_SSM();
+    
+    //SPI1 STAYS DISABLED UNTIL THE FIRST TRANSACTION
+    SPI1->CR1 = 0;
+    SPI1->CR2 = 0;
+    loadedDevice = 0;
+    
+    //CONFIGURE DMA1 FOR SPI1
+    configDma_SPI();
+    
+    return 1;
+}
+
+ /*****************************************************************
+ addSpiDevice
+ 
+    Registers a slave. Its slave select pin is made an output and
+    driven high
+    
+    Returns
+    1 if the device was added, 0 if the bus is full or a setting
+    is out of range
+*****************************************************************/
+uint8_t addSpiDevice(SpiDevice *device, GPIO_TypeDef *csPort, uint8_t csPin, uint8_t mode, uint32_t maxSckHz, uint8_t frameBits)
+{
+    if((deviceCount >= SPI_BUS_MAX_DEVICES) || (csPin > 15u) || (mode > 3u) || (frameBits < 4u) || (frameBits > 16u))
+    {
+        return 0;
+    }
+    
+    device->csPort = csPort;
+    device->csPin = csPin;
+    device->mode = mode;
+    device->frameBits = frameBits;
+    device->maxSckHz = maxSckHz;
+    device->head = 0;
+    device->tail = 0;
+    buildImages(device);
+    
+    //ENABLE THE CLOCK OF THE SLAVE SELECT PORT. PORTS ARE 0X400 APART
+    RCC->AHB2ENR |= (1u << (((uint32_t)csPort - GPIOA_BASE) / 0x400u));
+    
+    //SLAVE SELECT HIGH THEN OUTPUT SO IT NEVER GLITCHES LOW
+    GPIO_PIN_HIGH(csPort, csPin);
+    GPIO_WRITE_FIELD(csPort->MODER, GPIO_MODER_MSK(csPin), GPIO_MODER_SET(csPin, GPIO_MODE_OUTPUT));
+    
+    devices[deviceCount] = device;
+    deviceCount++;
+    
+    return 1;
+}
+
+ /*****************************************************************
+ queueSpiTransfer
+ 
+    Queues a burst of 'count' frames for 'device'. 'transaction'
+    must stay valid until its status is SPI_BUS_DONE or
+    SPI_BUS_ERROR. May be called from interrupts, including
+    transaction callbacks
+    
+    Returns
+    1 if the transaction was queued, 0 if 'count' is out of range
+    (1 to 65535 frames)
+*****************************************************************/
+uint8_t queueSpiTransfer(SpiTransaction *transaction, SpiDevice *device, const void *tx, void *rx, size_t count, SpiTransactionCallback callback, void *arg)
+{
+    uint32_t primask;
+    
+    if((count == 0u) || (count > 0xFFFFu))
+    {
+        return 0;
+    }
+    
+    transaction->next = 0;
+    transaction->device = device;
+    transaction->tx = tx;
+    transaction->rx = rx;
+    transaction->count = count;
+    transaction->callback = callback;
+    transaction->arg = arg;
+    transaction->status = SPI_BUS_QUEUED;
+    
+    primask = __get_PRIMASK();
+    __disable_irq();
+    
+    //ADD TO THE END OF THE DEVICE'S QUEUE
+    if(device->tail)
+    {
+        device->tail->next = transaction;
+    }
+    else
+    {
+        device->head = transaction;
+    }
+    device->tail = transaction;
+    
+    if(!activeTransaction)
+    {
+        startNextTransfer();
+    }
+    
+    __set_PRIMASK(primask);
+    
+    return 1;
+}
+
+ /*****************************************************************
+ waitSpiTransfer
+ 
+    Sleeps until a queued transaction has finished
+*****************************************************************/
+void waitSpiTransfer(const SpiTransaction *transaction)
+{
+    //INTERRUPTS ARE MASKED BETWEEN THE CHECK AND WFI SO THE END OF
+    //THE BURST CAN'T BE MISSED
+    __disable_irq();
+    while(transaction->status >= SPI_BUS_QUEUED)
+    {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    __enable_irq();
+}
+
+ /*****************************************************************
+ retimeSpiBus
+ 
+    Rebuilds every device's images after a clock change so SCK
+    stays at or below each device's maximum. Takes effect from the
+    next burst
+*****************************************************************/
+void retimeSpiBus(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint8_t i;
+    
+    __disable_irq();
+    
+    for(i = 0; i < deviceCount; i++)
+    {
+        buildImages(devices[i]);
+    }
+    
+    //FORCE A RELOAD ON THE NEXT BURST
+    loadedDevice = 0;
+    
+    __set_PRIMASK(primask);
+}
+
+ /*****************************************************************
+ getSpiBusStats
+ 
+    Returns
+    the bus counters
+*****************************************************************/
+const SpiBusStats *getSpiBusStats(void)
+{
+    return &stats;
+}
+
+ /*****************************************************************
+ finishTransfer
+ 
+    DMA callback. Releases the slave, hands the transaction back
+    and starts the next one
+*****************************************************************/
+static void finishTransfer(uint8_t status)
+{
+    completeTransfer(status);
+    
+    if(!activeTransaction)
+    {
+        startNextTransfer();
+    }
+}
+
+ /*****************************************************************
+ completeTransfer
+ 
+    Releases the slave of the active transaction, takes it off its
+    device's queue and hands it back with 'status'
+*****************************************************************/
+static void completeTransfer(uint8_t status)
+{
+    SpiTransaction *transaction = activeTransaction;
+    SpiDevice *device = transaction->device;
+    
+    //SET SLAVE SELECT HIGH
+    GPIO_PIN_HIGH(device->csPort, device->csPin);
+    
+    //TAKE IT OFF THE FRONT OF THE DEVICE'S QUEUE
+    device->head = transaction->next;
+    if(!device->head)
+    {
+        device->tail = 0;
+    }
+    
+    activeTransaction = 0;
+    transaction->status = (status == SPI_DMA_OK) ? SPI_BUS_DONE : SPI_BUS_ERROR;
+    
+    //THE CALLBACK MAY QUEUE MORE WORK, WHICH STARTS IT STRAIGHT AWAY
+    if(transaction->callback)
+    {
+        transaction->callback(transaction);
+    }
+}
+
+ /*****************************************************************
+ startNextTransfer
+ 
+    Starts the oldest transaction of the next device after the
+    last one that has work queued. A transaction the DMA won't
+    take, because SPI1 is already busy with a burst the bus didn't
+    start, ends with SPI_BUS_ERROR and the next one is tried.
+    Called with interrupts masked or from the DMA interrupt
+*****************************************************************/
+static void startNextTransfer(void)
+{
+    SpiDevice *device;
+    SpiTransaction *transaction;
+    uint8_t i;
+    uint8_t index;
+    
+    while(!activeTransaction)
+    {
+        device = 0;
+        index = lastDevice;
+        
+        //ROUND ROBIN, STARTING WITH THE DEVICE AFTER THE LAST ONE
+        for(i = 0; i < deviceCount; i++)
+        {
+            index = (uint8_t)((index + 1u) % deviceCount);
+            
+            if(devices[index]->head)
+            {
+                device = devices[index];
+                break;
+            }
+        }
+        
+        if(!device)
+        {
+            return;
+        }
+        
+        lastDevice = index;
+        transaction = device->head;
+        activeTransaction = transaction;
+        transaction->status = SPI_BUS_ACTIVE;
+        
+        //SPI1 MUST NOT BE TOUCHED WHILE A BURST THE BUS DIDN'T START
+        //IS RUNNING
+        if(!busySPI_DMA())
+        {
+            //SPI1 IS DISABLED BETWEEN BURSTS SO THE IMAGES CAN GO STRAIGHT IN
+            if(loadedDevice != device)
+            {
+                SPI1->CR1 = device->cr1;
+                SPI1->CR2 = device->cr2;
+                loadedDevice = device;
+                stats.reconfigs++;
+            }
+            
+            //SET SLAVE SELECT LOW
+            GPIO_PIN_LOW(device->csPort, device->csPin);
+            
+            if(startSPI_DMA(transaction->tx, transaction->rx, transaction->count, device->frameBits, finishTransfer))
+            {
+                stats.transactions++;
+                return;
+            }
+        }
+        
+        //RELEASES THE SLAVE. ITS CALLBACK MAY START SOMETHING ELSE,
+        //OTHERWISE THE NEXT ONE IS TRIED
+        stats.failed++;
+        completeTransfer(SPI_DMA_ERROR);
+    }
+}
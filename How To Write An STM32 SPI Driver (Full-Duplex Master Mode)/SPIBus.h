@@ -0,0 +1,70 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+#include <stddef.h>
+
+//MOST DEVICES THAT CAN SHARE SPI1
+#ifndef SPI_BUS_MAX_DEVICES
+#define SPI_BUS_MAX_DEVICES 4u
+#endif
+
+//CLOCK POLARITY AND PHASE, CR1 BITS 1 AND 0
+#define SPI_MODE_0          0u      //CPOL 0, CPHA 0
+#define SPI_MODE_1          1u      //CPOL 0, CPHA 1
+#define SPI_MODE_2          2u      //CPOL 1, CPHA 0
+#define SPI_MODE_3          3u      //CPOL 1, CPHA 1
+
+//TRANSACTION STATUS
+#define SPI_BUS_DONE        0u
+#define SPI_BUS_ERROR       1u
+#define SPI_BUS_QUEUED      2u
+#define SPI_BUS_ACTIVE      3u
+
+typedef struct SpiTransaction SpiTransaction;
+
+typedef void (*SpiTransactionCallback)(SpiTransaction *transaction);
+
+//ONE SLAVE ON THE BUS. FILLED IN BY addSpiDevice
+typedef struct
+{
+    GPIO_TypeDef *csPort;           //SLAVE SELECT PORT
+    uint8_t csPin;                  //SLAVE SELECT PIN, ACTIVE LOW
+    uint8_t mode;                   //SPI_MODE_0 TO SPI_MODE_3
+    uint8_t frameBits;              //4 TO 16 BITS PER FRAME
+    uint32_t maxSckHz;              //FASTEST SCK THE SLAVE ACCEPTS
+    uint16_t cr1;                   //CR1 IMAGE, SPI DISABLED
+    uint16_t cr2;                   //CR2 IMAGE, DMA REQUESTS OFF
+    SpiTransaction *head;           //QUEUED TRANSACTIONS, OLDEST FIRST
+    SpiTransaction *tail;
+} SpiDevice;
+
+//ONE CHIP SELECT BURST. OWNED BY THE BUS FROM queueSpiTransfer
+//UNTIL ITS STATUS IS SPI_BUS_DONE OR SPI_BUS_ERROR
+struct SpiTransaction
+{
+    SpiTransaction *next;
+    SpiDevice *device;
+    const void *tx;                 //0 TO SEND ALL ONES
+    void *rx;                       //0 TO THROW THE RECEIVED FRAMES AWAY
+    size_t count;                   //FRAMES, NOT BYTES
+    SpiTransactionCallback callback;    //CALLED FROM THE DMA INTERRUPT, MAY BE 0
+    void *arg;                      //FOR THE CALLER
+    volatile uint8_t status;
+};
+
+//COUNTERS FOR TUNING THE ORDER DEVICES ARE USED IN
+typedef struct
+{
+    uint32_t transactions;          //BURSTS STARTED
+    uint32_t reconfigs;             //BURSTS THAT HAD TO RELOAD CR1 AND CR2
+    uint32_t failed;                //TRANSACTIONS THE DMA WOULDN'T START
+} SpiBusStats;
+
+uint8_t initSpiBus(void);
+uint8_t addSpiDevice(SpiDevice *device, GPIO_TypeDef *csPort, uint8_t csPin, uint8_t mode, uint32_t maxSckHz, uint8_t frameBits);
+uint8_t queueSpiTransfer(SpiTransaction *transaction, SpiDevice *device, const void *tx, void *rx, size_t count, SpiTransactionCallback callback, void *arg);
+void waitSpiTransfer(const SpiTransaction *transaction);
+void retimeSpiBus(void);
+const SpiBusStats *getSpiBusStats(void);
@@ -0,0 +1,282 @@
+#include "stm32l432xx.h"
+#include "Sampler.h"
+#include "Timer.h"
+#include "Clock.h"
+
+
+/*****************************************************************
+* TIM7 runs freely with its reload set to the sampling period, so
+* the trigger rate only depends on the timer clock and never on
+* how long the job or the rest of the main loop takes.
+*
+* The update interrupt only flags the job. The main loop runs it
+* between beginSamplerJob and endSamplerJob, which timestamp it on
+* the TIM2 tick count. TIM7 and TIM2 count at the same rate, so
+* the time of the update event itself is the TIM2 count at the
+* interrupt less the TIM7 count at the interrupt.
+*****************************************************************/
+
+//SET BY THE TIM7 INTERRUPT, CLEARED BY beginSamplerJob
+static volatile uint8_t jobDue = 0;
+
+//SET BETWEEN beginSamplerJob AND endSamplerJob
+static volatile uint8_t jobRunning = 0;
+
+//TIM2 COUNT AT THE UPDATE EVENT THAT MADE THE JOB DUE
+static volatile uint32_t triggerTicks = 0;
+
+//TIM2 COUNT WHEN THE CURRENT JOB STARTED
+static uint32_t startTicks = 0;
+
+static SamplerStats stats;
+
+
+/*****************************************************************
+* initSampler
+*
+* Starts TIM7 firing every 'periodTicks' timer ticks. initTim2
+* must have been called first.
+*
+* Returns 1 on success, 0 if 'periodTicks' is out of range or the
+* clock listener table is full.
+*****************************************************************/
+uint8_t initSampler(uint32_t periodTicks)
+{
+    if((periodTicks < 2u) || (periodTicks > SAMPLER_MAX_PERIOD))
+    {
+        return 0;
+    }
+    
+    //KEEP THE TICK RATE WHEN THE CLOCKS CHANGE. REGISTERED FIRST SO
+    //A FULL TABLE LEAVES NOTHING HALF SET UP
+    if(!addClockListener(retimeSampler))
+    {
+        return 0;
+    }
+    
+    //ENABLE TIM7 CLOCK
+    RCC->APB1ENR1 |= (1u << 5);
+    
+    //TIM7 IS ON APB1 LIKE TIM2 SO THE SAME PRESCALER GIVES THE SAME TICK
+    TIM7->CR1 &= ~(1u << 0);
+    TIM7->PSC = calcTim2Psc(getApb1TimerHz());
+    TIM7->ARR = periodTicks - 1u;
+    
+    //LOAD THE PRESCALER NOW THEN CLEAR THE FLAG THAT SETS
+    TIM7->EGR = (1u << 0);
+    TIM7->SR = 0;
+    
+    jobDue = 0;
+    jobRunning = 0;
+    stats.period = periodTicks;
+    resetSamplerStats();
+    
+    //UPDATE INTERRUPT
+    TIM7->DIER |= (1u << 0);
+    NVIC_EnableIRQ(TIM7_IRQn);
+    
+    //ENABLE TIM7 COUNTER
+    TIM7->CR1 |= (1u << 0);
+    
+    return 1;
+}
+
+/*****************************************************************
+* retimeSampler
+*
+* Loads a new prescaler after a clock change, keeping the count so
+* the period in progress is not cut short.
+*****************************************************************/
+void retimeSampler(void)
+{
+    uint32_t cnt = TIM7->CNT;
+    
+    //THE UPDATE EVENT ALSO SETS UIF, WHICH MUST NOT LOOK LIKE A TRIGGER
+    TIM7->CR1 |= (1u << 2);
+    TIM7->PSC = calcTim2Psc(getApb1TimerHz());
+    TIM7->EGR = (1u << 0);
+    TIM7->CR1 &= ~(1u << 2);
+    TIM7->CNT = cnt;
+}
+
+/*****************************************************************
+* samplerRunning
+*
+* Returns 1 while TIM7 is counting. It stops in the Stop modes.
+*****************************************************************/
+uint8_t samplerRunning(void)
+{
+    return (uint8_t)(TIM7->CR1 & (1u << 0));
+}
+
+/*****************************************************************
+* getSamplerFlag
+*
+* Returns the flag that is set while a job is due, for
+* enterLowPower.
+*****************************************************************/
+const volatile uint8_t *getSamplerFlag(void)
+{
+    return &jobDue;
+}
+
+/*****************************************************************
+* recordSamplerStart
+*
+* Adds one job start to 'stats'. 'triggerTicks' is when the job
+* became due and 'startTicks' when it started. Only touches
+* 'stats', so it can be run against a simulated timer.
+*****************************************************************/
+void recordSamplerStart(SamplerStats *stats, uint32_t triggerTicks, uint32_t startTicks)
+{
+    uint32_t latency = startTicks - triggerTicks;
+    uint32_t period;
+    uint32_t jitter;
+    
+    if(latency > stats->maxStartLatency)
+    {
+        stats->maxStartLatency = latency;
+    }
+    
+    //THE FIRST JOB HAS NO PERIOD TO MEASURE
+    if(stats->jobs != 0u)
+    {
+        period = startTicks - stats->lastStart;
+        jitter = (period > stats->period) ? (period - stats->period) : (stats->period - period);
+        
+        if(period < stats->minPeriod)
+        {
+            stats->minPeriod = period;
+        }
+        
+        if(period > stats->maxPeriod)
+        {
+            stats->maxPeriod = period;
+        }
+        
+        if(jitter > stats->maxJitter)
+        {
+            stats->maxJitter = jitter;
+        }
+    }
+    
+    stats->lastStart = startTicks;
+    stats->jobs++;
+}
+
+/*****************************************************************
+* beginSamplerJob
+*
+* Call from the main loop before reading the sensor.
+*
+* Returns 1 if a job was due and has now started, 0 if not.
+*****************************************************************/
+uint8_t beginSamplerJob(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint8_t due;
+    
+    __disable_irq();
+    
+    due = jobDue;
+    
+    if(due)
+    {
+        jobDue = 0;
+        jobRunning = 1;
+        startTicks = getTicks();
+        recordSamplerStart(&stats, triggerTicks, startTicks);
+    }
+    
+    __set_PRIMASK(primask);
+    
+    return due;
+}
+
+/*****************************************************************
+* endSamplerJob
+*
+* Call from the main loop once the job has finished.
+*****************************************************************/
+void endSamplerJob(void)
+{
+    uint32_t run = getTicks() - startTicks;
+    
+    if(run > stats.maxRunTicks)
+    {
+        stats.maxRunTicks = run;
+    }
+    
+    jobRunning = 0;
+}
+
+/*****************************************************************
+* getSamplerStats
+*
+* Copies the statistics with interrupts masked so they are all
+* from the same moment.
+*****************************************************************/
+void getSamplerStats(SamplerStats *copy)
+{
+    uint32_t primask = __get_PRIMASK();
+    
+    __disable_irq();
+    *copy = stats;
+    __set_PRIMASK(primask);
+}
+
+/*****************************************************************
+* resetSamplerStats
+*
+* Clears the statistics but keeps the period.
+*****************************************************************/
+void resetSamplerStats(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    
+    __disable_irq();
+    
+    stats.triggers = 0;
+    stats.jobs = 0;
+    stats.overruns = 0;
+    stats.minPeriod = 0xFFFFFFFFu;
+    stats.maxPeriod = 0;
+    stats.maxJitter = 0;
+    stats.maxIsrLatency = 0;
+    stats.maxStartLatency = 0;
+    stats.maxRunTicks = 0;
+    stats.lastStart = 0;
+    
+    __set_PRIMASK(primask);
+}
+
+/*****************************************************************
+* TIM7_IRQHandler
+*
+* Makes the job due. The counter has been running since the
+* update event, so it is how late the interrupt is.
+*****************************************************************/
+void TIM7_IRQHandler(void)
+{
+    uint32_t late = TIM7->CNT;
+    uint32_t now = getTicks();
+    
+    TIM7->SR &= ~(1u << 0);
+    
+    stats.triggers++;
+    
+    if(late > stats.maxIsrLatency)
+    {
+        stats.maxIsrLatency = late;
+    }
+    
+    //THE LAST JOB HASN'T STARTED OR FINISHED, THIS TRIGGER IS LOST
+    if(jobDue || jobRunning)
+    {
+        stats.overruns++;
+        return;
+    }
+    
+    triggerTicks = now - late;
+    jobDue = 1;
+}
@@ -0,0 +1,35 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+#include <stdint.h>
+
+//TIM7 IS 16 BITS SO THE PERIOD IS 2 TO 65536 TICKS OF TIMER_TICK_HZ
+#define SAMPLER_MAX_PERIOD  65536u
+
+//TIMING OF THE SAMPLING JOB. ALL TIMES ARE IN TIMER TICKS
+typedef struct
+{
+    uint32_t period;            //NOMINAL PERIOD
+    uint32_t triggers;          //TIM7 UPDATES SEEN
+    uint32_t jobs;              //JOBS STARTED
+    uint32_t overruns;          //TRIGGERS THAT ARRIVED WHILE THE LAST JOB WAS STILL DUE OR RUNNING
+    uint32_t minPeriod;         //SHORTEST TIME BETWEEN JOB STARTS
+    uint32_t maxPeriod;         //LONGEST TIME BETWEEN JOB STARTS
+    uint32_t maxJitter;         //LARGEST DIFFERENCE BETWEEN A PERIOD AND THE NOMINAL ONE
+    uint32_t maxIsrLatency;     //LONGEST TIME FROM THE UPDATE EVENT TO THE INTERRUPT RUNNING
+    uint32_t maxStartLatency;   //LONGEST TIME FROM THE UPDATE EVENT TO THE JOB STARTING
+    uint32_t maxRunTicks;       //LONGEST JOB
+    uint32_t lastStart;         //WHEN THE LAST JOB STARTED
+} SamplerStats;
+
+uint8_t initSampler(uint32_t periodTicks);
+void retimeSampler(void);
+uint8_t samplerRunning(void);
+const volatile uint8_t *getSamplerFlag(void);
+uint8_t beginSamplerJob(void);
+void endSamplerJob(void);
+void getSamplerStats(SamplerStats *stats);
+void resetSamplerStats(void);
+void recordSamplerStart(SamplerStats *stats, uint32_t triggerTicks, uint32_t startTicks);
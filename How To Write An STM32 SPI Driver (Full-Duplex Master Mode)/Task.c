@@ -0,0 +1,175 @@
+#include "Task.h"
+
+
+/*****************************************************************
+* Tasks are kept in a list in the order they were added. Each pass
+* of runTasks walks the list once and calls every task that has
+* been woken, so a task that keeps yielding can't starve the ones
+* after it and no task waits more than one pass once woken.
+*
+* wakeTask only writes the task's own flags and the pending flag,
+* so interrupts can call it without locking. If a wake-up lands
+* while the task is running the flag is left set and the task runs
+* again on the next pass, so nothing is lost.
+*
+* Nothing here touches the hardware, so it also builds on the host
+* (see host/tasksim.c).
+*****************************************************************/
+
+//TASKS IN RUN ORDER
+static Task *firstTask = 0;
+static Task *lastTask = 0;
+
+//SET BY wakeTask, CLEARED AT THE START OF EACH PASS
+static volatile uint8_t pending = 0;
+
+//TICK COUNT FOR THE LATENCY FIGURES, 0 FOR NONE
+static TaskClock taskClock = 0;
+
+
+/*****************************************************************
+* initTasks
+*
+* Forgets every task. 'clock' is read when a task is woken and
+* again when it runs, pass 0 to skip the latency figures.
+*****************************************************************/
+void initTasks(TaskClock clock)
+{
+    firstTask = 0;
+    lastTask = 0;
+    pending = 0;
+    taskClock = clock;
+}
+
+/*****************************************************************
+* addTask
+*
+* Adds 'task' to the end of the run order and wakes it, so
+* 'function' is first called on the next pass of runTasks. Only
+* call from the main loop, and only once for each task.
+*****************************************************************/
+void addTask(Task *task, TaskFunction function, void *arg)
+{
+    task->next = 0;
+    task->function = function;
+    task->arg = arg;
+    task->line = 0;
+    task->ready = 0;
+    task->done = 0;
+    task->runs = 0;
+    task->maxLatency = 0;
+    task->totalLatency = 0;
+
+    if(lastTask)
+    {
+        lastTask->next = task;
+    }
+    else
+    {
+        firstTask = task;
+    }
+    lastTask = task;
+
+    wakeTask(task);
+}
+
+/*****************************************************************
+* restartTask
+*
+* Starts a task from the top of its function again, whether or not
+* it had finished. Only call from the main loop or from a task.
+*****************************************************************/
+void restartTask(Task *task)
+{
+    task->line = 0;
+    task->done = 0;
+
+    wakeTask(task);
+}
+
+/*****************************************************************
+* wakeTask
+*
+* Marks 'task' to be run on the next pass of runTasks. Safe to
+* call from interrupts and from other tasks.
+*****************************************************************/
+void wakeTask(Task *task)
+{
+    if(!task->ready)
+    {
+        task->wokenAt = taskClock ? taskClock() : 0u;
+        task->ready = 1;
+    }
+
+    pending = 1;
+}
+
+/*****************************************************************
+* wakeTaskCallback
+*
+* wakeTask in the shape of a timer or driver callback, with the
+* task passed as the argument.
+*****************************************************************/
+void wakeTaskCallback(void *task)
+{
+    wakeTask((Task *)task);
+}
+
+/*****************************************************************
+* runTasks
+*
+* Makes one pass over the tasks, calling each one that has been
+* woken.
+*
+* Returns the number of tasks that ran. When this is 0 and the
+* pending flag is still clear there is nothing to do until an
+* interrupt wakes a task.
+*****************************************************************/
+uint32_t runTasks(void)
+{
+    Task *task;
+    uint32_t ran = 0;
+    uint32_t latency;
+
+    pending = 0;
+
+    for(task = firstTask; task; task = task->next)
+    {
+        if(!task->ready || task->done)
+        {
+            continue;
+        }
+
+        //READ THE WAKE TIME BEFORE CLEARING THE FLAG, A NEW WAKE-UP
+        //ONLY RECORDS ITS TIME ONCE THE FLAG IS CLEAR
+        latency = taskClock ? (taskClock() - task->wokenAt) : 0u;
+        task->ready = 0;
+
+        task->runs++;
+        task->totalLatency += latency;
+        if(latency > task->maxLatency)
+        {
+            task->maxLatency = latency;
+        }
+
+        if(task->function(task) == TASK_DONE)
+        {
+            task->done = 1;
+        }
+
+        ran++;
+    }
+
+    return ran;
+}
+
+/*****************************************************************
+* getTaskFlag
+*
+* Returns the flag wakeTask sets, to hand to enterLowPower so the
+* core doesn't sleep through a wake-up.
+*****************************************************************/
+const volatile uint8_t *getTaskFlag(void)
+{
+    return &pending;
+}
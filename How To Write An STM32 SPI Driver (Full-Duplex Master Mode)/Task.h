@@ -0,0 +1,97 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdint.h>
+
+/*****************************************************************
+* Stackless cooperative tasks (protothreads). A task is a function
+* that is called again and again, and picks up where it left off
+* by jumping to the line it last waited on. Everything it needs to
+* keep between waits must live in the Task or in memory 'arg'
+* points to, never in local variables. switch statements can't be
+* used across a wait inside a task function. The waits for timers,
+* SPI and UART1 are in TaskIO.h.
+*
+*   uint8_t blink(Task *task)
+*   {
+*       TASK_BEGIN(task);
+*       while(1)
+*       {
+*           toggleLED();
+*           TASK_SLEEP(task, &ledTimer, MS_TO_TICKS(500));
+*       }
+*       TASK_END(task);
+*   }
+*****************************************************************/
+
+//WHAT A TASK FUNCTION RETURNS
+#define TASK_WAITING        0u      //WAITING TO BE WOKEN
+#define TASK_DONE           1u      //FINISHED, WON'T BE CALLED AGAIN
+
+typedef struct Task Task;
+
+typedef uint8_t (*TaskFunction)(Task *task);
+
+//READS A FREE-RUNNING TICK COUNT, FOR THE LATENCY FIGURES
+typedef uint32_t (*TaskClock)(void);
+
+//ONE TASK. OWNED BY THE CALLER, ONLY TOUCH THROUGH THE FUNCTIONS
+//AND MACROS IN THIS FILE
+struct Task
+{
+    Task *next;                     //NEXT TASK IN RUN ORDER
+    TaskFunction function;
+    void *arg;                      //FOR THE TASK FUNCTION
+    uint16_t line;                  //WHERE TO CARRY ON, 0 AT THE START
+    volatile uint8_t ready;         //WOKEN SINCE IT LAST RAN
+    uint8_t done;                   //RETURNED TASK_DONE
+    volatile uint32_t wokenAt;      //TICK COUNT WHEN IT WAS WOKEN
+    uint32_t runs;                  //TIMES THE FUNCTION HAS BEEN CALLED
+    uint32_t maxLatency;            //LONGEST TIME FROM WAKING TO RUNNING
+    uint64_t totalLatency;          //SUM OF THE TIMES FROM WAKING TO RUNNING
+};
+
+#define TASK_BEGIN(task)            switch((task)->line) { case 0:
+
+#define TASK_END(task)              } (task)->line = 0; return TASK_DONE
+
+//RETURN UNTIL 'condition' IS TRUE. WHATEVER MAKES IT TRUE MUST
+//CALL wakeTask, OR THE TASK IS NEVER LOOKED AT AGAIN
+#define TASK_WAIT_UNTIL(task, condition)                        \
+    do                                                          \
+    {                                                           \
+        (task)->line = __LINE__;                                \
+        case __LINE__:                                          \
+        if(!(condition))                                        \
+        {                                                       \
+            return TASK_WAITING;                                \
+        }                                                       \
+    } while(0)
+
+//LET EVERY OTHER READY TASK RUN ONCE BEFORE CARRYING ON
+#define TASK_YIELD(task)                                        \
+    do                                                          \
+    {                                                           \
+        wakeTask(task);                                         \
+        (task)->line = __LINE__;                                \
+        return TASK_WAITING;                                    \
+        case __LINE__:;                                         \
+    } while(0)
+
+//FINISH NOW
+#define TASK_EXIT(task)                                         \
+    do                                                          \
+    {                                                           \
+        (task)->line = 0;                                       \
+        return TASK_DONE;                                       \
+    } while(0)
+
+void initTasks(TaskClock clock);
+void addTask(Task *task, TaskFunction function, void *arg);
+void restartTask(Task *task);
+void wakeTask(Task *task);
+void wakeTaskCallback(void *task);
+uint32_t runTasks(void);
+const volatile uint8_t *getTaskFlag(void);
+
+#endif
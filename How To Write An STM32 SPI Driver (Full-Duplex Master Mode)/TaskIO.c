@@ -0,0 +1,125 @@
+#include "stm32l432xx.h"
+#include "TaskIO.h"
+
+
+//THE TASK WAITING FOR RECEIVED BYTES AND THE ONE WAITING FOR TX
+//SPACE. ONE OF EACH AT A TIME, UART1 IS THE ONLY UART
+static Task *volatile uartRxWaiter = 0;
+static Task *volatile uartTxWaiter = 0;
+
+
+/*****************************************************************
+* taskUartEvent
+*
+* UART1 interrupt callback. Wakes whichever task is waiting for
+* the event.
+*****************************************************************/
+static void taskUartEvent(uint8_t event)
+{
+    Task *task = (event == UART_EVENT_RX) ? uartRxWaiter : uartTxWaiter;
+
+    if(task)
+    {
+        wakeTask(task);
+    }
+}
+
+/*****************************************************************
+* taskSpiDone
+*
+* SPI bus transaction callback. Wakes the task that queued it.
+*****************************************************************/
+static void taskSpiDone(SpiTransaction *transaction)
+{
+    wakeTask((Task *)transaction->arg);
+}
+
+/*****************************************************************
+* initTaskIO
+*
+* Hooks the UART1 interrupt so tasks can wait on it. Call after
+* initUART_IT, initTim2 and initSpiBus.
+*****************************************************************/
+void initTaskIO(void)
+{
+    uartRxWaiter = 0;
+    uartTxWaiter = 0;
+
+    setUartEventCallback(taskUartEvent);
+}
+
+/*****************************************************************
+* startTaskTimer
+*
+* Starts a one-shot timer that wakes 'task' after 'ticks' timer
+* ticks. Used by TASK_SLEEP.
+*****************************************************************/
+void startTaskTimer(Task *task, SoftTimer *timer, uint32_t ticks)
+{
+    //startTimer ONLY FAILS WHEN EVERY SLOT IS TAKEN. WAKE THE TASK
+    //SO IT DOESN'T WAIT FOREVER, IT SEES THE TIMER ISN'T RUNNING
+    if(!startTimer(timer, ticks, 0, wakeTaskCallback, task))
+    {
+        wakeTask(task);
+    }
+}
+
+/*****************************************************************
+* queueTaskSpiTransfer
+*
+* Queues an SPI burst that wakes 'task' when it finishes. Used by
+* TASK_AWAIT_SPI. The transaction's callback and arg are used for
+* this, so they can't be set by the caller.
+*****************************************************************/
+void queueTaskSpiTransfer(Task *task, SpiTransaction *transaction, SpiDevice *device, const void *tx, void *rx, size_t count)
+{
+    if(!queueSpiTransfer(transaction, device, tx, rx, count, taskSpiDone, task))
+    {
+        //NEVER QUEUED, SO NOTHING WILL WAKE THE TASK
+        transaction->status = SPI_BUS_ERROR;
+        wakeTask(task);
+    }
+}
+
+/*****************************************************************
+* taskUartRxReady
+*
+* Condition for TASK_AWAIT_UART_RX. Signs 'task' up to be woken by
+* the next received byte before looking, so a byte that arrives in
+* between still wakes it.
+*
+* Returns 1 if there is a byte to read
+*****************************************************************/
+uint8_t taskUartRxReady(Task *task)
+{
+    uartRxWaiter = task;
+
+    if(uartRxAvailable() == 0u)
+    {
+        return 0;
+    }
+
+    uartRxWaiter = 0;
+    return 1;
+}
+
+/*****************************************************************
+* taskUartTxReady
+*
+* Condition for TASK_AWAIT_UART_TX and TASK_AWAIT_UART_DRAIN. The
+* task is woken when the TX ring buffer empties.
+*
+* Returns 1 if uartWrite can take 'len' bytes
+*****************************************************************/
+uint8_t taskUartTxReady(Task *task, size_t len)
+{
+    uartTxWaiter = task;
+
+    if(uartTxFree() < len)
+    {
+        return 0;
+    }
+
+    uartTxWaiter = 0;
+    return 1;
+}
@@ -0,0 +1,48 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+#include "Task.h"
+#include "Timer.h"
+#include "SPIBus.h"
+#include "UART.h"
+
+//THINGS A TASK CAN WAIT FOR WITHOUT HOLDING UP THE OTHER TASKS.
+//EACH ONE STARTS THE OPERATION, THEN RETURNS FROM THE TASK
+//FUNCTION UNTIL THE INTERRUPT THAT FINISHES IT WAKES THE TASK
+
+//WAIT 'ticks' TIMER TICKS. 'timer' MUST STAY VALID WHILE WAITING
+#define TASK_SLEEP(task, timer, ticks)                                  \
+    do                                                                  \
+    {                                                                   \
+        startTaskTimer((task), (timer), (ticks));                       \
+        TASK_WAIT_UNTIL((task), !timerRunning(timer));                  \
+    } while(0)
+
+//RUN AN SPI BURST ON THE BUS AND WAIT FOR IT. AFTERWARDS THE
+//TRANSACTION STATUS IS SPI_BUS_DONE OR SPI_BUS_ERROR
+#define TASK_AWAIT_SPI(task, transaction, device, tx, rx, count)        \
+    do                                                                  \
+    {                                                                   \
+        queueTaskSpiTransfer((task), (transaction), (device), (tx), (rx), (count)); \
+        TASK_WAIT_UNTIL((task), (transaction)->status <= SPI_BUS_ERROR); \
+    } while(0)
+
+//WAIT UNTIL THERE IS AT LEAST ONE RECEIVED BYTE TO uartRead
+#define TASK_AWAIT_UART_RX(task)                                        \
+    TASK_WAIT_UNTIL((task), taskUartRxReady(task))
+
+//WAIT UNTIL uartWrite CAN TAKE 'len' BYTES (AT MOST UART_TX_BUFFER_SIZE)
+#define TASK_AWAIT_UART_TX(task, len)                                   \
+    TASK_WAIT_UNTIL((task), taskUartTxReady((task), (len)))
+
+//WAIT UNTIL EVERYTHING WRITTEN HAS BEEN HANDED TO THE UART
+#define TASK_AWAIT_UART_DRAIN(task)                                     \
+    TASK_WAIT_UNTIL((task), taskUartTxReady((task), UART_TX_BUFFER_SIZE))
+
+void initTaskIO(void);
+void startTaskTimer(Task *task, SoftTimer *timer, uint32_t ticks);
+void queueTaskSpiTransfer(Task *task, SpiTransaction *transaction, SpiDevice *device, const void *tx, void *rx, size_t count);
+uint8_t taskUartRxReady(Task *task);
+uint8_t taskUartTxReady(Task *task, size_t len);
@@ -1,139 +1,467 @@
 #include "stm32l432xx.h"
 #include "Timer.h"
+#include "Clock.h"
+
+/*****************************************************************
+* Pending timers are kept in a binary min-heap ordered by expiry
+* so starting or stopping a timer costs O(log n) and the next
+* timer to fire is always at the top. TIM2 runs freely over the
+* full 32-bit range and compare channel 1 is loaded with the
+* expiry of the top timer, so the CPU is only interrupted when a
+* timer is actually due.
+* Expiry times are compared relative to each other so the counter
+* is allowed to wrap. A timer can be started at most 2^31 - 1
+* ticks (about 35 minutes) into the future.
+*****************************************************************/
+
+//HEAP OF PENDING TIMERS. ENTRY 0 IS UNUSED SO A TIMER'S SLOT IS
+//NEVER 0 WHILE IT IS RUNNING
+static SoftTimer *timerHeap[TIMER_MAX_TIMERS + 1u];
+
+//NUMBER OF TIMERS IN THE HEAP
+static uint32_t timerCount = 0;
+
 
 /*****************************************************************
 * initTim2
 *
-* This function initialises timer 2.
-* The STM32L432KC runs at 4MHz by default so 4,000,000 has been
-* written into the ARR register to reset the counter every second.
+* This function initialises timer 2 as a free-running 32-bit
+* counter that ticks at TIMER_TICK_HZ.
+* The prescaler is worked out from the current APB1 timer clock
+* and is recalculated whenever configClock changes the clocks.
+*
+* Returns 1 on success, 0 if the clock listener table is full, in
+* which case TIM2 is left alone.
 *****************************************************************/
-void initTim2(void) 
+uint8_t initTim2(void) 
 {
+    //KEEP THE TICK RATE WHEN THE CLOCKS CHANGE. REGISTERED FIRST SO
+    //A FULL TABLE LEAVES NOTHING HALF SET UP
+    if(!addClockListener(retimeTim2))
+    {
+        return 0;
+    }
+    
     //ENABLE TIM2 CLOCK
     RCC->APB1ENR1 |= (1u << 0);
     
-    //LEAVE THE COUNTER FREQUENCY UNCHANGED
-    TIM2->PSC = 0;
+    //DIVIDE THE INPUT CLOCK DOWN TO TIMER_TICK_HZ
+    TIM2->PSC = calcTim2Psc(getApb1TimerHz());
+    
+    //COUNT OVER THE FULL 32-BIT RANGE
+    TIM2->ARR = 0xFFFFFFFFu;
     
-    //SET TIMER RELOAD VALUE
-    TIM2->ARR = (uint32_t)4000000;
+    //LOAD THE PRESCALER NOW INSTEAD OF AT THE FIRST OVERFLOW
+    TIM2->EGR = (1u << 0);
     
     //SET INITIAL COUNTER VALUE
     TIM2->CNT = 0;
     
+    //NO TIMERS PENDING YET, COMPARE INTERRUPT STAYS OFF
+    timerCount = 0;
+    TIM2->DIER &= ~(1u << 1);
+    TIM2->SR = 0;
+    
+    NVIC_EnableIRQ(TIM2_IRQn);
+    
     //ENABLE TIM2 COUNTER
     TIM2->CR1 |= (1u << 0);
+    
+    return 1;
 }
 
 /*****************************************************************
-* delay1Sec
+* calcTim2Psc
 *
-* This function introduces a delay of 1 second approximately
-* by tracking the values in the CNT register of timer 2.
-* This function relies on the frequency of the microcontroller
-* to be accurate. The STM32L432KC runs at 4MHz by default so the
-* goalCount has been set to 4,000,000 to stop the count loop when
-* the counter variable reaches or exceeds that that number as 1
-* second (approx) would have passed.
-* The value of the goalCount therefore depends on the frequency
-* of the microcontroller.
+* Returns the prescaler value that divides 'timerClockHz' down to
+* TIMER_TICK_HZ, rounded to the nearest divider. The tick is only
+* exactly TIMER_TICK_HZ when the clock is a multiple of it, which
+* every ClockConfig in Clock.c is. Below TIMER_TICK_HZ the
+* prescaler is 0 and the timer ticks at the timer clock, so ticks
+* are longer than a microsecond. PSC is 16 bits on every timer
+* that uses this, so it never goes above 0xFFFF.
 *****************************************************************/
-void delay1Sec(void)
+uint32_t calcTim2Psc(uint32_t timerClockHz)
 {
-    /*HOLDS THE TOTAL COUNT FROM TM2_CNT REGISTER TO RECORD HOW
-    MUCH TIME ELAPSED.*/
-    unsigned int counter = 0;
-    //HOLDS THE COUNT FOR THE COUNTER TO COUNT TO.
-    unsigned int goalCount = 4000000;
-    //HOLDS THE MOST RECENT VALUE OBTAINED FROM TIM2_CNT.
-    unsigned int currentCntVal = 0;
-    //HOLDS THE PREVIOUS VALUE OBTAINED FROM TIM2_CNT.
-    unsigned int prevCntVal = 0;
-    //HOLDS RESULT OF CALCULATION BETWEEN CURRENT AND PREVIOUS COUNTS.
-    unsigned int countToAdd = 0;
-    
-    //GET INITIAL VALUE OF CNT
-    prevCntVal = TIM2->CNT; 
-    
-    //LOOP UNTIL COUNTER IS EQUAL OR EXCEED GOAL COUNT
-    while(counter < goalCount)
+    //ROUNDED WITHOUT ADDING TO 'timerClockHz', WHICH COULD OVERFLOW
+    uint32_t div = (timerClockHz / TIMER_TICK_HZ)
+                 + ((timerClockHz % TIMER_TICK_HZ) >= (TIMER_TICK_HZ / 2u));
+    
+    if(div == 0u)
     {
-        //GET NEWEST COUNT
-        currentCntVal = TIM2->CNT;
-        
-        //HANDLE SITUATION WHERE TIM2_CNT RESET
-        if(currentCntVal < prevCntVal)
+        return 0;
+    }
+    
+    return (div > 0x10000u) ? 0xFFFFu : (div - 1u);
+}
+
+/*****************************************************************
+* retimeTim2
+*
+* Loads a new prescaler after a clock change. The update event
+* needed to load it also clears the counter, so the count is put
+* back straight afterwards and pending timers are unaffected.
+*****************************************************************/
+void retimeTim2(void)
+{
+    uint32_t cnt = TIM2->CNT;
+    
+    TIM2->PSC = calcTim2Psc(getApb1TimerHz());
+    TIM2->EGR = (1u << 0);
+    TIM2->CNT = cnt;
+}
+
+/*****************************************************************
+* getTicks
+*
+* Returns the current TIM2 count in ticks. Wraps every 2^32 ticks.
+*****************************************************************/
+uint32_t getTicks(void)
+{
+    return TIM2->CNT;
+}
+
+/*****************************************************************
+* timerBefore
+*
+* Returns 1 if tick count 'a' comes before tick count 'b', taking
+* counter wraparound into account.
+*****************************************************************/
+static uint8_t timerBefore(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/*****************************************************************
+* heapPlace
+*
+* Stores a timer in a heap slot and tells the timer where it is.
+*****************************************************************/
+static void heapPlace(SoftTimer *timer, uint32_t slot)
+{
+    timerHeap[slot] = timer;
+    timer->slot = slot;
+}
+
+/*****************************************************************
+* heapUp
+*
+* Moves the timer in 'slot' towards the top until its parent
+* expires before it.
+*****************************************************************/
+static void heapUp(uint32_t slot)
+{
+    SoftTimer *timer = timerHeap[slot];
+    
+    while((slot > 1u) && timerBefore(timer->expiry, timerHeap[slot / 2u]->expiry))
+    {
+        heapPlace(timerHeap[slot / 2u], slot);
+        slot /= 2u;
+    }
+    
+    heapPlace(timer, slot);
+}
+
+/*****************************************************************
+* heapDown
+*
+* Moves the timer in 'slot' towards the bottom until both of its
+* children expire after it.
+*****************************************************************/
+static void heapDown(uint32_t slot)
+{
+    SoftTimer *timer = timerHeap[slot];
+    uint32_t child;
+    
+    while((child = slot * 2u) <= timerCount)
+    {
+        //PICK THE CHILD THAT EXPIRES FIRST
+        if((child < timerCount) && timerBefore(timerHeap[child + 1u]->expiry, timerHeap[child]->expiry))
         {
-            //GET THE COUNT BEFORE THE CNT REGISTER RESET AND THEN 
-            //ADD THE COUNT AFTER IT RESET TO GET ELAPSED COUNT
-            countToAdd = (4000000 - prevCntVal) + currentCntVal;
+            child++;
         }
-        else
+        
+        if(!timerBefore(timerHeap[child]->expiry, timer->expiry))
         {
-            //SSUBTRACT CURRENT COUNT FROM PREVIOUS COUNT TO GET
-            //ELAPSED COUNT
-            countToAdd = currentCntVal - prevCntVal;
+            break;
         }
         
-        //ADD ELAPSED COUNT TO THE COUNTER
-        counter += countToAdd;
+        heapPlace(timerHeap[child], slot);
+        slot = child;
+    }
+    
+    heapPlace(timer, slot);
+}
+
+/*****************************************************************
+* heapRemove
+*
+* Takes a running timer out of the heap.
+*****************************************************************/
+static void heapRemove(SoftTimer *timer)
+{
+    uint32_t slot = timer->slot;
+    SoftTimer *last = timerHeap[timerCount--];
+    
+    timer->slot = 0;
+    
+    //FILL THE HOLE WITH THE LAST TIMER AND MOVE IT TO WHERE IT BELONGS
+    if(last != timer)
+    {
+        heapPlace(last, slot);
+        heapUp(slot);
+        heapDown(last->slot);
+    }
+}
+
+/*****************************************************************
+* armCompare
+*
+* Loads the compare register with the expiry of the next timer.
+* If that time has already been passed the interrupt is raised
+* straight away so the timer is not missed.
+*****************************************************************/
+static void armCompare(void)
+{
+    if(timerCount == 0u)
+    {
+        //NOTHING PENDING, NO NEED TO INTERRUPT
+        TIM2->DIER &= ~(1u << 1);
+        return;
+    }
+    
+    //CLEAR CC1IF BEFORE LOADING THE NEW EXPIRY
+    TIM2->SR = ~(1u << 1);
+    TIM2->CCR1 = timerHeap[1]->expiry;
+    TIM2->DIER |= (1u << 1);
+    
+    //COUNTER MAY HAVE PASSED THE EXPIRY ALREADY
+    if(!timerBefore(TIM2->CNT, timerHeap[1]->expiry))
+    {
+        NVIC_SetPendingIRQ(TIM2_IRQn);
+    }
+}
+
+/*****************************************************************
+* startTimer
+*
+* Starts (or restarts) a timer that fires 'delayTicks' from now
+* and then every 'periodTicks' if that is not 0. 'callback' is
+* called from the TIM2 interrupt with 'arg'.
+*
+* Returns 1 if the timer was started, 0 if TIMER_MAX_TIMERS
+* timers are already running.
+*****************************************************************/
+uint8_t startTimer(SoftTimer *timer, uint32_t delayTicks, uint32_t periodTicks, TimerCallback callback, void *arg)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint8_t started = 0;
+    
+    __disable_irq();
+    
+    //A RUNNING TIMER IS TAKEN OUT FIRST SO IT CAN BE RESCHEDULED
+    if(timer->slot != 0u)
+    {
+        heapRemove(timer);
+    }
+    
+    if(timerCount < TIMER_MAX_TIMERS)
+    {
+        timer->expiry = TIM2->CNT + delayTicks;
+        timer->period = periodTicks;
+        timer->callback = callback;
+        timer->arg = arg;
         
-        //CURRENT COUNT NOW BECOMES PREVIOUS COUNT
-        prevCntVal = currentCntVal;
+        //ADD TO THE BOTTOM OF THE HEAP AND MOVE UP
+        timerCount++;
+        heapPlace(timer, timerCount);
+        heapUp(timerCount);
+        started = 1;
     }
+    
+    armCompare();
+    
+    __set_PRIMASK(primask);
+    
+    return started;
 }
 
+/*****************************************************************
+* stopTimer
+*
+* Stops a timer. Does nothing if the timer is not running.
+*****************************************************************/
+void stopTimer(SoftTimer *timer)
+{
+    uint32_t primask = __get_PRIMASK();
+    
+    __disable_irq();
+    
+    if(timer->slot != 0u)
+    {
+        heapRemove(timer);
+        armCompare();
+    }
+    
+    __set_PRIMASK(primask);
+}
 
 /*****************************************************************
-* delay
+* timerRunning
 *
-* This function introduces a delay in milliseconds specified
-* by the 'ms' parameter.
+* Returns 1 if the timer is waiting to fire.
 *****************************************************************/
-void delay(unsigned int ms)
+uint8_t timerRunning(const SoftTimer *timer)
+{
+    return timer->slot != 0u;
+}
+
+/*****************************************************************
+* nextTimerTicks
+*
+* Finds how long it is until the next timer fires. 'ticks' is set
+* to 0 if a timer is already due.
+*
+* Returns 1 if a timer is running, 0 if none are (and 'ticks' is
+* left alone).
+*****************************************************************/
+uint8_t nextTimerTicks(uint32_t *ticks)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint8_t pending = 0;
+    int32_t remaining;
+    
+    __disable_irq();
+    
+    if(timerCount != 0u)
+    {
+        remaining = (int32_t)(timerHeap[1]->expiry - TIM2->CNT);
+        *ticks = (remaining > 0) ? (uint32_t)remaining : 0u;
+        pending = 1;
+    }
+    
+    __set_PRIMASK(primask);
+    
+    return pending;
+}
+
+/*****************************************************************
+* TIM2_IRQHandler
+*
+* Fires every timer that is due. Periodic timers are put back
+* into the heap one period after their previous expiry so they
+* don't drift.
+*****************************************************************/
+void TIM2_IRQHandler(void)
 {
-    /*HOLDS THE TOTAL COUNT FROM TM2_CNT REGISTER TO RECORD HOW
-    MUCH TIME ELAPSED.*/
-    unsigned int counter = 0;
-    //HOLDS THE COUNT FOR THE COUNTER TO COUNT TO.
-    unsigned int goalCount = ms * 4000u;
-    //HOLDS THE MOST RECENT VALUE OBTAINED FROM TIM2_CNT.
-    unsigned int currentCntVal = 0;
-    //HOLDS THE PREVIOUS VALUE OBTAINED FROM TIM2_CNT.
-    unsigned int prevCntVal = 0;
-    //HOLDS RESULT OF CALCULATION BETWEEN CURRENT AND PREVIOUS COUNTS.
-    unsigned int countToAdd = 0;
-    
-    //GET INITIAL VALUE OF CNT
-    prevCntVal = TIM2->CNT; 
-    
-    //LOOP UNTIL COUNTER IS EQUAL OR EXCEED GOAL COUNT
-    while(counter < goalCount)
+    SoftTimer *timer;
+    uint32_t primask;
+    
+    //CLEAR CC1IF
+    TIM2->SR = ~(1u << 1);
+    
+    while(1)
     {
-        //GET NEWEST COUNT
-        currentCntVal = TIM2->CNT;
+        primask = __get_PRIMASK();
+        __disable_irq();
         
-        //HANDLE SITUATION WHERE TIM2_CNT RESET
-        if(currentCntVal < prevCntVal)
+        //STOP WHEN THE NEXT TIMER IS NOT DUE YET
+        if((timerCount == 0u) || timerBefore(TIM2->CNT, timerHeap[1]->expiry))
         {
-            //GET THE COUNT BEFORE THE CNT REGISTER RESET AND THEN 
-            //ADD THE COUNT AFTER IT RESET TO GET ELAPSED COUNT
-            countToAdd = (4000000 - prevCntVal) + currentCntVal;
+            armCompare();
+            __set_PRIMASK(primask);
+            break;
         }
-        else
+        
+        timer = timerHeap[1];
+        heapRemove(timer);
+        
+        if(timer->period != 0u)
         {
-            //SSUBTRACT CURRENT COUNT FROM PREVIOUS COUNT TO GET
-            //ELAPSED COUNT
-            countToAdd = currentCntVal - prevCntVal;
+            timer->expiry += timer->period;
+            timerCount++;
+            heapPlace(timer, timerCount);
+            heapUp(timerCount);
         }
         
-        //ADD ELAPSED COUNT TO THE COUNTER
-        counter += countToAdd;
+        __set_PRIMASK(primask);
         
-        //CURRENT COUNT NOW BECOMES PREVIOUS COUNT
-        prevCntVal = currentCntVal;
+        //THE CALLBACK IS ALLOWED TO START AND STOP TIMERS
+        if(timer->callback)
+        {
+            timer->callback(timer->arg);
+        }
+    }
+}
+
+/*****************************************************************
+* setFlag
+*
+* Timer callback used by the delay functions.
+*****************************************************************/
+static void setFlag(void *arg)
+{
+    *(volatile uint8_t *)arg = 1;
+}
+
+/*****************************************************************
+* waitTicks
+*
+* Sleeps until 'ticks' timer ticks have passed. The core is woken
+* by the TIM2 compare interrupt instead of polling the counter.
+* Must not be called from an interrupt handler.
+*****************************************************************/
+static void waitTicks(uint32_t ticks)
+{
+    SoftTimer timer = {0};
+    volatile uint8_t done = 0;
+    
+    if(ticks == 0u)
+    {
+        return;
+    }
+    
+    //NO FREE TIMER, FALL BACK TO WATCHING THE COUNTER
+    if(!startTimer(&timer, ticks, 0, setFlag, (void *)&done))
+    {
+        uint32_t start = TIM2->CNT;
+        while((TIM2->CNT - start) < ticks);
+        return;
+    }
+    
+    //SLEEP UNTIL THE TIMER FIRES. OTHER INTERRUPTS MAY WAKE US FIRST.
+    //INTERRUPTS ARE MASKED BETWEEN THE CHECK AND WFI SO THE TIMER
+    //CAN'T FIRE IN BETWEEN. A PENDING INTERRUPT STILL ENDS THE WFI
+    __disable_irq();
+    while(!done)
+    {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
     }
+    __enable_irq();
+}
+
+/*****************************************************************
+* delay1Sec
+*
+* This function introduces a delay of 1 second.
+*****************************************************************/
+void delay1Sec(void)
+{
+    waitTicks(TIMER_TICK_HZ);
+}
+
+
+/*****************************************************************
+* delay
+*
+* This function introduces a delay in milliseconds specified
+* by the 'ms' parameter.
+*****************************************************************/
+void delay(unsigned int ms)
+{
+    waitTicks(MS_TO_TICKS(ms));
 }
 
  /*****************************************************************
@@ -144,45 +472,5 @@ void delay(unsigned int ms)
 *****************************************************************/
 void delayUs(unsigned int us)
 {
-    /*HOLDS THE TOTAL COUNT FROM TM2_CNT REGISTER TO RECORD HOW
-    MUCH TIME ELAPSED.*/
-    unsigned int counter = 0;
-    //HOLDS THE COUNT FOR THE COUNTER TO COUNT TO.
-    unsigned int goalCount = us * 4;
-    //HOLDS THE MOST RECENT VALUE OBTAINED FROM TIM2_CNT.
-    unsigned int currentCntVal = 0;
-    //HOLDS THE PREVIOUS VALUE OBTAINED FROM TIM2_CNT.
-    unsigned int prevCntVal = 0;
-    //HOLDS RESULT OF CALCULATION BETWEEN CURRENT AND PREVIOUS COUNTS.
-    unsigned int countToAdd = 0;
-    
-    //GET INITIAL VALUE OF CNT
-    prevCntVal = TIM2->CNT; 
-    
-    //LOOP UNTIL COUNTER IS EQUAL OR EXCEED GOAL COUNT
-    while(counter < goalCount)
-    {
-        //GET NEWEST COUNT
-        currentCntVal = TIM2->CNT;
-        
-        //HANDLE SITUATION WHERE TIM2_CNT RESET
-        if(currentCntVal < prevCntVal)
-        {
-            //GET THE COUNT BEFORE THE CNT REGISTER RESET AND THEN 
-            //ADD THE COUNT AFTER IT RESET TO GET ELAPSED COUNT
-            countToAdd = (4000000 - prevCntVal) + currentCntVal;
-        }
-        else
-        {
-            //SSUBTRACT CURRENT COUNT FROM PREVIOUS COUNT TO GET
-            //ELAPSED COUNT
-            countToAdd = currentCntVal - prevCntVal;
-        }
-        
-        //ADD ELAPSED COUNT TO THE COUNTER
-        counter += countToAdd;
-        
-        //CURRENT COUNT NOW BECOMES PREVIOUS COUNT
-        prevCntVal = currentCntVal;
-    }
+    waitTicks((uint32_t)us * (TIMER_TICK_HZ / 1000000u));
 }
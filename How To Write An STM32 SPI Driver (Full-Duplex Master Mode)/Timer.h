@@ -1,5 +1,39 @@
 
-void initTim2(void);
+#include <stdint.h>
+
+//TIM2 COUNTS AT THIS RATE. ONE TICK IS ONE MICROSECOND
+#define TIMER_TICK_HZ       1000000u
+
+//CONVERT MILLISECONDS TO TIMER TICKS
+#define MS_TO_TICKS(ms)     ((uint32_t)(ms) * (TIMER_TICK_HZ / 1000u))
+
+//MAXIMUM NUMBER OF SOFTWARE TIMERS THAT CAN BE RUNNING AT ONCE
+#ifndef TIMER_MAX_TIMERS
+#define TIMER_MAX_TIMERS    32u
+#endif
+
+typedef void (*TimerCallback)(void *arg);
+
+//ONE SOFTWARE TIMER. OWNED BY THE CALLER, ONLY TOUCH THROUGH THE
+//FUNCTIONS BELOW
+typedef struct
+{
+    uint32_t expiry;            //TICK COUNT AT WHICH THE TIMER FIRES
+    uint32_t period;            //0 FOR ONE-SHOT, OTHERWISE RELOAD IN TICKS
+    TimerCallback callback;     //CALLED FROM THE TIM2 INTERRUPT
+    void *arg;                  //PASSED TO THE CALLBACK
+    uint32_t slot;              //POSITION IN THE PENDING QUEUE, 0 WHEN STOPPED
+} SoftTimer;
+
+uint8_t initTim2(void);
+uint32_t calcTim2Psc(uint32_t timerClockHz);
+void retimeTim2(void);
 void delay1Sec(void);
 void delay(unsigned int ms);
 void delayUs(unsigned int us);
+
+uint32_t getTicks(void);
+uint8_t startTimer(SoftTimer *timer, uint32_t delayTicks, uint32_t periodTicks, TimerCallback callback, void *arg);
+void stopTimer(SoftTimer *timer);
+uint8_t timerRunning(const SoftTimer *timer);
+uint8_t nextTimerTicks(uint32_t *ticks);
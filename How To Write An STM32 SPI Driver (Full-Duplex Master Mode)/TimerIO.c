@@ -0,0 +1,508 @@
+#include "stm32l432xx.h"
+#include "TimerIO.h"
+#include "Timer.h"
+#include "Clock.h"
+#include "GPIO.h"
+#include "Board.h"
+
+
+/*****************************************************************
+* Input capture and PWM on TIM2, TIM1, TIM15 and TIM16.
+*
+* Captures take the timer count on both edges of the pin and DMA
+* copies each one straight into a circular buffer, so the CPU is
+* not involved until the edges are read. The buffer is read in
+* place through readCapture/releaseCapture and must be read at
+* least once per trip round it or edges are overwritten.
+*
+* TIM2 is the 1MHz, 32-bit time base of Timer.c. Its channels 2
+* to 4 can capture without changing it, so TIM2 captures are
+* always at TIMER_TICK_HZ and initTim2 must be called first. The
+* other timers are 16-bit and are set up here, either for capture
+* (free running) or for PWM (period set by ARR), not both. A clock
+* listener works their prescalers out again after configClock, so
+* captures keep their tick rate and PWM outputs their frequency and
+* duty cycle. The one capture interval spanning the change is
+* wrong, as the update event that loads the prescaler clears the
+* count.
+*****************************************************************/
+
+
+//EVERY TIMER PIN: NAME, TIMER, CHANNEL, PORT, PIN, AF, DMA CHANNEL
+//(0 FOR NONE), DMA1 CHANNEL NUMBER AND CSELR REQUEST
+#define TIMER_PINS(X)                                                               \
+    X(timerPinTim2Ch2PB3,  TIM2,  2, B, 3, 1,  DMA1_Channel7, 7, 4)                 \
+    X(timerPinTim2Ch3PA2,  TIM2,  3, A, 2, 1,  DMA1_Channel1, 1, 4)                 \
+    X(timerPinTim2Ch4PA3,  TIM2,  4, A, 3, 1,  DMA1_Channel7, 7, 4)                 \
+    X(timerPinTim1Ch1PA8,  TIM1,  1, A, 8, 1,  DMA1_Channel2, 2, 7)                 \
+    X(timerPinTim15Ch1PA2, TIM15, 1, A, 2, 14, DMA1_Channel5, 5, 7)                 \
+    X(timerPinTim15Ch2PA3, TIM15, 2, A, 3, 14, 0,             0, 0)                 \
+    X(timerPinTim16Ch1PA6, TIM16, 1, A, 6, 14, DMA1_Channel6, 6, 4)
+
+#define TIMER_PIN_DEFINE_(name, tim, channel, port, pin, af, dma, dmaChannel, request)  \
+    const TimerPin name = { tim, channel, GPIO##port, pin, af, dma, dmaChannel, request };
+
+TIMER_PINS(TIMER_PIN_DEFINE_)
+
+//EACH PIN'S PORT, PIN AND AF AS A CONSTANT THE PREPROCESSOR CHECKS
+//CAN USE: PORT (0 FOR A) IN BITS 8 UP, PIN IN BITS 4-7, AF IN 0-3
+#define TIMER_PORT_A_                   0u
+#define TIMER_PORT_B_                   1u
+#define TIMER_PIN_CODE_(name, tim, channel, port, pin, af, dma, dmaChannel, request)    \
+    name##_CODE = (TIMER_PORT_##port##_ << 8) | ((pin) << 4) | (af),
+
+enum { TIMER_PINS(TIMER_PIN_CODE_) };
+
+//THE AF OF EVERY PIN IN A LIST, 4 BITS PER PIN
+#define TIMER_LIST_AF_(pin, af)         | ((uint64_t)(af) << (4u * (pin)))
+#define TIMER_LIST_AF(pins)             (0u pins(TIMER_LIST_AF_))
+
+//1 IF TimerPin 'name' IS ON PORT A AND IN LIST 'pins' WITH ITS AF
+#define TIMER_PIN_CODE(name)            TIMER_PIN_CODE_OF_(name)
+#define TIMER_PIN_CODE_OF_(name)        name##_CODE
+#define TIMER_IN_PORTA_LIST(pins, name)                                             \
+    (((TIMER_PIN_CODE(name) >> 8) == 0u)                                            \
+     && ((BOARD_PIN_OR(pins) >> ((TIMER_PIN_CODE(name) >> 4) & 15u)) & 1u)          \
+     && (((TIMER_LIST_AF(pins) >> (4u * ((TIMER_PIN_CODE(name) >> 4) & 15u))) & 15u) == (TIMER_PIN_CODE(name) & 15u)))
+
+//FAILS TO COMPILE UNLESS BOARD 'b's CAPTURE AND PWM PINS ARE
+//EXACTLY THE PINS IN ITS TIMER LIST
+#define TIMER_BOARD_CHECK(b)                                                        \
+    GPIO_STATIC_ASSERT(TIMER_IN_PORTA_LIST(b##_TIMER_PORTA_PINS, b##_CAPTURE_PIN), b##_capture_pin);   \
+    GPIO_STATIC_ASSERT(TIMER_IN_PORTA_LIST(b##_TIMER_PORTA_PINS, b##_PWM_PIN), b##_pwm_pin);           \
+    GPIO_STATIC_ASSERT(BOARD_PIN_OR(b##_TIMER_PORTA_PINS)                           \
+                       == ((1u << ((TIMER_PIN_CODE(b##_CAPTURE_PIN) >> 4) & 15u))   \
+                           | (1u << ((TIMER_PIN_CODE(b##_PWM_PIN) >> 4) & 15u))), b##_timer_pins)
+
+TIMER_BOARD_CHECK(BOARD_A);
+TIMER_BOARD_CHECK(BOARD_B);
+
+//WHAT TIM1, TIM15 AND TIM16 (IN THAT ORDER) ARE SET UP FOR, SO
+//retimeTimerIO CAN SET THEM UP AGAIN. AT MOST ONE OF EACH PAIR
+static CaptureChannel *timerCaptures[3];
+static PwmOutput *timerPwms[3];
+
+
+/*****************************************************************
+* enableTimer
+*
+* Enables the clock of a timer and the port of its pin.
+*
+* Returns the clock the timer counts from.
+*****************************************************************/
+static uint32_t enableTimer(const TimerPin *pin)
+{
+    //PORTS ARE 0X400 APART, THEIR CLOCKS ARE BITS 0 UP OF AHB2ENR
+    RCC->AHB2ENR |= (1u << (((uint32_t)pin->port - GPIOA_BASE) / 0x400u));
+    
+    if(pin->tim == TIM2)
+    {
+        RCC->APB1ENR1 |= (1u << 0);         //ENABLE TIM2 CLOCK
+        return getApb1TimerHz();
+    }
+    
+    if(pin->tim == TIM1)
+    {
+        RCC->APB2ENR |= (1u << 11);         //ENABLE TIM1 CLOCK
+    }
+    else if(pin->tim == TIM15)
+    {
+        RCC->APB2ENR |= (1u << 16);         //ENABLE TIM15 CLOCK
+    }
+    else
+    {
+        RCC->APB2ENR |= (1u << 17);         //ENABLE TIM16 CLOCK
+    }
+    
+    return getApb2TimerHz();
+}
+
+/*****************************************************************
+* timerIndex
+*
+* Returns the slot of a 16-bit timer in timerCaptures and
+* timerPwms.
+*****************************************************************/
+static uint32_t timerIndex(TIM_TypeDef *tim)
+{
+    if(tim == TIM1)
+    {
+        return 0;
+    }
+    
+    return (tim == TIM15) ? 1u : 2u;
+}
+
+/*****************************************************************
+* setTimerPinAF
+*
+* Connects the pin to its timer channel.
+*****************************************************************/
+static void setTimerPinAF(const TimerPin *pin)
+{
+    GPIO_WRITE_FIELD(pin->port->AFR[0], GPIO_AFRL_MSK(pin->pin), GPIO_AFRL_SET(pin->pin, pin->af));
+    GPIO_WRITE_FIELD(pin->port->AFR[1], GPIO_AFRH_MSK(pin->pin), GPIO_AFRH_SET(pin->pin, pin->af));
+    GPIO_WRITE_FIELD(pin->port->MODER, GPIO_MODER_MSK(pin->pin), GPIO_MODER_SET(pin->pin, GPIO_MODE_AF));
+}
+
+/*****************************************************************
+* setChannelMode
+*
+* Writes the 8-bit CCMR field of a channel. Channels 1 and 2 are
+* in CCMR1, 3 and 4 in CCMR2, the even ones in the top byte.
+*****************************************************************/
+static void setChannelMode(TIM_TypeDef *tim, uint8_t channel, uint32_t mode)
+{
+    volatile uint32_t *ccmr = (channel <= 2u) ? &tim->CCMR1 : &tim->CCMR2;
+    uint32_t shift = (channel & 1u) ? 0u : 8u;
+    
+    *ccmr = (*ccmr & ~(0xFFu << shift)) | (mode << shift);
+}
+
+/*****************************************************************
+* channelCcr
+*
+* Returns the address of a channel's capture/compare register.
+*****************************************************************/
+static volatile uint32_t *channelCcr(TIM_TypeDef *tim, uint8_t channel)
+{
+    return &tim->CCR1 + (channel - 1u);
+}
+
+/*****************************************************************
+* loadCaptureRate
+*
+* Sets a 16-bit capture timer counting at the capture's requested
+* rate or as little above it as the timer clock allows.
+*****************************************************************/
+static void loadCaptureRate(CaptureChannel *capture, uint32_t timerHz)
+{
+    TIM_TypeDef *tim = capture->pin->tim;
+    uint32_t div = timerHz / capture->requestedHz;
+    
+    //THE CLOCK MAY HAVE MOVED TOO FAR FOR THE RATE TO BE MADE
+    if(div == 0u)
+    {
+        div = 1u;
+    }
+    else if(div > 0x10000u)
+    {
+        div = 0x10000u;
+    }
+    
+    tim->PSC = div - 1u;
+    tim->EGR = (1u << 0);
+    capture->tickHz = timerHz / div;
+}
+
+/*****************************************************************
+* calcPwmPeriod
+*
+* Works out the smallest prescaler that fits the period of
+* 'frequencyHz' in 16 bits, for the finest duty cycle steps, and
+* the period in ticks of the prescaled clock.
+*
+* Returns 1 on success, 0 if the timer clock can't make the
+* frequency.
+*****************************************************************/
+static uint8_t calcPwmPeriod(uint32_t timerHz, uint32_t frequencyHz, uint32_t *psc, uint32_t *periodTicks)
+{
+    uint32_t ticks = timerHz / frequencyHz;
+    
+    *psc = (ticks - 1u) / 0x10000u;
+    
+    if((ticks < 2u) || (*psc > 0xFFFFu))
+    {
+        return 0;
+    }
+    
+    *periodTicks = ticks / (*psc + 1u);
+    
+    return 1;
+}
+
+/*****************************************************************
+* loadPwmPeriod
+*
+* Loads the prescaler and period of a PWM output with its duty
+* cycle, starting a new period.
+*****************************************************************/
+static void loadPwmPeriod(PwmOutput *pwm, uint32_t psc, uint32_t periodTicks)
+{
+    TIM_TypeDef *tim = pwm->pin->tim;
+    
+    pwm->periodTicks = periodTicks;
+    tim->PSC = psc;
+    tim->ARR = periodTicks - 1u;
+    setPwmDuty(pwm, pwm->dutyPermille);
+    
+    //LOAD PSC, ARR AND CCR NOW
+    tim->EGR = (1u << 0);
+}
+
+/*****************************************************************
+* initCapture
+*
+* Starts capturing both edges of a pin into 'buffer', which holds
+* 'size' edge times. 'size' must be even so rising and falling
+* edges always land in the same places. 'tickHz' is the count rate
+* for TIM1/15/16, TIM2 always counts at TIMER_TICK_HZ. 'filter' (0
+* to 15) is the ICxF input filter, 0 for none.
+*
+* Returns 1 on success, 0 if the pin has no DMA request, the
+* settings are out of range or the clock listener table is full.
+*****************************************************************/
+uint8_t initCapture(CaptureChannel *capture, const TimerPin *pin, uint32_t *buffer, size_t size, uint32_t tickHz, uint8_t filter)
+{
+    TIM_TypeDef *tim = pin->tim;
+    uint32_t timerHz;
+    uint32_t bit = 4u * (pin->channel - 1u);
+    
+    if((pin->dma == 0) || (size < 2u) || (size & 1u) || (size > 0xFFFFu) || (filter > 15u))
+    {
+        return 0;
+    }
+    
+    //KEEP THE TICK RATE WHEN THE CLOCKS CHANGE
+    if(!addClockListener(retimeTimerIO))
+    {
+        return 0;
+    }
+    
+    timerHz = enableTimer(pin);
+    
+    capture->pin = pin;
+    capture->buffer = buffer;
+    capture->size = size;
+    capture->readIndex = 0;
+    
+    if(tim == TIM2)
+    {
+        //SHARED WITH Timer.c, LEAVE THE TIME BASE ALONE
+        capture->tickHz = TIMER_TICK_HZ;
+        capture->requestedHz = TIMER_TICK_HZ;
+        capture->counterMask = 0xFFFFFFFFu;
+    }
+    else
+    {
+        if((tickHz == 0u) || (tickHz > timerHz) || ((timerHz / tickHz) > 0x10000u))
+        {
+            return 0;
+        }
+        
+        //FREE RUNNING OVER THE FULL 16 BITS
+        tim->CR1 &= ~(1u << 0);
+        tim->ARR = 0xFFFFu;
+        capture->requestedHz = tickHz;
+        loadCaptureRate(capture, timerHz);
+        capture->counterMask = 0xFFFFu;
+        
+        timerCaptures[timerIndex(tim)] = capture;
+        timerPwms[timerIndex(tim)] = 0;
+    }
+    
+    //DMA CHANNEL. 32-BIT CCR TO 32-BIT MEMORY, GOING ROUND FOREVER
+    RCC->AHB1ENR |= (1u << 0);
+    pin->dma->CCR &= ~(1u << 0);
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~(15u << (4u * (pin->dmaChannel - 1u))))
+                      | ((uint32_t)pin->dmaRequest << (4u * (pin->dmaChannel - 1u)));
+    pin->dma->CPAR = (uint32_t)channelCcr(tim, pin->channel);
+    pin->dma->CMAR = (uint32_t)buffer;
+    pin->dma->CNDTR = (uint32_t)size;
+    pin->dma->CCR = ((1u << 12)             //MEDIUM PRIORITY
+                    |(2u << 10)             //32-BIT MEMORY
+                    |(2u << 8)              //32-BIT PERIPHERAL
+                    |(1u << 7)              //STEP THROUGH MEMORY
+                    |(1u << 5)              //CIRCULAR
+                    );                      //DIRECTION: READ FROM PERIPHERAL, NO INTERRUPTS
+    pin->dma->CCR |= (1u << 0);
+    
+    //CHANNEL OFF WHILE IT IS CHANGED
+    tim->CCER &= ~(15u << bit);
+    
+    //CCxS = 01: CAPTURE FROM THE CHANNEL'S OWN PIN. NO PRESCALER
+    setChannelMode(tim, pin->channel, ((uint32_t)filter << 4) | 1u);
+    
+    //WHICH EDGE COMES FIRST DEPENDS ON WHERE THE PIN IS NOW
+    setTimerPinAF(pin);
+    capture->firstRising = ((pin->port->IDR >> pin->pin) & 1u) ? 0u : 1u;
+    
+    //BOTH EDGES (CCxP AND CCxNP SET) AND ENABLE
+    tim->CCER |= ((1u << (bit + 3u)) | (1u << (bit + 1u)) | (1u << bit));
+    
+    //A DMA REQUEST FOR EVERY CAPTURE
+    tim->DIER |= (1u << (8u + pin->channel));
+    
+    //START THE COUNTER. TIM2 IS ALREADY RUNNING
+    tim->CR1 |= (1u << 0);
+    
+    return 1;
+}
+
+/*****************************************************************
+* readCapture
+*
+* Finds the edge times captured since the last releaseCapture,
+* without copying them.
+*
+* Returns the number of edges in 'slice'.
+*****************************************************************/
+size_t readCapture(CaptureChannel *capture, CaptureSlice *slice)
+{
+    //DMA COUNTS CNDTR DOWN FROM size, RELOADING AT 0
+    size_t writeIndex = capture->size - capture->pin->dma->CNDTR;
+    size_t read = capture->readIndex;
+    
+    if(writeIndex == capture->size)
+    {
+        writeIndex = 0;
+    }
+    
+    slice->data = &capture->buffer[read];
+    slice->rising = capture->firstRising ^ (uint8_t)(read & 1u);
+    
+    if(writeIndex >= read)
+    {
+        slice->len = writeIndex - read;
+        slice->wrapData = capture->buffer;
+        slice->wrapLen = 0;
+    }
+    else
+    {
+        slice->len = capture->size - read;
+        slice->wrapData = capture->buffer;
+        slice->wrapLen = writeIndex;
+    }
+    
+    return slice->len + slice->wrapLen;
+}
+
+/*****************************************************************
+* releaseCapture
+*
+* Hands 'count' edges read through readCapture back to the DMA.
+*****************************************************************/
+void releaseCapture(CaptureChannel *capture, size_t count)
+{
+    capture->readIndex = (capture->readIndex + count) % capture->size;
+}
+
+/*****************************************************************
+* addCaptureSlice
+*
+* Adds both parts of a slice to the frequency and duty totals.
+*****************************************************************/
+void addCaptureSlice(CaptureStats *stats, const CaptureSlice *slice)
+{
+    addCaptureEdges(stats, slice->data, slice->len, slice->rising);
+    
+    //THE BUFFER IS AN EVEN SIZE SO THE WRAPPED PART CONTINUES THE PATTERN
+    addCaptureEdges(stats, slice->wrapData, slice->wrapLen, slice->rising ^ (uint8_t)(slice->len & 1u));
+}
+
+/*****************************************************************
+* initPwm
+*
+* Starts PWM mode 1 on a TIM1, TIM15 or TIM16 pin at 'frequencyHz'
+* with a duty cycle of 'dutyPermille' 1/1000ths.
+*
+* Returns 1 on success, 0 for TIM2 (its period belongs to Timer.c),
+* a frequency the timer can't make or a full clock listener table.
+*****************************************************************/
+uint8_t initPwm(PwmOutput *pwm, const TimerPin *pin, uint32_t frequencyHz, uint16_t dutyPermille)
+{
+    TIM_TypeDef *tim = pin->tim;
+    uint32_t periodTicks;
+    uint32_t psc;
+    uint32_t bit = 4u * (pin->channel - 1u);
+    
+    if((tim == TIM2) || (frequencyHz == 0u))
+    {
+        return 0;
+    }
+    
+    if(!calcPwmPeriod(enableTimer(pin), frequencyHz, &psc, &periodTicks))
+    {
+        return 0;
+    }
+    
+    //KEEP THE FREQUENCY WHEN THE CLOCKS CHANGE
+    if(!addClockListener(retimeTimerIO))
+    {
+        return 0;
+    }
+    
+    pwm->pin = pin;
+    pwm->frequencyHz = frequencyHz;
+    pwm->dutyPermille = dutyPermille;
+    
+    tim->CR1 &= ~(1u << 0);
+    tim->CR1 |= (1u << 7);                  //BUFFER ARR
+    
+    //CHANNEL OFF WHILE IT IS CHANGED
+    tim->CCER &= ~(15u << bit);
+    
+    //OCxM = 110 PWM MODE 1, OCxPE SO DUTY CHANGES WAIT FOR THE NEXT PERIOD
+    setChannelMode(tim, pin->channel, (6u << 4) | (1u << 3));
+    loadPwmPeriod(pwm, psc, periodTicks);
+    
+    timerPwms[timerIndex(tim)] = pwm;
+    timerCaptures[timerIndex(tim)] = 0;
+    
+    setTimerPinAF(pin);
+    
+    //ACTIVE HIGH OUTPUT
+    tim->CCER |= (1u << bit);
+    
+    //TIM1, TIM15 AND TIM16 ONLY DRIVE THEIR OUTPUTS WITH MOE SET
+    tim->BDTR |= (1u << 15);
+    
+    tim->CR1 |= (1u << 0);
+    
+    return 1;
+}
+
+/*****************************************************************
+* setPwmDuty
+*
+* Sets the duty cycle in 1/1000ths, from the start of the next
+* period.
+*****************************************************************/
+void setPwmDuty(PwmOutput *pwm, uint16_t dutyPermille)
+{
+    if(dutyPermille > 1000u)
+    {
+        dutyPermille = 1000u;
+    }
+    
+    pwm->dutyPermille = dutyPermille;
+    *channelCcr(pwm->pin->tim, pwm->pin->channel) = (uint32_t)(((uint64_t)pwm->periodTicks * dutyPermille + 500u) / 1000u);
+}
+
+/*****************************************************************
+* retimeTimerIO
+*
+* Works the prescalers of TIM1, TIM15 and TIM16 out again after a
+* clock change. A PWM frequency the new clock can't make keeps its
+* old settings, a capture rate it can't make gets the nearest.
+*****************************************************************/
+void retimeTimerIO(void)
+{
+    uint32_t timerHz = getApb2TimerHz();
+    uint32_t periodTicks;
+    uint32_t psc;
+    uint32_t i;
+    
+    for(i = 0; i < 3u; i++)
+    {
+        if(timerCaptures[i])
+        {
+            loadCaptureRate(timerCaptures[i], timerHz);
+        }
+        
+        if(timerPwms[i] && calcPwmPeriod(timerHz, timerPwms[i]->frequencyHz, &psc, &periodTicks))
+        {
+            loadPwmPeriod(timerPwms[i], psc, periodTicks);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+#include <stddef.h>
+#include "CaptureMath.h"
+
+//A TIMER CHANNEL, THE PIN IT IS ON AND THE DMA CHANNEL THAT CAN
+//SERVE ITS CAPTURES
+typedef struct
+{
+    TIM_TypeDef *tim;
+    uint8_t channel;                //1 TO 4
+    GPIO_TypeDef *port;
+    uint8_t pin;
+    uint8_t af;                     //ALTERNATE FUNCTION OF THE PIN
+    DMA_Channel_TypeDef *dma;       //0 IF THE CHANNEL HAS NO DMA REQUEST
+    uint8_t dmaChannel;             //DMA1 CHANNEL NUMBER, 1 TO 7
+    uint8_t dmaRequest;             //CSELR VALUE FOR THAT CHANNEL
+} TimerPin;
+
+//PINS THAT ARE FREE IN THIS PROJECT. EACH ONE NOTES WHAT IT SHARES
+extern const TimerPin timerPinTim2Ch2PB3;      //CAPTURE. DMA1 CH7, SHARED WITH TIM2 CH4. LD3 ON THE NUCLEO
+extern const TimerPin timerPinTim2Ch3PA2;      //CAPTURE. DMA1 CH1. VCP TX ON THE NUCLEO
+extern const TimerPin timerPinTim2Ch4PA3;      //CAPTURE. DMA1 CH7, SHARED WITH TIM2 CH2
+extern const TimerPin timerPinTim1Ch1PA8;      //CAPTURE OR PWM. DMA1 CH2, SHARED WITH SPI1 RX
+extern const TimerPin timerPinTim15Ch1PA2;     //CAPTURE OR PWM. DMA1 CH5, SHARED WITH UART1 DMA RX
+extern const TimerPin timerPinTim15Ch2PA3;     //PWM ONLY
+extern const TimerPin timerPinTim16Ch1PA6;     //CAPTURE OR PWM. DMA1 CH6
+
+//INPUT CAPTURE INTO A CIRCULAR BUFFER. ONLY TOUCH THROUGH THE
+//FUNCTIONS BELOW
+typedef struct
+{
+    const TimerPin *pin;
+    uint32_t *buffer;               //EDGE TIMES, WRITTEN BY DMA
+    size_t size;                    //EVEN NUMBER OF ENTRIES IN buffer
+    size_t readIndex;               //NEXT ENTRY TO HAND OUT
+    uint8_t firstRising;            //buffer[0] HOLDS A RISING EDGE
+    uint32_t tickHz;                //RATE THE TIMER COUNTS AT
+    uint32_t requestedHz;           //RATE ASKED FOR, KEPT ACROSS CLOCK CHANGES
+    uint32_t counterMask;           //LARGEST COUNT OF THE TIMER
+} CaptureChannel;
+
+//EDGE TIMES READY TO BE READ, IN PLACE IN THE CAPTURE BUFFER. IF
+//THEY WRAP AROUND THE END OF THE BUFFER THE REST ARE AT wrapData,
+//OTHERWISE wrapLen IS 0. EDGES ALTERNATE, data[0] IS RISING IF
+//rising IS 1
+typedef struct
+{
+    const uint32_t *data;
+    size_t len;
+    const uint32_t *wrapData;
+    size_t wrapLen;
+    uint8_t rising;
+} CaptureSlice;
+
+//PWM OUTPUT
+typedef struct
+{
+    const TimerPin *pin;
+    uint32_t periodTicks;           //ARR + 1
+    uint32_t frequencyHz;           //KEPT ACROSS CLOCK CHANGES
+    uint16_t dutyPermille;          //KEPT ACROSS CLOCK CHANGES
+} PwmOutput;
+
+uint8_t initCapture(CaptureChannel *capture, const TimerPin *pin, uint32_t *buffer, size_t size, uint32_t tickHz, uint8_t filter);
+size_t readCapture(CaptureChannel *capture, CaptureSlice *slice);
+void releaseCapture(CaptureChannel *capture, size_t count);
+void addCaptureSlice(CaptureStats *stats, const CaptureSlice *slice);
+
+uint8_t initPwm(PwmOutput *pwm, const TimerPin *pin, uint32_t frequencyHz, uint16_t dutyPermille);
+void setPwmDuty(PwmOutput *pwm, uint16_t dutyPermille);
+
+void retimeTimerIO(void);
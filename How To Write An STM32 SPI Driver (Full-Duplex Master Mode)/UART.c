@@ -0,0 +1,856 @@
+#include "stm32l432xx.h"
+#include "UART.h"
+#include "Clock.h"
+#include "GPIO.h"
+#include "Board.h"
+
+
+// BAUD RATE UART1 IS KEPT AT WHEN THE CLOCKS CHANGE
+static uint32_t uart1Baud = UART_BAUD_RATE;
+
+
+static uint8_t loadUart1Baud(void);
+
+
+/*****************************************************************
+ initUart1Clocks
+
+ All clocks required are initialised here.
+*****************************************************************/
+void initUart1Clocks(void)
+{
+    RCC->AHB2ENR |= RCC_AHB2ENR_GPIOAEN;        // ENABLE GPIO PORT A CLOCK (BIT 0)
+    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;       // ENABLE UART1 CLOCK (BIT 14)
+
+#if UART1_CLOCK_HSI16
+    // KEEP HSI16 RUNNING FOR UART1, EVEN IN STOP MODE
+    RCC->CR |= (RCC_CR_HSION                    // HSI16 ON                         (8)
+               |RCC_CR_HSIKERON);               // HSI16 ON FOR PERIPHERALS IN STOP (9)
+    while(!(RCC->CR & RCC_CR_HSIRDY));          // WAIT FOR HSI16 READY             (10)
+
+    // SELECT HSI16 AS THE UART1 CLOCK (BITS 1-0 = 10)
+    RCC->CCIPR = (RCC->CCIPR & ~RCC_CCIPR_USART1SEL) | RCC_CCIPR_USART1SEL_1;
+#endif
+}
+
+/*****************************************************************
+ getUart1ClockHz
+
+ Returns
+ the frequency of the clock feeding UART1
+*****************************************************************/
+uint32_t getUart1ClockHz(void)
+{
+#if UART1_CLOCK_HSI16
+    return 16000000u;
+#else
+    return getPclk2Hz();
+#endif
+}
+
+
+/*****************************************************************
+ configPinMode
+
+ Configures the mode of the pins.
+*****************************************************************/
+void configPinMode(void)
+{
+    // SET TX AND RX TO AF IN ONE READ-MODIFY-WRITE
+    GPIO_SET_AF_MODE(GPIOA, BOARD_UART1_PORTA_PINS);
+}
+
+/*****************************************************************
+ setAF
+
+ Configures alternate function of the pins to UART1.
+*****************************************************************/
+void setAF(void)
+{
+    // SET TX AND RX AF. GPIO_SET_AF ONLY WRITES THE AFR REGISTERS
+    // THE BOARD'S PINS ARE IN
+    GPIO_SET_AF(GPIOA, BOARD_UART1_PORTA_PINS);
+}
+
+/*****************************************************************
+ configUart1Pins
+
+ Configures required pins to to be used as UART1 pins.
+*****************************************************************/
+void configUart1Pins(void)
+{
+    // SET PIN MODE TO ALTERNATE FUNCTION
+    configPinMode();
+
+    // SET ALTERNATE FUNCTION TO BE UART1
+    setAF();
+}
+
+/*****************************************************************
+ configUart1
+
+ This function configures the UART1 related registers to set up
+ the peripheral.
+*****************************************************************/
+void configUart1(void)
+{
+    // CONFIGURE USART1 CR1 REGISTER
+    // CLEAR BITS
+    USART1->CR1 &= ~(USART_CR1_M1       // CLEAR M1 FOR 1 START BIT AND 8 DATA BITS (28)
+                    |(0x03 << 26)       // INHIBIT INTERRUPTS AT BITS 26 AND 27     (27/26)
+                    |USART_CR1_OVER8    // OVERSAMPLING BY 16                       (15)
+                    |USART_CR1_CMIE     // INHIBIT CHARACTER MATCH INTERRUPT        (14)
+                    |USART_CR1_MME      // DON'T ENABLE MUTE MODE                   (13)
+                    |USART_CR1_M0       // CLEAR M0 FOR 1 START BIT AND 8 DATA BITS (12)
+                    |USART_CR1_PCE      // NOT IMPLEMENTING PARITY CONTROL          (10)
+                    |(0x1F << 3)        // INHIBIT INTERRUPTS AT BITS 4 TO 8        (4-8)
+                    |USART_CR1_TE       // DON'T ENABLE TRANSMITTER JUST YET        (3)
+                    |USART_CR1_RE       // DON'T ENABLE RECEIVER JUST YET           (2)
+                    |USART_CR1_UE);     // DON'T ENABLE UART1 JUST YET              (0)
+
+    // CONFIGURE USART CR2 REGISTER
+    // CLEAR BITS
+    USART1->CR2 &= ~(USART_CR2_RTOEN    // DISABLE RECEIVER TIMEOUT             (23)
+                    |USART_CR2_ABREN    // NO AUTOMATIC BAUD RATE DETECTION     (20)
+                    |USART_CR2_MSBFIRST // TRANSMIT/RECEIVE LSB FIRST           (19)
+                    |(0x03 << 16)       // IDLE STATE HIGH FOR RX/TX PINS       (17/16)
+                    |USART_CR2_SWAP     // DON'T SWAP FUNCTION OF RX/TX PINS    (15)
+                    |USART_CR2_LINEN    // NO LIN MODE                          (14)
+                    |(0x03 << 12)       // 1 STOP BIT                           (13/12)
+                    |USART_CR2_CLKEN    // DON'T USE CLOCK WITH UART            (11)
+                    |USART_CR2_LBDIE);  // NO LIN BREAK DETECTION INTERRUPT     (6)
+
+    // CONFIGURE USART CR3 REGISTER
+    // CLEAR BITS
+    USART1->CR3 &= ~(USART_CR3_TCBGTIE  // NO TRANSMISSION COMPLETE BEFORE GUART TIME INTERRUPT (24)
+                    |USART_CR3_DEM      // NO DRIVER ENABLE MODE                                (14)
+                    |(0x7F << 3)        // DISABLE VARIOUS IRRELEVANT MODES                     (9-3)
+                    |USART_CR3_IREN     // NO IrDA MODE                                         (1)
+                    |USART_CR3_EIE);    // INHIBIT ERROR INTERRUPT                              (0)
+
+    // SET BITS
+    USART1->CR3 |= (USART_CR3_OVRDIS    // DISABLE OVERRUN FUNCTIONALITY (12)
+                   |USART_CR3_ONEBIT);  // USE ONE SAMPLE BIT METHOD     (11)
+
+    // SET OVER8 AND BRR FOR THE BAUD RATE. UART1 IS CLOCKED FROM
+    // PCLK2 UNLESS UART1_CLOCK_HSI16 IS SET (BRR IS 35 FOR 115,200
+    // AT THE DEFAULT 4MHZ)
+    loadUart1Baud();
+
+    // ENABLE UART
+    USART1->CR1 |= (USART_CR1_TE        // ENABLE TRANSMITTER (3)
+                   |USART_CR1_RE        // ENABLE RECEIVER    (2)
+                   |USART_CR1_UE);      // ENABLE UART1       (0)
+}
+
+/*****************************************************************
+ loadUart1Baud
+
+ Sets OVER8 and BRR for uart1Baud at the current UART1 clock.
+ UART1 must be disabled.
+
+ Returns
+ 1 if the baud rate is within UART_BAUD_MAX_ERROR_PPM
+*****************************************************************/
+static uint8_t loadUart1Baud(void)
+{
+    UartBaud setting;
+    uint8_t ok = calcUartBaud(getUart1ClockHz(), uart1Baud, &setting);
+
+    if(setting.over8)
+    {
+        USART1->CR1 |= USART_CR1_OVER8;     // OVERSAMPLING BY 8 (15)
+    }
+    else
+    {
+        USART1->CR1 &= ~USART_CR1_OVER8;    // OVERSAMPLING BY 16 (15)
+    }
+
+    USART1->BRR = setting.brr;
+
+    return ok;
+}
+
+/*****************************************************************
+ retimeUart1
+
+ Reloads OVER8 and BRR after a clock change.
+*****************************************************************/
+void retimeUart1(void)
+{
+    uint32_t enabled = USART1->CR1 & USART_CR1_UE;
+
+    // BRR CAN ONLY BE WRITTEN WHILE UART1 IS DISABLED
+    USART1->CR1 &= ~USART_CR1_UE;
+    loadUart1Baud();
+    USART1->CR1 |= enabled;
+}
+
+/*****************************************************************
+ setUart1Baud
+
+ Changes the UART1 baud rate, choosing oversampling by 16 or 8 and
+ the BRR value with the smallest error. Turns auto baud detection
+ off. 'result' (may be 0) gets the settings and the error. Bytes
+ still being sent or received are lost.
+
+ Returns
+ 1 if the baud rate was set, 0 if the error would be more than
+ UART_BAUD_MAX_ERROR_PPM, in which case nothing is changed
+*****************************************************************/
+uint8_t setUart1Baud(uint32_t baud, UartBaud *result)
+{
+    UartBaud setting;
+    uint32_t enabled = USART1->CR1 & USART_CR1_UE;
+    uint8_t ok = calcUartBaud(getUart1ClockHz(), baud, &setting);
+
+    if(result)
+    {
+        *result = setting;
+    }
+
+    if(!ok)
+    {
+        return 0;
+    }
+
+    uart1Baud = baud;
+
+    // OVER8, BRR AND ABREN CAN ONLY BE WRITTEN WHILE UART1 IS DISABLED
+    USART1->CR1 &= ~USART_CR1_UE;
+    USART1->CR2 &= ~USART_CR2_ABREN;    // NO AUTOMATIC BAUD RATE DETECTION (20)
+    loadUart1Baud();
+    USART1->CR1 |= enabled;
+
+    return 1;
+}
+
+/*****************************************************************
+ startUart1AutoBaud
+
+ Makes UART1 measure the baud rate from the next byte received.
+ 'mode' says what that byte looks like (UART_ABR_...). The byte
+ itself also lands in the receive buffer. Poll getUart1AutoBaud
+ to find out when it is done.
+*****************************************************************/
+void startUart1AutoBaud(uint8_t mode)
+{
+    uint32_t enabled = USART1->CR1 & USART_CR1_UE;
+
+    // ABREN AND ABRMODE CAN ONLY BE WRITTEN WHILE UART1 IS DISABLED
+    USART1->CR1 &= ~USART_CR1_UE;
+
+    USART1->CR2 = (USART1->CR2 & ~USART_CR2_ABRMODE)
+                | ((uint32_t)(mode & 3u) << 21)     // DETECTION MODE   (22/21)
+                | USART_CR2_ABREN;                  // AUTO BAUD RATE   (20)
+
+    USART1->CR1 |= enabled;
+
+    // START A FRESH MEASUREMENT IF ONE HAD ALREADY FINISHED
+    USART1->RQR = USART_RQR_ABRRQ;
+}
+
+/*****************************************************************
+ getUart1AutoBaud
+
+ Checks on the measurement started by startUart1AutoBaud. Once it
+ has worked the measured baud rate is kept across clock changes.
+
+ Returns
+ UART_ABR_BUSY, UART_ABR_DONE with 'baud' filled in, or
+ UART_ABR_FAILED if the byte could not be measured, in which case
+ it can be started again
+*****************************************************************/
+uint8_t getUart1AutoBaud(uint32_t *baud)
+{
+    uint32_t isr = USART1->ISR;
+
+    if(!(isr & USART_ISR_ABRF))     // NOT FINISHED YET (15)
+    {
+        return UART_ABR_BUSY;
+    }
+
+    if(isr & USART_ISR_ABRE)        // MEASUREMENT FAILED (14)
+    {
+        return UART_ABR_FAILED;
+    }
+
+    uart1Baud = calcUartBaudFromBrr(getUart1ClockHz(), (uint16_t)USART1->BRR,
+                                    (USART1->CR1 & USART_CR1_OVER8) ? 1u : 0u);
+    *baud = uart1Baud;
+
+    return UART_ABR_DONE;
+}
+
+/*****************************************************************
+ enableUart1WakeFromStop
+
+ Lets a received byte wake the core from Stop 1 mode. Only works
+ when UART1 is clocked from HSI16 (UART1_CLOCK_HSI16).
+*****************************************************************/
+void enableUart1WakeFromStop(void)
+{
+    uint32_t enabled = USART1->CR1 & USART_CR1_UE;
+
+    // WAKE-UP SETTINGS CAN ONLY BE CHANGED WHILE UART1 IS DISABLED
+    USART1->CR1 &= ~USART_CR1_UE;
+
+    USART1->CR3 |= (USART_CR3_UCESM     // KEEP UART1 CLOCK IN STOP MODE    (23)
+                   |USART_CR3_WUFIE     // WAKE-UP INTERRUPT                (22)
+                   |USART_CR3_WUS);     // WAKE UP ON RXNE                  (21/20)
+
+    USART1->CR1 |= (USART_CR1_UESM      // UART1 ABLE TO WAKE FROM STOP     (1)
+                   |enabled);
+
+    NVIC_EnableIRQ(USART1_IRQn);
+}
+
+/*****************************************************************
+ initUART
+
+ This function encapsulates all the code and function calls
+ related to setting up the UART.
+
+ Returns
+ 1 on success, 0 if the clock listener table is full, in which
+ case UART1 is left alone
+*****************************************************************/
+uint8_t initUART(void)
+{
+    // KEEP THE BAUD RATE WHEN THE CLOCKS CHANGE. REGISTERED FIRST
+    // SO A FULL TABLE LEAVES NOTHING HALF SET UP
+    if(!addClockListener(retimeUart1))
+    {
+        return 0;
+    }
+
+    // INITIALISE REQUIRED CLOCKS. MUST ALWAYS BE DONE FIRST
+    // AS WITHOUT ENABLING THE CLOCKS THE PERIPHERALS CANNOT
+    // BE CONFIGURED OR USED.
+    initUart1Clocks();
+
+    // CONFIGURE PINS FOR UART1
+    configUart1Pins();
+
+    // CONFIGURE UART1
+    configUart1();
+
+    return 1;
+}
+
+/*****************************************************************
+ transmitUart
+
+ This function sends a byte of data over UART.
+*****************************************************************/
+void transmitUart(uint8_t data)     // BYTE OF DATA TO BE TRANSMITTED
+{
+    // WAIT UNTIL TRANSMIT DATA REGISTER IS READY TO TAKE DATA
+    // USART_ISR_TXE EXPANDS TO (1 << 7);
+    while(!(USART1->ISR & USART_ISR_TXE));
+
+    // LOAD DATA TO TRANSMIT REGISTER
+    USART1->TDR = data;
+}
+
+/*****************************************************************
+ transmitStrUart
+
+ This function transmits a string over UART.
+*****************************************************************/
+void transmitStrUart(char* str) // POINTER TO A STRING TO BE TRANSMITTED
+{
+    // WHILE NOT END OF STRING
+    while(*str)
+    {
+        // TRANSMIT CHARACTER THEN INCREMENT POINTER TO NEXT CHARACTER
+        transmitUart(*str++);
+    }
+}
+
+/*****************************************************************
+ receiveUart
+
+ This function reads a byte of data from the receive data register
+ if there is data to be read.
+
+ Returns
+ a byte of data read from the receive data register
+*****************************************************************/
+uint8_t receiveUart(void)
+{
+    uint8_t rxData = 0;
+
+    // IF THERE IS DATA IN THE RECEIVE DATA REGISTER
+    // USART_ISR_RXNE EXPANDS TO (1 << 5)
+    if(USART1->ISR & USART_ISR_RXNE)
+    {
+        // READ DATA FROM THE REGISTER
+        rxData = USART1->RDR;
+    }
+
+    return rxData;
+}
+
+
+/**********************************************************************************/
+/***************************Interrupt Driven UART Code*****************************/
+/**********************************************************************************/
+
+
+// RING BUFFERS SHARED WITH THE INTERRUPT HANDLER. EACH HAS ONE
+// PRODUCER AND ONE CONSUMER SO NO LOCKING IS NEEDED. THE INDEXES
+// ONLY EVER COUNT UP AND ARE MASKED WHEN THE BUFFER IS ACCESSED.
+// THE PRODUCER ONLY WRITES THE HEAD AND THE CONSUMER ONLY WRITES
+// THE TAIL.
+static volatile uint8_t txBuffer[UART_TX_BUFFER_SIZE];
+static volatile uint32_t txHead = 0;
+static volatile uint32_t txTail = 0;
+
+static volatile uint8_t rxBuffer[UART_RX_BUFFER_SIZE];
+static volatile uint32_t rxHead = 0;
+static volatile uint32_t rxTail = 0;
+
+// BYTES THROWN AWAY BECAUSE THE RX RING BUFFER WAS FULL
+static volatile uint32_t rxDropped = 0;
+
+// BYTES LOST BECAUSE RDR WAS NOT READ IN TIME (HARDWARE OVERRUN)
+static volatile uint32_t rxOverruns = 0;
+
+// TOLD ABOUT RECEIVED BYTES AND THE TX RING BUFFER EMPTYING
+static UartEventCallback eventCallback = 0;
+
+static void uartDmaRxEvent(void);
+
+
+/*****************************************************************
+ initUART_IT
+
+ Sets up UART1 the same way as initUART but transmits and
+ receives in the background using the USART1 interrupt.
+ Use uartWrite and uartRead instead of transmitUart and
+ receiveUart once this has been called.
+
+ Returns
+ 1 on success, 0 if the clock listener table is full
+*****************************************************************/
+uint8_t initUART_IT(void)
+{
+    // SET UP UART1 FOR POLLING FIRST
+    if(!initUART())
+    {
+        return 0;
+    }
+
+    // EMPTY BOTH RING BUFFERS
+    txHead = txTail = 0;
+    rxHead = rxTail = 0;
+    rxDropped = 0;
+    rxOverruns = 0;
+
+    // OVERRUN DETECTION CAN ONLY BE CHANGED WHILE UART1 IS DISABLED
+    USART1->CR1 &= ~USART_CR1_UE;
+
+    // ENABLE OVERRUN DETECTION SO LOST BYTES CAN BE COUNTED (12)
+    USART1->CR3 &= ~USART_CR3_OVRDIS;
+
+    // ENABLE RX INTERRUPT AND UART1 AGAIN. TX INTERRUPT IS ONLY
+    // ENABLED WHILE THERE IS DATA WAITING TO BE SENT
+    USART1->CR1 |= (USART_CR1_RXNEIE    // RXNE AND ORE INTERRUPT (5)
+                   |USART_CR1_UE);      // ENABLE UART1           (0)
+
+    NVIC_EnableIRQ(USART1_IRQn);
+
+    return 1;
+}
+
+/*****************************************************************
+ uartWrite
+
+ Copies as many bytes as will fit into the TX ring buffer and
+ starts transmitting them in the background. Never waits.
+
+ Returns
+ the number of bytes accepted, which is less than len if the
+ TX ring buffer filled up
+*****************************************************************/
+size_t uartWrite(const uint8_t *buf,    // BYTES TO BE TRANSMITTED
+                 size_t len)            // NUMBER OF BYTES IN buf
+{
+    size_t count = 0;
+    uint32_t head = txHead;
+
+    // COPY UNTIL DONE OR THE BUFFER IS FULL
+    while((count < len) && ((head - txTail) < UART_TX_BUFFER_SIZE))
+    {
+        txBuffer[head & (UART_TX_BUFFER_SIZE - 1u)] = buf[count++];
+        head++;
+    }
+
+    // PUBLISH THE NEW BYTES TO THE INTERRUPT HANDLER
+    txHead = head;
+
+    // LET THE INTERRUPT HANDLER START SENDING
+    if(count > 0)
+    {
+        USART1->CR1 |= USART_CR1_TXEIE;
+    }
+
+    return count;
+}
+
+/*****************************************************************
+ uartRead
+
+ Copies up to maxLen received bytes out of the RX ring buffer.
+ Never waits.
+
+ Returns
+ the number of bytes copied into buf, 0 if nothing was received
+*****************************************************************/
+size_t uartRead(uint8_t *buf,       // WHERE TO PUT THE RECEIVED BYTES
+                size_t maxLen)      // SIZE OF buf
+{
+    size_t count = 0;
+    uint32_t tail = rxTail;
+
+    // COPY UNTIL DONE OR THE BUFFER IS EMPTY
+    while((count < maxLen) && (tail != rxHead))
+    {
+        buf[count++] = rxBuffer[tail & (UART_RX_BUFFER_SIZE - 1u)];
+        tail++;
+    }
+
+    // HAND THE FREED SPACE BACK TO THE INTERRUPT HANDLER
+    rxTail = tail;
+
+    return count;
+}
+
+/*****************************************************************
+ uartTxFree
+
+ Returns
+ the number of bytes uartWrite can currently accept
+*****************************************************************/
+size_t uartTxFree(void)
+{
+    return UART_TX_BUFFER_SIZE - (txHead - txTail);
+}
+
+/*****************************************************************
+ uartRxAvailable
+
+ Returns
+ the number of received bytes waiting to be read
+*****************************************************************/
+size_t uartRxAvailable(void)
+{
+    return rxHead - rxTail;
+}
+
+/*****************************************************************
+ uartRxDropped
+
+ Returns
+ the number of received bytes thrown away because the RX ring
+ buffer was full
+*****************************************************************/
+uint32_t uartRxDropped(void)
+{
+    return rxDropped;
+}
+
+/*****************************************************************
+ uartRxOverruns
+
+ Returns
+ the number of hardware overruns, where a byte arrived before the
+ previous one had been taken out of RDR
+*****************************************************************/
+uint32_t uartRxOverruns(void)
+{
+    return rxOverruns;
+}
+
+/*****************************************************************
+ setUartEventCallback
+
+ Sets the function the interrupt handler calls with UART_EVENT_RX
+ after putting a byte in the RX ring buffer, and UART_EVENT_TX_EMPTY
+ once the last byte in the TX ring buffer has been handed to the
+ UART. Used to wake whatever is waiting for data or for space
+ instead of polling. Pass 0 to turn it off.
+*****************************************************************/
+void setUartEventCallback(UartEventCallback callback)
+{
+    eventCallback = callback;
+}
+
+/*****************************************************************
+ USART1_IRQHandler
+
+ Moves received bytes into the RX ring buffer and feeds TDR from
+ the TX ring buffer.
+*****************************************************************/
+void USART1_IRQHandler(void)
+{
+    uint32_t isr = USART1->ISR;
+
+    // COUNT AND CLEAR HARDWARE OVERRUNS. NOISE AND FRAMING ERRORS
+    // ARE CLEARED SO THEY DON'T STAY SET
+    if(isr & (USART_ISR_ORE | USART_ISR_NE | USART_ISR_FE))
+    {
+        if(isr & USART_ISR_ORE)
+        {
+            rxOverruns++;
+        }
+
+        USART1->ICR = (USART_ICR_ORECF | USART_ICR_NCF | USART_ICR_FECF);
+    }
+
+    // WOKEN FROM STOP MODE. THE BYTE ITSELF IS HANDLED BELOW
+    if(isr & USART_ISR_WUF)
+    {
+        USART1->ICR = USART_ICR_WUCF;
+    }
+
+    // LINE WENT IDLE, THE DMA RECEIVE FRAME IS COMPLETE
+    if((USART1->CR1 & USART_CR1_IDLEIE) && (isr & USART_ISR_IDLE))
+    {
+        USART1->ICR = USART_ICR_IDLECF;
+        uartDmaRxEvent();
+    }
+
+    // RECEIVED A BYTE. LEFT ALONE WHEN DMA IS READING RDR
+    if((USART1->CR1 & USART_CR1_RXNEIE) && (isr & USART_ISR_RXNE))
+    {
+        uint8_t data = (uint8_t)USART1->RDR;
+        uint32_t head = rxHead;
+
+        if((head - rxTail) < UART_RX_BUFFER_SIZE)
+        {
+            rxBuffer[head & (UART_RX_BUFFER_SIZE - 1u)] = data;
+            rxHead = head + 1u;
+
+            if(eventCallback)
+            {
+                eventCallback(UART_EVENT_RX);
+            }
+        }
+        else
+        {
+            rxDropped++;
+        }
+    }
+
+    // TDR IS READY FOR THE NEXT BYTE
+    if((USART1->CR1 & USART_CR1_TXEIE) && (isr & USART_ISR_TXE))
+    {
+        uint32_t tail = txTail;
+
+        if(tail != txHead)
+        {
+            USART1->TDR = txBuffer[tail & (UART_TX_BUFFER_SIZE - 1u)];
+            txTail = tail + 1u;
+        }
+        else
+        {
+            // NOTHING LEFT TO SEND
+            USART1->CR1 &= ~USART_CR1_TXEIE;
+
+            if(eventCallback)
+            {
+                eventCallback(UART_EVENT_TX_EMPTY);
+            }
+        }
+    }
+}
+
+
+/**********************************************************************************/
+/*****************************DMA Receive UART Code********************************/
+/**********************************************************************************/
+
+
+// DMA1 CHANNEL 5 WRITES EVERY RECEIVED BYTE IN HERE, WRAPPING
+// AROUND TO THE START WHEN IT REACHES THE END
+static uint8_t dmaRxBuffer[UART_DMA_RX_BUFFER_SIZE];
+
+// CALLED WITH EACH COMPLETE FRAME
+static UartFrameCallback dmaFrameCallback = 0;
+
+// WHERE THE FRAME BEING RECEIVED STARTED
+static uint32_t dmaFrameStart = 0;
+
+// BYTES RECEIVED SO FAR IN THE CURRENT FRAME
+static uint32_t dmaFrameLen = 0;
+
+// DMA WRITE POSITION WHEN THE BUFFER WAS LAST LOOKED AT
+static uint32_t dmaLastPos = 0;
+
+// FRAMES LONGER THAN THE BUFFER, PART OF THEM WAS OVERWRITTEN
+static volatile uint32_t dmaFramesLost = 0;
+
+
+/*****************************************************************
+ initUART_DMA
+
+ Sets up UART1 to receive into a circular DMA buffer. A frame is
+ complete when the line goes idle for one character time, at
+ which point callback is called from the interrupt with the part
+ of the DMA buffer that holds the frame. Nothing is copied, so
+ the callback must be finished with the frame before another
+ UART_DMA_RX_BUFFER_SIZE bytes arrive.
+ uartWrite can still be used to transmit.
+
+ Returns
+ 1 on success, 0 if the clock listener table is full
+*****************************************************************/
+uint8_t initUART_DMA(UartFrameCallback callback)    // CALLED WITH EACH RECEIVED FRAME
+{
+    // SET UP UART1 FOR POLLING FIRST
+    if(!initUART())
+    {
+        return 0;
+    }
+
+    // EMPTY THE TX RING BUFFER
+    txHead = txTail = 0;
+
+    dmaFrameCallback = callback;
+    dmaFrameStart = 0;
+    dmaFrameLen = 0;
+    dmaLastPos = 0;
+    dmaFramesLost = 0;
+
+    // ENABLE DMA1 CLOCK (BIT 0)
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+
+    // MAKE SURE CHANNEL 5 IS OFF BEFORE CONFIGURING IT
+    DMA1_Channel5->CCR &= ~DMA_CCR_EN;
+
+    // ROUTE USART1_RX REQUESTS TO CHANNEL 5 (19-16)
+    DMA1_CSELR->CSELR &= ~DMA_CSELR_C5S;
+    DMA1_CSELR->CSELR |= (2u << DMA_CSELR_C5S_Pos);
+
+    DMA1_Channel5->CPAR = (uint32_t)&USART1->RDR;
+    DMA1_Channel5->CMAR = (uint32_t)dmaRxBuffer;
+    DMA1_Channel5->CNDTR = UART_DMA_RX_BUFFER_SIZE;
+
+    // 8-BIT PERIPHERAL AND MEMORY SIZES, PERIPHERAL TO MEMORY
+    DMA1_Channel5->CCR = (DMA_CCR_PL_1  // HIGH PRIORITY                  (13)
+                         |DMA_CCR_MINC  // STEP THROUGH THE BUFFER        (7)
+                         |DMA_CCR_CIRC  // WRAP AROUND AT THE END         (5)
+                         |DMA_CCR_HTIE  // HALF TRANSFER INTERRUPT        (2)
+                         |DMA_CCR_TCIE  // TRANSFER COMPLETE INTERRUPT    (1)
+                         |DMA_CCR_EN);  // ENABLE CHANNEL                 (0)
+
+    // RECEIVER IS SERVICED BY DMA INSTEAD OF THE RXNE INTERRUPT
+    USART1->CR1 &= ~USART_CR1_RXNEIE;
+    USART1->CR3 |= USART_CR3_DMAR;      // DMA ENABLE RECEIVER (6)
+
+    // CLEAR ANY OLD IDLE FLAG THEN ENABLE THE IDLE INTERRUPT (4)
+    USART1->ICR = USART_ICR_IDLECF;
+    USART1->CR1 |= USART_CR1_IDLEIE;
+
+    NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+    NVIC_EnableIRQ(USART1_IRQn);
+
+    return 1;
+}
+
+/*****************************************************************
+ uartDmaFramesLost
+
+ Returns
+ the number of frames thrown away because they were too long
+ for the DMA buffer
+*****************************************************************/
+uint32_t uartDmaFramesLost(void)
+{
+    return dmaFramesLost;
+}
+
+/*****************************************************************
+ uartDmaUpdate
+
+ Adds the bytes written by DMA since the last call to the
+ current frame.
+*****************************************************************/
+static void uartDmaUpdate(void)
+{
+    // CNDTR COUNTS DOWN FROM THE BUFFER SIZE
+    uint32_t pos = UART_DMA_RX_BUFFER_SIZE - DMA1_Channel5->CNDTR;
+
+    if(pos == UART_DMA_RX_BUFFER_SIZE)
+    {
+        pos = 0;
+    }
+
+    // EVENTS ARE NEVER MORE THAN HALF A BUFFER APART SO THIS IS
+    // THE NUMBER OF NEW BYTES
+    dmaFrameLen += (pos + UART_DMA_RX_BUFFER_SIZE - dmaLastPos) % UART_DMA_RX_BUFFER_SIZE;
+    dmaLastPos = pos;
+}
+
+/*****************************************************************
+ uartDmaRxEvent
+
+ Called when the line goes idle. Hands the frame received since
+ the last idle to the callback.
+*****************************************************************/
+static void uartDmaRxEvent(void)
+{
+    UartRxSlice frame;
+
+    uartDmaUpdate();
+
+    if(dmaFrameLen > UART_DMA_RX_BUFFER_SIZE)
+    {
+        // THE START OF THE FRAME WAS OVERWRITTEN
+        dmaFramesLost++;
+    }
+    else if((dmaFrameLen > 0) && dmaFrameCallback)
+    {
+        frame.data = &dmaRxBuffer[dmaFrameStart];
+
+        if((dmaFrameStart + dmaFrameLen) > UART_DMA_RX_BUFFER_SIZE)
+        {
+            // FRAME WRAPPED AROUND THE END OF THE BUFFER
+            frame.len = UART_DMA_RX_BUFFER_SIZE - dmaFrameStart;
+            frame.wrapData = &dmaRxBuffer[0];
+            frame.wrapLen = dmaFrameLen - frame.len;
+        }
+        else
+        {
+            frame.len = dmaFrameLen;
+            frame.wrapData = 0;
+            frame.wrapLen = 0;
+        }
+
+        dmaFrameCallback(&frame);
+    }
+
+    // NEXT FRAME STARTS WHERE DMA WILL WRITE NEXT
+    dmaFrameStart = dmaLastPos;
+    dmaFrameLen = 0;
+}
+
+/*****************************************************************
+ DMA1_Channel5_IRQHandler
+
+ Keeps count of the bytes received in a frame that is longer
+ than half of the DMA buffer.
+*****************************************************************/
+void DMA1_Channel5_IRQHandler(void)
+{
+    // CLEAR ALL CHANNEL 5 FLAGS
+    DMA1->IFCR = DMA_IFCR_CGIF5;
+
+    // DISABLE THE IDLE INTERRUPT SO IT CAN'T RUN IN THE MIDDLE
+    // OF THE UPDATE
+    NVIC_DisableIRQ(USART1_IRQn);
+    uartDmaUpdate();
+    NVIC_EnableIRQ(USART1_IRQn);
+}
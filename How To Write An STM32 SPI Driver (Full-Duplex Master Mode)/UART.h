@@ -0,0 +1,94 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+#include <stddef.h>
+#include "UARTBaud.h"
+
+// BAUD RATE USED BY configUart1. setUart1Baud CHANGES IT LATER
+#ifndef UART_BAUD_RATE
+#define UART_BAUD_RATE          115200u
+#endif
+
+// SET TO 1 TO CLOCK UART1 FROM HSI16 INSTEAD OF PCLK2. UART1 CAN
+// ONLY WAKE THE CORE FROM STOP MODE WHEN CLOCKED FROM HSI16
+#ifndef UART1_CLOCK_HSI16
+#define UART1_CLOCK_HSI16       0
+#endif
+
+// SIZES OF THE INTERRUPT DRIVEN TX AND RX RING BUFFERS.
+// BOTH MUST BE A POWER OF 2
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE     256u
+#endif
+
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE     256u
+#endif
+
+// SIZE OF THE CIRCULAR DMA RECEIVE BUFFER. MUST BE EVEN AND
+// LARGER THAN THE LONGEST FRAME
+#ifndef UART_DMA_RX_BUFFER_SIZE
+#define UART_DMA_RX_BUFFER_SIZE 512u
+#endif
+
+// A RECEIVED FRAME INSIDE THE DMA BUFFER. IF THE FRAME WRAPPED
+// AROUND THE END OF THE BUFFER ITS REMAINING BYTES ARE AT
+// wrapData, OTHERWISE wrapLen IS 0
+typedef struct
+{
+    const uint8_t *data;
+    size_t len;
+    const uint8_t *wrapData;
+    size_t wrapLen;
+} UartRxSlice;
+
+typedef void (*UartFrameCallback)(const UartRxSlice *frame);
+
+// EVENTS PASSED TO THE UartEventCallback, FROM THE INTERRUPT HANDLER
+#define UART_EVENT_RX           0u      // A BYTE WAS ADDED TO THE RX RING BUFFER
+#define UART_EVENT_TX_EMPTY     1u      // THE TX RING BUFFER HAS BEEN EMPTIED
+
+typedef void (*UartEventCallback)(uint8_t event);
+
+// WHAT THE FIRST BYTE LOOKS LIKE FOR AUTO BAUD DETECTION (ABRMODE)
+#define UART_ABR_START_BIT      0u      // ANY BYTE STARTING WITH A 1 BIT
+#define UART_ABR_FALLING_EDGE   1u      // ANY BYTE STARTING WITH 10
+#define UART_ABR_0X7F           2u      // 0x7F
+#define UART_ABR_0X55           3u      // 0x55
+
+// RESULTS OF getUart1AutoBaud
+#define UART_ABR_BUSY           0u
+#define UART_ABR_DONE           1u
+#define UART_ABR_FAILED         2u
+
+void initUart1Clocks(void);
+void configPinMode(void);
+void setAF(void);
+void configUart1Pins(void);
+void configUart1(void);
+uint32_t getUart1ClockHz(void);
+void enableUart1WakeFromStop(void);
+void retimeUart1(void);
+uint8_t setUart1Baud(uint32_t baud, UartBaud *result);
+void startUart1AutoBaud(uint8_t mode);
+uint8_t getUart1AutoBaud(uint32_t *baud);
+uint8_t initUART(void);
+void transmitUart(uint8_t data);
+void transmitStrUart(char* str);
+uint8_t receiveUart(void);
+
+
+uint8_t initUART_IT(void);
+size_t uartWrite(const uint8_t *buf, size_t len);
+size_t uartRead(uint8_t *buf, size_t maxLen);
+size_t uartTxFree(void);
+size_t uartRxAvailable(void);
+uint32_t uartRxDropped(void);
+uint32_t uartRxOverruns(void);
+void setUartEventCallback(UartEventCallback callback);
+
+
+uint8_t initUART_DMA(UartFrameCallback callback);
+uint32_t uartDmaFramesLost(void);
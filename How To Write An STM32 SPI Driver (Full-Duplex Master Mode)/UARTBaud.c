@@ -0,0 +1,119 @@
+#include "UARTBaud.h"
+
+
+/*****************************************************************
+ With either oversampling the UART sends one bit every D clocks,
+ where D is a whole number. Oversampling by 16 needs D of at least
+ 16, oversampling by 8 lets D go down to 8 and so doubles the top
+ baud rate, but takes fewer samples per bit so copes less well
+ with noise. Both give exactly the same baud rates where they
+ overlap, so 8 is only chosen when 16 can't reach the baud rate.
+
+    OVER8 = 0   BRR = D                     D FROM 16 TO 65535
+    OVER8 = 1   BRR = USARTDIV WITH BITS 3-0 SHIFTED RIGHT ONE,
+                USARTDIV = 2 x D            D FROM 8 TO 32767
+*****************************************************************/
+
+
+/*****************************************************************
+ calcUartBaudFromBrr
+
+ Works out the baud rate a BRR and OVER8 setting gives, e.g. after
+ auto baud detection has written BRR
+
+ Returns
+ the baud rate, 0 if the BRR value is not valid
+*****************************************************************/
+uint32_t calcUartBaudFromBrr(uint32_t clockHz, uint16_t brr, uint8_t over8)
+{
+    uint32_t div = brr;
+
+    if(over8)
+    {
+        // BITS 2-0 HOLD USARTDIV BITS 3-1, D IS HALF OF USARTDIV
+        div = ((brr & 0xFFF0u) | ((brr & 7u) << 1)) / 2u;
+    }
+
+    if(div < (over8 ? 8u : 16u))
+    {
+        return 0;
+    }
+
+    return (uint32_t)(((uint64_t)clockHz + (div / 2u)) / div);
+}
+
+/*****************************************************************
+ calcUartBaudError
+
+ Returns
+ how far a divider of 'div' is from 'baud', in ppm
+*****************************************************************/
+static int32_t calcUartBaudError(uint32_t clockHz, uint32_t baud, uint32_t div)
+{
+    int64_t error = (((int64_t)clockHz * 1000000) / div) - ((int64_t)baud * 1000000);
+
+    return (int32_t)(error / (int64_t)baud);
+}
+
+/*****************************************************************
+ calcUartBaud
+
+ Picks the oversampling and BRR value that get closest to 'baud'
+ from a UART clock of 'clockHz'. 'result' is always filled in,
+ with the nearest setting there is if 'baud' is out of reach
+
+ Returns
+ 1 if the error is within UART_BAUD_MAX_ERROR_PPM, otherwise 0
+*****************************************************************/
+uint8_t calcUartBaud(uint32_t clockHz, uint32_t baud, UartBaud *result)
+{
+    uint32_t div;
+    int32_t below;
+    int32_t above;
+
+    if(baud == 0u)
+    {
+        baud = 1u;
+    }
+
+    // THE BEST DIVIDER IS EITHER SIDE OF clockHz / baud. THE ERROR
+    // GOES AS 1 / div SO ROUNDING ISN'T ALWAYS THE CLOSEST
+    div = clockHz / baud;
+
+    if(div < 8u)
+    {
+        div = 8u;
+    }
+    else if(div >= 0xFFFFu)
+    {
+        div = 0xFFFFu;
+    }
+    else
+    {
+        below = calcUartBaudError(clockHz, baud, div);
+        above = calcUartBaudError(clockHz, baud, div + 1u);
+
+        if(((above < 0) ? -above : above) < ((below < 0) ? -below : below))
+        {
+            div++;
+        }
+    }
+
+    if(div >= 16u)
+    {
+        // OVERSAMPLING BY 16
+        result->over8 = 0;
+        result->brr = (uint16_t)div;
+    }
+    else
+    {
+        // OVERSAMPLING BY 8. USARTDIV = 2 x D IS UNDER 32 HERE
+        result->over8 = 1;
+        result->brr = (uint16_t)(((2u * div) & 0xFFF0u) | (((2u * div) & 0x000Fu) >> 1));
+    }
+
+    result->actualBaud = (uint32_t)(((uint64_t)clockHz + (div / 2u)) / div);
+    result->errorPpm = calcUartBaudError(clockHz, baud, div);
+
+    return (result->errorPpm <= UART_BAUD_MAX_ERROR_PPM) && (result->errorPpm >= -UART_BAUD_MAX_ERROR_PPM);
+}
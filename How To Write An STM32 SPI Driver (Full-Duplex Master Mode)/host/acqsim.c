@@ -0,0 +1,439 @@
+/*****************************************************************
+ acqsim
+
+    Feeds the acquisition pipeline (Acquire.c) from a simulated
+    sensor and reports its throughput and how many frames it drops
+    as the main loop gets busier.
+
+    Time is counted in core cycles at 80MHz. The sensor interrupt
+    delivers a 7 channel frame, like startAcquireMpu9250, at a fixed
+    rate. The main loop runs the pipeline whenever a block is full:
+      sequence  checks the frame numbers carried in channels 0 and 1
+      decimate  averages every 4 frames into one
+      lowpass   first order low-pass, shift 3
+      transmit  copies the frames into a UART ring
+    Each stage "uses" the CPU for a set number of cycles per frame,
+    and any sensor frames that fall due meanwhile are delivered as
+    the interrupt would deliver them. Between blocks the main loop
+    also runs other work that takes 'load' of the CPU in bursts of
+    0 to 4ms, which is what makes the producer overrun.
+
+    Every run checks that the frames missing from the sequence are
+    exactly the frames the pipeline counted as dropped.
+
+    The low-pass stage is also given full scale steps, -32768 to
+    +32767 and back, and checked against the same filter in double.
+
+    The same stages are then timed on the host to give the cost of
+    the pipeline code itself.
+
+    Build:  cc -O2 -I.. -o acqsim acqsim.c ../Acquire.c ../Pool.c -lm
+    Usage:  acqsim [seconds]
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "Acquire.h"
+
+#define CPU_HZ              80000000u
+#define US(us)              ((uint64_t)(us) * (CPU_HZ / 1000000u))
+
+#define SENSOR_HZ           4000u       //FRAMES PER SECOND
+#define CHANNELS            7u          //ACCEL, TEMP, GYRO
+#define DECIMATE            4u
+#define LOWPASS_SHIFT       3u
+#define MAX_BLOCK_FRAMES    256u
+
+//CYCLES PER FRAME EACH STAGE TAKES ON THE TARGET
+#define SEQUENCE_CYCLES     12u
+#define DECIMATE_CYCLES     40u         //PER FRAME IN
+#define LOWPASS_CYCLES      60u         //PER FRAME IN, AFTER DECIMATION
+#define TRANSMIT_CYCLES     (CHANNELS * 2u * 8u)
+#define BLOCK_CYCLES        200u        //FIXED COST OF RUNNING A BLOCK
+
+//LONGEST BURST OF OTHER WORK
+#define BURST_MAX_US        4000u
+
+//CURRENT TIME IN CORE CYCLES
+static uint64_t now = 0;
+
+
+/**********************************************************************************/
+/*********************************Simulated Sensor*********************************/
+/**********************************************************************************/
+
+
+static Acquire acquire;
+
+//TWO BLOCKS, DOUBLE BUFFERING
+POOL_DEFINE(blockPool, MAX_BLOCK_FRAMES * CHANNELS * sizeof(int16_t), 2u);
+
+static uint64_t sensorNextAt = 0;
+static uint32_t sensorSequence = 0;
+
+/*****************************************************************
+ sensorInterrupt
+
+    One frame from the sensor, stored the way acquireDoneMpu9250
+    stores it. Channels 0 and 1 carry the frame number
+*****************************************************************/
+static void sensorInterrupt(void)
+{
+    size_t room;
+    int16_t *frame = getAcquireSlot(&acquire, &room);
+    uint8_t c;
+
+    if(!frame)
+    {
+        dropAcquire(&acquire, 1);
+    }
+    else
+    {
+        frame[0] = (int16_t)(sensorSequence & 0xFFFFu);
+        frame[1] = (int16_t)(sensorSequence >> 16);
+
+        for(c = 2; c < CHANNELS; c++)
+        {
+            frame[c] = (int16_t)((rand() % 2001) - 1000);
+        }
+
+        commitAcquire(&acquire, 1);
+    }
+
+    sensorSequence++;
+    sensorNextAt += CPU_HZ / SENSOR_HZ;
+}
+
+/*****************************************************************
+ work
+
+    Uses the CPU for 'cycles', delivering sensor frames that fall
+    due meanwhile
+*****************************************************************/
+static void work(uint64_t cycles)
+{
+    uint64_t end = now + cycles;
+
+    while(sensorNextAt <= end)
+    {
+        now = sensorNextAt;
+        sensorInterrupt();
+    }
+
+    now = end;
+}
+
+
+/**********************************************************************************/
+/*************************************Stages***************************************/
+/**********************************************************************************/
+
+
+typedef struct
+{
+    uint32_t expected;          //NEXT FRAME NUMBER
+    uint32_t missing;           //FRAMES SKIPPED IN THE SEQUENCE
+} Sequence;
+
+typedef struct
+{
+    uint8_t ring[256];
+    uint8_t head;
+    uint32_t bytes;
+} Transmit;
+
+//SET TO 0 WHEN TIMING THE STAGES ON THE HOST
+static uint8_t simulate = 1;
+
+static size_t sequenceStage(int16_t *data, size_t frames, uint8_t channels, void *arg)
+{
+    Sequence *sequence = (Sequence *)arg;
+    size_t i;
+
+    for(i = 0; i < frames; i++)
+    {
+        uint32_t number = (uint16_t)data[i * channels] | ((uint32_t)(uint16_t)data[(i * channels) + 1u] << 16);
+
+        sequence->missing += number - sequence->expected;
+        sequence->expected = number + 1u;
+    }
+
+    if(simulate)
+    {
+        work(BLOCK_CYCLES + (frames * (SEQUENCE_CYCLES + DECIMATE_CYCLES)));
+    }
+
+    return frames;
+}
+
+static size_t lowPassStage(int16_t *data, size_t frames, uint8_t channels, void *arg)
+{
+    if(simulate)
+    {
+        work(frames * LOWPASS_CYCLES);
+    }
+
+    return lowPassAcquire(data, frames, channels, arg);
+}
+
+static size_t transmitStage(int16_t *data, size_t frames, uint8_t channels, void *arg)
+{
+    Transmit *transmit = (Transmit *)arg;
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t i;
+
+    for(i = 0; i < (frames * channels * 2u); i++)
+    {
+        transmit->ring[transmit->head++] = bytes[i];
+    }
+
+    transmit->bytes += (uint32_t)(frames * channels * 2u);
+
+    if(simulate)
+    {
+        work(frames * TRANSMIT_CYCLES);
+    }
+
+    return frames;
+}
+
+
+/**********************************************************************************/
+/*************************************Runs*****************************************/
+/**********************************************************************************/
+
+
+static AcquireStage stages[4];
+static Sequence sequence;
+static AcquireDecimate decimate;
+static AcquireLowPass lowPass;
+static Transmit transmit;
+
+static void buildPipeline(size_t blockFrames)
+{
+    initPool(&blockPool);
+    initAcquire(&acquire, &blockPool, blockFrames, CHANNELS);
+
+    sequence.expected = 0;
+    sequence.missing = 0;
+    decimate.factor = DECIMATE;
+    lowPass.shift = LOWPASS_SHIFT;
+    lowPass.primed = 0;
+    transmit.head = 0;
+    transmit.bytes = 0;
+
+    addAcquireStage(&acquire, &stages[0], sequenceStage, &sequence);
+    addAcquireStage(&acquire, &stages[1], decimateAcquire, &decimate);
+    addAcquireStage(&acquire, &stages[2], lowPassStage, &lowPass);
+    addAcquireStage(&acquire, &stages[3], transmitStage, &transmit);
+}
+
+/*****************************************************************
+ runSimulation
+
+    Runs the main loop for 'seconds' with other work taking 'load'
+    percent of the CPU
+
+    Returns
+    1 if the missing frames matched the dropped count
+*****************************************************************/
+static uint8_t runSimulation(size_t blockFrames, unsigned load, unsigned seconds)
+{
+    uint64_t end = (uint64_t)seconds * CPU_HZ;
+    uint64_t pipelineCycles = 0;
+    uint64_t credit = 0;
+    uint64_t last;
+    uint64_t burst = 0;
+    uint32_t trailing;
+    AcquireStats stats;
+
+    now = 0;
+    sensorNextAt = 0;
+    sensorSequence = 0;
+    srand(1);
+    buildPipeline(blockFrames);
+
+    last = now;
+
+    while(now < end)
+    {
+        uint64_t before = now;
+
+        if(runAcquire(&acquire))
+        {
+            pipelineCycles += now - before;
+        }
+        else if((load > 0u) && (credit >= burst))
+        {
+            //OTHER WORK RUNS IN WHOLE BURSTS WHEN NO BLOCK IS WAITING
+            credit -= burst;
+            work(burst);
+            burst = US((uint64_t)rand() % (BURST_MAX_US + 1u));
+        }
+        else
+        {
+            //NOTHING TO DO, SLEEP UNTIL THE NEXT FRAME
+            work(sensorNextAt - now);
+        }
+
+        //OTHER WORK EARNS 'load' PERCENT OF THE TIME GONE BY
+        credit += ((now - last) * load) / 100u;
+        last = now;
+    }
+
+    //STOP THE SENSOR AND FINISH WHAT IS FULL
+    sensorNextAt = UINT64_MAX;
+    while(runAcquire(&acquire))
+    {
+    }
+
+    getAcquireStats(&acquire, &stats);
+
+    //FRAMES DROPPED AFTER THE LAST BLOCK SEEN CAN'T SHOW AS A GAP YET
+    trailing = sensorSequence - sequence.expected - (uint32_t)acquire.filled;
+
+    printf("  %5lu  %3u%%  %8lu  %8lu  %6.2f%%  %6lu  %9.0f  %6.1f%%  %s\n",
+           (unsigned long)blockFrames, load,
+           (unsigned long)stats.frames,
+           (unsigned long)stats.framesDropped,
+           (100.0 * stats.framesDropped) / (stats.frames + stats.framesDropped),
+           (unsigned long)stats.overruns,
+           (double)stats.blocksProcessed * blockFrames / seconds,
+           (100.0 * pipelineCycles) / end,
+           ((sequence.missing + trailing) == stats.framesDropped) ? "ok" : "MISMATCH");
+
+    return (sequence.missing + trailing) == stats.framesDropped;
+}
+
+/*****************************************************************
+ checkLowPassStep
+
+    Steps every channel from -32768 to +32767 and back again with
+    the filter settled at the old value, for each shift. The output
+    has to follow y += (x - y) / 2^shift worked out in double to
+    within 1
+
+    Returns
+    1 if every output did
+*****************************************************************/
+static uint8_t checkLowPassStep(void)
+{
+    static const int16_t levels[] = { -32768, 32767, -32768 };
+    int16_t frame[ACQUIRE_MAX_CHANNELS];
+    AcquireLowPass filter;
+    double expected;
+    double worst = 0.0;
+    uint8_t shift;
+    uint32_t i;
+    uint8_t c;
+    size_t l;
+
+    for(shift = 0; shift <= 8u; shift++)
+    {
+        filter.shift = shift;
+        filter.primed = 0;
+        expected = levels[0];
+
+        for(l = 0; l < (sizeof(levels) / sizeof(levels[0])); l++)
+        {
+            for(i = 0; i < 200u; i++)
+            {
+                for(c = 0; c < ACQUIRE_MAX_CHANNELS; c++)
+                {
+                    frame[c] = levels[l];
+                }
+
+                lowPassAcquire(frame, 1u, ACQUIRE_MAX_CHANNELS, &filter);
+                expected += (levels[l] - expected) / (double)(1u << shift);
+
+                for(c = 0; c < ACQUIRE_MAX_CHANNELS; c++)
+                {
+                    if(fabs(frame[c] - expected) > worst)
+                    {
+                        worst = fabs(frame[c] - expected);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("low-pass full scale steps: worst error %.2f\n", worst);
+
+    return worst <= 1.0;
+}
+
+/*****************************************************************
+ timeHost
+
+    Times the stages, without the simulated costs, on the host
+
+    Returns
+    nanoseconds per frame
+*****************************************************************/
+static double timeHost(size_t blockFrames)
+{
+    const uint32_t blocks = 200000u;
+    struct timespec start;
+    struct timespec stop;
+    uint32_t i;
+    size_t f;
+
+    simulate = 0;
+    sensorSequence = 0;
+    buildPipeline(blockFrames);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i = 0; i < blocks; i++)
+    {
+        for(f = 0; f < blockFrames; f++)
+        {
+            sensorInterrupt();
+        }
+
+        runAcquire(&acquire);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    simulate = 1;
+
+    return (((stop.tv_sec - start.tv_sec) * 1e9) + (stop.tv_nsec - start.tv_nsec)) / ((double)blocks * blockFrames);
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t blockSizes[] = { 8, 32, 128 };
+    static const unsigned loads[] = { 0, 50, 80, 95 };
+    unsigned seconds = (argc > 1) ? (unsigned)atoi(argv[1]) : 10u;
+    unsigned failed = 0;
+    size_t b;
+    size_t l;
+
+    printf("sensor %u Hz, %u channels, %us per run\n", SENSOR_HZ, CHANNELS, seconds);
+    printf("  block  load    frames   dropped    drop%%  overrun  frames/s  pipeline\n");
+
+    for(b = 0; b < (sizeof(blockSizes) / sizeof(blockSizes[0])); b++)
+    {
+        for(l = 0; l < (sizeof(loads) / sizeof(loads[0])); l++)
+        {
+            failed += !runSimulation(blockSizes[b], loads[l], seconds);
+        }
+    }
+
+    failed += !checkLowPassStep();
+
+    printf("host cost of the pipeline code:\n");
+
+    for(b = 0; b < (sizeof(blockSizes) / sizeof(blockSizes[0])); b++)
+    {
+        printf("  block %3lu: %5.1f ns per frame\n", (unsigned long)blockSizes[b], timeHost(blockSizes[b]));
+    }
+
+    printf("%s\n", failed ? "FAILED" : "drops all accounted for");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/*****************************************************************
+ boardcheck
+
+    Builds the GPIO register images each board in Board.h gives and
+    compares them with the hand-written values the pin code used
+    before the board table existed:
+
+    board A   SPI1 on PA1/PA11/PA12 and PB0, UART1 on PA9/PA10
+              (the full-duplex SPI driver and UART driver)
+    board B   SPI1 on PA5/PA6/PA7 and PB0, UART1 on PA9/PA10
+              (GPIO Programming #2)
+
+    Each image starts from the reset value of the register and goes
+    through the same GPIO_SET_AF_MODE and GPIO_SET_AF calls the
+    drivers make. Bad pins and conflicts don't get this far, Board.h
+    fails to compile.
+
+    Build:  cc -O2 -I.. -o boardcheck boardcheck.c
+    Usage:  boardcheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Board.h"
+
+//REGISTERS OF ONE PORT THE PIN MACROS TOUCH
+typedef struct
+{
+    uint32_t MODER;
+    uint32_t AFR[2];
+} Port;
+
+//RESET VALUES OF MODER (RM0394 8.5.1). AFR RESETS TO 0
+#define PORTA_MODER_RESET   0xABFFFFFFu
+#define PORTB_MODER_RESET   0xFFFFFEBFu
+
+typedef struct
+{
+    Port a;
+    Port b;
+} Images;
+
+static unsigned failed = 0;
+
+static void expect(const char *reg, uint32_t got, uint32_t want)
+{
+    printf("  %-12s %08lX", reg, (unsigned long)got);
+
+    if(got != want)
+    {
+        printf("   FAIL, want %08lX", (unsigned long)want);
+        failed++;
+    }
+
+    printf("\n");
+}
+
+static void resetPorts(Images *images)
+{
+    images->a.MODER = PORTA_MODER_RESET;
+    images->a.AFR[0] = 0;
+    images->a.AFR[1] = 0;
+    images->b.MODER = PORTB_MODER_RESET;
+    images->b.AFR[0] = 0;
+    images->b.AFR[1] = 0;
+}
+
+//THE PIN SETUP OF initSPI_HSM AND initUART FOR ONE BOARD'S LISTS
+#define CONFIGURE_BOARD(images, board)                                  \
+    do                                                                  \
+    {                                                                   \
+        Port *portA = &(images)->a;                                     \
+        Port *portB = &(images)->b;                                     \
+                                                                        \
+        GPIO_SET_AF_MODE(portA, board##_SPI1_PORTA_PINS);               \
+        GPIO_SET_AF_MODE(portB, board##_SPI1_PORTB_PINS);               \
+        GPIO_SET_AF(portA, board##_SPI1_PORTA_PINS);                    \
+        GPIO_SET_AF(portB, board##_SPI1_PORTB_PINS);                    \
+        GPIO_SET_AF_MODE(portA, board##_UART1_PORTA_PINS);              \
+        GPIO_SET_AF(portA, board##_UART1_PORTA_PINS);                   \
+    } while(0)
+
+int main(void)
+{
+    Images images;
+    uint32_t wantModerA;
+    uint32_t wantAfrlA;
+    uint32_t wantAfrhA;
+
+    //BOARD A. THE VALUES SPI.c AND UART.c ASSERTED BEFORE
+    resetPorts(&images);
+    CONFIGURE_BOARD(&images, BOARD_A);
+
+    wantModerA = PORTA_MODER_RESET;
+    wantModerA &= ~((3u << (2 * 1)) | (3u << (2 * 11)) | (3u << (2 * 12)) | (3u << 18) | (3u << 20));
+    wantModerA |= ((2u << (2 * 1)) | (2u << (2 * 11)) | (2u << (2 * 12)) | (2u << 18) | (2u << 20));
+    wantAfrlA = (5u << (4 * 1));
+    wantAfrhA = (5u << (4 * 3)) | (5u << (4 * 4)) | (7u << 4) | (7u << 8);
+
+    printf("board A, SPI1 on PA1/PA11/PA12\n");
+    expect("GPIOA MODER", images.a.MODER, wantModerA);
+    expect("GPIOA AFRL", images.a.AFR[0], wantAfrlA);
+    expect("GPIOA AFRH", images.a.AFR[1], wantAfrhA);
+    expect("GPIOB MODER", images.b.MODER, (PORTB_MODER_RESET & ~(3u << (2 * 0))) | (2u << (2 * 0)));
+    expect("GPIOB AFRL", images.b.AFR[0], (5u << (4 * 0)));
+
+    //BOARD B. THE VALUES configGpioSpiPins IN GPIO PROGRAMMING #2 WROTE
+    resetPorts(&images);
+    CONFIGURE_BOARD(&images, BOARD_B);
+
+    wantModerA = PORTA_MODER_RESET;
+    wantModerA &= ~((3u << (2 * 7)) | (3u << (2 * 6)) | (3u << (2 * 5)) | (3u << 18) | (3u << 20));
+    wantModerA |= ((2u << (2 * 7)) | (2u << (2 * 6)) | (2u << (2 * 5)) | (2u << 18) | (2u << 20));
+    wantAfrlA = (5u << (4 * 7)) | (5u << (4 * 6)) | (5u << (4 * 5));
+    wantAfrhA = (7u << 4) | (7u << 8);
+
+    printf("board B, SPI1 on PA5/PA6/PA7\n");
+    expect("GPIOA MODER", images.a.MODER, wantModerA);
+    expect("GPIOA AFRL", images.a.AFR[0], wantAfrlA);
+    expect("GPIOA AFRH", images.a.AFR[1], wantAfrhA);
+    expect("GPIOB MODER", images.b.MODER, (PORTB_MODER_RESET & ~(3u << (2 * 0))) | (2u << (2 * 0)));
+    expect("GPIOB AFRL", images.b.AFR[0], (5u << (4 * 0)));
+
+    //THE TIMER PINS OF EACH BOARD ARE CHECKED BY Board.h, SHOW THEM
+    printf("timer pins on port A: board A %04lX, board B %04lX\n",
+           (unsigned long)BOARD_PIN_OR(BOARD_A_TIMER_PORTA_PINS),
+           (unsigned long)BOARD_PIN_OR(BOARD_B_TIMER_PORTA_PINS));
+
+    printf("%s\n", failed ? "FAILED" : "all images ok");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,362 @@
+/*****************************************************************
+ buscheck
+
+    Checks the SPI bus manager in SPIBus.c against the SPI1 and
+    DMA1 models in host/sim/, with four devices on their own slave
+    select pins and their own frame formats.
+
+      fairness  one device with a long queue doesn't hold the
+                others off. With everything queued at once the
+                bus goes round the devices in turn
+      format    every frame has the frame size of the device whose
+                slave select is low, and only one is ever low
+      switch    going from one device to another costs the CR1 and
+                CR2 writes and nothing else. The register accesses
+                and time per transaction are printed for one
+                device on its own and for two taking turns
+      busy      a transaction queued while SPI1 is busy with a
+                burst the bus didn't start ends with SPI_BUS_ERROR
+                and its slave select high, without disturbing that
+                burst, and the bus works again afterwards
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o buscheck buscheck.c ../../host/sim/sim.c ../SPIBus.c ../SPI.c ../Clock.c
+    Usage:  buscheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Board.h"
+#include "Clock.h"
+#include "SPI.h"
+#include "SPIBus.h"
+
+#define DEVICES         4u
+#define MAX_TRANSACTIONS 64u
+#define SWITCH_RUNS     64u
+
+//FRAMES IN EACH TRANSACTION
+#define FRAMES          4u
+
+static SpiDevice devices[DEVICES];
+static GPIO_TypeDef *const csPorts[DEVICES] = {BOARD_SPI1_CS_PORT, GPIOB, GPIOB, GPIOB};
+static const uint8_t csPins[DEVICES] = {BOARD_SPI1_CS_PIN, 1u, 6u, 7u};
+static const uint8_t modes[DEVICES] = {SPI_MODE_3, SPI_MODE_0, SPI_MODE_1, SPI_MODE_3};
+static const uint32_t sckHz[DEVICES] = {1000000u, 4000000u, 2000000u, 1000000u};
+static const uint8_t frameBits[DEVICES] = {8u, 16u, 12u, 8u};
+
+static SpiTransaction transactions[MAX_TRANSACTIONS];
+
+//THE DMA ONLY TAKES 32-BIT ADDRESSES, SO THE BUFFERS ARE STATIC
+static uint16_t txBuf[FRAMES];
+static uint16_t rxBuf[MAX_TRANSACTIONS][FRAMES];
+
+//DEVICES IN THE ORDER THEIR TRANSACTIONS FINISHED
+static uint8_t finished[MAX_TRANSACTIONS];
+static uint32_t finishedCount = 0;
+
+//FRAMES THE SLAVE SIDE SAW
+static uint32_t framesSeen[DEVICES];
+static uint32_t framesWrongSize = 0;
+static uint32_t framesUnselected = 0;
+static uint32_t framesMultiSelected = 0;
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+ /*****************************************************************
+ slave
+
+    Works out which device the frame went to from the slave select
+    pins, checks its size and answers with the frame inverted
+*****************************************************************/
+static uint16_t slave(void *ctx, uint16_t mosi, uint8_t bits)
+{
+    uint32_t selected = DEVICES;
+    uint32_t count = 0;
+    uint32_t d;
+
+    (void)ctx;
+
+    for(d = 0; d < DEVICES; d++)
+    {
+        if(!simGetPin(csPorts[d], csPins[d]))
+        {
+            selected = d;
+            count++;
+        }
+    }
+
+    if(count == 0u)
+    {
+        framesUnselected++;
+    }
+    else if(count > 1u)
+    {
+        framesMultiSelected++;
+    }
+    else
+    {
+        framesSeen[selected]++;
+
+        if(bits != frameBits[selected])
+        {
+            framesWrongSize++;
+        }
+    }
+
+    return (uint16_t)~mosi;
+}
+
+static void onFinished(SpiTransaction *transaction)
+{
+    if(finishedCount < MAX_TRANSACTIONS)
+    {
+        finished[finishedCount++] = (uint8_t)(transaction->device - devices);
+    }
+}
+
+ /*****************************************************************
+ queueAll
+
+    Queues transaction 'n' for each device in 'order' with
+    interrupts masked, so the bus sees them all before the first
+    burst ends
+*****************************************************************/
+static void queueAll(const uint8_t *order, uint32_t count, SpiTransactionCallback callback)
+{
+    uint32_t n;
+
+    finishedCount = 0;
+
+    __disable_irq();
+    for(n = 0; n < count; n++)
+    {
+        check(queueSpiTransfer(&transactions[n], &devices[order[n]], txBuf, rxBuf[n], FRAMES, callback, 0),
+              "transaction queued");
+    }
+    __enable_irq();
+}
+
+static void waitAll(uint32_t count)
+{
+    uint32_t n;
+
+    for(n = 0; n < count; n++)
+    {
+        waitSpiTransfer(&transactions[n]);
+    }
+}
+
+static void checkFairness(void)
+{
+    //EIGHT FOR DEVICE 0, TWO EACH FOR DEVICES 1 AND 2, QUEUED IN
+    //THAT ORDER
+    static const uint8_t queued[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2};
+
+    //DEVICE 0 STARTS AT ONCE, THEN THE BUS GOES ROUND IN TURN
+    static const uint8_t expected[] = {0, 1, 2, 0, 1, 2, 0, 0, 0, 0, 0, 0};
+    uint32_t count = sizeof(queued);
+    uint8_t ok = 1;
+    uint32_t n;
+
+    queueAll(queued, count, onFinished);
+    waitAll(count);
+
+    check(finishedCount == count, "every transaction finished");
+    for(n = 0; n < count; n++)
+    {
+        ok &= (finished[n] == expected[n]);
+        ok &= (transactions[n].status == SPI_BUS_DONE);
+    }
+    check(ok, "devices served in turn");
+
+    for(n = 0; n < DEVICES; n++)
+    {
+        check(simGetPin(csPorts[n], csPins[n]) == 1u, "slave select high when idle");
+    }
+}
+
+static void checkFormat(void)
+{
+    uint16_t inverted;
+    uint32_t n;
+    uint8_t ok = 1;
+
+    check(framesWrongSize == 0u, "every frame the size of its device");
+    check(framesUnselected == 0u, "no frames without a slave selected");
+    check(framesMultiSelected == 0u, "never more than one slave selected");
+
+    //16-BIT DEVICE. THE SLAVE INVERTS EVERY FRAME
+    for(n = 0; n < FRAMES; n++)
+    {
+        inverted = (uint16_t)(txBuf[n] ^ 0xFFFFu);
+        ok &= (rxBuf[8][n] == inverted);
+    }
+    check(ok, "16-bit frames received whole");
+
+    //12-BIT DEVICE. ONLY 12 BITS ARE SHIFTED
+    ok = 1;
+    for(n = 0; n < FRAMES; n++)
+    {
+        inverted = (uint16_t)((txBuf[n] ^ 0xFFFFu) & 0x0FFFu);
+        ok &= (rxBuf[10][n] == inverted);
+    }
+    check(ok, "12-bit frames received");
+}
+
+ /*****************************************************************
+ runSwitch
+
+    Runs SWITCH_RUNS transactions alternating between devices 'a'
+    and 'b' (the same device for no switching) and reports what
+    each cost
+
+    Returns
+    the register writes per transaction
+*****************************************************************/
+static double runSwitch(const char *name, uint8_t a, uint8_t b)
+{
+    static uint8_t order[SWITCH_RUNS];
+    const SpiBusStats *bus = getSpiBusStats();
+    uint32_t reconfigs;
+    SimStats before;
+    SimStats after;
+    double writes;
+    uint32_t n;
+
+    for(n = 0; n < SWITCH_RUNS; n++)
+    {
+        order[n] = (n & 1u) ? b : a;
+    }
+
+    //ONE RUN FIRST SO DEVICE 'a' IS LOADED EITHER WAY, THEN EVERY
+    //RUN BUT THE FIRST IS A SWITCH WHEN 'a' AND 'b' DIFFER
+    queueAll(order, 1u, 0);
+    waitAll(1u);
+
+    reconfigs = bus->reconfigs;
+    simGetStats(&before);
+    for(n = 0; n < SWITCH_RUNS; n++)
+    {
+        queueSpiTransfer(&transactions[n], &devices[order[n]], txBuf, rxBuf[n], FRAMES, 0, 0);
+        waitSpiTransfer(&transactions[n]);
+    }
+    simGetStats(&after);
+
+    writes = (double)(after.total.writes - before.total.writes) / SWITCH_RUNS;
+
+    printf("%-24s %8.2f %8.2f %10.2f %9u\n", name,
+           (double)(after.total.reads - before.total.reads) / SWITCH_RUNS, writes,
+           (double)(after.timePs - before.timePs) / SWITCH_RUNS / SIM_PS_PER_US,
+           bus->reconfigs - reconfigs);
+
+    check(bus->reconfigs - reconfigs == ((a == b) ? 0u : (SWITCH_RUNS - 1u)), "reconfigs only on a device change");
+
+    return writes;
+}
+
+static void checkSwitch(void)
+{
+    double same;
+    double alternate;
+
+    printf("%-24s %8s %8s %10s %9s\n", "transactions", "reads", "writes", "time us", "reconfigs");
+
+    //DEVICES 0 AND 3 ONLY DIFFER IN THEIR SLAVE SELECT, SO THE
+    //DIFFERENCE IS THE COST OF THE SWITCH ALONE
+    same = runSwitch("device 0 on its own", 0u, 0u);
+    alternate = runSwitch("devices 0 and 3 in turn", 0u, 3u);
+
+    alternate = (alternate - same) * SWITCH_RUNS / (SWITCH_RUNS - 1u);
+    printf("a switch costs %.2f register writes\n", alternate);
+
+    check((alternate > 1.99) && (alternate < 2.01), "a switch costs the CR1 and CR2 writes");
+}
+
+static void onForeign(uint8_t status)
+{
+    check(status == SPI_DMA_OK, "burst the bus didn't start finished normally");
+}
+
+static void checkBusy(void)
+{
+    static uint8_t foreign[256];
+    static const uint8_t order[] = {0u, 1u};
+    const SpiBusStats *bus = getSpiBusStats();
+    uint32_t failed = bus->failed;
+    uint32_t unselected = framesUnselected;
+    uint32_t wrongSize = framesWrongSize;
+
+    //A BURST STARTED BEHIND THE BUS'S BACK WITH DEVICE 0'S SETTINGS
+    check(startSPI_DMA(foreign, foreign, sizeof(foreign), 8u, onForeign), "burst started without the bus");
+
+    queueAll(order, 2u, onFinished);
+
+    check((transactions[0].status == SPI_BUS_ERROR) && (transactions[1].status == SPI_BUS_ERROR),
+          "transactions refused with SPI_BUS_ERROR");
+    check(finishedCount == 2u, "callbacks called for refused transactions");
+    check(bus->failed - failed == 2u, "refused transactions counted");
+    check(simGetPin(csPorts[0], csPins[0]) && simGetPin(csPorts[1], csPins[1]), "slave select high when refused");
+
+    while(busySPI_DMA())
+    {
+        simRunUs(10u);
+    }
+
+    check(framesUnselected - unselected == sizeof(foreign), "burst the bus didn't start not disturbed");
+
+    //WORKS AGAIN
+    queueAll(order, 2u, onFinished);
+    waitAll(2u);
+    check((transactions[0].status == SPI_BUS_DONE) && (transactions[1].status == SPI_BUS_DONE),
+          "bus works after the refusals");
+    check(framesWrongSize == wrongSize, "frame sizes right after the refusals");
+}
+
+int main(void)
+{
+    uint32_t n;
+
+    simInit();
+    simSetSpiSlave(slave, 0);
+
+    configClock(&clockPll80MHz);
+    initSpiBus();
+
+    for(n = 0; n < DEVICES; n++)
+    {
+        check(addSpiDevice(&devices[n], csPorts[n], csPins[n], modes[n], sckHz[n], frameBits[n]), "device added");
+    }
+    check(!addSpiDevice(&devices[0], GPIOA, 0u, SPI_MODE_0, 1000000u, 8u), "fifth device refused");
+
+    for(n = 0; n < FRAMES; n++)
+    {
+        txBuf[n] = (uint16_t)(0x1234u * (n + 1u));
+    }
+
+    checkFairness();
+    checkFormat();
+    checkSwitch();
+    checkBusy();
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
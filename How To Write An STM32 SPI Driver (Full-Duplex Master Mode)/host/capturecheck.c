@@ -0,0 +1,108 @@
+/*****************************************************************
+ capturecheck
+
+    Feeds simulated capture streams through CaptureMath.c and
+    checks the frequency and duty cycle it works out. Each case
+    is a square wave of a known frequency and duty cycle sampled
+    by a 16-bit or 32-bit counter, with the counter wrapping many
+    times, a random starting count, random jitter on every edge
+    and the stream split into DMA-sized slices at random points.
+
+    Build:  cc -O2 -I.. -o capturecheck capturecheck.c ../CaptureMath.c
+    Usage:  capturecheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "CaptureMath.h"
+
+#define EDGES   4000u
+
+static const struct
+{
+    uint32_t tickHz;            //TIMER COUNT RATE
+    uint32_t counterMask;       //16 OR 32-BIT COUNTER
+    double frequency;           //SIGNAL FREQUENCY IN HZ
+    double duty;                //FRACTION OF THE PERIOD SPENT HIGH
+    uint32_t jitter;            //MOST TICKS ANY EDGE IS MOVED BY
+    uint8_t firstRising;
+} cases[] =
+{
+    { 1000000u, 0xFFFFFFFFu, 1000.0,    0.25,  0, 1 },
+    { 1000000u, 0xFFFFFFFFu, 37.5,      0.5,   3, 0 },
+    { 1000000u, 0xFFFFu,     100.0,     0.1,   2, 1 },
+    { 1000000u, 0xFFFFu,     20.0,      0.9,   5, 0 },
+    { 80000000u, 0xFFFFu,    25000.0,   0.333, 1, 1 },
+    { 80000000u, 0xFFFFu,    1234.5,    0.75,  8, 0 },
+    { 8000000u, 0xFFFFu,     200000.0,  0.5,   0, 1 },
+};
+
+int main(void)
+{
+    static uint32_t stamps[EDGES];
+    unsigned failed = 0;
+    size_t c;
+
+    for(c = 0; c < (sizeof(cases) / sizeof(cases[0])); c++)
+    {
+        double period = cases[c].tickHz / cases[c].frequency;
+        double start = (double)(rand() & 0xFFFF);
+        CaptureStats stats;
+        uint32_t mHz;
+        uint16_t duty;
+        double wantMHz = cases[c].frequency * 1000.0;
+        double wantDuty = cases[c].duty * 1000.0;
+        size_t i;
+        size_t done;
+        uint8_t rising = cases[c].firstRising;
+
+        //EDGE TIMES OF THE SIGNAL AS THE COUNTER WOULD CAPTURE THEM
+        for(i = 0; i < EDGES; i++)
+        {
+            size_t cycle = (i + (cases[c].firstRising ? 0u : 1u)) / 2u;
+            uint8_t isRise = cases[c].firstRising ? !(i & 1u) : (i & 1u);
+            double t = start + (cycle * period) + (isRise ? 0.0 : cases[c].duty * period);
+            int32_t j = cases[c].jitter ? ((rand() % (2 * (int)cases[c].jitter + 1)) - (int)cases[c].jitter) : 0;
+
+            stamps[i] = ((uint32_t)(uint64_t)(t + 0.5) + (uint32_t)j) & cases[c].counterMask;
+        }
+
+        //FEED IT IN IN RANDOM SLICES, AS readCapture WOULD HAND IT OVER
+        initCaptureStats(&stats, cases[c].counterMask);
+
+        for(done = 0; done < EDGES; )
+        {
+            size_t n = 1u + (size_t)(rand() % 97);
+
+            if(n > (EDGES - done))
+            {
+                n = EDGES - done;
+            }
+
+            addCaptureEdges(&stats, &stamps[done], n, rising);
+            rising ^= (uint8_t)(n & 1u);
+            done += n;
+        }
+
+        mHz = calcCaptureFrequency(&stats, cases[c].tickHz);
+        duty = calcCaptureDuty(&stats);
+
+        //ALLOW 0.05% ON THE FREQUENCY AND 1/1000 (PLUS JITTER) ON THE DUTY
+        if(((mHz - wantMHz) > (wantMHz * 0.0005)) || ((wantMHz - mHz) > (wantMHz * 0.0005))
+         || ((duty - wantDuty) > (1.0 + (1000.0 * cases[c].jitter / period)))
+         || ((wantDuty - duty) > (1.0 + (1000.0 * cases[c].jitter / period))))
+        {
+            failed++;
+            printf("FAIL ");
+        }
+
+        printf("%9lu Hz tick, %s counter, want %10.3f Hz %5.1f%%, got %10.3f Hz %5.1f%%\n",
+               (unsigned long)cases[c].tickHz, (cases[c].counterMask == 0xFFFFu) ? "16-bit" : "32-bit",
+               cases[c].frequency, wantDuty / 10.0, mHz / 1000.0, duty / 10.0);
+    }
+
+    printf("%s\n", failed ? "FAILED" : "all cases ok");
+
+    return failed ? 1 : 0;
+}
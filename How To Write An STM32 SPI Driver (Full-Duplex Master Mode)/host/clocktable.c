@@ -0,0 +1,293 @@
+/*****************************************************************
+ clocktable
+
+    Checks every divider the drivers work out from the clocks
+    against the models in host/sim/, for a table of ClockConfigs from
+    100kHz MSI to the 80MHz PLL, with and without the AHB and APB
+    prescalers, and with PLL outputs that are not a whole number of
+    MHz.
+
+    For each one configClock runs the clock listeners, then:
+      PSC       TIM2 and TIM7 have the prescaler that brings the
+                timer clock nearest TIMER_TICK_HZ, 0 below it, and
+                TIM2 really counts at that rate
+      ARR       TIM7 still reloads every sampler period
+      BR        SPI1 SCK is the fastest not above SPI1_MAX_SCK_HZ
+      BRR       USART1 has the OVER8 and BRR calcUartBaud gives,
+                within UART_BAUD_MAX_ERROR_PPM when it can be
+    It also checks that an init whose clock listener doesn't fit
+    returns 0 without touching its peripheral, and prints the
+    table. The listener table is built the size of the four inits
+    it makes, so a fifth doesn't fit.
+
+    Then it switches between pairs of configurations that change
+    the PLL input, such as the 80MHz PLL on MSI 4MHz to MSI 48MHz.
+    The models in host/sim/ stop the run if a PLL that is on goes
+    out of range, or is reprogrammed, so configClock must be off
+    the PLL before it touches MSIRANGE.
+
+    Build:  cc -O2 -no-pie -DCLOCK_MAX_LISTENERS=4 -I../../host/sim -I.. -o clocktable clocktable.c ../../host/sim/sim.c ../Timer.c ../Sampler.c ../SPI.c ../SPIBus.c ../UART.c ../UARTBaud.c ../Clock.c
+    Usage:  clocktable
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Clock.h"
+#include "Timer.h"
+#include "Sampler.h"
+#include "SPI.h"
+#include "SPIBus.h"
+#include "UART.h"
+#include "UARTBaud.h"
+
+//SAMPLER PERIOD IN TICKS
+#define PERIOD          1000u
+
+//TIME THE TICK RATE IS MEASURED OVER
+#define MEASURE_US      4000u
+
+typedef struct
+{
+    const char *name;
+    ClockConfig config;
+} Row;
+
+static const Row rows[] =
+{
+    {"MSI 100kHz",          {CLOCK_SOURCE_MSI,    0u, CLOCK_SOURCE_MSI,   1u,  8u, 2u,   1u,  1u,  1u}},
+    {"MSI 800kHz",          {CLOCK_SOURCE_MSI,    3u, CLOCK_SOURCE_MSI,   1u,  8u, 2u,   1u,  1u,  1u}},
+    {"MSI 1MHz",            {CLOCK_SOURCE_MSI,    4u, CLOCK_SOURCE_MSI,   1u,  8u, 2u,   1u,  1u,  1u}},
+    {"MSI 4MHz",            {CLOCK_SOURCE_MSI,    6u, CLOCK_SOURCE_MSI,   1u,  8u, 2u,   1u,  1u,  1u}},
+    {"MSI 24MHz",           {CLOCK_SOURCE_MSI,    9u, CLOCK_SOURCE_MSI,   1u,  8u, 2u,   1u,  1u,  1u}},
+    {"MSI 48MHz",           {CLOCK_SOURCE_MSI,   11u, CLOCK_SOURCE_MSI,   1u,  8u, 2u,   1u,  1u,  1u}},
+    {"HSI16",               {CLOCK_SOURCE_HSI16,  6u, CLOCK_SOURCE_HSI16, 1u,  8u, 2u,   1u,  1u,  1u}},
+    {"HSI16 AHB/16",        {CLOCK_SOURCE_HSI16,  6u, CLOCK_SOURCE_HSI16, 1u,  8u, 2u,  16u,  1u,  1u}},
+    {"HSI16 AHB/512",       {CLOCK_SOURCE_HSI16,  6u, CLOCK_SOURCE_HSI16, 1u,  8u, 2u, 512u,  1u,  1u}},
+    {"HSI16 APB/2",         {CLOCK_SOURCE_HSI16,  6u, CLOCK_SOURCE_HSI16, 1u,  8u, 2u,   1u,  2u,  2u}},
+    {"HSI16 APB/16",        {CLOCK_SOURCE_HSI16,  6u, CLOCK_SOURCE_HSI16, 1u,  8u, 2u,   1u, 16u, 16u}},
+    {"PLL 80MHz",           {CLOCK_SOURCE_PLL,    6u, CLOCK_SOURCE_MSI,   1u, 40u, 2u,   1u,  1u,  1u}},
+    {"PLL 80MHz APB/4",     {CLOCK_SOURCE_PLL,    6u, CLOCK_SOURCE_MSI,   1u, 40u, 2u,   1u,  4u,  2u}},
+    {"PLL 34.67MHz",        {CLOCK_SOURCE_PLL,    6u, CLOCK_SOURCE_HSI16, 3u, 13u, 2u,   1u,  1u,  1u}},
+    {"PLL 11.56MHz APB/8",  {CLOCK_SOURCE_PLL,    6u, CLOCK_SOURCE_HSI16, 3u, 13u, 6u,   1u,  8u,  8u}},
+};
+
+#define ROWS            (sizeof(rows) / sizeof(rows[0]))
+
+static const ClockConfig msi48MHz = {CLOCK_SOURCE_MSI,  11u, CLOCK_SOURCE_MSI,   1u,  8u, 2u,   1u,  1u,  1u};
+static const ClockConfig pllHsi   = {CLOCK_SOURCE_PLL,   6u, CLOCK_SOURCE_HSI16, 3u, 13u, 2u,   1u,  1u,  1u};
+
+typedef struct
+{
+    const char *name;
+    const ClockConfig *from;
+    const ClockConfig *to;
+} Switch;
+
+static const Switch switches[] =
+{
+    {"PLL 80MHz to MSI 48MHz",      &clockPll80MHz, &msi48MHz},
+    {"MSI 48MHz to PLL 80MHz",      &msi48MHz,      &clockPll80MHz},
+    {"PLL 80MHz to PLL on HSI16",   &clockPll80MHz, &pllHsi},
+    {"PLL on HSI16 to PLL 80MHz",   &pllHsi,        &clockPll80MHz},
+    {"PLL 80MHz to PLL 80MHz",      &clockPll80MHz, &clockPll80MHz},
+    {"PLL 80MHz to MSI 4MHz",       &clockPll80MHz, &clockMsi4MHz},
+};
+
+#define SWITCHES        (sizeof(switches) / sizeof(switches[0]))
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *name, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s: %s\n", name, what);
+        errors++;
+    }
+}
+
+ /*****************************************************************
+ checkPsc
+
+    calcTim2Psc on its own, for clocks the ClockConfigs can't give
+*****************************************************************/
+static void checkPsc(void)
+{
+    static const uint32_t hz[] = {0u, 1u, 100000u, 499999u, 500000u, 999999u, 1000000u,
+                                  1499999u, 1500000u, 34666666u, 80000000u, 0xFFFFFFFFu};
+    double divider;
+    uint32_t psc;
+    uint32_t i;
+
+    for(i = 0; i < (sizeof(hz) / sizeof(hz[0])); i++)
+    {
+        psc = calcTim2Psc(hz[i]);
+
+        check(psc <= 0xFFFFu, "calcTim2Psc", "fits the 16-bit PSC");
+
+        if(hz[i] < TIMER_TICK_HZ)
+        {
+            check(psc == 0u, "calcTim2Psc", "0 below TIMER_TICK_HZ");
+        }
+        else
+        {
+            divider = (double)hz[i] / TIMER_TICK_HZ;
+            check(((psc + 0.5) <= divider) && (divider <= (psc + 1.5)), "calcTim2Psc", "nearest divider");
+        }
+    }
+}
+
+static void checkRow(const Row *row)
+{
+    uint32_t timerHz = getApb1TimerHz();
+    uint32_t psc = calcTim2Psc(timerHz);
+    uint32_t pclk2Hz = getPclk2Hz();
+    uint32_t br = (SPI1->CR1 >> 3) & 7u;
+    uint32_t sckHz = pclk2Hz >> (br + 1u);
+    double tickHz = (double)timerHz / (double)(psc + 1u);
+    double expected;
+    uint64_t start;
+    uint32_t before;
+    uint32_t ticks;
+    UartBaud baud;
+    uint8_t baudOk;
+    uint32_t actual;
+
+    //PRESCALERS. BELOW TIMER_TICK_HZ THE TIMER CAN'T BE SLOWED DOWN
+    check(TIM2->PSC == psc, row->name, "TIM2 PSC from calcTim2Psc");
+    check(TIM7->PSC == psc, row->name, "TIM7 PSC the same as TIM2");
+    check((timerHz >= TIMER_TICK_HZ) || (psc == 0u), row->name, "PSC 0 below TIMER_TICK_HZ");
+    check((timerHz < TIMER_TICK_HZ) || ((tickHz > 0.5 * TIMER_TICK_HZ) && (tickHz < 1.5 * TIMER_TICK_HZ)),
+          row->name, "tick within half a divider of TIMER_TICK_HZ");
+
+    //TIM2 REALLY COUNTS AT THAT RATE. THE TIME IS TAKEN BETWEEN THE
+    //TWO READS SO THE BUS TIME OF THE READ ITSELF DROPS OUT
+    before = getTicks();
+    start = simTimePs();
+    simRunUs(MEASURE_US);
+    ticks = getTicks() - before;
+    expected = tickHz * (double)(simTimePs() - start) / SIM_PS_PER_S;
+    check((ticks + 1.0 >= expected) && (ticks <= expected + 1.0), row->name, "TIM2 counts at the tick rate");
+
+    //SAMPLER PERIOD
+    check(TIM7->ARR == (PERIOD - 1u), row->name, "TIM7 ARR still the sampler period");
+
+    //SCK
+    check(br == calcSpiBaudRate(pclk2Hz, SPI1_MAX_SCK_HZ), row->name, "SPI1 BR from calcSpiBaudRate");
+    check((sckHz <= SPI1_MAX_SCK_HZ) || (br == 7u), row->name, "SCK not above SPI1_MAX_SCK_HZ");
+    check((br == 0u) || ((pclk2Hz >> br) > SPI1_MAX_SCK_HZ), row->name, "SCK the fastest allowed");
+
+    //BAUD RATE
+    baudOk = calcUartBaud(getUart1ClockHz(), UART_BAUD_RATE, &baud);
+    actual = calcUartBaudFromBrr(getUart1ClockHz(), (uint16_t)USART1->BRR, (USART1->CR1 & USART_CR1_OVER8) != 0u);
+    check(USART1->BRR == baud.brr, row->name, "USART1 BRR from calcUartBaud");
+    check(((USART1->CR1 & USART_CR1_OVER8) != 0u) == baud.over8, row->name, "USART1 OVER8 from calcUartBaud");
+    check(!baudOk || (llabs((long long)actual - UART_BAUD_RATE) * 1000000ll <= (long long)UART_BAUD_MAX_ERROR_PPM * UART_BAUD_RATE),
+          row->name, "baud rate within UART_BAUD_MAX_ERROR_PPM");
+
+    printf("%-20s %9u %9u %9u %6u %10.0f %3u %9u %6u %4u %9u %s\n", row->name,
+           getSysclkHz(), getHclkHz(), timerHz, psc, tickHz, br, sckHz,
+           (uint32_t)USART1->BRR, baud.over8, actual, baudOk ? "" : "(out of range)");
+}
+
+ /*****************************************************************
+ checkFull
+
+    With every listener slot taken, an init with a new listener
+    must fail and leave its peripheral alone, while one whose
+    listener is already registered still works
+*****************************************************************/
+static void checkFull(void)
+{
+    uint32_t cr1 = SPI1->CR1;
+    uint32_t cr2 = SPI1->CR2;
+    SimStats before;
+    SimStats after;
+
+    simGetStats(&before);
+    check(!initSpiBus(), "full", "initSpiBus refused with the listener table full");
+    simGetStats(&after);
+
+    check((SPI1->CR1 == cr1) && (SPI1->CR2 == cr2), "full", "SPI1 left alone");
+    check(after.total.writes == before.total.writes, "full", "no registers written");
+
+    check(initSPI_SSM(), "full", "initSPI_SSM again, its listener is already there");
+}
+
+ /*****************************************************************
+ checkSwitch
+
+    configClock from one configuration to another. SYSCLK must end
+    up on the new source at the new frequency, the PLL off unless
+    it is used, and HSI16 left as it was unless it is used
+*****************************************************************/
+static void checkSwitch(const Switch *sw)
+{
+    const ClockConfig *to = sw->to;
+    uint8_t needHsi = (to->source == CLOCK_SOURCE_HSI16)
+                    ||((to->source == CLOCK_SOURCE_PLL) && (to->pllInput == CLOCK_SOURCE_HSI16));
+    uint8_t hsiWasOn;
+
+    if(!configClock(sw->from))
+    {
+        check(0, sw->name, "configClock accepted the first configuration");
+        return;
+    }
+
+    hsiWasOn = (RCC->CR & RCC_CR_HSION) != 0u;
+
+    check(configClock(to), sw->name, "configClock accepted the second configuration");
+    check(((RCC->CFGR >> 2) & 3u) == to->source, sw->name, "SYSCLK on the new source");
+    check(getSysclkHz() == calcSysclkHz(to), sw->name, "SYSCLK at the new frequency");
+    check(simHclkHz() == getHclkHz(), sw->name, "HCLK the same in Clock.c and the sim");
+    check(((RCC->CR & RCC_CR_PLLON) != 0u) == (to->source == CLOCK_SOURCE_PLL), sw->name, "PLL on only when used");
+    check(((RCC->CR & RCC_CR_HSION) != 0u) == (hsiWasOn || needHsi), sw->name, "HSI16 only left on when it was or is used");
+}
+
+int main(void)
+{
+    uint32_t i;
+
+    simInit();
+
+    //FOUR LISTENERS, THE SIZE OF THE TABLE
+    check(initTim2(), "init", "initTim2");
+    check(initSampler(PERIOD), "init", "initSampler");
+    check(initSPI_SSM(), "init", "initSPI_SSM");
+    check(initUART(), "init", "initUART");
+
+    checkPsc();
+    checkFull();
+
+    printf("%-20s %9s %9s %9s %6s %10s %3s %9s %6s %4s %9s\n", "clocks",
+           "SYSCLK", "HCLK", "TIM clk", "PSC", "tick Hz", "BR", "SCK", "BRR", "OV8", "baud");
+
+    for(i = 0; i < ROWS; i++)
+    {
+        if(!configClock(&rows[i].config))
+        {
+            check(0, rows[i].name, "configClock accepted it");
+            continue;
+        }
+
+        checkRow(&rows[i]);
+    }
+
+    for(i = 0; i < SWITCHES; i++)
+    {
+        checkSwitch(&switches[i]);
+    }
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
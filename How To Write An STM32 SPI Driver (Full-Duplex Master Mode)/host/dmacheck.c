@@ -0,0 +1,245 @@
+/*****************************************************************
+ dmacheck
+
+    Checks the DMA burst mode of SPI.c (transferSPI_DMA) against
+    the SPI1 and DMA1 models in host/sim/.
+
+    A slave on SPI1 records every byte it is sent and answers with
+    its own pattern, and notes whether slave select was low. For a
+    range of burst lengths the test checks that:
+      - every byte reaches the slave in order with slave select
+        held low, and every reply lands in the receive buffer
+      - the callback is called once, with SPI_DMA_OK, after which
+        slave select is high and busySPI_DMA is 0
+      - the bytes follow each other with no gap, so the burst
+        takes the frame time times the length
+      - the CPU makes a fixed number of register accesses whatever
+        the length
+    It also checks the 0xFF dummy bytes when 'tx' is 0, that 'rx'
+    may be 0, that bad lengths and a second burst are refused, and
+    that a DMA transfer error ends the burst with SPI_DMA_ERROR.
+    The bus cycles of DMA1 itself are not modelled.
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o dmacheck dmacheck.c ../../host/sim/sim.c ../SPI.c ../Clock.c
+    Usage:  dmacheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Board.h"
+#include "Clock.h"
+#include "SPI.h"
+
+#define MAX_BURST       4096u
+
+//THE DMA ONLY TAKES 32-BIT ADDRESSES, SO NOTHING IT USES IS ON THE STACK
+static uint8_t txBuf[MAX_BURST];
+static uint8_t rxBuf[MAX_BURST];
+static uint8_t seen[MAX_BURST];
+static uint32_t seenCount = 0;
+static uint32_t seenWithCsHigh = 0;
+
+static uint32_t callbacks = 0;
+static uint8_t lastStatus = 0xFFu;
+static uint8_t csAtCallback = 0;
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what, uint32_t len)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s (%u bytes)\n", what, len);
+        errors++;
+    }
+}
+
+ /*****************************************************************
+ reply
+
+    Byte the slave sends back as its n'th byte
+*****************************************************************/
+static uint8_t reply(uint32_t n)
+{
+    return (uint8_t)((n * 13u) ^ 0x5Au);
+}
+
+static uint16_t slave(void *ctx, uint16_t mosi, uint8_t bits)
+{
+    (void)ctx;
+    (void)bits;
+
+    if(simGetPin(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN))
+    {
+        seenWithCsHigh++;
+    }
+
+    if(seenCount < MAX_BURST)
+    {
+        seen[seenCount] = (uint8_t)mosi;
+    }
+
+    return reply(seenCount++);
+}
+
+static void onDone(uint8_t status)
+{
+    callbacks++;
+    lastStatus = status;
+    csAtCallback = simGetPin(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN);
+}
+
+ /*****************************************************************
+ waitBurst
+
+    Lets simulated time pass until the burst has finished or
+    'limitUs' is up
+*****************************************************************/
+static void waitBurst(uint32_t limitUs)
+{
+    uint32_t us;
+
+    for(us = 0; (us < limitUs) && busySPI_DMA(); us++)
+    {
+        simRunUs(1u);
+    }
+}
+
+static void startCheck(void)
+{
+    seenCount = 0;
+    seenWithCsHigh = 0;
+    callbacks = 0;
+    lastStatus = 0xFFu;
+}
+
+ /*****************************************************************
+ checkBurst
+
+    Runs one burst of 'len' bytes and checks it. 'tx' and 'rx'
+    may be 0 as for transferSPI_DMA
+*****************************************************************/
+static void checkBurst(uint32_t len, uint8_t withTx, uint8_t withRx, double frameUs)
+{
+    SimStats before;
+    SimStats start;
+    SimStats end;
+    uint64_t cpuStart;
+    uint64_t cpuAccesses;
+    double us;
+    uint32_t i;
+    uint8_t ok;
+
+    for(i = 0; i < len; i++)
+    {
+        txBuf[i] = (uint8_t)(i * 7u + len);
+    }
+
+    memset(rxBuf, 0, sizeof(rxBuf));
+    startCheck();
+
+    simGetStats(&before);
+    check(transferSPI_DMA(withTx ? txBuf : 0, withRx ? rxBuf : 0, len, onDone) == 1u, "burst started", len);
+    simGetStats(&end);
+    cpuStart = end.total.reads + end.total.writes - before.total.reads - before.total.writes;
+
+    check(transferSPI_DMA(txBuf, rxBuf, len, onDone) == 0u, "second burst refused while busy", len);
+
+    simGetStats(&start);
+    waitBurst(len * 20u + 100u);
+    simGetStats(&end);
+
+    check(!busySPI_DMA(), "burst finished", len);
+    check(callbacks == 1u, "callback called once", len);
+    check(lastStatus == SPI_DMA_OK, "status SPI_DMA_OK", len);
+    check(csAtCallback == 1u, "slave select high at callback", len);
+    check(seenCount == len, "slave got every byte", len);
+    check(seenWithCsHigh == 0u, "slave select low for the whole burst", len);
+
+    ok = 1;
+    for(i = 0; i < len; i++)
+    {
+        ok &= (seen[i] == (withTx ? txBuf[i] : 0xFFu));
+    }
+    check(ok, withTx ? "bytes sent in order" : "0xFF sent without a tx buffer", len);
+
+    if(withRx)
+    {
+        ok = 1;
+        for(i = 0; i < len; i++)
+        {
+            ok &= (rxBuf[i] == reply(i));
+        }
+        check(ok, "replies received in order", len);
+    }
+    else
+    {
+        check(rxBuf[0] == 0u, "rx buffer left alone", len);
+    }
+
+    //THE CPU ONLY SETS THE BURST UP AND FINISHES IT. THE ISR'S LAST
+    //BSY POLL AND THE 1US STEPS ADD A LITTLE TIME AT THE END
+    us = (double)(end.timePs - start.timePs) / SIM_PS_PER_US;
+    cpuAccesses = end.total.reads + end.total.writes - start.total.reads - start.total.writes;
+
+    check(us < ((len * frameUs) + 2.0), "no gaps between bytes", len);
+    check(end.dmaTransfers - before.dmaTransfers == 2u * len, "one RX and one TX transfer a byte", len);
+
+    printf("%6u bytes  %9.2f us  %6.3f us/byte  start %3llu  finish %3llu register accesses\n",
+           len, us, us / len, (unsigned long long)cpuStart, (unsigned long long)cpuAccesses);
+}
+
+int main(void)
+{
+    static const uint32_t lengths[] = {1u, 2u, 3u, 15u, 64u, 1000u, MAX_BURST};
+    double frameUs;
+    uint32_t i;
+
+    simInit();
+    simSetSpiSlave(slave, 0);
+
+    configClock(&clockPll80MHz);
+    initSPI_DMA();
+
+    //8 BITS AT THE SCK CHOSEN FOR SPI1_MAX_SCK_HZ
+    frameUs = (8.0 * (2u << ((SPI1->CR1 >> 3) & 7u)) * 1e6) / getPclk2Hz();
+    printf("SCK %.0f Hz, %.3f us a byte\n", 8e6 / frameUs, frameUs);
+
+    for(i = 0; i < (sizeof(lengths) / sizeof(lengths[0])); i++)
+    {
+        checkBurst(lengths[i], 1u, 1u, frameUs);
+    }
+
+    checkBurst(16u, 0u, 1u, frameUs);
+    checkBurst(16u, 1u, 0u, frameUs);
+
+    check(transferSPI_DMA(txBuf, rxBuf, 0u, onDone) == 0u, "0 bytes refused", 0u);
+    check(transferSPI_DMA(txBuf, rxBuf, 0x10000u, onDone) == 0u, "65536 bytes refused", 0x10000u);
+
+    //POINT THE TX CHANNEL AT A REGISTER THE SIM DOESN'T MODEL
+    startCheck();
+    DMA1_Channel3->CPAR = (uint32_t)&SYSCFG->SKR;
+    transferSPI_DMA(txBuf, rxBuf, 8u, onDone);
+    waitBurst(100u);
+    DMA1_Channel3->CPAR = (uint32_t)&SPI1->DR;
+
+    check(!busySPI_DMA(), "burst ended by the error", 8u);
+    check((callbacks == 1u) && (lastStatus == SPI_DMA_ERROR), "status SPI_DMA_ERROR", 8u);
+    check(csAtCallback == 1u, "slave select high after the error", 8u);
+
+    //SPI1 IS STILL USABLE AFTERWARDS
+    checkBurst(8u, 1u, 1u, frameUs);
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,431 @@
+/*****************************************************************
+ filtercheck
+
+    Checks that the SIMD versions of the filters in Filter.c give
+    exactly the same output as the plain C ones, then times both.
+
+    Filter.c is built with FILTER_USE_SIMD set, so runFir,
+    runBiquad and runFusion run the packed code with the DSP
+    instructions modelled in C, and are compared sample by sample
+    with runFirScalar, runBiquadScalar and runFusionScalar:
+      fir       every length from 1 to FIR_MAX_TAPS, random and
+                full scale coefficients, random and full scale input
+      biquad    a Butterworth low-pass cascade, then random sections
+                including unstable ones that saturate
+      fusion    a tilting, noisy MPU9250 with a gyro bias
+    Both versions wrap and saturate the same way, so they have to
+    agree even where the filter itself has overflowed.
+
+    It also checks the angles atan2Filter and the fusion give.
+
+    The timings are host timings. The modelled instructions are
+    slower than the real ones, so for the Cortex-M4 it shows the
+    instructions each version needs per sample instead. Time them on
+    the target with PROFILE_BEGIN and PROFILE_END.
+
+    Build:  cc -O2 -DFILTER_USE_SIMD=1 -I.. -o filtercheck filtercheck.c ../Filter.c -lm
+    Usage:  filtercheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "Filter.h"
+
+#if !FILTER_USE_SIMD
+#error "build with -DFILTER_USE_SIMD=1 so there are two versions to compare"
+#endif
+
+#define SAMPLES             4096u
+#define CHANNELS            7u
+#define PI                  3.14159265358979323846
+
+static unsigned failed = 0;
+
+static int16_t randomSample(void)
+{
+    //ONE IN 8 AT FULL SCALE TO HIT THE SATURATION
+    switch(rand() & 7)
+    {
+        case 0:
+            return 32767;
+        case 1:
+            return -32768;
+        default:
+            return (int16_t)((rand() & 0xFFFF) - 32768);
+    }
+}
+
+static void fill(int16_t *data, size_t count)
+{
+    size_t i;
+
+    for(i = 0; i < count; i++)
+    {
+        data[i] = randomSample();
+    }
+}
+
+static void compare(const char *what, const int16_t *simd, const int16_t *scalar, size_t count)
+{
+    size_t i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(simd[i] != scalar[i])
+        {
+            printf("  %s: sample %lu is %d, plain C gives %d\n", what, (unsigned long)i, simd[i], scalar[i]);
+            failed++;
+            return;
+        }
+    }
+}
+
+
+/**********************************************************************************/
+/**************************************Checks**************************************/
+/**********************************************************************************/
+
+
+static int16_t input[SAMPLES * CHANNELS];
+static int16_t outSimd[SAMPLES * CHANNELS];
+static int16_t outScalar[SAMPLES * CHANNELS];
+
+static void checkFir(void)
+{
+    int16_t coeffs[FIR_MAX_TAPS];
+    Fir simd;
+    Fir scalar;
+    size_t taps;
+    size_t i;
+    int round;
+
+    for(round = 0; round < 2; round++)
+    {
+        for(taps = 1; taps <= FIR_MAX_TAPS; taps++)
+        {
+            //A PROPER LOW-PASS (SUM OF |h| BELOW 1), THEN FULL SCALE
+            for(i = 0; i < taps; i++)
+            {
+                coeffs[i] = round ? randomSample() : (int16_t)(32767 / (int)taps);
+            }
+
+            initFir(&simd, coeffs, taps);
+            initFir(&scalar, coeffs, taps);
+            fill(input, SAMPLES);
+
+            //IN TWO PIECES SO THE DELAY LINE CARRIES OVER
+            runFir(&simd, input, outSimd, SAMPLES / 2u, 1);
+            runFir(&simd, input + (SAMPLES / 2u), outSimd + (SAMPLES / 2u), SAMPLES / 2u, 1);
+            runFirScalar(&scalar, input, outScalar, SAMPLES, 1);
+
+            compare("fir", outSimd, outScalar, SAMPLES);
+        }
+    }
+
+    //ONE CHANNEL OF INTERLEAVED FRAMES, IN PLACE
+    fill(input, SAMPLES * CHANNELS);
+    memcpy(outSimd, input, sizeof(input));
+    memcpy(outScalar, input, sizeof(input));
+    initFir(&simd, coeffs, 31);
+    initFir(&scalar, coeffs, 31);
+    runFir(&simd, outSimd + 4, outSimd + 4, SAMPLES, CHANNELS);
+    runFirScalar(&scalar, outScalar + 4, outScalar + 4, SAMPLES, CHANNELS);
+    compare("fir stride", outSimd, outScalar, SAMPLES * CHANNELS);
+}
+
+/*****************************************************************
+ butterworth
+
+    Q14 coefficients of a second order Butterworth low-pass with
+    its corner at 'fraction' of the sample rate
+*****************************************************************/
+static void butterworth(int16_t *c, double fraction)
+{
+    double k = tan(PI * fraction);
+    double norm = 1.0 / (1.0 + (sqrt(2.0) * k) + (k * k));
+    double b0 = k * k * norm;
+
+    c[0] = Q14(b0);
+    c[1] = Q14(2.0 * b0);
+    c[2] = Q14(b0);
+    c[3] = Q14(2.0 * ((k * k) - 1.0) * norm);
+    c[4] = Q14((1.0 - (sqrt(2.0) * k) + (k * k)) * norm);
+}
+
+static void checkBiquad(void)
+{
+    int16_t coeffs[5u * BIQUAD_MAX_SECTIONS];
+    Biquad simd;
+    Biquad scalar;
+    size_t i;
+    int round;
+
+    butterworth(&coeffs[0], 0.05);
+    butterworth(&coeffs[5], 0.05);
+
+    for(round = 0; round < 200; round++)
+    {
+        uint8_t sections = (uint8_t)((round == 0) ? 2u : (1u + (rand() % BIQUAD_MAX_SECTIONS)));
+
+        if(round > 0)
+        {
+            for(i = 0; i < (5u * sections); i++)
+            {
+                do
+                {
+                    coeffs[i] = randomSample();
+                } while(coeffs[i] == -32768);
+            }
+        }
+
+        initBiquad(&simd, coeffs, sections);
+        initBiquad(&scalar, coeffs, sections);
+        fill(input, SAMPLES);
+
+        runBiquad(&simd, input, outSimd, SAMPLES, 1);
+        runBiquadScalar(&scalar, input, outScalar, SAMPLES, 1);
+
+        compare("biquad", outSimd, outScalar, SAMPLES);
+    }
+}
+
+static void checkAtan2(void)
+{
+    double worst = 0;
+    int i;
+
+    for(i = 0; i < 3600; i++)
+    {
+        double angle = (i - 1800) * PI / 1800.0;
+        int32_t x = (int32_t)lrint(30000.0 * cos(angle));
+        int32_t y = (int32_t)lrint(30000.0 * sin(angle));
+        double error = (atan2Filter(y, x) * 180.0 / 32768.0) - (atan2((double)y, (double)x) * 180.0 / PI);
+
+        //THE SAME ANGLE A TURN APART
+        if(error > 180.0)
+        {
+            error -= 360.0;
+        }
+        else if(error < -180.0)
+        {
+            error += 360.0;
+        }
+
+        if(fabs(error) > worst)
+        {
+            worst = fabs(error);
+        }
+    }
+
+    printf("  atan2Filter worst error %.3f degrees\n", worst);
+
+    if(worst > 0.3)
+    {
+        failed++;
+    }
+}
+
+/*****************************************************************
+ imuFrame
+
+    One MPU9250 frame at +-2g and +-250dps for the board at 'roll'
+    and 'pitch' degrees, turning at 'rollRate' and 'pitchRate'
+    degrees per second, with noise and a gyro bias
+*****************************************************************/
+static void imuFrame(int16_t *frame, double roll, double pitch, double rollRate, double pitchRate)
+{
+    double r = roll * PI / 180.0;
+    double p = pitch * PI / 180.0;
+
+    frame[0] = (int16_t)lrint((-16384.0 * sin(p)) + ((rand() % 401) - 200));
+    frame[1] = (int16_t)lrint((16384.0 * cos(p) * sin(r)) + ((rand() % 401) - 200));
+    frame[2] = (int16_t)lrint((16384.0 * cos(p) * cos(r)) + ((rand() % 401) - 200));
+    frame[3] = 0;
+    frame[4] = (int16_t)lrint((131.0 * rollRate) + 40 + ((rand() % 21) - 10));
+    frame[5] = (int16_t)lrint((131.0 * pitchRate) - 25 + ((rand() % 21) - 10));
+    frame[6] = 0;
+}
+
+static void checkFusion(void)
+{
+    const unsigned hz = 1000u;
+    Fusion simd;
+    Fusion scalar;
+    int16_t frame[CHANNELS];
+    double roll = 10.0;
+    double pitch = -20.0;
+    double worst = 0;
+    unsigned i;
+
+    initFusion(&simd, FUSION_GYRO_GAIN(1310u, hz), 8);
+    initFusion(&scalar, FUSION_GYRO_GAIN(1310u, hz), 8);
+    setFusionGyroBias(&simd, 40, -25);
+    setFusionGyroBias(&scalar, 40, -25);
+
+    //5 SECONDS OF ROLLING AT 30 DEGREES PER SECOND AND PITCHING BACK
+    //AND FORTH, THROUGH THE +-180 DEGREE ROLL WRAP
+    for(i = 0; i < (5u * hz); i++)
+    {
+        double pitchRate = 40.0 * cos(i * 2.0 * PI / hz);
+        double error;
+
+        imuFrame(frame, roll, pitch, 30.0, pitchRate);
+        runFusion(&simd, frame);
+        runFusionScalar(&scalar, frame);
+
+        if((simd.roll != scalar.roll) || (simd.pitch != scalar.pitch))
+        {
+            printf("  fusion: frame %u differs\n", i);
+            failed++;
+            return;
+        }
+
+        roll += 30.0 / hz;
+        pitch += pitchRate / hz;
+
+        if(roll > 180.0)
+        {
+            roll -= 360.0;
+        }
+
+        //AFTER A SECOND TO SETTLE
+        if(i >= hz)
+        {
+            error = fabs(remainder((getFusionRoll(&simd) * 180.0 / 32768.0) - roll, 360.0));
+            worst = (error > worst) ? error : worst;
+            error = fabs((getFusionPitch(&simd) * 180.0 / 32768.0) - pitch);
+            worst = (error > worst) ? error : worst;
+        }
+    }
+
+    printf("  fusion worst error while moving %.2f degrees\n", worst);
+
+    if(worst > 2.0)
+    {
+        failed++;
+    }
+}
+
+
+/**********************************************************************************/
+/*************************************Timing***************************************/
+/**********************************************************************************/
+
+
+static double elapsedNs(const struct timespec *start, const struct timespec *stop)
+{
+    return ((stop->tv_sec - start->tv_sec) * 1e9) + (stop->tv_nsec - start->tv_nsec);
+}
+
+typedef void (*Runner)(void *filter, const int16_t *in, int16_t *out, size_t count, size_t stride);
+
+static void firSimd(void *f, const int16_t *in, int16_t *out, size_t n, size_t s) { runFir(f, in, out, n, s); }
+static void firScalar(void *f, const int16_t *in, int16_t *out, size_t n, size_t s) { runFirScalar(f, in, out, n, s); }
+static void biquadSimd(void *f, const int16_t *in, int16_t *out, size_t n, size_t s) { runBiquad(f, in, out, n, s); }
+static void biquadScalar(void *f, const int16_t *in, int16_t *out, size_t n, size_t s) { runBiquadScalar(f, in, out, n, s); }
+
+static double timeRunner(Runner run, void *filter)
+{
+    const unsigned passes = 500u;
+    struct timespec start;
+    struct timespec stop;
+    unsigned i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i = 0; i < passes; i++)
+    {
+        run(filter, input, outSimd, SAMPLES, 1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    return elapsedNs(&start, &stop) / ((double)passes * SAMPLES);
+}
+
+static double timeFusion(void (*run)(Fusion *, const int16_t *))
+{
+    const unsigned passes = 200u;
+    struct timespec start;
+    struct timespec stop;
+    Fusion fusion;
+    unsigned i;
+    size_t f;
+
+    initFusion(&fusion, FUSION_GYRO_GAIN(1310u, 1000u), 8);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i = 0; i < passes; i++)
+    {
+        for(f = 0; f < SAMPLES; f++)
+        {
+            run(&fusion, &input[f * CHANNELS]);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    return elapsedNs(&start, &stop) / ((double)passes * SAMPLES);
+}
+
+static void benchmark(void)
+{
+    int16_t coeffs[32];
+    Fir fir;
+    Biquad biquad;
+    size_t i;
+
+    for(i = 0; i < 32u; i++)
+    {
+        coeffs[i] = (int16_t)(32767 / 32);
+    }
+
+    initFir(&fir, coeffs, 32);
+    butterworth(&coeffs[0], 0.05);
+    butterworth(&coeffs[5], 0.1);
+    initBiquad(&biquad, coeffs, 2);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        input[i] = (int16_t)((rand() % 2001) - 1000);
+    }
+
+    for(i = 0; i < (SAMPLES * CHANNELS); i++)
+    {
+        input[i] = (int16_t)((rand() % 20001) - 10000);
+    }
+
+    printf("host ns per sample          plain C   SIMD (modelled)\n");
+    printf("  fir 32 taps               %7.1f   %7.1f\n", timeRunner(firScalar, &fir), timeRunner(firSimd, &fir));
+    printf("  biquad 2 sections         %7.1f   %7.1f\n", timeRunner(biquadScalar, &biquad), timeRunner(biquadSimd, &biquad));
+    printf("  fusion, per frame         %7.1f   %7.1f\n", timeFusion(runFusionScalar), timeFusion(runFusion));
+
+    printf("Cortex-M4 instructions per sample in the inner loop\n");
+    printf("                            plain C   SIMD\n");
+    printf("  fir 32 taps, multiplies   %7u   %7u  (MLA / SMLAD)\n", 32u, 16u);
+    printf("  fir 32 taps, loads        %7u   %7u  (LDRSH / LDR)\n", 64u, 32u);
+    printf("  biquad, per section       %7u   %7u  (MLA / MUL + 2 SMLAD)\n", 5u, 3u);
+    printf("  fusion, norm and bias     %7u   %7u  (2 MLA + 2 SUB + 2 SSAT / SMUAD + QSUB16)\n", 6u, 2u);
+}
+
+int main(void)
+{
+    srand(1);
+
+    printf("bit exactness\n");
+    checkFir();
+    checkBiquad();
+    checkFusion();
+    checkAtan2();
+
+    printf("%s\n\n", failed ? "FAILED" : "SIMD and plain C agree");
+
+    benchmark();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,288 @@
+/*****************************************************************
+ gpiocheck
+
+    Checks the BSRR output macros in GPIO.h and compares them with
+    the ODR read-modify-write sequences they replace.
+
+    1. Encoding. For random pin masks and values, the BSRR word each
+       macro builds is applied to a model of the port the way the
+       hardware does (low half sets, high half clears, set wins) and
+       the result is compared with the pins the caller asked for.
+
+    2. Bus accesses and interrupts. Each way of changing a pin is
+       written out as the loads and stores the core makes to the
+       port. An "interrupt" that drives a different pin on the same
+       port is slipped in between every pair of accesses, and any
+       change of its that is lost is counted.
+
+    Build:  cc -O2 -I.. -o gpiocheck gpiocheck.c
+    Usage:  gpiocheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "GPIO.h"
+
+//THE OUTPUT REGISTERS OF ONE PORT. THE MACROS ONLY STORE TO BSRR
+//AND BRR AND LOAD FROM ODR, applyPort THEN DOES WHAT THE HARDWARE
+//WOULD WITH THE STORES
+typedef struct
+{
+    uint32_t ODR;
+    uint32_t BSRR;
+    uint32_t BRR;
+} Port;
+
+static void applyPort(Port *port)
+{
+    port->ODR &= ~(port->BSRR >> 16);
+    port->ODR |= (port->BSRR & 0xFFFFu);
+    port->ODR &= ~(port->BRR & 0xFFFFu);
+    port->ODR &= 0xFFFFu;
+    port->BSRR = 0;
+    port->BRR = 0;
+}
+
+static unsigned failed = 0;
+
+static void expect(const char *what, uint32_t got, uint32_t want)
+{
+    if(got != want)
+    {
+        printf("FAIL %s: got %04lX want %04lX\n", what, (unsigned long)got, (unsigned long)want);
+        failed++;
+    }
+}
+
+static void checkEncoding(void)
+{
+    Port port;
+    uint32_t n;
+
+    expect("BSRR_SET", GPIO_BSRR_SET(0x8001u), 0x00008001u);
+    expect("BSRR_RESET", GPIO_BSRR_RESET(0x8001u), 0x80010000u);
+    expect("BSRR_WRITE", GPIO_BSRR_WRITE(0x00F0u, 0x0050u), 0x00A00050u);
+    expect("BSRR_BUS", GPIO_BSRR_BUS(4u, 8u, 0xA5u), 0x05A00A50u);
+
+    for(n = 0; n < 100000u; n++)
+    {
+        uint32_t start = (uint32_t)rand() & 0xFFFFu;
+        uint32_t pins = (uint32_t)rand() & 0xFFFFu;
+        uint32_t value = (uint32_t)rand();
+        uint32_t pin = (uint32_t)rand() & 15u;
+        uint32_t first = (uint32_t)rand() & 15u;
+        uint32_t width = 1u + ((uint32_t)rand() % (16u - first));
+        uint32_t busMask = ((1u << width) - 1u) << first;
+
+        port.ODR = start;
+        GPIO_WRITE_PINS(&port, pins, value);
+        applyPort(&port);
+        expect("WRITE_PINS", port.ODR, (start & ~pins) | (value & pins));
+
+        port.ODR = start;
+        GPIO_WRITE_BUS(&port, first, width, value);
+        applyPort(&port);
+        expect("WRITE_BUS", port.ODR, (start & ~busMask) | ((value << first) & busMask));
+
+        port.ODR = start;
+        GPIO_TOGGLE_PINS(&port, pins);
+        applyPort(&port);
+        expect("TOGGLE_PINS", port.ODR, start ^ pins);
+
+        port.ODR = start;
+        GPIO_PIN_HIGH(&port, pin);
+        applyPort(&port);
+        expect("PIN_HIGH", port.ODR, start | (1u << pin));
+
+        port.ODR = start;
+        GPIO_PIN_LOW(&port, pin);
+        applyPort(&port);
+        expect("PIN_LOW", port.ODR, start & ~(1u << pin));
+
+        port.ODR = start;
+        GPIO_PINS_HIGH(&port, pins);
+        applyPort(&port);
+        expect("PINS_HIGH", port.ODR, start | pins);
+
+        port.ODR = start;
+        GPIO_PINS_LOW(&port, pins);
+        applyPort(&port);
+        expect("PINS_LOW", port.ODR, start & ~pins);
+    }
+}
+
+
+/*****************************************************************
+ Each sequence is the list of port accesses one C statement makes
+ on the Cortex-M4, as steps. 'step' is called with 0, 1, ... until
+ it returns 0. 'pins' is what the statement changes, 'scratch'
+ stands in for the core register holding the value loaded.
+*****************************************************************/
+
+typedef uint8_t (*Sequence)(Port *port, uint32_t step, uint32_t pins, uint32_t *scratch);
+
+//ODR |= pins         LDR ODR, ORR, STR ODR
+static uint8_t odrSet(Port *port, uint32_t step, uint32_t pins, uint32_t *scratch)
+{
+    if(step == 0u)
+    {
+        *scratch = port->ODR;
+        return 1;
+    }
+
+    port->ODR = *scratch | pins;
+    return 0;
+}
+
+//ODR ^= pins         LDR ODR, EOR, STR ODR
+static uint8_t odrToggle(Port *port, uint32_t step, uint32_t pins, uint32_t *scratch)
+{
+    if(step == 0u)
+    {
+        *scratch = port->ODR;
+        return 1;
+    }
+
+    port->ODR = *scratch ^ pins;
+    return 0;
+}
+
+//ODR = (ODR & ~mask) | value, A 4-BIT BUS ON PINS 4 TO 7
+static uint8_t odrBus(Port *port, uint32_t step, uint32_t pins, uint32_t *scratch)
+{
+    if(step == 0u)
+    {
+        *scratch = port->ODR;
+        return 1;
+    }
+
+    port->ODR = (*scratch & ~0x00F0u) | (pins & 0x00F0u);
+    return 0;
+}
+
+//GPIO_PINS_HIGH      STR BSRR
+static uint8_t bsrrSet(Port *port, uint32_t step, uint32_t pins, uint32_t *scratch)
+{
+    (void)step;
+    (void)scratch;
+
+    GPIO_PINS_HIGH(port, pins);
+    applyPort(port);
+    return 0;
+}
+
+//GPIO_TOGGLE_PINS    LDR ODR, STR BSRR
+static uint8_t bsrrToggle(Port *port, uint32_t step, uint32_t pins, uint32_t *scratch)
+{
+    if(step == 0u)
+    {
+        *scratch = port->ODR;
+        return 1;
+    }
+
+    port->BSRR = GPIO_BSRR_WRITE(pins, ~*scratch);
+    applyPort(port);
+    return 0;
+}
+
+//GPIO_WRITE_BUS      STR BSRR
+static uint8_t bsrrBus(Port *port, uint32_t step, uint32_t pins, uint32_t *scratch)
+{
+    (void)step;
+    (void)scratch;
+
+    GPIO_WRITE_BUS(port, 4u, 4u, pins >> 4);
+    applyPort(port);
+    return 0;
+}
+
+/*****************************************************************
+ runSequence
+
+    Runs 'sequence' on pins 4 to 7 with an interrupt toggling pin 0
+    before step 'interruptAt'.
+
+    Returns the number of port accesses, and sets 'lost' if the
+    interrupt's change to pin 0 didn't survive
+*****************************************************************/
+static uint32_t runSequence(Sequence sequence, uint32_t interruptAt, uint8_t *lost)
+{
+    Port port = { 0x0001u, 0, 0 };
+    uint32_t scratch = 0;
+    uint32_t step = 0;
+    uint32_t isrPin0 = 0;
+    uint8_t more = 1;
+
+    while(more)
+    {
+        if(step == interruptAt)
+        {
+            //THE INTERRUPT USES BSRR, SO ONLY THE MAIN LINE CAN LOSE IT
+            port.BSRR = GPIO_BSRR_WRITE(1u, ~port.ODR);
+            applyPort(&port);
+            isrPin0 = port.ODR & 1u;
+        }
+
+        more = sequence(&port, step, 0x00A0u, &scratch);
+        step++;
+    }
+
+    *lost = (interruptAt < step) && ((port.ODR & 1u) != isrPin0);
+
+    return step;
+}
+
+static void checkRaces(void)
+{
+    static const struct
+    {
+        const char *name;
+        Sequence sequence;
+        uint8_t atomic;
+    } sequences[] =
+    {
+        { "ODR |= pins",          odrSet,     0 },
+        { "GPIO_PINS_HIGH",       bsrrSet,    1 },
+        { "ODR ^= pins",          odrToggle,  0 },
+        { "GPIO_TOGGLE_PINS",     bsrrToggle, 1 },
+        { "ODR 4-bit bus RMW",    odrBus,     0 },
+        { "GPIO_WRITE_BUS",       bsrrBus,    1 },
+    };
+    size_t i;
+
+    printf("\n%-20s  accesses  interrupt points that lose a change\n", "sequence");
+
+    for(i = 0; i < (sizeof(sequences) / sizeof(sequences[0])); i++)
+    {
+        uint8_t lost;
+        uint32_t accesses = runSequence(sequences[i].sequence, 0xFFFFFFFFu, &lost);
+        uint32_t losses = 0;
+        uint32_t at;
+
+        for(at = 0; at < accesses; at++)
+        {
+            runSequence(sequences[i].sequence, at, &lost);
+            losses += lost;
+        }
+
+        printf("%-20s  %8lu  %lu of %lu\n", sequences[i].name, (unsigned long)accesses,
+               (unsigned long)losses, (unsigned long)accesses);
+
+        if(sequences[i].atomic && losses)
+        {
+            printf("FAIL %s lost an interrupt's change\n", sequences[i].name);
+            failed++;
+        }
+    }
+}
+
+int main(void)
+{
+    checkEncoding();
+    checkRaces();
+
+    printf("%s\n", failed ? "FAILED" : "all checks ok");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,537 @@
+/*****************************************************************
+ mpucheck
+
+    Checks MPU9250.c against a fake MPU9250 on SPI1 in host/sim/,
+    through SPIBus.c and the DMA, exactly as it runs on the STM32.
+
+    The fake has the register file, the SPI protocol (address byte
+    with the read bit, auto-increment except on FIFO_R_W) and a
+    512 byte FIFO that takes a 14 byte sample at 1kHz / (1 +
+    SMPLRT_DIV) in simulated time. When the FIFO is full the oldest
+    bytes are written over and INT_STATUS bit 4 is set, cleared by
+    reading INT_STATUS. Sample n holds a known pattern with negative
+    and positive values, so every decoded field can be checked.
+
+      init      the wrong WHO_AM_I is reported, then the right one,
+                and the wake and I2C disable writes reach the chip
+      regs      bursts longer than the buffers are refused
+      sample    readSampleMpu9250 puts each register in its field
+      fifo      readFifoMpu9250 gets every sample in order, a few
+                at a time or all at once, none twice or missed
+      overflow  an overflowed FIFO is reset and counted, not
+                decoded, and the samples after it are right
+      acquire   startAcquireMpu9250 stores frames in the same
+                channel order as the Mpu9250Sample fields, in
+                blocks from a Pool. Every other block is taken out
+                of the pipeline and freed a pass later, as a
+                consumer handing it on would, and every block is
+                back in the pool once acquisition stops
+    Every frame must be 8 bits with slave select low, and the bus
+    must be in SPI mode 3.
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o mpucheck mpucheck.c ../../host/sim/sim.c ../MPU9250.c ../SPIBus.c ../SPI.c ../Timer.c ../Acquire.c ../Pool.c ../Clock.c
+    Usage:  mpucheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Board.h"
+#include "Clock.h"
+#include "Timer.h"
+#include "SPIBus.h"
+#include "MPU9250.h"
+#include "Acquire.h"
+
+#define BLOCK_FRAMES    8u
+#define POOL_BLOCKS     3u
+
+POOL_DEFINE(blockPool, BLOCK_FRAMES * MPU9250_CHANNELS * sizeof(int16_t), POOL_BLOCKS);
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+
+/**********************************************************************************/
+/**********************************Fake MPU9250***********************************/
+/**********************************************************************************/
+
+
+static uint8_t regs[128];
+
+//BYTES IN THE FIFO, OLDEST AT fifoTail
+static uint8_t fifo[MPU9250_FIFO_BYTES];
+static uint32_t fifoTail = 0;
+static uint32_t fifoCount = 0;
+
+//NEXT SAMPLE THE FIFO TAKES
+static uint64_t fifoNext = 0;
+
+//POSITION IN THE CURRENT BURST
+static uint32_t burstByte = 0;
+static uint8_t burstAddr = 0;
+static uint8_t burstRead = 0;
+
+//SAMPLE IN THE DATA REGISTERS, HELD FOR THE WHOLE BURST
+static uint64_t burstSample = 0;
+
+static uint32_t bursts = 0;
+static uint32_t badFrames = 0;
+
+ /*****************************************************************
+ sampleByte
+
+    Byte 'i' (0 to 13) of sample 'n' as the registers hold it, high
+    byte first
+*****************************************************************/
+static uint8_t sampleByte(uint64_t n, uint32_t i)
+{
+    uint16_t value = (uint16_t)(((uint32_t)n * 101u) + ((i / 2u) * 4099u) - 16000u);
+
+    return (i & 1u) ? (uint8_t)value : (uint8_t)(value >> 8);
+}
+
+static int16_t sampleValue(uint64_t n, uint32_t channel)
+{
+    return (int16_t)(((uint16_t)sampleByte(n, 2u * channel) << 8) | sampleByte(n, (2u * channel) + 1u));
+}
+
+//SAMPLE PERIOD FROM SMPLRT_DIV
+static uint64_t samplePs(void)
+{
+    return (SIM_PS_PER_S / 1000u) * (1u + regs[MPU9250_SMPLRT_DIV]);
+}
+
+//INDEX OF THE NEWEST SAMPLE
+static uint64_t sampleNow(void)
+{
+    return simTimePs() / samplePs();
+}
+
+static uint8_t fifoRunning(void)
+{
+    return (regs[MPU9250_USER_CTRL] & (1u << 6)) && (regs[MPU9250_FIFO_EN] == MPU9250_FIFO_SAMPLE_EN);
+}
+
+ /*****************************************************************
+ fillFifo
+
+    Adds every sample that has come due since the last call. A full
+    FIFO writes over its oldest bytes and flags the overflow
+*****************************************************************/
+static void fillFifo(void)
+{
+    uint64_t newest = sampleNow();
+    uint32_t i;
+
+    if(!fifoRunning())
+    {
+        fifoNext = newest + 1u;
+        return;
+    }
+
+    for(; fifoNext <= newest; fifoNext++)
+    {
+        for(i = 0; i < MPU9250_SAMPLE_BYTES; i++)
+        {
+            if(fifoCount == MPU9250_FIFO_BYTES)
+            {
+                fifoTail = (fifoTail + 1u) % MPU9250_FIFO_BYTES;
+                fifoCount--;
+                regs[MPU9250_INT_STATUS] |= MPU9250_INT_FIFO_OVERFLOW;
+            }
+
+            fifo[(fifoTail + fifoCount) % MPU9250_FIFO_BYTES] = sampleByte(fifoNext, i);
+            fifoCount++;
+        }
+    }
+}
+
+static uint8_t readReg(uint8_t reg)
+{
+    uint8_t value;
+
+    if((reg >= MPU9250_ACCEL_XOUT_H) && (reg < (MPU9250_ACCEL_XOUT_H + MPU9250_SAMPLE_BYTES)))
+    {
+        return sampleByte(burstSample, reg - MPU9250_ACCEL_XOUT_H);
+    }
+
+    switch(reg)
+    {
+        case MPU9250_INT_STATUS:
+            value = regs[reg];
+            regs[reg] = 0;
+            return value;
+
+        case MPU9250_FIFO_COUNTH:
+            return (uint8_t)(fifoCount >> 8);
+
+        case MPU9250_FIFO_COUNTH + 1u:
+            return (uint8_t)fifoCount;
+
+        case MPU9250_FIFO_R_W:
+            if(fifoCount == 0u)
+            {
+                return 0xFFu;
+            }
+            value = fifo[fifoTail];
+            fifoTail = (fifoTail + 1u) % MPU9250_FIFO_BYTES;
+            fifoCount--;
+            return value;
+
+        default:
+            return regs[reg];
+    }
+}
+
+static void writeReg(uint8_t reg, uint8_t value)
+{
+    if((reg == MPU9250_WHO_AM_I) || (reg == MPU9250_INT_STATUS))
+    {
+        return;
+    }
+
+    if((reg == MPU9250_USER_CTRL) && (value & (1u << 2)))
+    {
+        fifoTail = 0;
+        fifoCount = 0;
+        value &= (uint8_t)~(1u << 2);
+    }
+
+    regs[reg] = value;
+}
+
+ /*****************************************************************
+ onSlaveSelect
+
+    A falling edge starts a burst. The FIFO catches up first and the
+    newest sample is latched, so a burst sees the samples due when
+    it starts and never half of one and half of the next
+*****************************************************************/
+static void onSlaveSelect(void *ctx, uint8_t level)
+{
+    (void)ctx;
+
+    if(level == 0u)
+    {
+        fillFifo();
+        burstSample = sampleNow();
+        burstByte = 0;
+        bursts++;
+    }
+}
+
+static uint16_t mpuSlave(void *ctx, uint16_t mosi, uint8_t bits)
+{
+    uint16_t miso = 0xFFu;
+
+    (void)ctx;
+
+    //8-BIT FRAMES, SELECTED
+    if((bits != 8u) || simGetPin(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN))
+    {
+        badFrames++;
+        return miso;
+    }
+
+    if(burstByte == 0u)
+    {
+        burstAddr = (uint8_t)(mosi & 0x7Fu);
+        burstRead = (uint8_t)((mosi & MPU9250_READ) != 0u);
+    }
+    else
+    {
+        if(burstRead)
+        {
+            miso = readReg(burstAddr);
+        }
+        else
+        {
+            writeReg(burstAddr, (uint8_t)mosi);
+        }
+
+        if(burstAddr != MPU9250_FIFO_R_W)
+        {
+            burstAddr = (burstAddr + 1u) & 0x7Fu;
+        }
+    }
+
+    burstByte++;
+
+    return miso;
+}
+
+
+/**********************************************************************************/
+/**************************************Checks**************************************/
+/**********************************************************************************/
+
+
+static uint8_t sameSample(const Mpu9250Sample *sample, uint64_t n)
+{
+    return (sample->accelX == sampleValue(n, 0))
+        && (sample->accelY == sampleValue(n, 1))
+        && (sample->accelZ == sampleValue(n, 2))
+        && (sample->temp   == sampleValue(n, 3))
+        && (sample->gyroX  == sampleValue(n, 4))
+        && (sample->gyroY  == sampleValue(n, 5))
+        && (sample->gyroZ  == sampleValue(n, 6));
+}
+
+ /*****************************************************************
+ sampleIndex
+
+    Works out which sample a decoded one is from accelX, which
+    steps by 101 a sample
+
+    Returns
+    1 with the index in 'n' if every field matches that sample
+*****************************************************************/
+static uint8_t sampleIndex(const Mpu9250Sample *sample, uint64_t near, uint64_t *n)
+{
+    uint64_t i;
+
+    for(i = (near > 700u) ? (near - 700u) : 0u; i <= (near + 1u); i++)
+    {
+        if(sameSample(sample, i))
+        {
+            *n = i;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void checkInit(void)
+{
+    regs[MPU9250_WHO_AM_I] = 0x70u;
+    check(initMpu9250() == 0u, "wrong WHO_AM_I reported");
+
+    regs[MPU9250_WHO_AM_I] = MPU9250_ID;
+    check(initMpu9250() == 1u, "right WHO_AM_I reported");
+
+    check(regs[MPU9250_PWR_MGMT_1] == 0x01u, "woken with the best clock source");
+    check(regs[MPU9250_USER_CTRL] == (1u << 4), "I2C interface disabled");
+
+    //THE BUS LEAVES THE LAST DEVICE'S SETTINGS IN CR1
+    check((SPI1->CR1 & 3u) == 3u, "SPI mode 3 (CPOL and CPHA set)");
+}
+
+static void checkRegs(void)
+{
+    static uint8_t data[MPU9250_FIFO_BYTES + 1u];
+    uint32_t before = bursts;
+
+    check(readRegsMpu9250(MPU9250_WHO_AM_I, data, sizeof(data)) == 0u, "burst longer than the buffers refused");
+    check(bursts == before, "nothing sent for a refused burst");
+
+    check((readRegsMpu9250(MPU9250_WHO_AM_I, data, 1u) == 1u) && (data[0] == MPU9250_ID), "one register read");
+}
+
+static void checkSample(void)
+{
+    Mpu9250Sample sample;
+    uint64_t n;
+
+    simRunUs(3500u);
+    n = sampleNow();
+    readSampleMpu9250(&sample);
+
+    check(sameSample(&sample, n), "readSampleMpu9250 puts every register in its field");
+    check((sample.accelX < 0) && (sample.gyroZ > 0), "negative and positive values decoded");
+}
+
+static void checkFifo(void)
+{
+    static Mpu9250Sample samples[MPU9250_FIFO_SAMPLES];
+    uint64_t expect = 0;
+    uint64_t n = 0;
+    uint32_t got = 0;
+    uint32_t pass;
+    size_t count;
+    size_t i;
+    uint8_t ok = 1;
+
+    //100HZ, 10MS A SAMPLE
+    enableFifoMpu9250(9u);
+    check(regs[MPU9250_FIFO_EN] == MPU9250_FIFO_SAMPLE_EN, "FIFO takes accel, temp and gyro");
+    check(fifoCount == 0u, "FIFO reset");
+
+    //3 AT A TIME THEN ALL OF THEM, ALTERNATELY
+    for(pass = 0; pass < 40u; pass++)
+    {
+        simRunUs(25000u);
+
+        count = readFifoMpu9250(samples, (pass & 1u) ? MPU9250_FIFO_SAMPLES : 3u);
+
+        for(i = 0; i < count; i++)
+        {
+            if(got == 0u)
+            {
+                ok &= sampleIndex(&samples[i], sampleNow(), &n);
+                expect = n;
+            }
+
+            ok &= sameSample(&samples[i], expect);
+            expect++;
+            got++;
+        }
+    }
+
+    check(ok, "FIFO samples decoded in order, none missed or twice");
+    check(got > 90u, "FIFO samples read");
+    check(fifoOverflowsMpu9250() == 0u, "no overflows reading often enough");
+}
+
+static void checkOverflow(void)
+{
+    static Mpu9250Sample samples[MPU9250_FIFO_SAMPLES];
+    uint32_t overflows = fifoOverflowsMpu9250();
+    uint64_t n = 0;
+    size_t count;
+    size_t i;
+    uint8_t ok = 1;
+
+    readFifoMpu9250(samples, MPU9250_FIFO_SAMPLES);
+
+    //36 SAMPLES FILL 504 BYTES, 1 MORE WRITES OVER THE FIRST
+    simRunUs(500000u);
+    check(readFifoMpu9250(samples, MPU9250_FIFO_SAMPLES) == 0u, "nothing decoded from an overflowed FIFO");
+    check(fifoOverflowsMpu9250() - overflows == 1u, "overflow counted");
+    check(fifoCount == 0u, "FIFO reset after the overflow");
+    check(fifoRunning(), "FIFO running again after the overflow");
+
+    simRunUs(105000u);
+    count = readFifoMpu9250(samples, MPU9250_FIFO_SAMPLES);
+    check(count >= 10u, "samples collected after the overflow");
+
+    ok &= sampleIndex(&samples[0], sampleNow(), &n);
+    for(i = 0; i < count; i++)
+    {
+        ok &= sameSample(&samples[i], n + i);
+    }
+    check(ok, "samples after the overflow decoded in order");
+    check(fifoOverflowsMpu9250() - overflows == 1u, "no more overflows");
+}
+
+static void checkAcquire(void)
+{
+    static Acquire acquire;
+    Mpu9250Sample sample;
+    const int16_t *block;
+    int16_t *handedOn = 0;
+    uint64_t n = 0;
+    uint64_t last = 0;
+    uint32_t blocks = 0;
+    uint32_t pass;
+    uint32_t i;
+    uint8_t ok = 1;
+
+    initPool(&blockPool);
+    check(!initAcquire(&acquire, &blockPool, BLOCK_FRAMES + 1u, MPU9250_CHANNELS), "blocks bigger than the pool's refused");
+    check(initAcquire(&acquire, &blockPool, BLOCK_FRAMES, MPU9250_CHANNELS) == 1u, "pipeline set up");
+
+    //1KHZ SO EVERY READ IS A NEW SAMPLE
+    writeRegMpu9250(MPU9250_SMPLRT_DIV, 0);
+    check(startAcquireMpu9250(&acquire, MS_TO_TICKS(2)), "acquisition started");
+
+    for(pass = 0; pass < 20u; pass++)
+    {
+        simRunUs(10000u);
+
+        while((block = readAcquire(&acquire)) != 0)
+        {
+            for(i = 0; i < BLOCK_FRAMES; i++)
+            {
+                //A FRAME IS A SAMPLE'S FIELDS IN ORDER
+                sample.accelX = block[(i * MPU9250_CHANNELS) + 0u];
+                sample.accelY = block[(i * MPU9250_CHANNELS) + 1u];
+                sample.accelZ = block[(i * MPU9250_CHANNELS) + 2u];
+                sample.temp   = block[(i * MPU9250_CHANNELS) + 3u];
+                sample.gyroX  = block[(i * MPU9250_CHANNELS) + 4u];
+                sample.gyroY  = block[(i * MPU9250_CHANNELS) + 5u];
+                sample.gyroZ  = block[(i * MPU9250_CHANNELS) + 6u];
+
+                ok &= sampleIndex(&sample, sampleNow(), &n) && (n > last);
+                last = n;
+            }
+
+            //HAND EVERY OTHER BLOCK ON AND FREE IT ON THE NEXT PASS
+            if(blocks & 1u)
+            {
+                check(!handedOn, "one block handed on at a time");
+                handedOn = takeAcquire(&acquire);
+                check(handedOn == block, "takeAcquire gives the block read");
+            }
+            else
+            {
+                releaseAcquire(&acquire);
+            }
+            blocks++;
+        }
+
+        if(handedOn)
+        {
+            check(freePool(&blockPool, handedOn), "handed on block freed");
+            handedOn = 0;
+        }
+    }
+
+    stopAcquireMpu9250();
+    simRunUs(2000u);
+
+    //THE PARTLY FILLED BLOCK IS THE ONLY ONE STILL OUT
+    check(poolAvailable(&blockPool) + 1u == POOL_BLOCKS, "blocks back in the pool");
+
+    check(ok, "acquired frames hold whole samples in field order");
+    //A FRAME EVERY 2MS FOR 200MS
+    check(blocks >= 12u, "acquired blocks delivered");
+}
+
+int main(void)
+{
+    SimStats stats;
+
+    simInit();
+    simSetSpiSlave(mpuSlave, 0);
+    simWatchPin(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN, onSlaveSelect, 0);
+
+    configClock(&clockPll80MHz);
+    initTim2();
+    initSpiBus();
+
+    checkInit();
+    checkRegs();
+    checkSample();
+    checkFifo();
+    checkOverflow();
+    checkAcquire();
+
+    check(badFrames == 0u, "every frame 8 bits with slave select low");
+
+    simGetStats(&stats);
+    printf("%.1f ms simulated, %u bursts, %llu SPI frames, %llu interrupts\n",
+           (double)stats.timePs / 1e9, bursts, (unsigned long long)stats.spiFrames,
+           (unsigned long long)stats.interrupts);
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,336 @@
+/*****************************************************************
+ poolbench
+
+    Stress tests Pool.c with several threads allocating and freeing
+    from one pool at once, then times it against malloc and free.
+
+    The threads stand in for the main loop and interrupts, but run
+    truly in parallel, which is harder on the pool than interrupts
+    on a single core. Each thread fills every block it gets with its
+    own pattern and checks the pattern is still there before
+    freeing it, so a block handed to two owners at once is caught.
+    One pair of threads also passes blocks from a producer to a
+    consumer through a queue without copying them, the way a driver
+    hands a filled DMA buffer on.
+
+    Build:  cc -O2 -pthread -I.. -o poolbench poolbench.c ../Pool.c
+    Usage:  poolbench [operations per thread]
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "Pool.h"
+
+#define BLOCK_SIZE      64u
+#define BLOCK_COUNT     32u
+#define WORKERS         4u
+#define HOLD_MAX        4u          //BLOCKS EACH WORKER HOLDS AT ONCE
+#define QUEUE_SIZE      8u          //POWER OF 2
+
+POOL_DEFINE(testPool, BLOCK_SIZE, BLOCK_COUNT);
+
+static unsigned long operations = 200000ul;
+static volatile uint32_t errors = 0;
+
+//PRODUCER TO CONSUMER QUEUE OF BLOCK POINTERS. FREE-RUNNING INDEXES
+static void *volatile queue[QUEUE_SIZE];
+static volatile uint32_t queueHead = 0;
+static volatile uint32_t queueTail = 0;
+
+
+static void fillBlock(uint32_t *block, uint32_t pattern)
+{
+    uint32_t i;
+
+    for(i = 0; i < (BLOCK_SIZE / 4u); i++)
+    {
+        block[i] = pattern + i;
+    }
+}
+
+static uint8_t checkBlock(const uint32_t *block, uint32_t pattern)
+{
+    uint32_t i;
+
+    for(i = 0; i < (BLOCK_SIZE / 4u); i++)
+    {
+        if(block[i] != (pattern + i))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void countError(void)
+{
+    __atomic_add_fetch(&errors, 1u, __ATOMIC_RELAXED);
+}
+
+/*****************************************************************
+ worker
+
+    Holds up to HOLD_MAX blocks, allocating or freeing one at
+    random each step.
+*****************************************************************/
+static void *worker(void *arg)
+{
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+    uint32_t *held[HOLD_MAX];
+    uint32_t patterns[HOLD_MAX];
+    uint32_t count = 0;
+    uint32_t seed = id * 2654435761u + 1u;
+    unsigned long n;
+
+    for(n = 0; n < operations; n++)
+    {
+        seed = seed * 1103515245u + 12345u;
+
+        if((count < HOLD_MAX) && ((count == 0u) || (seed & 0x10000u)))
+        {
+            uint32_t *block = allocPool(&testPool);
+
+            if(block)
+            {
+                patterns[count] = (id << 24) ^ (uint32_t)n;
+                fillBlock(block, patterns[count]);
+                held[count++] = block;
+            }
+        }
+        else
+        {
+            count--;
+
+            if(!checkBlock(held[count], patterns[count]))
+            {
+                countError();
+            }
+
+            if(!freePool(&testPool, held[count]))
+            {
+                countError();
+            }
+        }
+    }
+
+    while(count)
+    {
+        count--;
+        if(!checkBlock(held[count], patterns[count]) || !freePool(&testPool, held[count]))
+        {
+            countError();
+        }
+    }
+
+    return 0;
+}
+
+/*****************************************************************
+ producer / consumer
+
+    The producer fills blocks and queues them, the consumer checks
+    and frees them. Neither copies the data.
+*****************************************************************/
+static void *producer(void *arg)
+{
+    unsigned long n;
+
+    (void)arg;
+
+    for(n = 0; n < operations; n++)
+    {
+        uint32_t *block;
+
+        while(!(block = allocPool(&testPool)))
+        {
+            sched_yield();
+        }
+
+        fillBlock(block, 0xA5000000u ^ (uint32_t)n);
+
+        while((queueHead - __atomic_load_n(&queueTail, __ATOMIC_ACQUIRE)) >= QUEUE_SIZE)
+        {
+            sched_yield();
+        }
+
+        queue[queueHead & (QUEUE_SIZE - 1u)] = block;
+        __atomic_store_n(&queueHead, queueHead + 1u, __ATOMIC_RELEASE);
+    }
+
+    return 0;
+}
+
+static void *consumer(void *arg)
+{
+    unsigned long n = 0;
+
+    (void)arg;
+
+    while(n < operations)
+    {
+        uint32_t *block;
+
+        if(__atomic_load_n(&queueHead, __ATOMIC_ACQUIRE) == queueTail)
+        {
+            sched_yield();
+            continue;
+        }
+
+        block = queue[queueTail & (QUEUE_SIZE - 1u)];
+        __atomic_store_n(&queueTail, queueTail + 1u, __ATOMIC_RELEASE);
+
+        if(!checkBlock(block, 0xA5000000u ^ (uint32_t)n) || !freePool(&testPool, block))
+        {
+            countError();
+        }
+
+        n++;
+    }
+
+    return 0;
+}
+
+static double seconds(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (double)t.tv_sec + ((double)t.tv_nsec * 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[WORKERS + 2u];
+    static void *burst[BLOCK_COUNT];
+    uint32_t i;
+    unsigned long n;
+    unsigned long passes;
+    double start;
+    double poolPair;
+    double mallocPair;
+    double poolBurst;
+    double mallocBurst;
+    volatile uintptr_t sink = 0;
+
+    if(argc > 1)
+    {
+        operations = strtoul(argv[1], 0, 0);
+    }
+
+    initPool(&testPool);
+
+    //STRESS
+    for(i = 0; i < WORKERS; i++)
+    {
+        pthread_create(&threads[i], 0, worker, (void *)(uintptr_t)(i + 1u));
+    }
+    pthread_create(&threads[WORKERS], 0, producer, 0);
+    pthread_create(&threads[WORKERS + 1u], 0, consumer, 0);
+
+    for(i = 0; i < (WORKERS + 2u); i++)
+    {
+        pthread_join(threads[i], 0);
+    }
+
+    printf("%u workers + producer/consumer, %lu operations each\n", WORKERS, operations);
+    printf("corrupted or bad frees: %lu, failed allocations: %lu, fewest free: %lu of %u\n",
+           (unsigned long)errors, (unsigned long)testPool.failures,
+           (unsigned long)testPool.lowWater, BLOCK_COUNT);
+
+    //EVERY BLOCK MUST BE BACK, ONCE EACH
+    if(poolAvailable(&testPool) != BLOCK_COUNT)
+    {
+        printf("FAIL %lu blocks free afterwards\n", (unsigned long)poolAvailable(&testPool));
+        errors++;
+    }
+
+    for(i = 0; i < BLOCK_COUNT; i++)
+    {
+        uint32_t j;
+
+        burst[i] = allocPool(&testPool);
+
+        for(j = 0; j < i; j++)
+        {
+            if(!burst[i] || (burst[i] == burst[j]))
+            {
+                errors++;
+            }
+        }
+    }
+
+    if(allocPool(&testPool) != 0)
+    {
+        printf("FAIL more blocks than the pool holds\n");
+        errors++;
+    }
+
+    for(i = 0; i < BLOCK_COUNT; i++)
+    {
+        freePool(&testPool, burst[i]);
+    }
+
+    //BENCHMARK, ONE THREAD
+    passes = operations * 10ul;
+
+    start = seconds();
+    for(n = 0; n < passes; n++)
+    {
+        void *block = allocPool(&testPool);
+        sink ^= (uintptr_t)block;
+        freePool(&testPool, block);
+    }
+    poolPair = (seconds() - start) * 1e9 / (double)passes;
+
+    start = seconds();
+    for(n = 0; n < passes; n++)
+    {
+        void *block = malloc(BLOCK_SIZE);
+        sink ^= (uintptr_t)block;
+        free(block);
+    }
+    mallocPair = (seconds() - start) * 1e9 / (double)passes;
+
+    start = seconds();
+    for(n = 0; n < (passes / BLOCK_COUNT); n++)
+    {
+        for(i = 0; i < BLOCK_COUNT; i++)
+        {
+            burst[i] = allocPool(&testPool);
+        }
+        for(i = 0; i < BLOCK_COUNT; i++)
+        {
+            freePool(&testPool, burst[(i * 7u) % BLOCK_COUNT]);
+        }
+    }
+    poolBurst = (seconds() - start) * 1e9 / (double)((passes / BLOCK_COUNT) * BLOCK_COUNT);
+
+    start = seconds();
+    for(n = 0; n < (passes / BLOCK_COUNT); n++)
+    {
+        for(i = 0; i < BLOCK_COUNT; i++)
+        {
+            burst[i] = malloc(BLOCK_SIZE);
+        }
+        for(i = 0; i < BLOCK_COUNT; i++)
+        {
+            free(burst[(i * 7u) % BLOCK_COUNT]);
+        }
+    }
+    mallocBurst = (seconds() - start) * 1e9 / (double)((passes / BLOCK_COUNT) * BLOCK_COUNT);
+
+    printf("\nns per alloc + free   pool     malloc\n");
+    printf("one at a time       %6.1f   %8.1f\n", poolPair, mallocPair);
+    printf("%u held at once     %6.1f   %8.1f\n", BLOCK_COUNT, poolBurst, mallocBurst);
+
+    printf("%s\n", errors ? "FAILED" : "pool ok");
+
+    return errors ? 1 : 0;
+}
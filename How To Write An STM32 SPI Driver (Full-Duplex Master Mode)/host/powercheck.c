@@ -0,0 +1,277 @@
+/*****************************************************************
+ powercheck
+
+    Checks the low power mode choice and the wake-up path in
+    Power.c.
+
+      choose    choosePowerMode on its own, for a table of states
+                covering every rule it has
+      wake      enterLowPower against the models in host/sim/, from
+                each clock configuration. Sleep is used while a
+                TIM2 timer runs and Stop 2 otherwise. After Stop,
+                which wakes on MSI with the PLL off, SYSCLK must be
+                back on the configuration in use without any clock
+                listener running and without writing to the
+                peripherals they look after
+      time      the LPTIM1 ticks put down to each mode match the
+                simulated time spent in it, Stop included, while
+                TIM2 stands still through Stop
+
+    Sleep ends on TIM6. Stop 2 ends on the LPTIM1 wrap interrupt,
+    as no pin is routed to EXTI here and TIM6 stops with its clock.
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o powercheck powercheck.c ../../host/sim/sim.c ../Power.c ../LPTime.c ../Timer.c ../Sampler.c ../SPI.c ../UART.c ../UARTBaud.c ../Clock.c
+    Usage:  powercheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Clock.h"
+#include "Timer.h"
+#include "Sampler.h"
+#include "SPI.h"
+#include "UART.h"
+#include "LPTime.h"
+#include "Power.h"
+
+//TIME UNTIL TIM6 WAKES THE CORE, IN TIM6 CLOCKS
+#define WAKE_CLOCKS     40000u
+
+//LPTIM1 TICKS THE TIME IN A MODE MAY BE OUT BY, ONE AT EACH END
+#define TICK_SLACK      2u
+
+typedef struct
+{
+    const char *name;
+    PowerState state;
+    uint8_t mode;
+} Choice;
+
+//timerPending, ticksToDeadline, busy, workPending, wakeSources, uartStopWake
+static const Choice choices[] =
+{
+    {"nothing to keep",         {0u,    0u, 0u, 0u, 0u,                                  0u}, POWER_MODE_STOP2},
+    {"EXTI only",               {0u,    0u, 0u, 0u, POWER_WAKE_EXTI,                     0u}, POWER_MODE_STOP2},
+    {"UART1 from HSI16",        {0u,    0u, 0u, 0u, POWER_WAKE_UART1,                    1u}, POWER_MODE_STOP1},
+    {"UART1 and EXTI",          {0u,    0u, 0u, 0u, POWER_WAKE_UART1 | POWER_WAKE_EXTI,  1u}, POWER_MODE_STOP1},
+    {"UART1 not from HSI16",    {0u,    0u, 0u, 0u, POWER_WAKE_UART1,                    0u}, POWER_MODE_SLEEP},
+    {"timer running",           {1u,  500u, 0u, 0u, 0u,                                  0u}, POWER_MODE_SLEEP},
+    {"timer and UART1",         {1u,  500u, 0u, 0u, POWER_WAKE_UART1,                    1u}, POWER_MODE_SLEEP},
+    {"timer due",               {1u,    0u, 0u, 0u, 0u,                                  0u}, POWER_MODE_RUN},
+    {"timer due and busy",      {1u,    0u, 1u, 0u, POWER_WAKE_EXTI,                     0u}, POWER_MODE_RUN},
+    {"busy",                    {0u,    0u, 1u, 0u, 0u,                                  0u}, POWER_MODE_SLEEP},
+    {"busy and UART1",          {0u,    0u, 1u, 0u, POWER_WAKE_UART1,                    1u}, POWER_MODE_SLEEP},
+    {"deadline not pending",    {0u,    0u, 0u, 0u, POWER_WAKE_EXTI,                     0u}, POWER_MODE_STOP2},
+    {"work pending",            {0u,    0u, 0u, 1u, POWER_WAKE_EXTI,                     0u}, POWER_MODE_RUN},
+    {"work pending and busy",   {1u,  500u, 1u, 1u, POWER_WAKE_UART1,                    1u}, POWER_MODE_RUN},
+};
+
+#define CHOICES         (sizeof(choices) / sizeof(choices[0]))
+
+static volatile uint8_t woken = 0;
+static uint32_t listenerRuns = 0;
+static SoftTimer timer;
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *name, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s: %s\n", name, what);
+        errors++;
+    }
+}
+
+void TIM6_DAC_IRQHandler(void)
+{
+    TIM6->SR = 0;
+    TIM6->CR1 &= ~(1u << 0);
+    woken = 1;
+}
+
+static void countListener(void)
+{
+    listenerRuns++;
+}
+
+static void onTimer(void *arg)
+{
+    (void)arg;
+}
+
+ /*****************************************************************
+ queryPower
+
+    The same PowerQuery as main.c
+*****************************************************************/
+static void queryPower(PowerState *state)
+{
+    state->timerPending = nextTimerTicks(&state->ticksToDeadline);
+    state->busy = busySPI_DMA() || samplerRunning() || (uartTxFree() < UART_TX_BUFFER_SIZE);
+    state->workPending = 0;
+    state->uartStopWake = UART1_CLOCK_HSI16;
+}
+
+ /*****************************************************************
+ checkTicks
+
+    Checks 'ticks' LPTIM1 ticks against 'ps' of simulated time
+*****************************************************************/
+static void checkTicks(uint64_t ticks, uint64_t ps, const char *name, const char *what)
+{
+    uint64_t expected = (ps * LPTIME_HZ) / SIM_PS_PER_S;
+
+    check((ticks + TICK_SLACK >= expected) && (ticks <= expected + TICK_SLACK), name, what);
+}
+
+static void checkChoices(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < CHOICES; i++)
+    {
+        check(choosePowerMode(&choices[i].state) == choices[i].mode, choices[i].name, "choosePowerMode");
+    }
+}
+
+ /*****************************************************************
+ startWake
+
+    Starts TIM6 so it wakes the core WAKE_CLOCKS timer clocks from
+    now
+*****************************************************************/
+static void startWake(void)
+{
+    woken = 0;
+
+    TIM6->CR1 = 0;
+    TIM6->PSC = 0;
+    TIM6->ARR = WAKE_CLOCKS - 1u;
+    TIM6->CNT = 0;
+    TIM6->SR = 0;
+    TIM6->DIER = (1u << 0);
+    TIM6->CR1 = (1u << 0);
+}
+
+ /*****************************************************************
+ sleepOnce
+
+    Calls enterLowPower until TIM6 wakes the core
+
+    Returns
+    the mode the last call used
+*****************************************************************/
+static uint8_t sleepOnce(void)
+{
+    uint8_t mode = POWER_MODE_RUN;
+
+    startWake();
+
+    while(!woken)
+    {
+        mode = enterLowPower(&woken);
+    }
+
+    return mode;
+}
+
+static void checkWake(const char *name, const ClockConfig *config)
+{
+    uint32_t sysclkHz;
+    uint32_t sws;
+    uint32_t runs;
+    uint32_t ticks;
+    uint64_t start;
+    SimStats before;
+    SimStats after;
+    PowerStats power;
+    uint8_t mode;
+
+    check(configClock(config), name, "configClock");
+    sysclkHz = getSysclkHz();
+    sws = (RCC->CFGR >> 2) & 3u;
+
+    start = simTimePs();
+    simGetStats(&before);
+    initPower(0, queryPower);
+
+    //A TIMER RUNNING KEEPS TIM2 ON, SO ONLY SLEEP
+    check(startTimer(&timer, 1000000u, 0, onTimer, 0), name, "timer started");
+    mode = sleepOnce();
+    stopTimer(&timer);
+    simGetStats(&after);
+    getPowerStats(&power);
+
+    check(mode == POWER_MODE_SLEEP, name, "Sleep with a timer running");
+    checkTicks(power.ticks[POWER_MODE_SLEEP], after.sleepPs - before.sleepPs, name, "Sleep time counted");
+
+    //NOTHING RUNNING, STOP 2 UNTIL LPTIM1 WRAPS. THE CLOCKS COME BACK
+    //WITHOUT ANY DRIVER BEING RE-TIMED, AND TIM2 STOOD STILL
+    runs = listenerRuns;
+    simGetStats(&before);
+    ticks = getTicks();
+    mode = enterLowPower(0);
+    ticks = getTicks() - ticks;
+    simGetStats(&after);
+    getPowerStats(&power);
+
+    check(mode == POWER_MODE_STOP2, name, "Stop 2 with nothing running");
+    check(power.entries[POWER_MODE_STOP2] == 1u, name, "Stop 2 counted");
+    check(after.stopPs > before.stopPs, name, "core was in Stop");
+    checkTicks(power.ticks[POWER_MODE_STOP2], after.stopPs - before.stopPs, name, "Stop time counted");
+    checkTicks(power.totalTicks, simTimePs() - start, name, "all the time since initPower counted");
+    check(power.totalTicks == power.ticks[POWER_MODE_RUN] + power.ticks[POWER_MODE_SLEEP] + power.ticks[POWER_MODE_STOP2],
+          name, "time in the modes adds up");
+    check(ticks < 100u, name, "TIM2 stopped in Stop");
+    check(getSleepPermille() > 900u, name, "mostly asleep");
+    check(((RCC->CFGR >> 2) & 3u) == sws, name, "SYSCLK source put back");
+    check((simHclkHz() == getHclkHz()) && (getSysclkHz() == sysclkHz), name, "frequencies as before");
+    check(listenerRuns == runs, name, "no clock listener run on wake-up");
+    check((after.periph[SIM_TIM2].writes == before.periph[SIM_TIM2].writes)
+       && (after.periph[SIM_USART1].writes == before.periph[SIM_USART1].writes)
+       && (after.periph[SIM_TIM7].writes == before.periph[SIM_TIM7].writes),
+          name, "TIM2, TIM7 and USART1 not written on wake-up");
+
+    printf("%-12s %9u %6llu %6llu %6llu %8u %9llu %9llu\n", name, getSysclkHz(),
+           (unsigned long long)(after.periph[SIM_RCC].writes - before.periph[SIM_RCC].writes),
+           (unsigned long long)(after.periph[SIM_TIM2].writes - before.periph[SIM_TIM2].writes),
+           (unsigned long long)(after.periph[SIM_USART1].writes - before.periph[SIM_USART1].writes),
+           power.lastRestoreCycles[POWER_MODE_STOP2],
+           (unsigned long long)power.ticks[POWER_MODE_STOP2], (unsigned long long)power.totalTicks);
+}
+
+int main(void)
+{
+    simInit();
+
+    check(initTim2(), "init", "initTim2");
+    check(initUART_IT(), "init", "initUART_IT");
+    check(addClockListener(countListener), "init", "listener added");
+
+    RCC->APB1ENR1 |= (1u << 4);
+    NVIC_EnableIRQ(TIM6_DAC_IRQn);
+
+    checkChoices();
+
+    printf("%-12s %9s %6s %6s %6s %8s %9s %9s\n", "", "", "writes", "during", "Stop 2", "restore", "Stop 2", "total");
+    printf("%-12s %9s %6s %6s %6s %8s %9s %9s\n",
+           "clocks", "SYSCLK", "RCC", "TIM2", "USART1", "cycles", "ticks", "ticks");
+
+    checkWake("PLL 80MHz", &clockPll80MHz);
+    checkWake("HSI16", &clockHsi16MHz);
+    checkWake("MSI 4MHz", &clockMsi4MHz);
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,367 @@
+/*****************************************************************
+ profcheck
+
+    Checks the zone statistics and the dump in Profile.c against
+    the DWT model in host/sim/, where CYCCNT counts HCLK cycles of
+    simulated time and simBusy stands for code of a known length.
+
+      empty     an empty PROFILE_BEGIN/PROFILE_END pair records 0
+                cycles once the overhead initProfile measured is
+                taken off
+      stats     count, min, max, total and the log2 histogram for
+                a table of lengths, the longest past the last bin
+      clocks    the same code measures 20 times more cycles on the
+                80MHz PLL than on MSI 4MHz
+      wrap      a zone across the CYCCNT wrap still measures right
+      irq       a TIM6 handler with its own zone interrupts zones
+                the main loop has open. Every handler run is
+                counted with its own length, and the main loop's
+                zones grow by the handler time only
+      dump      serializeProfile and sendProfile give the format
+                in Profile.h, through a writer that takes a few
+                bytes at a time
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o profcheck profcheck.c ../../host/sim/sim.c ../Profile.c ../Clock.c
+    Usage:  profcheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Clock.h"
+#include "Profile.h"
+
+//ZONES USED HERE
+#define ZONE_EMPTY      0u
+#define ZONE_STATS      1u
+#define ZONE_MSI        2u
+#define ZONE_PLL        3u
+#define ZONE_WRAP       4u
+#define ZONE_MAIN       5u
+#define ZONE_IRQ        6u
+
+//CYCLES THE TIM6 HANDLER AND EACH MAIN LOOP ZONE STAND FOR
+#define IRQ_CYCLES      200u
+#define MAIN_CYCLES     3000u
+#define MAIN_RUNS       500u
+
+//MOST BYTES THE TEST WRITER TAKES IN ONE CALL
+#define WRITE_CHUNK     13u
+
+static uint8_t sent[PROFILE_DUMP_BYTES];
+static size_t sentLen = 0;
+static uint32_t writeCalls = 0;
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+static uint64_t getLE(const uint8_t *p, uint32_t bytes)
+{
+    uint64_t value = 0;
+
+    while(bytes--)
+    {
+        value = (value << 8) | p[bytes];
+    }
+
+    return value;
+}
+
+static uint32_t binOf(uint32_t cycles)
+{
+    uint32_t bin = 0;
+
+    while((cycles >>= 1) != 0u)
+    {
+        bin++;
+    }
+
+    return (bin < PROFILE_HIST_BINS) ? bin : (PROFILE_HIST_BINS - 1u);
+}
+
+void TIM6_DAC_IRQHandler(void)
+{
+    TIM6->SR = 0;
+
+    PROFILE_BEGIN(ZONE_IRQ);
+    simBusy(IRQ_CYCLES);
+    PROFILE_END(ZONE_IRQ);
+}
+
+ /*****************************************************************
+ takeChunk
+
+    A ProfileWriter that takes up to WRITE_CHUNK bytes, and none
+    on every third call, like a UART TX buffer that is nearly full
+*****************************************************************/
+static size_t takeChunk(const uint8_t *buf, size_t len)
+{
+    size_t n = (len < WRITE_CHUNK) ? len : WRITE_CHUNK;
+
+    if((++writeCalls % 3u) == 0u)
+    {
+        return 0;
+    }
+
+    if(sentLen + n > sizeof(sent))
+    {
+        n = sizeof(sent) - sentLen;
+    }
+
+    memcpy(&sent[sentLen], buf, n);
+    sentLen += n;
+
+    return n;
+}
+
+static void checkEmpty(void)
+{
+    ProfileZone z;
+
+    PROFILE_BEGIN(ZONE_EMPTY);
+    PROFILE_END(ZONE_EMPTY);
+
+    readProfile(ZONE_EMPTY, &z);
+    check((z.count == 1u) && (z.min == 0u) && (z.max == 0u) && (z.total == 0u), "empty zone is 0 cycles");
+    check(z.hist[0] == 1u, "empty zone in bin 0");
+}
+
+static void checkStats(void)
+{
+    static const uint32_t lengths[] = {1u, 2u, 3u, 100u, 1000u, 4095u, 4096u, 65536u,
+                                       (1u << 23) + 5u, (1u << 24), (1u << 25)};
+    uint32_t hist[PROFILE_HIST_BINS];
+    uint64_t total = 0;
+    ProfileZone z;
+    uint32_t i;
+
+    memset(hist, 0, sizeof(hist));
+
+    for(i = 0; i < (sizeof(lengths) / sizeof(lengths[0])); i++)
+    {
+        PROFILE_BEGIN(ZONE_STATS);
+        simBusy(lengths[i]);
+        PROFILE_END(ZONE_STATS);
+
+        total += lengths[i];
+        hist[binOf(lengths[i])]++;
+    }
+
+    //OUT OF RANGE ZONES ARE IGNORED
+    recordProfile(PROFILE_MAX_ZONES, 5u);
+
+    readProfile(ZONE_STATS, &z);
+    check(z.count == (sizeof(lengths) / sizeof(lengths[0])), "every length counted");
+    check(z.min == 1u, "shortest length");
+    check(z.max == (1u << 25), "longest length");
+    check(z.total == total, "total of the lengths");
+    check(memcmp(z.hist, hist, sizeof(hist)) == 0, "histogram bins, the last one open ended");
+}
+
+static void checkClocks(void)
+{
+    ProfileZone msi;
+    ProfileZone pll;
+
+    check(configClock(&clockMsi4MHz), "configClock MSI 4MHz");
+    PROFILE_BEGIN(ZONE_MSI);
+    simRunUs(100u);
+    PROFILE_END(ZONE_MSI);
+
+    check(configClock(&clockPll80MHz), "configClock PLL 80MHz");
+    PROFILE_BEGIN(ZONE_PLL);
+    simRunUs(100u);
+    PROFILE_END(ZONE_PLL);
+
+    readProfile(ZONE_MSI, &msi);
+    readProfile(ZONE_PLL, &pll);
+    check(msi.max == 400u, "100us is 400 cycles at 4MHz");
+    check(pll.max == 8000u, "100us is 8000 cycles at 80MHz");
+}
+
+static void checkWrap(void)
+{
+    ProfileZone z;
+
+    DWT->CYCCNT = 0xFFFFFFFFu - 50u;
+
+    PROFILE_BEGIN(ZONE_WRAP);
+    simBusy(1000u);
+    PROFILE_END(ZONE_WRAP);
+
+    readProfile(ZONE_WRAP, &z);
+    check((z.count == 1u) && (z.max == 1000u), "zone across the CYCCNT wrap");
+}
+
+static void checkIrq(void)
+{
+    SimStats before;
+    SimStats after;
+    ProfileZone loop;
+    ProfileZone irq;
+    uint32_t runs;
+    uint32_t i;
+
+    //TIM6 EVERY 7000 CYCLES, OUT OF STEP WITH THE MAIN LOOP
+    RCC->APB1ENR1 |= (1u << 4);
+    TIM6->PSC = 0;
+    TIM6->ARR = 6999u;
+    TIM6->CNT = 0;
+    TIM6->SR = 0;
+    TIM6->DIER = (1u << 0);
+    NVIC_EnableIRQ(TIM6_DAC_IRQn);
+
+    simGetStats(&before);
+    TIM6->CR1 = (1u << 0);
+
+    for(i = 0; i < MAIN_RUNS; i++)
+    {
+        PROFILE_BEGIN(ZONE_MAIN);
+        simBusy(MAIN_CYCLES);
+        PROFILE_END(ZONE_MAIN);
+    }
+
+    TIM6->CR1 = 0;
+    simGetStats(&after);
+    runs = (uint32_t)(after.interrupts - before.interrupts);
+
+    readProfile(ZONE_MAIN, &loop);
+    readProfile(ZONE_IRQ, &irq);
+
+    check(runs > 0u, "TIM6 interrupted");
+    check(irq.count == runs, "every handler run counted");
+    check((irq.min == IRQ_CYCLES) && (irq.max == IRQ_CYCLES), "handler zones their own length");
+    check(loop.count == MAIN_RUNS, "every main loop zone counted");
+    check(loop.min == MAIN_CYCLES, "uninterrupted zones exact");
+    check((loop.max > MAIN_CYCLES + IRQ_CYCLES) && (loop.max < MAIN_CYCLES + (2u * IRQ_CYCLES)),
+          "interrupted zones grow by the handler and its entry and exit");
+
+    printf("irq: %u handler runs, main zones %u to %u cycles\n", runs, loop.min, loop.max);
+}
+
+ /*****************************************************************
+ checkDump
+
+    Decodes a dump and checks it against readProfile
+*****************************************************************/
+static void checkDump(const uint8_t *p, size_t len)
+{
+    uint32_t zoneCount = 0;
+    uint16_t sum = 0;
+    const uint8_t *z;
+    ProfileZone stats;
+    uint32_t used;
+    uint32_t i;
+    uint32_t j;
+    size_t k;
+
+    for(i = 0; i < PROFILE_MAX_ZONES; i++)
+    {
+        readProfile(i, &stats);
+        zoneCount += (stats.count != 0u);
+    }
+
+    check(len == PROFILE_HEADER_BYTES + (zoneCount * PROFILE_ZONE_BYTES) + 2u, "dump length");
+    if(len < PROFILE_HEADER_BYTES + 2u)
+    {
+        return;
+    }
+
+    check(memcmp(p, "PROF", 4) == 0, "dump magic");
+    check((p[4] == PROFILE_DUMP_VERSION) && (p[5] == zoneCount) && (p[6] == PROFILE_HIST_BINS) && (p[7] == 0u),
+          "dump header");
+    check(getLE(&p[8], 4) == getHclkHz(), "core clock in the header");
+    check(getLE(&p[12], 4) == 1u, "overhead of one CYCCNT read on the PPB");
+
+    for(k = 0; k < len - 2u; k++)
+    {
+        sum = (uint16_t)(sum + p[k]);
+    }
+    check(getLE(&p[len - 2u], 2) == sum, "dump checksum");
+
+    used = (uint32_t)((len - PROFILE_HEADER_BYTES - 2u) / PROFILE_ZONE_BYTES);
+
+    for(i = 0; i < used; i++)
+    {
+        z = &p[PROFILE_HEADER_BYTES + (i * PROFILE_ZONE_BYTES)];
+        readProfile(z[0], &stats);
+
+        check((stats.count != 0u) && (getLE(&z[1], 4) == stats.count), "zone count in the dump");
+        check((getLE(&z[5], 4) == stats.min) && (getLE(&z[9], 4) == stats.max), "zone min and max in the dump");
+        check(getLE(&z[13], 8) == stats.total, "zone total in the dump");
+
+        for(j = 0; j < PROFILE_HIST_BINS; j++)
+        {
+            check(getLE(&z[21u + (4u * j)], 4) == stats.hist[j], "zone histogram in the dump");
+        }
+    }
+}
+
+static void checkSend(void)
+{
+    static uint8_t dump[PROFILE_DUMP_BYTES];
+    size_t len;
+    uint32_t pumps = 0;
+    uint8_t done;
+
+    check(serializeProfile(dump, sizeof(dump) - 1u) == 0u, "too small a buffer refused");
+
+    len = serializeProfile(dump, sizeof(dump));
+    checkDump(dump, len);
+
+    sentLen = 0;
+    done = sendProfile(takeChunk);
+
+    while(!done && (pumps < 1000u))
+    {
+        done = pumpProfile(takeChunk);
+        pumps++;
+    }
+
+    check(done, "sendProfile and pumpProfile finish the dump");
+    check((sentLen == len) && (memcmp(sent, dump, len) == 0), "dump sent in pieces is the one serialized");
+    check(pumpProfile(takeChunk) == 1u, "nothing left to send");
+
+    printf("dump: %u zones, %u bytes in %u writes\n", dump[5], (uint32_t)len, writeCalls);
+
+    //AFTER A RESET THE DUMP IS THE HEADER AND CHECKSUM ONLY
+    resetProfile();
+    len = serializeProfile(dump, sizeof(dump));
+    check((len == PROFILE_HEADER_BYTES + 2u) && (dump[5] == 0u), "no zones after resetProfile");
+    checkDump(dump, len);
+}
+
+int main(void)
+{
+    simInit();
+
+    initProfile();
+    check(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk, "CYCCNT started");
+
+    checkEmpty();
+    checkStats();
+    checkClocks();
+    checkWrap();
+    checkIrq();
+    checkSend();
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*****************************************************************
+ profdecode
+
+    Host-side decoder for the profile dumps sent by sendProfile.
+    Reads the raw UART capture from a file (or stdin) and prints
+    one table per dump.
+
+    Build:  cc -O2 -o profdecode profdecode.c
+    Usage:  profdecode [capture.bin] [zone0name zone1name ...]
+*****************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BINS    64u
+
+static uint64_t getLE(const uint8_t *p, unsigned bytes)
+{
+    uint64_t value = 0;
+
+    while(bytes--)
+    {
+        value = (value << 8) | p[bytes];
+    }
+
+    return value;
+}
+
+/*****************************************************************
+ decodeDump
+
+    Decodes one dump starting at 'p' ('avail' bytes available)
+
+    Returns
+    the length of the dump, 0 if it is incomplete or corrupt
+*****************************************************************/
+static size_t decodeDump(const uint8_t *p, size_t avail, int nameCount, char **names)
+{
+    unsigned zoneCount;
+    unsigned bins;
+    unsigned zoneBytes;
+    uint32_t hz;
+    size_t len;
+    uint16_t sum = 0;
+    size_t i;
+    unsigned z;
+    unsigned b;
+
+    if((avail < 16u) || (p[4] != 1u))
+    {
+        return 0;
+    }
+
+    zoneCount = p[5];
+    bins = p[6];
+    zoneBytes = 21u + (4u * bins);
+    len = 16u + ((size_t)zoneCount * zoneBytes) + 2u;
+
+    if((bins > MAX_BINS) || (avail < len))
+    {
+        return 0;
+    }
+
+    for(i = 0; i < (len - 2u); i++)
+    {
+        sum = (uint16_t)(sum + p[i]);
+    }
+
+    if(sum != (uint16_t)getLE(&p[len - 2u], 2))
+    {
+        return 0;
+    }
+
+    hz = (uint32_t)getLE(&p[8], 4);
+
+    printf("core %lu Hz, overhead %lu cycles\n", (unsigned long)hz, (unsigned long)getLE(&p[12], 4));
+    printf("%-16s %10s %12s %12s %12s %12s\n", "zone", "count", "min cyc", "mean cyc", "max cyc", "mean us");
+
+    for(z = 0; z < zoneCount; z++)
+    {
+        const uint8_t *q = &p[16u + (z * zoneBytes)];
+        unsigned id = q[0];
+        uint64_t count = getLE(&q[1], 4);
+        uint64_t total = getLE(&q[13], 8);
+        double mean = count ? ((double)total / (double)count) : 0.0;
+        char label[32];
+
+        if((int)id < nameCount)
+        {
+            snprintf(label, sizeof(label), "%s", names[id]);
+        }
+        else
+        {
+            snprintf(label, sizeof(label), "zone %u", id);
+        }
+
+        printf("%-16s %10llu %12llu %12.1f %12llu %12.3f\n", label,
+               (unsigned long long)count,
+               (unsigned long long)getLE(&q[5], 4),
+               mean,
+               (unsigned long long)getLE(&q[9], 4),
+               hz ? (mean * 1e6 / hz) : 0.0);
+
+        //ONLY PRINT BINS THAT WERE HIT
+        for(b = 0; b < bins; b++)
+        {
+            uint64_t n = getLE(&q[21u + (4u * b)], 4);
+
+            if(n)
+            {
+                printf("    %10llu..%-10llu %llu\n",
+                       (unsigned long long)(b ? (1ull << b) : 0ull),
+                       (unsigned long long)((2ull << b) - 1ull),
+                       (unsigned long long)n);
+            }
+        }
+    }
+
+    printf("\n");
+
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    uint8_t *data = NULL;
+    size_t size = 0;
+    size_t cap = 0;
+    size_t pos = 0;
+    size_t n;
+
+    if((argc > 1) && strcmp(argv[1], "-"))
+    {
+        in = fopen(argv[1], "rb");
+
+        if(!in)
+        {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    //READ THE WHOLE CAPTURE
+    do
+    {
+        if(size == cap)
+        {
+            cap = cap ? (cap * 2u) : 65536u;
+            data = realloc(data, cap);
+
+            if(!data)
+            {
+                return 1;
+            }
+        }
+
+        n = fread(&data[size], 1, cap - size, in);
+        size += n;
+    } while(n > 0);
+
+    //SCAN FOR "PROF" AND DECODE EVERY VALID DUMP
+    while((pos + 4u) <= size)
+    {
+        if(!memcmp(&data[pos], "PROF", 4))
+        {
+            n = decodeDump(&data[pos], size - pos, (argc > 2) ? (argc - 2) : 0, &argv[2]);
+
+            if(n)
+            {
+                pos += n;
+                continue;
+            }
+        }
+
+        pos++;
+    }
+
+    free(data);
+
+    return 0;
+}
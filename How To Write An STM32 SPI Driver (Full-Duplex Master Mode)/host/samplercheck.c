@@ -0,0 +1,276 @@
+/*****************************************************************
+ samplercheck
+
+    Checks the TIM7 sampler in Sampler.c against the TIM2 and TIM7
+    models in host/sim/, with a main loop that sleeps in __WFI until
+    a job is due, as main.c does.
+
+      record    recordSamplerStart on its own, for a table of start
+                times that goes through the 32-bit wrap
+      drift     jobs of random length, all shorter than the period,
+                start on the TIM7 grid. After hundreds of periods
+                and a TIM2 wrap the last start is still a whole
+                number of periods after the first, the jitter and
+                latencies stay within MAX_LATE ticks and no trigger
+                is lost
+      overrun   jobs longer than the period lose every other
+                trigger, each one is counted as an overrun, and the
+                jobs that do run are still on the grid
+      retime    configClock part way through the run keeps the
+                period in ticks and in time, moving the grid by no
+                more than MAX_SKEW, and the update event the new
+                prescaler needs is not taken as a trigger
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o samplercheck samplercheck.c ../../host/sim/sim.c ../Sampler.c ../Timer.c ../Clock.c
+    Usage:  samplercheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Clock.h"
+#include "Timer.h"
+#include "Sampler.h"
+
+//SAMPLER PERIOD IN TICKS, 1MS
+#define PERIOD          1000u
+
+//LATEST A JOB MAY START AFTER ITS UPDATE EVENT, IN TICKS. THE CORE
+//WAKES AT ONCE BUT THE HANDLER AND beginSamplerJob READ REGISTERS
+#define MAX_LATE        4u
+
+//HOW FAR A CLOCK CHANGE MAY MOVE THE TIM7 GRID AGAINST TIM2, IN
+//TICKS. BOTH COUNT WITH THE OLD PRESCALER FROM THE SWITCH UNTIL
+//THEIR LISTENER RUNS, AND THE LISTENERS RUN ONE AFTER THE OTHER
+#define MAX_SKEW        24u
+
+//PERIODS EACH RUN LASTS
+#define RUNS            400u
+
+static const ClockConfig clockHsi16Apb2 = {CLOCK_SOURCE_HSI16, 6u, CLOCK_SOURCE_HSI16, 1u, 8u, 2u, 1u, 2u, 2u};
+
+static uint32_t seed = 1u;
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+static uint32_t random32(void)
+{
+    seed = (seed * 1103515245u) + 12345u;
+
+    return (seed >> 8) ^ (seed << 20);
+}
+
+ /*****************************************************************
+ runJobs
+
+    The main loop: sleeps until a job is due, then runs it for
+    'minUs' to 'maxUs'. Calls 'between' (if not 0) after job
+    'at'
+
+    Returns
+    the TIM2 count when the first job started
+*****************************************************************/
+static uint32_t runJobs(uint32_t jobs, uint32_t minUs, uint32_t maxUs, uint32_t at, void (*between)(void))
+{
+    uint32_t first = 0;
+    uint32_t n;
+
+    for(n = 0; n < jobs; n++)
+    {
+        while(!beginSamplerJob())
+        {
+            __WFI();
+        }
+
+        if(n == 0u)
+        {
+            first = getTicks();
+        }
+
+        simRunUs(minUs + (random32() % (maxUs - minUs + 1u)));
+        endSamplerJob();
+
+        if((n == at) && between)
+        {
+            between();
+        }
+    }
+
+    return first;
+}
+
+static void printStats(const char *name, const SamplerStats *s)
+{
+    printf("%-8s %6u %6u %6u %6u %6u %6u %6u %6u %6u\n", name, s->triggers, s->jobs, s->overruns,
+           s->minPeriod, s->maxPeriod, s->maxJitter, s->maxIsrLatency, s->maxStartLatency, s->maxRunTicks);
+}
+
+static void checkRecord(void)
+{
+    //STARTS ACROSS THE WRAP, THEN ONE LATE AND ONE EARLY
+    static const uint32_t starts[] = {0xFFFFFC18u, 0x00000000u, 0x000003E8u, 0x000007D5u, 0x00000BB8u};
+    SamplerStats s;
+    uint32_t i;
+
+    memset(&s, 0, sizeof(s));
+    s.period = PERIOD;
+    s.minPeriod = 0xFFFFFFFFu;
+
+    recordSamplerStart(&s, starts[0] - 3u, starts[0]);
+    check((s.jobs == 1u) && (s.maxPeriod == 0u) && (s.minPeriod == 0xFFFFFFFFu), "first job has no period");
+    check(s.maxStartLatency == 3u, "start latency from the trigger");
+
+    for(i = 1; i < (sizeof(starts) / sizeof(starts[0])); i++)
+    {
+        recordSamplerStart(&s, starts[i] - 1u, starts[i]);
+    }
+
+    check(s.jobs == 5u, "every start counted");
+    check(s.lastStart == starts[4], "last start kept");
+    check(s.minPeriod == (PERIOD - 5u), "shortest period");
+    check(s.maxPeriod == (PERIOD + 5u), "longest period");
+    check(s.maxJitter == 5u, "jitter either side of the period");
+    check(s.maxStartLatency == 3u, "longest start latency kept");
+}
+
+static void checkDrift(void)
+{
+    SamplerStats s;
+    uint64_t start;
+    uint32_t first;
+    uint32_t span;
+    uint64_t us;
+
+    //THE RUN GOES THROUGH THE TIM2 WRAP
+    TIM2->CNT = 0xFFFFFFFFu - ((RUNS / 2u) * PERIOD);
+    resetSamplerStats();
+
+    start = simTimePs();
+    first = runJobs(RUNS, 50u, 900u, RUNS, 0);
+    getSamplerStats(&s);
+    us = (simTimePs() - start) / SIM_PS_PER_US;
+    printStats("drift", &s);
+
+    span = s.lastStart - first;
+
+    check(s.jobs == RUNS, "every job ran");
+    check(s.overruns == 0u, "no overruns with jobs shorter than the period");
+    check(s.triggers == s.jobs, "one trigger per job");
+    check((span % PERIOD) <= MAX_LATE, "last start still on the TIM7 grid");
+    check((span / PERIOD) == (RUNS - 1u), "a whole period between each start");
+    check(s.maxJitter <= MAX_LATE, "jitter within MAX_LATE");
+    check(s.maxStartLatency <= MAX_LATE, "start latency within MAX_LATE");
+    check(s.maxIsrLatency <= MAX_LATE, "interrupt latency within MAX_LATE");
+    check((s.minPeriod + MAX_LATE >= PERIOD) && (s.maxPeriod <= PERIOD + MAX_LATE), "periods within MAX_LATE");
+
+    //AND IN TIME, AT 1 TICK A US. THE RUN WAITS UP TO A PERIOD FOR
+    //THE FIRST JOB AND ENDS WITH THE LAST ONE
+    check((us >= (RUNS - 1u) * PERIOD) && (us <= (RUNS + 1u) * PERIOD), "period is 1ms in time");
+}
+
+static void checkOverrun(void)
+{
+    SamplerStats s;
+    uint32_t first;
+    uint32_t span;
+
+    resetSamplerStats();
+
+    //EACH JOB RUNS OVER THE NEXT TRIGGER BUT ENDS BEFORE THE ONE
+    //AFTER, SO EVERY OTHER TRIGGER IS LOST
+    first = runJobs(RUNS / 2u, 1200u, 1800u, RUNS, 0);
+    getSamplerStats(&s);
+    printStats("overrun", &s);
+
+    span = s.lastStart - first;
+
+    check(s.jobs == (RUNS / 2u), "every job ran");
+    check((s.overruns + 1u >= s.jobs) && (s.overruns <= s.jobs), "the trigger during each job is an overrun");
+    check((s.triggers >= s.jobs + s.overruns) && (s.triggers <= s.jobs + s.overruns + 1u),
+          "every trigger either starts a job or is an overrun");
+    check((span % PERIOD) <= MAX_LATE, "jobs still on the TIM7 grid");
+    check((s.minPeriod + MAX_LATE >= 2u * PERIOD) && (s.maxPeriod <= 2u * PERIOD + MAX_LATE),
+          "two periods between each start");
+}
+
+static void toMsi4MHz(void)
+{
+    check(configClock(&clockMsi4MHz), "configClock MSI 4MHz");
+}
+
+static void toHsi16(void)
+{
+    check(configClock(&clockHsi16Apb2), "configClock HSI16 APB/2");
+}
+
+ /*****************************************************************
+ checkRetime
+
+    Runs with the clocks changed after job 'at'. Every clock here
+    is a whole number of MHz, so the tick stays exactly 1us
+*****************************************************************/
+static void checkRetime(const char *name, void (*change)(void))
+{
+    SamplerStats s;
+    uint64_t start;
+    uint32_t first;
+    uint32_t span;
+    uint64_t us;
+
+    resetSamplerStats();
+
+    start = simTimePs();
+    first = runJobs(RUNS, 50u, 600u, RUNS / 2u, change);
+    getSamplerStats(&s);
+    us = (simTimePs() - start) / SIM_PS_PER_US;
+    printStats(name, &s);
+
+    span = s.lastStart - first;
+
+    check(s.jobs == RUNS, "every job ran across the clock change");
+    check(s.overruns == 0u, "the prescaler update is not a trigger");
+    check(s.triggers == s.jobs, "one trigger per job across the clock change");
+    check(((span + MAX_SKEW) / PERIOD) == (RUNS - 1u), "no period cut short or lost");
+    check(s.maxJitter <= MAX_SKEW, "grid moved by no more than MAX_SKEW");
+    check((us >= (RUNS - 1u) * PERIOD) && (us <= (RUNS + 1u) * PERIOD), "period is still 1ms in time");
+}
+
+int main(void)
+{
+    simInit();
+
+    configClock(&clockPll80MHz);
+    check(initTim2(), "initTim2");
+    check(!initSampler(1u) && !initSampler(SAMPLER_MAX_PERIOD + 1u), "periods out of range refused");
+    check(initSampler(PERIOD), "initSampler");
+    check(samplerRunning(), "TIM7 counting");
+
+    printf("%-8s %6s %6s %6s %6s %6s %6s %6s %6s %6s\n", "run",
+           "trig", "jobs", "over", "minP", "maxP", "jitter", "isr", "start", "run");
+
+    checkRecord();
+    checkDrift();
+    checkOverrun();
+    checkRetime("to 4MHz", toMsi4MHz);
+    checkRetime("to 16MHz", toHsi16);
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
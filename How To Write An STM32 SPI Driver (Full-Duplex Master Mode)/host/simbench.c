@@ -0,0 +1,301 @@
+/*****************************************************************
+ simbench
+
+    Runs the SPI, UART, TIM2 and clock drivers unchanged against the
+    peripheral models in host/sim/ and reports, for each driver call,
+    the register reads and writes it made, the bus cycles those
+    cost, how long it took in simulated time and how many
+    interrupts it took.
+
+    SPI1 talks to a slave that echoes each byte one byte later and
+    the far end of UART1 sends bytes at 115200 baud, so each call's
+    result is checked as well as timed. Calls that repeat are
+    averaged.
+
+    Bus cycles are HCLK cycles, an estimate from the bus each
+    peripheral sits on (see host/sim/sim.c), not datasheet figures.
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o simbench simbench.c ../../host/sim/sim.c ../SPI.c ../Timer.c ../Clock.c ../UART.c ../UARTBaud.c
+    Usage:  simbench
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Clock.h"
+#include "SPI.h"
+#include "Timer.h"
+#include "UART.h"
+
+#define STREAM_BYTES    64u
+#define REPEATS         16u
+
+static uint32_t errors = 0;
+static SimStats before;
+static uint32_t expired = 0;
+
+
+//LAST BYTE THE ECHO SLAVE WAS SENT
+static uint8_t echoLast = 0;
+
+ /*****************************************************************
+ echo
+
+    SPI1 slave that sends back each byte one byte later, like a
+    shift register between MOSI and MISO. Frames go MSB first, so
+    a 16-bit frame is its high byte then its low byte
+*****************************************************************/
+static uint16_t echo(void *ctx, uint16_t mosi, uint8_t bits)
+{
+    uint16_t miso;
+
+    (void)ctx;
+
+    if(bits <= 8u)
+    {
+        miso = echoLast;
+        echoLast = (uint8_t)mosi;
+    }
+    else
+    {
+        miso = (uint16_t)((echoLast << 8) | (mosi >> 8));
+        echoLast = (uint8_t)mosi;
+    }
+
+    return miso;
+}
+
+static void onExpire(void *arg)
+{
+    (void)arg;
+    expired++;
+}
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+ /*****************************************************************
+ begin / report
+
+    Bracket the calls being measured. 'count' is how many times
+    they were made, the figures printed are per call
+*****************************************************************/
+static void begin(void)
+{
+    simGetStats(&before);
+}
+
+static void report(const char *name, uint32_t count)
+{
+    SimStats after;
+    char busiest[32] = "-";
+    uint64_t most = 0;
+    uint64_t n;
+    uint32_t p;
+
+    simGetStats(&after);
+
+    for(p = 0; p < SIM_PERIPH_COUNT; p++)
+    {
+        n = (after.periph[p].reads + after.periph[p].writes)
+          - (before.periph[p].reads + before.periph[p].writes);
+
+        if(n > most)
+        {
+            most = n;
+            snprintf(busiest, sizeof(busiest), "%s", simPeriphName((SimPeriph)p));
+        }
+    }
+
+    printf("%-28s %8.1f %8.1f %10.1f %10.2f %6.1f  %s\n", name,
+           (double)(after.total.reads - before.total.reads) / count,
+           (double)(after.total.writes - before.total.writes) / count,
+           (double)(after.total.busCycles - before.total.busCycles) / count,
+           (double)(after.timePs - before.timePs) / count / SIM_PS_PER_US,
+           (double)(after.interrupts - before.interrupts) / count,
+           busiest);
+}
+
+static void benchClock(void)
+{
+    begin();
+    check(configClock(&clockPll80MHz) == 1, "configClock(PLL 80MHz)");
+    report("configClock(PLL 80MHz)", 1);
+    check(simHclkHz() == 80000000u, "HCLK is 80MHz");
+}
+
+static void benchSpi(void)
+{
+    uint8_t tx[STREAM_BYTES];
+    uint8_t rx[STREAM_BYTES];
+    uint16_t tx16[STREAM_BYTES / 2u];
+    uint16_t rx16[STREAM_BYTES / 2u];
+    uint8_t ok = 1;
+    uint32_t i;
+
+    simSetSpiSlave(echo, 0);
+
+    begin();
+    initSPI_SSM();
+    report("initSPI_SSM", 1);
+
+    //ONE 16-BIT FRAME, THE BYTE SENT THEN A DUMMY. THE REPLY IS IN
+    //THE SECOND BYTE
+    begin();
+    for(i = 0; i < REPEATS; i++)
+    {
+        ok &= (transferSPI_SSM((uint8_t)(0xA5u + i)) == (uint8_t)(0xA5u + i));
+    }
+    report("transferSPI_SSM", REPEATS);
+    check(ok, "transferSPI_SSM gets its byte back");
+
+    for(i = 0; i < STREAM_BYTES; i++)
+    {
+        tx[i] = (uint8_t)(i * 7u);
+    }
+
+    memset(rx, 0, sizeof(rx));
+    begin();
+    transferSPIStream_SSM(tx, rx, STREAM_BYTES, SPI_FRAME_8BIT);
+    report("transferSPIStream_SSM 64x8", 1);
+    check(memcmp(tx, &rx[1], STREAM_BYTES - 1u) == 0, "8-bit stream echoed");
+
+    for(i = 0; i < (STREAM_BYTES / 2u); i++)
+    {
+        tx16[i] = (uint16_t)(0x1234u * (i + 1u));
+    }
+
+    memset(rx16, 0, sizeof(rx16));
+    begin();
+    transferSPIStream_SSM(tx16, rx16, STREAM_BYTES / 2u, SPI_FRAME_16BIT);
+    report("transferSPIStream_SSM 32x16", 1);
+    for(i = 1; i < (STREAM_BYTES / 2u); i++)
+    {
+        ok &= (rx16[i] == (uint16_t)((tx16[i - 1u] << 8) | (tx16[i] >> 8)));
+    }
+    check(ok, "16-bit stream echoed");
+}
+
+static void benchUart(void)
+{
+    static char text[] = "simbench\r\n";
+    uint8_t sent[32];
+    size_t len;
+    uint8_t ok = 1;
+    uint32_t i;
+
+    begin();
+    initUART();
+    report("initUART", 1);
+
+    begin();
+    for(i = 0; i < REPEATS; i++)
+    {
+        transmitUart((uint8_t)('A' + i));
+    }
+    report("transmitUart", REPEATS);
+
+    begin();
+    transmitStrUart(text);
+    report("transmitStrUart 10 chars", 1);
+
+    simRunUs(2000u);
+    len = simUartTx(sent, sizeof(sent));
+    check(len == (REPEATS + strlen(text)), "every byte sent");
+    check((len >= REPEATS) && (sent[0] == 'A') && (memcmp(&sent[REPEATS], text, len - REPEATS) == 0),
+          "bytes sent in order");
+
+    //receiveUart DOESN'T WAIT, SO LET EACH BYTE ARRIVE FIRST
+    for(i = 0; i < REPEATS; i++)
+    {
+        sent[i] = (uint8_t)(0x30u + i);
+        simUartRx(&sent[i], 1u, 0u);
+        simRunUs(100u);
+
+        if(i == 0u)
+        {
+            begin();
+            ok &= (receiveUart() == sent[i]);
+            report("receiveUart", 1);
+        }
+        else
+        {
+            ok &= (receiveUart() == sent[i]);
+        }
+    }
+    check(ok, "receiveUart gets each byte");
+    check(receiveUart() == 0u, "receiveUart gives 0 with nothing received");
+}
+
+static void benchTimer(void)
+{
+    SoftTimer timer;
+    uint32_t start;
+    uint32_t ticks = 0;
+    uint64_t t;
+    uint32_t i;
+
+    begin();
+    initTim2();
+    report("initTim2", 1);
+
+    begin();
+    for(i = 0; i < REPEATS; i++)
+    {
+        ticks = getTicks();
+    }
+    report("getTicks", REPEATS);
+    (void)ticks;
+
+    memset(&timer, 0, sizeof(timer));
+    begin();
+    startTimer(&timer, 1000u, 0u, onExpire, 0);
+    report("startTimer", 1);
+
+    begin();
+    stopTimer(&timer);
+    report("stopTimer", 1);
+
+    startTimer(&timer, 500u, 0u, onExpire, 0);
+    simRunUs(600u);
+    check(expired == 1u, "one-shot timer fires once");
+
+    start = getTicks();
+    t = simTimePs();
+    begin();
+    delayUs(100u);
+    report("delayUs(100)", 1);
+    t = simTimePs() - t;
+    check((getTicks() - start) >= 100u, "delayUs waits 100 ticks");
+    check((t >= (100u * SIM_PS_PER_US)) && (t < (110u * SIM_PS_PER_US)), "delayUs takes 100us");
+}
+
+int main(void)
+{
+    simInit();
+
+    printf("%-28s %8s %8s %10s %10s %6s  %s\n",
+           "operation", "reads", "writes", "bus cyc", "time us", "irqs", "busiest");
+
+    benchClock();
+    benchSpi();
+    benchUart();
+    benchTimer();
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,266 @@
+/*****************************************************************
+ streambench
+
+    Measures the FIFO streaming transfer in SPI.c
+    (transferSPIStream_SSM) against the SPI1 model in host/sim/ and
+    compares it with moving the same bytes one transferSPI_SSM call
+    at a time.
+
+    For each frame size and length it prints the simulated time,
+    the throughput, the share of the time SCK was running (the
+    line efficiency) and the register accesses per frame. A slave
+    that echoes each byte one byte later checks every frame came
+    back in order, and the SPI1 overrun flag must stay clear.
+    It also checks that frame sizes other than SPI_FRAME_8BIT and
+    SPI_FRAME_16BIT are refused without touching slave select or
+    the bus.
+
+    In the simulation only register accesses take CPU time, so the
+    efficiency shows how well the FIFO hides the register traffic,
+    not the cost of the rest of the loop. Build with
+    -DSPI1_MAX_SCK_HZ=40000000 (or any other SCK) to see where the
+    CPU stops keeping up. At the default SCK every long stream
+    must be gap free.
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o streambench streambench.c ../../host/sim/sim.c ../SPI.c ../Clock.c
+    Usage:  streambench
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Board.h"
+#include "Clock.h"
+#include "SPI.h"
+
+#define MAX_BYTES       2048u
+
+static uint8_t tx8[MAX_BYTES];
+static uint8_t rx8[MAX_BYTES];
+static uint16_t tx16[MAX_BYTES / 2u];
+static uint16_t rx16[MAX_BYTES / 2u];
+
+//LAST BYTE THE ECHO SLAVE WAS SENT
+static uint8_t echoLast = 0;
+
+//SLAVE SELECT EDGES SEEN
+static uint32_t csEdges = 0;
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+ /*****************************************************************
+ echo
+
+    Sends back each byte one byte later. A 16-bit frame is its high
+    byte then its low byte
+*****************************************************************/
+static uint16_t echo(void *ctx, uint16_t mosi, uint8_t bits)
+{
+    uint16_t miso;
+
+    (void)ctx;
+
+    if(bits <= 8u)
+    {
+        miso = echoLast;
+    }
+    else
+    {
+        miso = (uint16_t)((echoLast << 8) | (mosi >> 8));
+    }
+
+    echoLast = (uint8_t)mosi;
+
+    return miso;
+}
+
+static void onSlaveSelect(void *ctx, uint8_t level)
+{
+    (void)ctx;
+    (void)level;
+
+    csEdges++;
+}
+
+ /*****************************************************************
+ sckHz
+
+    SCK from the prescaler SPI.c chose
+*****************************************************************/
+static double sckHz(void)
+{
+    return (double)getPclk2Hz() / (double)(2u << ((SPI1->CR1 >> 3) & 7u));
+}
+
+static void report(const char *name, uint32_t bytes, uint32_t frames, const SimStats *before, const SimStats *after)
+{
+    double us = (double)(after->timePs - before->timePs) / SIM_PS_PER_US;
+    double lineUs = (8.0 * bytes * 1e6) / sckHz();
+
+    printf("%-22s %6u %10.1f %10.1f %8.1f%% %8.2f\n", name, bytes, us,
+           bytes / us * 1e3, 100.0 * lineUs / us,
+           (double)((after->total.reads + after->total.writes) - (before->total.reads + before->total.writes)) / frames);
+}
+
+ /*****************************************************************
+ benchStream
+
+    One stream of 'bytes' bytes in frames of 'frameBits'
+
+    Returns
+    the line efficiency
+*****************************************************************/
+static double benchStream(uint32_t bytes, uint8_t frameBits)
+{
+    SimStats before;
+    SimStats after;
+    uint32_t frames = (frameBits == SPI_FRAME_16BIT) ? (bytes / 2u) : bytes;
+    char name[32];
+    uint8_t ok = 1;
+    uint32_t i;
+
+    for(i = 0; i < bytes; i++)
+    {
+        tx8[i] = (uint8_t)((i * 29u) + bytes);
+    }
+    for(i = 0; i < (bytes / 2u); i++)
+    {
+        tx16[i] = (uint16_t)((tx8[2u * i] << 8) | tx8[(2u * i) + 1u]);
+    }
+
+    memset(rx8, 0, sizeof(rx8));
+    memset(rx16, 0, sizeof(rx16));
+    echoLast = 0;
+
+    simGetStats(&before);
+    if(frameBits == SPI_FRAME_16BIT)
+    {
+        ok &= transferSPIStream_SSM(tx16, rx16, frames, SPI_FRAME_16BIT);
+    }
+    else
+    {
+        ok &= transferSPIStream_SSM(tx8, rx8, frames, SPI_FRAME_8BIT);
+    }
+    simGetStats(&after);
+
+    //EVERY FRAME COMES BACK ONE BYTE LATE
+    for(i = 1; i < frames; i++)
+    {
+        if(frameBits == SPI_FRAME_16BIT)
+        {
+            ok &= (rx16[i] == (uint16_t)((tx16[i - 1u] << 8) | (tx16[i] >> 8)));
+        }
+        else
+        {
+            ok &= (rx8[i] == tx8[i - 1u]);
+        }
+    }
+
+    snprintf(name, sizeof(name), "stream %2u-bit", frameBits);
+    check(ok, "stream echoed in order");
+    check(!(SPI1->SR & (1u << 6)), "no RX overrun");
+    check(after.spiFrames - before.spiFrames == frames, "one SPI frame per frame");
+
+    report(name, bytes, frames, &before, &after);
+
+    return (8.0 * bytes * 1e6 / sckHz()) / ((double)(after.timePs - before.timePs) / SIM_PS_PER_US);
+}
+
+static void benchSingle(uint32_t bytes)
+{
+    SimStats before;
+    SimStats after;
+    uint32_t i;
+
+    simGetStats(&before);
+    for(i = 0; i < bytes; i++)
+    {
+        transferSPI_SSM(tx8[i]);
+    }
+    simGetStats(&after);
+
+    //EACH CALL IS A 16-BIT FRAME, THE BYTE AND A DUMMY, SO HALF OF
+    //THE LINE TIME CARRIES THE BYTE
+    report("transferSPI_SSM", bytes, bytes, &before, &after);
+}
+
+static void checkRefused(void)
+{
+    static const uint8_t bad[] = {0u, 4u, 7u, 9u, 12u, 15u, 17u};
+    SimStats before;
+    SimStats after;
+    uint32_t edges = csEdges;
+    uint8_t ok = 1;
+    uint32_t i;
+
+    simGetStats(&before);
+    for(i = 0; i < sizeof(bad); i++)
+    {
+        ok &= (transferSPIStream_SSM(tx8, rx8, 4u, bad[i]) == 0u);
+    }
+    simGetStats(&after);
+
+    check(ok, "frame sizes other than 8 and 16 bits refused");
+    check(csEdges == edges, "slave select left alone when refused");
+    check((after.spiFrames == before.spiFrames) && (after.total.writes == before.total.writes),
+          "bus left alone when refused");
+
+    check(transferSPIStream_SSM(tx8, rx8, 0u, SPI_FRAME_8BIT) == 1u, "0 frames accepted");
+}
+
+int main(void)
+{
+    static const uint32_t lengths[] = {2u, 4u, 16u, 64u, 256u, MAX_BYTES};
+    double efficiency;
+    uint32_t i;
+
+    simInit();
+    simSetSpiSlave(echo, 0);
+    simWatchPin(BOARD_SPI1_CS_PORT, BOARD_SPI1_CS_PIN, onSlaveSelect, 0);
+
+    configClock(&clockPll80MHz);
+    initSPI_SSM();
+
+    printf("SCK %.0f Hz, PCLK2 %u Hz\n", sckHz(), getPclk2Hz());
+    printf("%-22s %6s %10s %10s %9s %8s\n", "transfer", "bytes", "time us", "kB/s", "line", "reg/frm");
+
+    for(i = 0; i < (sizeof(lengths) / sizeof(lengths[0])); i++)
+    {
+        efficiency = benchStream(lengths[i], SPI_FRAME_8BIT);
+        if((SPI1_MAX_SCK_HZ <= 1000000u) && (lengths[i] >= 64u))
+        {
+            check(efficiency > 0.97, "8-bit stream gap free at the default SCK");
+        }
+
+        efficiency = benchStream(lengths[i], SPI_FRAME_16BIT);
+        if((SPI1_MAX_SCK_HZ <= 1000000u) && (lengths[i] >= 64u))
+        {
+            check(efficiency > 0.97, "16-bit stream gap free at the default SCK");
+        }
+    }
+
+    benchSingle(64u);
+
+    checkRefused();
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,557 @@
+/*****************************************************************
+ tasksim
+
+    Runs the cooperative task executor (Task.c) on the host against
+    simulated peripherals and reports how long woken tasks wait to
+    run and how the CPU is shared between them.
+
+    Time is counted in core cycles at 80MHz. Task code "uses" the
+    CPU by calling work(), and any peripheral events that fall due
+    meanwhile are handled as interrupts would be, by waking the task
+    waiting on them. When no task is ready the simulation skips to
+    the next event, like the core sleeping in WFI.
+
+    The simulated peripherals mirror TaskIO.c: a one-shot timer, a
+    DMA SPI bus serving one burst at a time, and UART1 with 256 byte
+    ring buffers running at 115200 baud.
+
+    Four workflows run together:
+      sensor   reads 15 bytes over SPI every millisecond
+      echo     sends every received UART byte back
+      logger   writes a 200 byte report every 50ms
+      hog      does 50us of work at a time, yielding in between
+
+    Build:  cc -O2 -I.. -o tasksim tasksim.c ../Task.c
+    Usage:  tasksim [seconds]
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "Task.h"
+
+#define CPU_HZ              80000000u
+#define US(us)              ((uint32_t)(us) * (CPU_HZ / 1000000u))
+
+#define SPI_CYCLES_PER_BYTE 64u         //10MHz SCK
+#define UART_CYCLES_PER_BYTE 6944u      //10 BITS AT 115200 BAUD
+#define UART_BUFFER_SIZE    256u
+#define MAX_TIMERS          8u
+
+//CURRENT TIME IN CORE CYCLES
+static uint64_t now = 0;
+
+
+/**********************************************************************************/
+/******************************Simulated Peripherals*******************************/
+/**********************************************************************************/
+
+
+typedef struct
+{
+    uint64_t expiry;
+    Task *task;
+    uint8_t running;
+} SimTimer;
+
+typedef struct SimSpi SimSpi;
+
+struct SimSpi
+{
+    SimSpi *next;
+    Task *task;
+    uint32_t count;
+    volatile uint8_t done;
+};
+
+static SimTimer *timers[MAX_TIMERS];
+
+static SimSpi *spiHead = 0;
+static SimSpi *spiTail = 0;
+static uint64_t spiDoneAt = 0;
+
+static uint32_t rxAvailable = 0;
+static uint64_t rxNextAt = 0;
+static uint32_t rxBytes = 0;
+static uint32_t rxDropped = 0;
+static Task *rxWaiter = 0;
+
+static uint32_t txUsed = 0;
+static uint64_t txNextAt = 0;
+static uint32_t txBytes = 0;
+static Task *txWaiter = 0;
+
+
+static uint32_t readClock(void)
+{
+    return (uint32_t)now;
+}
+
+/*****************************************************************
+ nextRx
+
+    Bytes arrive in bursts of 1 to 16 back to back, with a random
+    gap of up to 5ms between bursts.
+*****************************************************************/
+static void nextRx(void)
+{
+    static uint32_t burstLeft = 0;
+
+    if(burstLeft == 0u)
+    {
+        burstLeft = 1u + (uint32_t)(rand() % 16);
+        rxNextAt = now + US(rand() % 5000);
+    }
+    else
+    {
+        rxNextAt = now + UART_CYCLES_PER_BYTE;
+    }
+
+    burstLeft--;
+}
+
+/*****************************************************************
+ runEvents
+
+    Handles every peripheral event due up to 'until', in time
+    order, then moves the clock on to 'until'.
+*****************************************************************/
+static void runEvents(uint64_t until)
+{
+    while(1)
+    {
+        uint64_t first = until + 1u;
+        SimTimer *timer = 0;
+        uint32_t i;
+
+        for(i = 0; i < MAX_TIMERS; i++)
+        {
+            if(timers[i] && timers[i]->running && (timers[i]->expiry < first))
+            {
+                first = timers[i]->expiry;
+                timer = timers[i];
+            }
+        }
+
+        if(spiHead && (spiDoneAt < first))
+        {
+            first = spiDoneAt;
+            timer = 0;
+        }
+
+        if(rxNextAt < first)
+        {
+            first = rxNextAt;
+            timer = 0;
+        }
+
+        if(txUsed && (txNextAt < first))
+        {
+            first = txNextAt;
+            timer = 0;
+        }
+
+        if(first > until)
+        {
+            break;
+        }
+
+        now = first;
+
+        if(timer)
+        {
+            timer->running = 0;
+            wakeTask(timer->task);
+        }
+        else if(spiHead && (spiDoneAt == first))
+        {
+            SimSpi *spi = spiHead;
+
+            spiHead = spi->next;
+            if(!spiHead)
+            {
+                spiTail = 0;
+            }
+            else
+            {
+                spiDoneAt = now + ((uint64_t)spiHead->count * SPI_CYCLES_PER_BYTE);
+            }
+
+            spi->done = 1;
+            wakeTask(spi->task);
+        }
+        else if(rxNextAt == first)
+        {
+            if(rxAvailable < UART_BUFFER_SIZE)
+            {
+                rxAvailable++;
+                rxBytes++;
+                if(rxWaiter)
+                {
+                    wakeTask(rxWaiter);
+                }
+            }
+            else
+            {
+                rxDropped++;
+            }
+
+            nextRx();
+        }
+        else
+        {
+            txUsed--;
+            txBytes++;
+            txNextAt = now + UART_CYCLES_PER_BYTE;
+
+            if((txUsed == 0u) && txWaiter)
+            {
+                wakeTask(txWaiter);
+            }
+        }
+    }
+
+    now = until;
+}
+
+/*****************************************************************
+ nextEvent
+
+    Returns the time of the next peripheral event
+*****************************************************************/
+static uint64_t nextEvent(void)
+{
+    uint64_t first = rxNextAt;
+    uint32_t i;
+
+    for(i = 0; i < MAX_TIMERS; i++)
+    {
+        if(timers[i] && timers[i]->running && (timers[i]->expiry < first))
+        {
+            first = timers[i]->expiry;
+        }
+    }
+
+    if(spiHead && (spiDoneAt < first))
+    {
+        first = spiDoneAt;
+    }
+
+    if(txUsed && (txNextAt < first))
+    {
+        first = txNextAt;
+    }
+
+    return first;
+}
+
+//TASK CODE TAKING 'cycles' OF CPU TIME
+static void work(uint32_t cycles)
+{
+    runEvents(now + cycles);
+}
+
+static void addTimer(SimTimer *timer)
+{
+    uint32_t i;
+
+    for(i = 0; i < MAX_TIMERS; i++)
+    {
+        if(!timers[i])
+        {
+            timers[i] = timer;
+            return;
+        }
+    }
+}
+
+//THE SAME SHAPE AS startTaskTimer AND queueTaskSpiTransfer IN TaskIO.c
+static void startSimTimer(Task *task, SimTimer *timer, uint64_t expiry)
+{
+    timer->expiry = expiry;
+    timer->task = task;
+    timer->running = 1;
+}
+
+static void queueSimSpi(Task *task, SimSpi *spi, uint32_t count)
+{
+    spi->next = 0;
+    spi->task = task;
+    spi->count = count;
+    spi->done = 0;
+
+    if(spiTail)
+    {
+        spiTail->next = spi;
+    }
+    else
+    {
+        spiHead = spi;
+        spiDoneAt = now + ((uint64_t)count * SPI_CYCLES_PER_BYTE);
+    }
+    spiTail = spi;
+}
+
+static uint8_t simRxReady(Task *task)
+{
+    rxWaiter = task;
+
+    if(rxAvailable == 0u)
+    {
+        return 0;
+    }
+
+    rxWaiter = 0;
+    return 1;
+}
+
+static uint8_t simTxReady(Task *task, uint32_t len)
+{
+    txWaiter = task;
+
+    if((UART_BUFFER_SIZE - txUsed) < len)
+    {
+        return 0;
+    }
+
+    txWaiter = 0;
+    return 1;
+}
+
+static void simWrite(uint32_t len)
+{
+    if(txUsed == 0u)
+    {
+        txNextAt = now + UART_CYCLES_PER_BYTE;
+    }
+
+    txUsed += len;
+}
+
+#define SIM_SLEEP_UNTIL(task, timer, expiry)                            \
+    do                                                                  \
+    {                                                                   \
+        startSimTimer((task), (timer), (expiry));                       \
+        TASK_WAIT_UNTIL((task), !(timer)->running);                     \
+    } while(0)
+
+#define SIM_AWAIT_SPI(task, spi, count)                                 \
+    do                                                                  \
+    {                                                                   \
+        queueSimSpi((task), (spi), (count));                            \
+        TASK_WAIT_UNTIL((task), (spi)->done);                           \
+    } while(0)
+
+
+/**********************************************************************************/
+/************************************Workflows*************************************/
+/**********************************************************************************/
+
+
+#define SENSOR_PERIOD       US(1000)
+#define LOGGER_PERIOD       US(50000)
+#define LOGGER_BYTES        200u
+
+typedef struct
+{
+    SimTimer timer;
+    SimSpi spi;
+    uint64_t due;
+    uint64_t maxLate;           //LONGEST FROM DUE TO THE SPI READ STARTING
+    uint32_t reads;
+} Sensor;
+
+typedef struct
+{
+    uint32_t echoed;
+} Echo;
+
+typedef struct
+{
+    SimTimer timer;
+    uint64_t due;
+    uint32_t reports;
+} Logger;
+
+typedef struct
+{
+    uint32_t slices;
+} Hog;
+
+static uint8_t sensorTask(Task *task)
+{
+    Sensor *sensor = (Sensor *)task->arg;
+
+    TASK_BEGIN(task);
+
+    sensor->due = now;
+
+    while(1)
+    {
+        sensor->due += SENSOR_PERIOD;
+        SIM_SLEEP_UNTIL(task, &sensor->timer, sensor->due);
+
+        if((now - sensor->due) > sensor->maxLate)
+        {
+            sensor->maxLate = now - sensor->due;
+        }
+
+        //READ THE FIFO COUNT AND A SAMPLE, THEN CONVERT IT
+        SIM_AWAIT_SPI(task, &sensor->spi, 15u);
+        work(US(20));
+        sensor->reads++;
+    }
+
+    TASK_END(task);
+}
+
+static uint8_t echoTask(Task *task)
+{
+    Echo *echo = (Echo *)task->arg;
+
+    TASK_BEGIN(task);
+
+    while(1)
+    {
+        TASK_WAIT_UNTIL(task, simRxReady(task));
+        TASK_WAIT_UNTIL(task, simTxReady(task, 1u));
+
+        rxAvailable--;
+        simWrite(1u);
+        work(US(2));
+        echo->echoed++;
+    }
+
+    TASK_END(task);
+}
+
+static uint8_t loggerTask(Task *task)
+{
+    Logger *logger = (Logger *)task->arg;
+
+    TASK_BEGIN(task);
+
+    logger->due = now;
+
+    while(1)
+    {
+        logger->due += LOGGER_PERIOD;
+        SIM_SLEEP_UNTIL(task, &logger->timer, logger->due);
+
+        //FORMAT THE REPORT, THEN WAIT FOR ROOM FOR ALL OF IT
+        work(US(100));
+        TASK_WAIT_UNTIL(task, simTxReady(task, LOGGER_BYTES));
+        simWrite(LOGGER_BYTES);
+        logger->reports++;
+    }
+
+    TASK_END(task);
+}
+
+static uint8_t hogTask(Task *task)
+{
+    Hog *hog = (Hog *)task->arg;
+
+    TASK_BEGIN(task);
+
+    while(1)
+    {
+        work(US(50));
+        hog->slices++;
+        TASK_YIELD(task);
+    }
+
+    TASK_END(task);
+}
+
+
+int main(int argc, char **argv)
+{
+    static Task tasks[4];
+    static const char *const names[4] = { "sensor", "echo", "logger", "hog" };
+    static Sensor sensor;
+    static Echo echo;
+    static Logger logger;
+    static Hog hog;
+    double seconds = (argc > 1) ? atof(argv[1]) : 10.0;
+    uint64_t end = (uint64_t)(seconds * CPU_HZ);
+    uint64_t idle = 0;
+    uint32_t passes = 0;
+    uint32_t i;
+    unsigned failed = 0;
+
+    srand(1);
+    nextRx();
+
+    addTimer(&sensor.timer);
+    addTimer(&logger.timer);
+
+    initTasks(readClock);
+    addTask(&tasks[0], sensorTask, &sensor);
+    addTask(&tasks[1], echoTask, &echo);
+    addTask(&tasks[2], loggerTask, &logger);
+    addTask(&tasks[3], hogTask, &hog);
+
+    while(now < end)
+    {
+        runTasks();
+        passes++;
+
+        //NOTHING WOKEN, SLEEP UNTIL THE NEXT INTERRUPT
+        if(!*getTaskFlag())
+        {
+            uint64_t next = nextEvent();
+
+            idle += next - now;
+            runEvents(next);
+        }
+    }
+
+    printf("%.1f simulated seconds, %lu passes, %.1f%% idle\n\n",
+           seconds, (unsigned long)passes, 100.0 * (double)idle / (double)now);
+    printf("task     runs       mean wake-to-run  max wake-to-run\n");
+
+    for(i = 0; i < 4u; i++)
+    {
+        printf("%-8s %-10lu %9.2f us %14.2f us\n", names[i], (unsigned long)tasks[i].runs,
+               (double)tasks[i].totalLatency / tasks[i].runs / (CPU_HZ / 1000000u),
+               (double)tasks[i].maxLatency / (CPU_HZ / 1000000u));
+    }
+
+    printf("\nsensor   %lu reads, latest %.2f us after due\n", (unsigned long)sensor.reads,
+           (double)sensor.maxLate / (CPU_HZ / 1000000u));
+    printf("echo     %lu of %lu bytes echoed, %lu dropped\n", (unsigned long)echo.echoed,
+           (unsigned long)rxBytes, (unsigned long)rxDropped);
+    printf("logger   %lu reports\n", (unsigned long)logger.reports);
+    printf("hog      %lu slices of 50 us\n", (unsigned long)hog.slices);
+
+    //THE HOG NEVER RUNS MORE THAN ONE SLICE BEFORE THE OTHERS GET A
+    //TURN, SO NO ONE WAITS MUCH LONGER THAN ONE PASS OVER EVERY TASK
+    if(sensor.reads < (uint32_t)(seconds * 1000.0) - 1u)
+    {
+        printf("FAIL sensor missed reads\n");
+        failed++;
+    }
+
+    if(sensor.maxLate > US(200))
+    {
+        printf("FAIL sensor started late\n");
+        failed++;
+    }
+
+    if((echo.echoed + 16u < rxBytes) || rxDropped)
+    {
+        printf("FAIL echo fell behind\n");
+        failed++;
+    }
+
+    if(logger.reports < (uint32_t)(seconds * 20.0) - 1u)
+    {
+        printf("FAIL logger missed reports\n");
+        failed++;
+    }
+
+    printf("%s\n", failed ? "FAILED" : "all workflows kept up");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,366 @@
+/*****************************************************************
+ timercheck
+
+    Checks the heap of software timers in Timer.c against the TIM2
+    model in host/sim/, with TIM2_IRQHandler called by the simulated
+    NVIC exactly as the STM32 would call it.
+
+      wrap      one-shot and periodic timers started just before
+                the 32-bit counter wraps fire in order, at their
+                tick, on both sides of the wrap, and periodic ones
+                don't drift
+      many      thousands of one-shot and periodic timers with
+                random delays, some stopped and some restarted part
+                way, all while the counter wraps. Every timer must
+                fire at its tick, in expiry order, never after it
+                was stopped, and nextTimerTicks must always give
+                the time to the earliest one
+      full      starting one more than TIMER_MAX_TIMERS timers is
+                refused, and restarting a running one is not
+    A reference model of every timer's next expiry is kept next to
+    the heap and compared with it.
+
+    Build:  cc -O2 -no-pie -DTIMER_MAX_TIMERS=4096 -I../../host/sim -I.. -o timercheck timercheck.c ../../host/sim/sim.c ../Timer.c ../Clock.c
+    Usage:  timercheck [timers]
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Clock.h"
+#include "Timer.h"
+
+//LATEST A TIMER MAY FIRE, IN TICKS. THE HANDLER TAKES A LITTLE
+//TIME FOR EACH TIMER DUE AT ONCE
+#define MAX_LATE        8u
+
+//LONGEST RANDOM DELAY AND PERIOD
+#define MAX_DELAY       400000u
+#define MAX_PERIOD      150000u
+
+static SoftTimer timers[TIMER_MAX_TIMERS + 1u];
+
+//REFERENCE MODEL
+static uint32_t expect[TIMER_MAX_TIMERS + 1u];
+static uint32_t periods[TIMER_MAX_TIMERS + 1u];
+static uint8_t running[TIMER_MAX_TIMERS + 1u];
+
+//WHAT THE CALLBACKS SAW
+static uint32_t fires = 0;
+static uint32_t lastExpect = 0;
+static uint32_t worstLate = 0;
+static uint32_t badFires = 0;
+static uint32_t lateFires = 0;
+static uint32_t outOfOrder = 0;
+static uint32_t badStarts = 0;
+
+static uint32_t seed = 1u;
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+static uint32_t random32(void)
+{
+    seed = (seed * 1103515245u) + 12345u;
+
+    return (seed >> 8) ^ (seed << 20);
+}
+
+ /*****************************************************************
+ onFire
+
+    Checks a timer fired when the model says it should, then moves
+    the model on as Timer.c moves the timer on
+*****************************************************************/
+static void onFire(void *arg)
+{
+    uint32_t n = (uint32_t)(uintptr_t)arg;
+    uint32_t late = getTicks() - expect[n];
+
+    if(!running[n])
+    {
+        badFires++;
+        return;
+    }
+
+    //THE COUNTER HAS PASSED THE EXPIRY, BUT NOT BY MUCH
+    if(late > MAX_LATE)
+    {
+        lateFires++;
+    }
+    worstLate = ((late > worstLate) && (late <= 0x7FFFFFFFu)) ? late : worstLate;
+
+    //EXPIRIES COME OUT OF THE HEAP IN ORDER
+    if((fires > 0u) && ((int32_t)(expect[n] - lastExpect) < 0))
+    {
+        outOfOrder++;
+    }
+    lastExpect = expect[n];
+    fires++;
+
+    if(periods[n])
+    {
+        expect[n] += periods[n];
+    }
+    else
+    {
+        running[n] = 0;
+    }
+}
+
+static uint8_t start(uint32_t n, uint32_t delay, uint32_t period)
+{
+    uint32_t before;
+    uint8_t ok;
+
+    //THE COUNT MOVES ON AS THE REGISTERS ARE READ, SO THE EXPIRY
+    //startTimer CHOSE IS TAKEN FROM THE TIMER, AFTER CHECKING IT
+    __disable_irq();
+    before = getTicks();
+    ok = startTimer(&timers[n], delay, period, onFire, (void *)(uintptr_t)n);
+    if(ok)
+    {
+        if((timers[n].expiry - before - delay) > 2u)
+        {
+            badStarts++;
+        }
+
+        expect[n] = timers[n].expiry;
+        periods[n] = period;
+        running[n] = 1;
+    }
+    __enable_irq();
+
+    return ok;
+}
+
+static void stop(uint32_t n)
+{
+    stopTimer(&timers[n]);
+    running[n] = 0;
+}
+
+ /*****************************************************************
+ checkNext
+
+    nextTimerTicks must give the time to the earliest timer in the
+    model
+
+    Returns
+    1 if it does
+*****************************************************************/
+static uint8_t checkNext(uint32_t count)
+{
+    uint32_t now;
+    uint32_t ticks = 0xFFFFFFFFu;
+    int32_t best = 0x7FFFFFFF;
+    int32_t left;
+    uint8_t any = 0;
+    uint8_t pending;
+    uint32_t n;
+
+    __disable_irq();
+    now = getTicks();
+    pending = nextTimerTicks(&ticks);
+
+    for(n = 0; n < count; n++)
+    {
+        if(running[n])
+        {
+            left = (int32_t)(expect[n] - now);
+            best = (left < best) ? left : best;
+            any = 1;
+        }
+    }
+    __enable_irq();
+
+    if(!any)
+    {
+        return !pending;
+    }
+
+    //nextTimerTicks READS THE COUNTER AGAIN, A TICK OR SO LATER
+    return pending && ((int32_t)ticks <= ((best > 0) ? best : 0)) && ((int32_t)ticks >= (best - 2));
+}
+
+static void resetChecks(void)
+{
+    fires = 0;
+    worstLate = 0;
+    badFires = 0;
+    lateFires = 0;
+    outOfOrder = 0;
+}
+
+static void checkWrap(void)
+{
+    static const uint32_t delays[] = {9000u, 1000u, 7000u, 3000u, 5000u, 2000u, 8000u, 4000u};
+    uint32_t count = sizeof(delays) / sizeof(delays[0]);
+    uint32_t periodic = count;
+    uint32_t begin;
+    uint32_t first;
+    uint32_t n;
+
+    resetChecks();
+
+    //5000 TICKS BEFORE THE WRAP
+    TIM2->CNT = 0xFFFFFFFFu - 5000u;
+    begin = getTicks();
+
+    for(n = 0; n < count; n++)
+    {
+        start(n, delays[n], 0);
+    }
+    start(periodic, 1500u, 1500u);
+    first = expect[periodic];
+
+    simRunUs(10000u);
+
+    check((int32_t)(getTicks() - begin) > 10000, "counter wrapped");
+    check(fires == count + 6u, "one-shot timers fired once, periodic every period");
+    check(outOfOrder == 0u, "fired in order across the wrap");
+    check(lateFires == 0u, "fired on time across the wrap");
+
+    //STILL ON ITS ORIGINAL GRID AFTER 6 PERIODS, WHATEVER THE
+    //HANDLER'S LATENCY WAS
+    check(timers[periodic].expiry == first + (6u * 1500u), "periodic timer doesn't drift");
+    stop(periodic);
+
+    check(checkNext(periodic + 1u), "nothing pending");
+    check(!(TIM2->DIER & (1u << 1)), "compare interrupt off with nothing pending");
+}
+
+static void checkMany(uint32_t count)
+{
+    SimStats before;
+    SimStats after;
+    uint32_t expected = 0;
+    uint32_t nextOk = 1;
+    uint32_t step;
+    uint32_t n;
+
+    resetChecks();
+
+    //THE RUN GOES THROUGH THE WRAP
+    TIM2->CNT = 0xFFFFFFFFu - (MAX_DELAY / 2u);
+
+    for(n = 0; n < count; n++)
+    {
+        if((n & 3u) == 0u)
+        {
+            start(n, 1u + (random32() % MAX_DELAY), 20000u + (random32() % MAX_PERIOD));
+        }
+        else
+        {
+            start(n, 1u + (random32() % MAX_DELAY), 0);
+        }
+    }
+
+    simGetStats(&before);
+
+    for(step = 0; step < 40u; step++)
+    {
+        simRunUs(MAX_DELAY / 20u);
+        nextOk &= checkNext(count);
+
+        //NOW AND THEN STOP SOME AND RESTART OTHERS, RUNNING OR NOT
+        if((step % 8u) == 3u)
+        {
+            for(n = 0; n < (count / 16u); n++)
+            {
+                stop(random32() % count);
+                start(random32() % count, 1u + (random32() % MAX_DELAY), ((n & 1u) ? 0u : 30000u));
+            }
+            nextOk &= checkNext(count);
+        }
+    }
+
+    simGetStats(&after);
+
+    for(n = 0; n < count; n++)
+    {
+        stop(n);
+    }
+
+    //EVERY ONE-SHOT STARTED EARLY ENOUGH HAS FIRED
+    for(n = 0; n < count; n++)
+    {
+        expected += (periods[n] == 0u) && running[n];
+    }
+
+    check(fires > count, "timers fired");
+    check(badFires == 0u, "no timer fired after it was stopped");
+    check(lateFires == 0u, "every timer fired at its tick");
+    check(outOfOrder == 0u, "timers fired in expiry order");
+    check(nextOk, "nextTimerTicks gives the earliest timer");
+    check(badStarts == 0u, "every expiry 'delay' ticks after the start");
+    check(expected == 0u, "stopped timers left the model");
+    check(checkNext(count), "nothing pending after stopping them all");
+
+    printf("%u timers: %u fired, %llu interrupts (%.2f timers each), worst %u ticks late\n",
+           count, fires, (unsigned long long)(after.interrupts - before.interrupts),
+           (double)fires / (double)(after.interrupts - before.interrupts), worstLate);
+}
+
+static void checkFull(void)
+{
+    uint32_t n;
+    uint8_t ok = 1;
+
+    for(n = 0; n < TIMER_MAX_TIMERS; n++)
+    {
+        ok &= start(n, 1000000u + n, 0);
+    }
+
+    check(ok, "TIMER_MAX_TIMERS timers started");
+    check(!start(TIMER_MAX_TIMERS, 1000u, 0), "one more refused");
+    check(start(0u, 500u, 0), "a running timer can still be restarted");
+
+    resetChecks();
+    simRunUs(600u);
+    check((fires == 1u) && (lateFires == 0u), "restarted timer fired at its new time");
+
+    for(n = 0; n < TIMER_MAX_TIMERS; n++)
+    {
+        stop(n);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t count = (argc > 1) ? (uint32_t)strtoul(argv[1], 0, 0) : 4000u;
+
+    if((count == 0u) || (count > TIMER_MAX_TIMERS))
+    {
+        printf("timers must be 1 to %u, build with a bigger TIMER_MAX_TIMERS for more\n", TIMER_MAX_TIMERS);
+        return 1;
+    }
+
+    simInit();
+
+    configClock(&clockPll80MHz);
+    initTim2();
+
+    checkWrap();
+    checkMany(count);
+    checkFull();
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -1,33 +1,134 @@
 #include "stm32l432xx.h"
 #include "Timer.h"
 #include "SPI.h"
+#include "SPIBus.h"
+#include "Clock.h"
+#include "MPU9250.h"
+#include "UART.h"
+#include "Profile.h"
+#include "Power.h"
+#include "Sampler.h"
+#include "Filter.h"
 
+//PROFILING ZONES
+#define ZONE_FIFO_READ  0u
+#define ZONE_SLEEP      1u
+#define ZONE_FUSION     2u
+
+//FIFO SAMPLE RATE SET BY enableFifoMpu9250 BELOW
+#define SAMPLE_HZ       100u
+
+//GYRO SENSITIVITY x 10 AT THE RESET RANGE OF +-250DPS
+#define GYRO_LSB_DPS10  1310u
+
+//LOOP PASSES BETWEEN PROFILE DUMPS (20 x 50MS = 1 SECOND)
+#define DUMP_EVERY      20u
+
+//ROLL AND PITCH WORKED OUT FROM THE SAMPLES
+static Fusion fusion;
+
+
+ /*****************************************************************
+ queryPower
+
+    Tells the power layer what is running. TIM2, TIM7, the DMA and
+    UART1 TX all stop in Stop mode
+*****************************************************************/
+static void queryPower(PowerState *state)
+{
+    state->timerPending = nextTimerTicks(&state->ticksToDeadline);
+    state->busy = busySPI_DMA() || samplerRunning() || (uartTxFree() < UART_TX_BUFFER_SIZE);
+    state->workPending = 0;
+    state->uartStopWake = UART1_CLOCK_HSI16;
+}
 
 int main (void)
 {
-    //MPU9250 Addresses
-    uint8_t data[4] = {187, 188, 189, 190};
+    //STORES SAMPLES READ FROM THE MPU9250 FIFO
+    Mpu9250Sample samples[MPU9250_FIFO_SAMPLES];
+    
+    //NUMBER OF SAMPLES IN samples
+    size_t count = 0;
     
-    //STORES DATA RECEIVED FROM MPU9250
-    uint8_t rxd = 0;
+    size_t i;
     
-    //SET UP THE TIMER
-    initTim2();
+    //COUNTS LOOP PASSES UNTIL THE NEXT PROFILE DUMP
+    uint32_t passes = 0;
     
-    //SETUP SPI MASTER
-    initSPI_SSM();
+    //RUN THE CORE AT 80MHZ. MUST BE DONE BEFORE THE PERIPHERALS
+    //ARE SET UP SO THEY PICK UP THE NEW FREQUENCIES
+    configClock(&clockPll80MHz);
+    
+    //START THE CYCLE COUNTER
+    initProfile();
+    
+    //SET UP THE TIMER, UART1 TO SEND THE PROFILE DUMPS AND THE SPI
+    //BUS FOR THE MPU9250. EACH TAKES A CLOCK LISTENER, SO THEY FAIL
+    //IF CLOCK_MAX_LISTENERS IS TOO SMALL
+    if(!initTim2() || !initUART_IT() || !initSpiBus())
+    {
+        while(1);
+    }
+    
+    //NOTHING TO DO IF THE MPU9250 ISN'T THERE OR DOESN'T ANSWER
+    if(!initMpu9250())
+    {
+        while(1);
+    }
+    
+    //COLLECT SAMPLES IN THE MPU9250 FIFO AT 1KHZ / (1 + 9) = 100HZ
+    enableFifoMpu9250(9);
+    
+    //TRUST THE ACCEL 1/256 PER SAMPLE, THE GYRO FOR THE REST
+    initFusion(&fusion, FUSION_GYRO_GAIN(GYRO_LSB_DPS10, SAMPLE_HZ), 8);
+    
+    //NOTHING NEEDS TO WAKE US APART FROM THE TIMER
+    initPower(0, queryPower);
+    
+    //READ THE SENSOR EVERY 50MS, TIMED BY TIM7 SO IT DOESN'T DRIFT
+    if(!initSampler(MS_TO_TICKS(50))) { while(1); }
     
     while(1)
     {
-        //WRITE TO SPI
-        rxd = transferSPI_SSM(data[0]);
+        //SLEEP UNTIL THE NEXT SAMPLE IS DUE
+        if(!beginSamplerJob())
+        {
+            PROFILE_BEGIN(ZONE_SLEEP);
+            enterLowPower(getSamplerFlag());
+            PROFILE_END(ZONE_SLEEP);
+            continue;
+        }
+        
+        //READ EVERYTHING COLLECTED SINCE THE LAST PASS
+        {
+            PROFILE_BEGIN(ZONE_FIFO_READ);
+            count = readFifoMpu9250(samples, MPU9250_FIFO_SAMPLES);
+            PROFILE_END(ZONE_FIFO_READ);
+        }
         
-        //DELAY MS
-        delay(50);
+        endSamplerJob();
+        
+        //Mpu9250Sample IS A FRAME IN THE ORDER runFusion TAKES
+        {
+            PROFILE_BEGIN(ZONE_FUSION);
+            for(i = 0; i < count; i++)
+            {
+                runFusion(&fusion, &samples[i].accelX);
+            }
+            PROFILE_END(ZONE_FUSION);
+        }
+        
+        //SEND THE STATISTICS ONCE A SECOND, FINISHING ANY DUMP
+        //THAT DIDN'T FIT IN THE UART BUFFER LAST TIME
+        if(++passes >= DUMP_EVERY)
+        {
+            passes = 0;
+            sendProfile(uartWrite);
+            resetProfile();
+        }
+        else
+        {
+            pumpProfile(uartWrite);
+        }
     }
 }
-
-
-
-
-
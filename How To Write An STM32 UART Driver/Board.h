@@ -0,0 +1,154 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+#include "GPIO.h"
+
+/*****************************************************************
+ Board pin maps
+
+    Every wiring of the NUCLEO-L432KC we build for is described
+    below as pin lists in the GPIO.h format, PIN(pin number,
+    alternate function), one list per peripheral per port. The
+    drivers only use the BOARD_... names, which are pointed at the
+    lists of the board being built. Choose the board by defining
+    BOARD in the project settings, e.g. BOARD=BOARD_B.
+
+    Every board is checked when this file is compiled, whichever
+    one is being built:
+    - each pin is one the peripheral can use, with the right
+      alternate function (STM32L432KC datasheet, table 15)
+    - SPI1 has exactly one SCK, one MISO and one MOSI pin, and at
+      most one NSS pin, across both ports
+    - no pin is used twice on the same port
+    TimerIO.c also checks the capture and PWM pins are the ones in
+    the timer pin list.
+
+    A new board needs its lists, its chip select, a BOARD_CHECK
+    line and an entry in the selection at the end.
+*****************************************************************/
+
+#define BOARD_A             1u      //SPI1 ON PA1/PA11/PA12 (FULL-DUPLEX SPI DRIVER)
+#define BOARD_B             2u      //SPI1 ON PA5/PA6/PA7 (GPIO PROGRAMMING #2)
+
+#ifndef BOARD
+#define BOARD               BOARD_A
+#endif
+
+
+//BOARD A. THE MPU9250 ON PA1, PA11, PA12 WITH SLAVE SELECT ON PB0
+#define BOARD_A_SPI1_PORTA_PINS(PIN)    PIN(1, 5)       /*SCLK*/    \
+                                        PIN(11, 5)      /*MISO*/    \
+                                        PIN(12, 5)      /*MOSI*/
+#define BOARD_A_SPI1_PORTB_PINS(PIN)    PIN(0, 5)       /*SSEL*/
+#define BOARD_A_SPI1_CS_PORT            GPIOB
+#define BOARD_A_SPI1_CS_PIN             0u
+#define BOARD_A_UART1_PORTA_PINS(PIN)   PIN(9, 7)       /*TX*/      \
+                                        PIN(10, 7)      /*RX*/
+#define BOARD_A_TIMER_PORTA_PINS(PIN)   PIN(6, 14)      /*TIM16 CH1 CAPTURE*/   \
+                                        PIN(8, 1)       /*TIM1 CH1 PWM*/
+#define BOARD_A_CAPTURE_PIN             timerPinTim16Ch1PA6
+#define BOARD_A_PWM_PIN                 timerPinTim1Ch1PA8
+
+//BOARD B. SPI1 ON PA5, PA6, PA7 WITH SLAVE SELECT ON PB0. PA6 IS
+//MISO SO CAPTURE MOVES TO TIM2 CH3 ON PA2
+#define BOARD_B_SPI1_PORTA_PINS(PIN)    PIN(7, 5)       /*MOSI*/    \
+                                        PIN(6, 5)       /*MISO*/    \
+                                        PIN(5, 5)       /*SCLK*/
+#define BOARD_B_SPI1_PORTB_PINS(PIN)    PIN(0, 5)       /*SSEL*/
+#define BOARD_B_SPI1_CS_PORT            GPIOB
+#define BOARD_B_SPI1_CS_PIN             0u
+#define BOARD_B_UART1_PORTA_PINS(PIN)   PIN(9, 7)       /*TX*/      \
+                                        PIN(10, 7)      /*RX*/
+#define BOARD_B_TIMER_PORTA_PINS(PIN)   PIN(2, 1)       /*TIM2 CH3 CAPTURE*/    \
+                                        PIN(8, 1)       /*TIM1 CH1 PWM*/
+#define BOARD_B_CAPTURE_PIN             timerPinTim2Ch3PA2
+#define BOARD_B_PWM_PIN                 timerPinTim1Ch1PA8
+
+
+//PINS EACH PERIPHERAL CAN USE, ONE BIT PER PIN, AND THE AF THAT
+//CONNECTS THEM
+#define BOARD_SPI1_PORTA_OK(pin, af)    (((af) == 5u) && ((0x98F2u >> (pin)) & 1u))    //PA1,4,5,6,7,11,12,15
+#define BOARD_SPI1_PORTB_OK(pin, af)    (((af) == 5u) && ((0x0039u >> (pin)) & 1u))    //PB0,3,4,5
+#define BOARD_UART1_PORTA_OK(pin, af)   (((af) == 7u) && ((0x1E00u >> (pin)) & 1u))    //PA9,10,11,12
+#define BOARD_TIMER_PORTA_OK(pin, af)   ((((af) == 1u) && ((0x8F2Fu >> (pin)) & 1u))   /*TIM1, TIM2*/      \
+                                       || (((af) == 14u) && ((0x004Cu >> (pin)) & 1u))) /*TIM15, TIM16*/
+
+//SPI1 PINS FOR EACH SIGNAL, ONE BIT PER PIN. THE PIN DECIDES THE
+//SIGNAL, WHATEVER THE LIST'S COMMENT SAYS
+#define BOARD_SPI1_PORTA_SCK            0x0022u     //PA1,5
+#define BOARD_SPI1_PORTA_MISO           0x0840u     //PA6,11
+#define BOARD_SPI1_PORTA_MOSI           0x1080u     //PA7,12
+#define BOARD_SPI1_PORTA_NSS            0x8010u     //PA4,15
+#define BOARD_SPI1_PORTB_SCK            0x0008u     //PB3
+#define BOARD_SPI1_PORTB_MISO           0x0010u     //PB4
+#define BOARD_SPI1_PORTB_MOSI           0x0020u     //PB5
+#define BOARD_SPI1_PORTB_NSS            0x0001u     //PB0
+
+//PER PIN HELPERS USED TO EXPAND A PIN LIST. NOT USED DIRECTLY
+#define BOARD_BAD_SPI1_PORTA_(pin, af)  + !BOARD_SPI1_PORTA_OK(pin, af)
+#define BOARD_BAD_SPI1_PORTB_(pin, af)  + !BOARD_SPI1_PORTB_OK(pin, af)
+#define BOARD_BAD_UART1_PORTA_(pin, af) + !BOARD_UART1_PORTA_OK(pin, af)
+#define BOARD_BAD_TIMER_PORTA_(pin, af) + !BOARD_TIMER_PORTA_OK(pin, af)
+#define BOARD_PIN_OR_(pin, af)          | (1u << (pin))
+#define BOARD_PIN_ADD_(pin, af)         + (1u << (pin))
+
+//PINS IN A LIST THAT FAIL A CHECK, AND ALL THE PINS IN A LIST. IF
+//THE SUM OF THE PIN BITS ON A PORT DIFFERS FROM THEIR OR, SOME PIN
+//IS USED TWICE
+#define BOARD_BAD_PINS(pins, check)     (0u pins(check))
+#define BOARD_PIN_OR(pins)              (0u pins(BOARD_PIN_OR_))
+#define BOARD_PIN_ADD(pins)             (0u pins(BOARD_PIN_ADD_))
+
+//THE PINS OF ONE SPI1 SIGNAL IN THE PORT A AND B LISTS, PORT B IN
+//THE TOP HALF, AND CHECKS FOR ONE OR AT MOST ONE OF THEM
+#define BOARD_SPI1_SIGNAL(pinsA, pinsB, sig)                                        \
+    ((BOARD_PIN_OR(pinsA) & BOARD_SPI1_PORTA_##sig) | ((BOARD_PIN_OR(pinsB) & BOARD_SPI1_PORTB_##sig) << 16))
+#define BOARD_ONE_PIN(bits)             (((bits) != 0u) && (((bits) & ((bits) - 1u)) == 0u))
+#define BOARD_ONE_PIN_AT_MOST(bits)     (((bits) & ((bits) - 1u)) == 0u)
+
+//FAILS TO COMPILE IF BOARD 'b' HAS A BAD PIN OR A CONFLICT
+#define BOARD_CHECK(b)                                                                                          \
+    GPIO_STATIC_ASSERT(BOARD_BAD_PINS(b##_SPI1_PORTA_PINS, BOARD_BAD_SPI1_PORTA_) == 0u, b##_spi1_porta_af);    \
+    GPIO_STATIC_ASSERT(BOARD_BAD_PINS(b##_SPI1_PORTB_PINS, BOARD_BAD_SPI1_PORTB_) == 0u, b##_spi1_portb_af);    \
+    GPIO_STATIC_ASSERT(BOARD_BAD_PINS(b##_UART1_PORTA_PINS, BOARD_BAD_UART1_PORTA_) == 0u, b##_uart1_porta_af); \
+    GPIO_STATIC_ASSERT(BOARD_BAD_PINS(b##_TIMER_PORTA_PINS, BOARD_BAD_TIMER_PORTA_) == 0u, b##_timer_porta_af); \
+    GPIO_STATIC_ASSERT(BOARD_ONE_PIN(BOARD_SPI1_SIGNAL(b##_SPI1_PORTA_PINS, b##_SPI1_PORTB_PINS, SCK)), b##_spi1_sck);   \
+    GPIO_STATIC_ASSERT(BOARD_ONE_PIN(BOARD_SPI1_SIGNAL(b##_SPI1_PORTA_PINS, b##_SPI1_PORTB_PINS, MISO)), b##_spi1_miso); \
+    GPIO_STATIC_ASSERT(BOARD_ONE_PIN(BOARD_SPI1_SIGNAL(b##_SPI1_PORTA_PINS, b##_SPI1_PORTB_PINS, MOSI)), b##_spi1_mosi); \
+    GPIO_STATIC_ASSERT(BOARD_ONE_PIN_AT_MOST(BOARD_SPI1_SIGNAL(b##_SPI1_PORTA_PINS, b##_SPI1_PORTB_PINS, NSS)), b##_spi1_nss); \
+    GPIO_STATIC_ASSERT((BOARD_PIN_ADD(b##_SPI1_PORTA_PINS) + BOARD_PIN_ADD(b##_UART1_PORTA_PINS)                \
+                        + BOARD_PIN_ADD(b##_TIMER_PORTA_PINS))                                                  \
+                       == (BOARD_PIN_OR(b##_SPI1_PORTA_PINS) | BOARD_PIN_OR(b##_UART1_PORTA_PINS)               \
+                           | BOARD_PIN_OR(b##_TIMER_PORTA_PINS)), b##_porta_conflict);                          \
+    GPIO_STATIC_ASSERT(BOARD_PIN_ADD(b##_SPI1_PORTB_PINS) == BOARD_PIN_OR(b##_SPI1_PORTB_PINS), b##_portb_conflict); \
+    GPIO_STATIC_ASSERT(b##_SPI1_CS_PIN < 16u, b##_cs_pin)
+
+BOARD_CHECK(BOARD_A);
+BOARD_CHECK(BOARD_B);
+
+
+//THE BOARD BEING BUILT
+#if BOARD == BOARD_A
+#define BOARD_SPI1_PORTA_PINS           BOARD_A_SPI1_PORTA_PINS
+#define BOARD_SPI1_PORTB_PINS           BOARD_A_SPI1_PORTB_PINS
+#define BOARD_SPI1_CS_PORT              BOARD_A_SPI1_CS_PORT
+#define BOARD_SPI1_CS_PIN               BOARD_A_SPI1_CS_PIN
+#define BOARD_UART1_PORTA_PINS          BOARD_A_UART1_PORTA_PINS
+#define BOARD_TIMER_PORTA_PINS          BOARD_A_TIMER_PORTA_PINS
+#define BOARD_CAPTURE_PIN               BOARD_A_CAPTURE_PIN
+#define BOARD_PWM_PIN                   BOARD_A_PWM_PIN
+#elif BOARD == BOARD_B
+#define BOARD_SPI1_PORTA_PINS           BOARD_B_SPI1_PORTA_PINS
+#define BOARD_SPI1_PORTB_PINS           BOARD_B_SPI1_PORTB_PINS
+#define BOARD_SPI1_CS_PORT              BOARD_B_SPI1_CS_PORT
+#define BOARD_SPI1_CS_PIN               BOARD_B_SPI1_CS_PIN
+#define BOARD_UART1_PORTA_PINS          BOARD_B_UART1_PORTA_PINS
+#define BOARD_TIMER_PORTA_PINS          BOARD_B_TIMER_PORTA_PINS
+#define BOARD_CAPTURE_PIN               BOARD_B_CAPTURE_PIN
+#define BOARD_PWM_PIN                   BOARD_B_PWM_PIN
+#else
+#error "BOARD must be BOARD_A or BOARD_B"
+#endif
+
+#endif
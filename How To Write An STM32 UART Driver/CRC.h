@@ -0,0 +1,24 @@
+// CRC-32 AS USED BY ETHERNET, ZLIB AND PNG. POLYNOMIAL 0x04C11DB7,
+// INITIAL VALUE 0xFFFFFFFF, BITS REFLECTED, RESULT INVERTED.
+// THE CRC OF "123456789" IS 0xCBF43926
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 1 TO USE THE CRC UNIT, 0 FOR THE TABLE. THE HOST USES THE TABLE
+// SO Frame.c AND THE HOST TOOLS BUILD UNCHANGED. host/crcbench.c
+// SETS IT TO 1 TO RUN THE CRC UNIT CODE AGAINST host/sim/
+#ifndef CRC_USE_HARDWARE
+#if defined(__arm__) || defined(__ARM_ARCH)
+#define CRC_USE_HARDWARE        1
+#else
+#define CRC_USE_HARDWARE        0
+#endif
+#endif
+
+void initCrc(void);
+void startCrc32(void);
+void addCrc32(const void *data, size_t len);
+uint32_t finishCrc32(void);
+uint32_t calcCrc32(const void *data, size_t len);
+uint32_t calcCrc32Table(const void *data, size_t len);
@@ -0,0 +1,447 @@
+#include "stm32l432xx.h"
+#include "Clock.h"
+
+
+//MSI FREQUENCY FOR EACH MSIRANGE VALUE
+static const uint32_t msiRangeHz[12] =
+{
+    100000u, 200000u, 400000u, 800000u, 1000000u, 2000000u,
+    4000000u, 8000000u, 16000000u, 24000000u, 32000000u, 48000000u
+};
+
+//RESET STATE. 4MHZ MSI, NO PRESCALERS
+const ClockConfig clockMsi4MHz  = {CLOCK_SOURCE_MSI,   6u, CLOCK_SOURCE_MSI,   1u,  8u, 2u, 1u, 1u, 1u};
+
+//16MHZ HSI16, NO PRESCALERS
+const ClockConfig clockHsi16MHz = {CLOCK_SOURCE_HSI16, 6u, CLOCK_SOURCE_HSI16, 1u,  8u, 2u, 1u, 1u, 1u};
+
+//80MHZ FROM THE PLL. 4MHZ MSI / 1 * 40 / 2
+const ClockConfig clockPll80MHz = {CLOCK_SOURCE_PLL,   6u, CLOCK_SOURCE_MSI,   1u, 40u, 2u, 1u, 1u, 1u};
+
+//CONFIGURATION CURRENTLY IN USE
+static const ClockConfig *currentConfig = &clockMsi4MHz;
+
+//FREQUENCIES CURRENTLY IN USE
+static uint32_t sysclkHz = 4000000u;
+static uint32_t hclkHz = 4000000u;
+static uint32_t pclk1Hz = 4000000u;
+static uint32_t pclk2Hz = 4000000u;
+static uint8_t apb1Div = 1u;
+static uint8_t apb2Div = 1u;
+
+//CALLED AFTER EVERY CLOCK CHANGE SO DRIVERS CAN RE-TIME THEMSELVES
+static ClockListener listeners[CLOCK_MAX_LISTENERS];
+static uint32_t listenerCount = 0;
+
+
+/*****************************************************************
+ calcSysclkHz
+ 
+    Works out the SYSCLK frequency a configuration would give
+    
+    Returns
+    the frequency in Hz, 0 if the configuration is not valid
+*****************************************************************/
+uint32_t calcSysclkHz(const ClockConfig *config)
+{
+    uint32_t inputHz;
+    uint32_t vcoHz;
+    
+    if(config->msiRange > 11u)
+    {
+        return 0;
+    }
+    
+    if(config->source == CLOCK_SOURCE_MSI)
+    {
+        return msiRangeHz[config->msiRange];
+    }
+    
+    if(config->source == CLOCK_SOURCE_HSI16)
+    {
+        return 16000000u;
+    }
+    
+    if(config->source != CLOCK_SOURCE_PLL)
+    {
+        return 0;
+    }
+    
+    //CHECK THE PLL SETTINGS ARE IN RANGE
+    if((config->pllM < 1u) || (config->pllM > 8u)
+     ||(config->pllN < 8u) || (config->pllN > 86u)
+     ||(config->pllR < 2u) || (config->pllR > 8u) || (config->pllR & 1u))
+    {
+        return 0;
+    }
+    
+    if(config->pllInput == CLOCK_SOURCE_MSI)
+    {
+        inputHz = msiRangeHz[config->msiRange];
+    }
+    else if(config->pllInput == CLOCK_SOURCE_HSI16)
+    {
+        inputHz = 16000000u;
+    }
+    else
+    {
+        return 0;
+    }
+    
+    //PLL INPUT MUST BE 4 TO 16MHZ AND VCO 64 TO 344MHZ
+    inputHz /= config->pllM;
+    vcoHz = inputHz * config->pllN;
+    
+    if((inputHz < 4000000u) || (inputHz > 16000000u) || (vcoHz < 64000000u) || (vcoHz > 344000000u))
+    {
+        return 0;
+    }
+    
+    return vcoHz / config->pllR;
+}
+
+/*****************************************************************
+ calcFlashLatency
+ 
+    Returns
+    the number of flash wait states needed at 'hclkHz' in
+    voltage range 1
+*****************************************************************/
+uint8_t calcFlashLatency(uint32_t hclkHz)
+{
+    //ONE EXTRA WAIT STATE FOR EVERY 16MHZ
+    return (uint8_t)((hclkHz - 1u) / 16000000u);
+}
+
+/*****************************************************************
+ calcHpre
+ 
+    Returns
+    the CFGR HPRE bits for an AHB divider, 0xFF if not valid
+*****************************************************************/
+static uint8_t calcHpre(uint16_t div)
+{
+    switch(div)
+    {
+        case 1u:   return 0x0u;
+        case 2u:   return 0x8u;
+        case 4u:   return 0x9u;
+        case 8u:   return 0xAu;
+        case 16u:  return 0xBu;
+        case 64u:  return 0xCu;
+        case 128u: return 0xDu;
+        case 256u: return 0xEu;
+        case 512u: return 0xFu;
+        default:   return 0xFFu;
+    }
+}
+
+/*****************************************************************
+ calcPpre
+ 
+    Returns
+    the CFGR PPRE1/PPRE2 bits for an APB divider, 0xFF if not
+    valid
+*****************************************************************/
+static uint8_t calcPpre(uint8_t div)
+{
+    switch(div)
+    {
+        case 1u:  return 0x0u;
+        case 2u:  return 0x4u;
+        case 4u:  return 0x5u;
+        case 8u:  return 0x6u;
+        case 16u: return 0x7u;
+        default:  return 0xFFu;
+    }
+}
+
+/*****************************************************************
+ setFlashLatency
+ 
+    Sets the number of flash wait states and waits until the flash
+    interface is using them
+*****************************************************************/
+static void setFlashLatency(uint8_t latency)
+{
+    FLASH->ACR = (FLASH->ACR & ~(7u << 0)) | latency;
+    
+    while((FLASH->ACR & (7u << 0)) != latency);
+}
+
+/*****************************************************************
+ switchSysclk
+ 
+    Selects the SYSCLK source and waits until the switch is done
+*****************************************************************/
+static void switchSysclk(uint8_t source)
+{
+    RCC->CFGR = (RCC->CFGR & ~(3u << 0)) | source;
+    
+    while(((RCC->CFGR >> 2) & 3u) != source);
+}
+
+/*****************************************************************
+ startOscillators
+ 
+    Turns on and sets the range of the oscillators a configuration
+    needs
+*****************************************************************/
+static void startOscillators(const ClockConfig *config)
+{
+    uint8_t needMsi = (config->source == CLOCK_SOURCE_MSI)
+                    ||((config->source == CLOCK_SOURCE_PLL) && (config->pllInput == CLOCK_SOURCE_MSI));
+    
+    if(needMsi)
+    {
+        //MSI RANGE CAN ONLY BE CHANGED WHILE MSI IS OFF OR READY
+        RCC->CR |= (1u << 0);                               //MSI ON
+        while(!(RCC->CR & (1u << 1)));                      //WAIT FOR MSIRDY
+        
+        RCC->CR = (RCC->CR & ~(15u << 4))                   //CLEAR MSIRANGE
+                | ((uint32_t)config->msiRange << 4)         //SET MSIRANGE
+                | (1u << 3);                                //TAKE RANGE FROM RCC_CR
+        while(!(RCC->CR & (1u << 1)));                      //WAIT FOR MSIRDY
+    }
+    else
+    {
+        RCC->CR |= (1u << 8);                               //HSI16 ON
+        while(!(RCC->CR & (1u << 10)));                     //WAIT FOR HSIRDY
+    }
+}
+
+/*****************************************************************
+ startPll
+ 
+    Programs and starts the PLL. Must not be running from the PLL
+    when this is called
+*****************************************************************/
+static void startPll(const ClockConfig *config)
+{
+    //PLL CAN ONLY BE CONFIGURED WHILE IT IS OFF
+    RCC->CR &= ~(1u << 24);                                 //PLL OFF
+    while(RCC->CR & (1u << 25));                            //WAIT FOR PLLRDY TO CLEAR
+    
+    RCC->PLLCFGR = ((uint32_t)((config->pllR / 2u) - 1u) << 25)  //PLLR
+                 | (1u << 24)                                    //PLLR OUTPUT ENABLED
+                 | ((uint32_t)config->pllN << 8)                 //PLLN
+                 | ((uint32_t)(config->pllM - 1u) << 4)          //PLLM
+                 | ((config->pllInput == CLOCK_SOURCE_MSI) ? 1u : 2u); //PLL SOURCE MSI OR HSI16
+    
+    RCC->CR |= (1u << 24);                                  //PLL ON
+    while(!(RCC->CR & (1u << 25)));                         //WAIT FOR PLLRDY
+}
+
+/*****************************************************************
+ configClock
+ 
+    Switches the system clock to a new configuration, adjusting
+    the flash wait states, and tells every listener so the
+    peripherals can re-time themselves. Should be called while
+    no transfers are in progress.
+    
+    Returns
+    1 on success, 0 if the configuration is not valid
+*****************************************************************/
+uint8_t configClock(const ClockConfig *config)
+{
+    uint32_t newSysclkHz = calcSysclkHz(config);
+    uint32_t newHclkHz;
+    uint8_t hpre = calcHpre(config->ahbDiv);
+    uint8_t ppre1 = calcPpre(config->apb1Div);
+    uint8_t ppre2 = calcPpre(config->apb2Div);
+    uint8_t hsiWasOn;
+    uint8_t needHsi = (config->source == CLOCK_SOURCE_HSI16)
+                    ||((config->source == CLOCK_SOURCE_PLL) && (config->pllInput == CLOCK_SOURCE_HSI16));
+    uint8_t latency;
+    uint32_t i;
+    
+    if((newSysclkHz == 0u) || (hpre == 0xFFu) || (ppre1 == 0xFFu) || (ppre2 == 0xFFu))
+    {
+        return 0;
+    }
+    
+    newHclkHz = newSysclkHz / config->ahbDiv;
+    
+    if(newHclkHz > CLOCK_MAX_HZ)
+    {
+        return 0;
+    }
+    
+    latency = calcFlashLatency(newHclkHz);
+    
+    //MORE WAIT STATES ARE NEEDED BEFORE SPEEDING UP
+    if(newHclkHz > hclkHz)
+    {
+        setFlashLatency(latency);
+    }
+    
+    //GET OFF THE PLL BEFORE ITS INPUT CAN CHANGE. HSI16 IS FINE AT
+    //ANY WAIT STATES, SO RUN FROM IT WHILE THE PLL IS OFF
+    hsiWasOn = (RCC->CR & (1u << 8)) != 0u;
+    
+    if(((RCC->CFGR >> 2) & 3u) == CLOCK_SOURCE_PLL)
+    {
+        RCC->CR |= (1u << 8);                               //HSI16 ON
+        while(!(RCC->CR & (1u << 10)));                     //WAIT FOR HSIRDY
+        switchSysclk(CLOCK_SOURCE_HSI16);
+    }
+    
+    RCC->CR &= ~(1u << 24);                                 //PLL OFF
+    while(RCC->CR & (1u << 25));                            //WAIT FOR PLLRDY TO CLEAR
+    
+    startOscillators(config);
+    
+    if(config->source == CLOCK_SOURCE_PLL)
+    {
+        startPll(config);
+    }
+    
+    //SET THE BUS PRESCALERS THEN SWITCH
+    RCC->CFGR = (RCC->CFGR & ~((15u << 4) | (7u << 8) | (7u << 11)))
+              | ((uint32_t)hpre << 4)                       //AHB PRESCALER
+              | ((uint32_t)ppre1 << 8)                      //APB1 PRESCALER
+              | ((uint32_t)ppre2 << 11);                    //APB2 PRESCALER
+    
+    switchSysclk(config->source);
+    
+    //HSI16 WAS ONLY TURNED ON FOR THE SWITCH
+    if(!hsiWasOn && !needHsi)
+    {
+        RCC->CR &= ~(1u << 8);
+    }
+    
+    //FEWER WAIT STATES ONLY ONCE SLOWED DOWN
+    if(newHclkHz <= hclkHz)
+    {
+        setFlashLatency(latency);
+    }
+    
+    currentConfig = config;
+    sysclkHz = newSysclkHz;
+    hclkHz = newHclkHz;
+    apb1Div = config->apb1Div;
+    apb2Div = config->apb2Div;
+    pclk1Hz = newHclkHz / apb1Div;
+    pclk2Hz = newHclkHz / apb2Div;
+    
+    //LET THE DRIVERS RE-TIME THEMSELVES
+    for(i = 0; i < listenerCount; i++)
+    {
+        listeners[i]();
+    }
+    
+    return 1;
+}
+
+/*****************************************************************
+ getClockConfig
+ 
+    Returns
+    the configuration in use
+*****************************************************************/
+const ClockConfig *getClockConfig(void)
+{
+    return currentConfig;
+}
+
+/*****************************************************************
+ restoreClock
+ 
+    Puts SYSCLK back on the current configuration after Stop mode,
+    which turns the PLL off and wakes up on MSI or HSI16. The MSI
+    range, bus prescalers and flash wait states are kept through
+    Stop, so the frequencies come back as they were and the
+    listeners are not called
+*****************************************************************/
+void restoreClock(void)
+{
+    const ClockConfig *config = currentConfig;
+    
+    //WOKE UP ON THE SOURCE IN USE, NOTHING WAS LOST
+    if(((RCC->CFGR >> 2) & 3u) == config->source)
+    {
+        return;
+    }
+    
+    startOscillators(config);
+    
+    if(config->source == CLOCK_SOURCE_PLL)
+    {
+        startPll(config);
+    }
+    
+    switchSysclk(config->source);
+}
+
+/*****************************************************************
+ addClockListener
+ 
+    Registers a function to be called after every clock change.
+    Registering the same function twice has no effect
+    
+    Returns
+    1 if the function is registered, 0 if there is no room
+*****************************************************************/
+uint8_t addClockListener(ClockListener listener)
+{
+    uint32_t i;
+    
+    for(i = 0; i < listenerCount; i++)
+    {
+        if(listeners[i] == listener)
+        {
+            return 1;
+        }
+    }
+    
+    if(listenerCount >= CLOCK_MAX_LISTENERS)
+    {
+        return 0;
+    }
+    
+    listeners[listenerCount++] = listener;
+    
+    return 1;
+}
+
+/*****************************************************************
+ getSysclkHz / getHclkHz / getPclk1Hz / getPclk2Hz
+ 
+    Return the current frequency of each clock in Hz
+*****************************************************************/
+uint32_t getSysclkHz(void)
+{
+    return sysclkHz;
+}
+
+uint32_t getHclkHz(void)
+{
+    return hclkHz;
+}
+
+uint32_t getPclk1Hz(void)
+{
+    return pclk1Hz;
+}
+
+uint32_t getPclk2Hz(void)
+{
+    return pclk2Hz;
+}
+
+/*****************************************************************
+ getApb1TimerHz / getApb2TimerHz
+ 
+    Return the clock fed to the timers on each APB bus. The timer
+    clock is doubled whenever the APB prescaler is not 1
+*****************************************************************/
+uint32_t getApb1TimerHz(void)
+{
+    return (apb1Div == 1u) ? pclk1Hz : (pclk1Hz * 2u);
+}
+
+uint32_t getApb2TimerHz(void)
+{
+    return (apb2Div == 1u) ? pclk2Hz : (pclk2Hz * 2u);
+}
@@ -0,0 +1,53 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+//SYSCLK SOURCES
+#define CLOCK_SOURCE_MSI        0
+#define CLOCK_SOURCE_HSI16      1
+#define CLOCK_SOURCE_PLL        3
+
+//FASTEST HCLK ALLOWED IN VOLTAGE RANGE 1
+#define CLOCK_MAX_HZ            80000000u
+
+//NUMBER OF FUNCTIONS THAT CAN ASK TO BE TOLD ABOUT CLOCK CHANGES.
+//ENOUGH FOR EVERY DRIVER THAT HAS ONE (TIMER, SAMPLER, SPI OR THE
+//SPI BUS, UART AND TIMER IO) WITH ROOM TO SPARE
+#ifndef CLOCK_MAX_LISTENERS
+#define CLOCK_MAX_LISTENERS     8u
+#endif
+
+typedef struct
+{
+    uint8_t source;         //CLOCK_SOURCE_MSI, CLOCK_SOURCE_HSI16 OR CLOCK_SOURCE_PLL
+    uint8_t msiRange;       //MSI RANGE 0 (100KHZ) TO 11 (48MHZ). 6 IS THE 4MHZ RESET DEFAULT
+    uint8_t pllInput;       //CLOCK_SOURCE_MSI OR CLOCK_SOURCE_HSI16
+    uint8_t pllM;           //PLL INPUT DIVIDER 1 TO 8. PLL INPUT MUST END UP 4 TO 16MHZ
+    uint8_t pllN;           //VCO MULTIPLIER 8 TO 86. VCO MUST END UP 64 TO 344MHZ
+    uint8_t pllR;           //SYSCLK DIVIDER 2, 4, 6 OR 8
+    uint16_t ahbDiv;        //HCLK = SYSCLK / ahbDiv. 1, 2, 4, 8, 16, 64, 128, 256 OR 512
+    uint8_t apb1Div;        //PCLK1 = HCLK / apb1Div. 1, 2, 4, 8 OR 16
+    uint8_t apb2Div;        //PCLK2 = HCLK / apb2Div. 1, 2, 4, 8 OR 16
+} ClockConfig;
+
+typedef void (*ClockListener)(void);
+
+extern const ClockConfig clockMsi4MHz;
+extern const ClockConfig clockHsi16MHz;
+extern const ClockConfig clockPll80MHz;
+
+uint8_t configClock(const ClockConfig *config);
+const ClockConfig *getClockConfig(void);
+void restoreClock(void);
+uint8_t addClockListener(ClockListener listener);
+
+uint32_t calcSysclkHz(const ClockConfig *config);
+uint8_t calcFlashLatency(uint32_t hclkHz);
+
+uint32_t getSysclkHz(void);
+uint32_t getHclkHz(void);
+uint32_t getPclk1Hz(void);
+uint32_t getPclk2Hz(void);
+uint32_t getApb1TimerHz(void);
+uint32_t getApb2TimerHz(void);
@@ -0,0 +1,244 @@
+#include "Frame.h"
+#include "CRC.h"
+
+
+/*****************************************************************
+ Binary framing for the UART. Frames are COBS encoded so 0x00
+ only ever appears as the end of a frame, which lets the receiver
+ find the next frame after any corruption or lost bytes. Each
+ frame carries a sequence number so lost frames can be counted
+ and a CRC-32 (the same one as Ethernet and zlib) so damaged ones
+ are thrown away.
+
+ The CRC comes from CRC.c, so on the STM32 it is worked out by the
+ CRC unit. Frames must only be encoded and decoded from the main
+ loop as the unit is shared.
+*****************************************************************/
+
+
+// COBS WRITER STATE
+typedef struct
+{
+    uint8_t *out;
+    size_t pos;                 // NEXT BYTE TO WRITE
+    size_t codePos;             // WHERE THE CURRENT CODE BYTE GOES
+    uint8_t code;               // 1 + BYTES SINCE THE CODE BYTE
+} CobsWriter;
+
+
+/*****************************************************************
+ putCobs
+
+ Adds one byte to a COBS encoded stream
+*****************************************************************/
+static void putCobs(CobsWriter *cobs, uint8_t byte)
+{
+    if(byte != 0u)
+    {
+        cobs->out[cobs->pos++] = byte;
+        cobs->code++;
+    }
+
+    // A ZERO ENDS THE BLOCK, SO DOES A FULL ONE
+    if((byte == 0u) || (cobs->code == 0xFFu))
+    {
+        cobs->out[cobs->codePos] = cobs->code;
+        cobs->codePos = cobs->pos++;
+        cobs->code = 1;
+    }
+}
+
+/*****************************************************************
+ encodeFrame
+
+ Builds a complete frame, including the 0x00 at the end, in
+ 'out', which must hold FRAME_ENCODED_MAX(len) bytes
+
+ Returns
+ the number of bytes written, 0 if 'len' is more than
+ FRAME_MAX_PAYLOAD
+*****************************************************************/
+size_t encodeFrame(uint8_t *out, uint8_t seq, uint8_t type, const uint8_t *payload, size_t len)
+{
+    CobsWriter cobs;
+    uint8_t header[2];
+    uint32_t crc;
+    size_t i;
+
+    if(len > FRAME_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+
+    header[0] = seq;
+    header[1] = type;
+
+    startCrc32();
+    addCrc32(header, 2);
+    addCrc32(payload, len);
+    crc = finishCrc32();
+
+    cobs.out = out;
+    cobs.codePos = 0;
+    cobs.pos = 1;
+    cobs.code = 1;
+
+    putCobs(&cobs, seq);
+    putCobs(&cobs, type);
+
+    for(i = 0; i < len; i++)
+    {
+        putCobs(&cobs, payload[i]);
+    }
+
+    for(i = 0; i < 4u; i++)
+    {
+        putCobs(&cobs, (uint8_t)(crc >> (8u * i)));
+    }
+
+    // CLOSE THE LAST BLOCK THEN END THE FRAME
+    out[cobs.codePos] = cobs.code;
+    out[cobs.pos++] = 0;
+
+    return cobs.pos;
+}
+
+/*****************************************************************
+ initFrameDecoder
+
+ Clears a decoder and its counters. If it starts listening part
+ way through a frame, that frame is counted as malformed
+*****************************************************************/
+void initFrameDecoder(FrameDecoder *decoder)
+{
+    decoder->len = 0;
+    decoder->overflow = 0;
+    decoder->synced = 0;
+    decoder->nextSeq = 0;
+    decoder->good = 0;
+    decoder->crcErrors = 0;
+    decoder->malformed = 0;
+    decoder->lost = 0;
+}
+
+/*****************************************************************
+ unstuffCobs
+
+ Decodes COBS in place
+
+ Returns
+ the decoded length, or (size_t)-1 if the data is not valid COBS
+*****************************************************************/
+static size_t unstuffCobs(uint8_t *buf, size_t len)
+{
+    size_t in = 0;
+    size_t out = 0;
+    uint8_t code;
+    uint8_t i;
+
+    while(in < len)
+    {
+        code = buf[in++];
+
+        if((code == 0u) || ((in + code - 1u) > len))
+        {
+            return (size_t)-1;
+        }
+
+        for(i = 1; i < code; i++)
+        {
+            buf[out++] = buf[in++];
+        }
+
+        // A SHORT BLOCK STANDS FOR A ZERO, UNLESS IT IS THE LAST ONE
+        if((code != 0xFFu) && (in < len))
+        {
+            buf[out++] = 0;
+        }
+    }
+
+    return out;
+}
+
+/*****************************************************************
+ decodeFrameByte
+
+ Feeds one received byte into the decoder. Fills in 'frame' when a
+ good frame ends
+
+ Returns
+ one of the FRAME_... results
+*****************************************************************/
+uint8_t decodeFrameByte(FrameDecoder *decoder, uint8_t byte, Frame *frame)
+{
+    size_t len;
+    uint32_t crc;
+
+    if(byte != 0u)
+    {
+        if(decoder->len < sizeof(decoder->buf))
+        {
+            decoder->buf[decoder->len++] = byte;
+        }
+        else
+        {
+            decoder->overflow = 1;
+        }
+
+        return FRAME_NONE;
+    }
+
+    // END OF A FRAME
+    len = decoder->len;
+    decoder->len = 0;
+
+    // TOO LONG TO BE A FRAME
+    if(decoder->overflow)
+    {
+        decoder->overflow = 0;
+        decoder->malformed++;
+        return FRAME_MALFORMED;
+    }
+
+    // BACK-TO-BACK 0x00 BYTES ARE ALLOWED AS IDLE FILL
+    if(len == 0u)
+    {
+        return FRAME_NONE;
+    }
+
+    len = unstuffCobs(decoder->buf, len);
+
+    if((len == (size_t)-1) || (len < FRAME_OVERHEAD) || (len > (FRAME_MAX_PAYLOAD + FRAME_OVERHEAD)))
+    {
+        decoder->malformed++;
+        return FRAME_MALFORMED;
+    }
+
+    crc = (uint32_t)decoder->buf[len - 4u]
+        | ((uint32_t)decoder->buf[len - 3u] << 8)
+        | ((uint32_t)decoder->buf[len - 2u] << 16)
+        | ((uint32_t)decoder->buf[len - 1u] << 24);
+
+    if(crc != calcCrc32(decoder->buf, len - 4u))
+    {
+        decoder->crcErrors++;
+        return FRAME_BAD_CRC;
+    }
+
+    // COUNT ANY FRAMES SKIPPED SINCE THE LAST GOOD ONE
+    if(decoder->synced)
+    {
+        decoder->lost += (uint8_t)(decoder->buf[0] - decoder->nextSeq);
+    }
+
+    decoder->synced = 1;
+    decoder->nextSeq = (uint8_t)(decoder->buf[0] + 1u);
+    decoder->good++;
+
+    frame->seq = decoder->buf[0];
+    frame->type = decoder->buf[1];
+    frame->payload = &decoder->buf[2];
+    frame->len = len - FRAME_OVERHEAD;
+
+    return FRAME_OK;
+}
@@ -0,0 +1,53 @@
+// NO REGISTER ACCESS IN HERE SO THE SAME FILES BUILD ON THE HOST
+#include <stdint.h>
+#include <stddef.h>
+
+// LONGEST PAYLOAD IN ONE FRAME. 240 KEEPS A WHOLE ENCODED FRAME
+// INSIDE THE 256 BYTE UART TX BUFFER
+#ifndef FRAME_MAX_PAYLOAD
+#define FRAME_MAX_PAYLOAD       240u
+#endif
+
+// BEFORE COBS A FRAME IS
+//  SEQUENCE (1), TYPE (1), PAYLOAD (0 TO FRAME_MAX_PAYLOAD),
+//  CRC-32 OF EVERYTHING BEFORE IT (4, LITTLE-ENDIAN, SEE CRC.h)
+// IT IS THEN COBS ENCODED SO IT HOLDS NO 0x00 AND ENDS WITH A 0x00
+#define FRAME_OVERHEAD          6u
+
+// MOST BYTES encodeFrame CAN WRITE FOR A PAYLOAD OF 'len' BYTES.
+// COBS ADDS ONE BYTE PER 254 AND ONE MORE, PLUS THE 0x00
+#define FRAME_ENCODED_MAX(len)  ((len) + FRAME_OVERHEAD + (((len) + FRAME_OVERHEAD) / 254u) + 2u)
+
+// RESULTS OF decodeFrameByte
+#define FRAME_NONE              0u      // NO FRAME ENDED WITH THIS BYTE
+#define FRAME_OK                1u      // GOOD FRAME IN 'frame'
+#define FRAME_BAD_CRC           2u      // FRAME ENDED BUT FAILED ITS CRC
+#define FRAME_MALFORMED         3u      // TOO SHORT, TOO LONG OR NOT VALID COBS
+
+// A DECODED FRAME. payload POINTS INTO THE DECODER AND IS ONLY
+// VALID UNTIL THE NEXT BYTE IS FED IN
+typedef struct
+{
+    uint8_t seq;
+    uint8_t type;
+    const uint8_t *payload;
+    size_t len;
+} Frame;
+
+// RECEIVE STATE FOR ONE LINK
+typedef struct
+{
+    uint8_t buf[FRAME_ENCODED_MAX(FRAME_MAX_PAYLOAD)];
+    size_t len;                 // BYTES IN buf
+    uint8_t overflow;           // FRAME TOO LONG, DROPPED AT THE NEXT 0x00
+    uint8_t synced;             // A FRAME HAS BEEN SEEN, nextSeq IS VALID
+    uint8_t nextSeq;            // SEQUENCE NUMBER EXPECTED NEXT
+    uint32_t good;              // FRAMES DECODED
+    uint32_t crcErrors;         // FRAMES THAT FAILED THE CRC
+    uint32_t malformed;         // FRAMES THAT WERE NOT VALID
+    uint32_t lost;              // FRAMES MISSED, FROM GAPS IN THE SEQUENCE
+} FrameDecoder;
+
+size_t encodeFrame(uint8_t *out, uint8_t seq, uint8_t type, const uint8_t *payload, size_t len);
+void initFrameDecoder(FrameDecoder *decoder);
+uint8_t decodeFrameByte(FrameDecoder *decoder, uint8_t byte, Frame *frame);
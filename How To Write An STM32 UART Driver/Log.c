@@ -0,0 +1,325 @@
+#include <string.h>
+#include "Log.h"
+#include "Frame.h"
+
+#if defined(__arm__) || defined(__ARM_ARCH)
+#include "stm32l432xx.h"
+
+// THE RING IS SHARED WITH INTERRUPTS, A RECORD GOES IN WITH THEM
+// MASKED. THE PREVIOUS STATE IS PUT BACK SO THIS WORKS FROM ANY
+// INTERRUPT TOO
+#define LOG_LOCK(primask)       do { (primask) = __get_PRIMASK(); __disable_irq(); } while(0)
+#define LOG_UNLOCK(primask)     __set_PRIMASK(primask)
+#define LOG_TIME()              (DWT->CYCCNT)
+#else
+// ON THE HOST THERE ARE NO INTERRUPTS AND THE TIME COUNTS RECORDS
+static uint32_t hostTime = 0;
+
+#define LOG_LOCK(primask)       ((primask) = 0)
+#define LOG_UNLOCK(primask)     ((void)(primask))
+#define LOG_TIME()              (hostTime++)
+#endif
+
+typedef char log_ring_words_check[((LOG_RING_WORDS & (LOG_RING_WORDS - 1u)) == 0u) ? 1 : -1];
+
+// WORD 'offset' OF THE RECORD STARTING AT 'start'
+#define LOG_PUT(start, offset, value)   ring[((start) + (offset)) & (LOG_RING_WORDS - 1u)] = (value)
+
+// RECORDS WAITING TO BE SENT. WRITTEN AT 'head' BY ANY CODE, WITH
+// INTERRUPTS MASKED, AND READ AT 'tail' BY pumpLog ONLY
+static uint32_t ring[LOG_RING_WORDS];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+
+// RECORDS THAT DIDN'T FIT, NOT YET REPORTED AND IN TOTAL
+static volatile uint32_t lostPending = 0;
+static volatile uint32_t lostTotal = 0;
+
+// RECORDS TAKEN FROM THE RING FOR THE NEXT FRAME, AND THE FRAME
+static uint8_t payload[FRAME_MAX_PAYLOAD];
+static size_t payloadLen = 0;
+static uint8_t encoded[FRAME_ENCODED_MAX(FRAME_MAX_PAYLOAD)];
+
+
+/*****************************************************************
+ initLog
+
+ Empties the ring buffer. On the STM32 it also starts the DWT
+ cycle counter used for the time stamps
+*****************************************************************/
+void initLog(void)
+{
+#if defined(__arm__) || defined(__ARM_ARCH)
+    // ENABLE TRACE SO THE DWT CAN BE USED THEN START CYCCNT
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+    head = 0;
+    tail = 0;
+    lostPending = 0;
+    lostTotal = 0;
+    payloadLen = 0;
+}
+
+/*****************************************************************
+ roomLog
+
+ Returns
+ 1 if a record of 'words' words fits after 'start'. Otherwise
+ counts it as lost and returns 0. Interrupts must be masked
+*****************************************************************/
+static uint8_t roomLog(uint32_t start, uint32_t words)
+{
+    if((LOG_RING_WORDS - (start - tail)) >= words)
+    {
+        return 1;
+    }
+
+    lostPending++;
+    lostTotal++;
+
+    return 0;
+}
+
+/*****************************************************************
+ recordLog0 TO recordLog4
+
+ Store one record. Use the LOG0 to LOG4 macros instead, they
+ check the argument count. If the ring is full the record is lost
+ and counted
+*****************************************************************/
+void recordLog0(uint32_t id)
+{
+    uint32_t primask;
+    uint32_t start;
+
+    LOG_LOCK(primask);
+    start = head;
+
+    if(roomLog(start, LOG_RECORD_WORDS(0u)))
+    {
+        LOG_PUT(start, 0u, LOG_HEADER(id, 0u));
+        LOG_PUT(start, 1u, LOG_TIME());
+        head = start + LOG_RECORD_WORDS(0u);
+    }
+
+    LOG_UNLOCK(primask);
+}
+
+void recordLog1(uint32_t id, uint32_t a)
+{
+    uint32_t primask;
+    uint32_t start;
+
+    LOG_LOCK(primask);
+    start = head;
+
+    if(roomLog(start, LOG_RECORD_WORDS(1u)))
+    {
+        LOG_PUT(start, 0u, LOG_HEADER(id, 1u));
+        LOG_PUT(start, 1u, LOG_TIME());
+        LOG_PUT(start, 2u, a);
+        head = start + LOG_RECORD_WORDS(1u);
+    }
+
+    LOG_UNLOCK(primask);
+}
+
+void recordLog2(uint32_t id, uint32_t a, uint32_t b)
+{
+    uint32_t primask;
+    uint32_t start;
+
+    LOG_LOCK(primask);
+    start = head;
+
+    if(roomLog(start, LOG_RECORD_WORDS(2u)))
+    {
+        LOG_PUT(start, 0u, LOG_HEADER(id, 2u));
+        LOG_PUT(start, 1u, LOG_TIME());
+        LOG_PUT(start, 2u, a);
+        LOG_PUT(start, 3u, b);
+        head = start + LOG_RECORD_WORDS(2u);
+    }
+
+    LOG_UNLOCK(primask);
+}
+
+void recordLog3(uint32_t id, uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t primask;
+    uint32_t start;
+
+    LOG_LOCK(primask);
+    start = head;
+
+    if(roomLog(start, LOG_RECORD_WORDS(3u)))
+    {
+        LOG_PUT(start, 0u, LOG_HEADER(id, 3u));
+        LOG_PUT(start, 1u, LOG_TIME());
+        LOG_PUT(start, 2u, a);
+        LOG_PUT(start, 3u, b);
+        LOG_PUT(start, 4u, c);
+        head = start + LOG_RECORD_WORDS(3u);
+    }
+
+    LOG_UNLOCK(primask);
+}
+
+void recordLog4(uint32_t id, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    uint32_t primask;
+    uint32_t start;
+
+    LOG_LOCK(primask);
+    start = head;
+
+    if(roomLog(start, LOG_RECORD_WORDS(4u)))
+    {
+        LOG_PUT(start, 0u, LOG_HEADER(id, 4u));
+        LOG_PUT(start, 1u, LOG_TIME());
+        LOG_PUT(start, 2u, a);
+        LOG_PUT(start, 3u, b);
+        LOG_PUT(start, 4u, c);
+        LOG_PUT(start, 5u, d);
+        head = start + LOG_RECORD_WORDS(4u);
+    }
+
+    LOG_UNLOCK(primask);
+}
+
+/*****************************************************************
+ logFloatBits
+
+ Returns
+ the bits of 'x' as a word, for a %f argument
+*****************************************************************/
+uint32_t logFloatBits(float x)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &x, sizeof(bits));
+
+    return bits;
+}
+
+/*****************************************************************
+ putWord
+
+ Adds a word to the payload, little-endian
+*****************************************************************/
+static size_t putWord(size_t len, uint32_t word)
+{
+    payload[len++] = (uint8_t)word;
+    payload[len++] = (uint8_t)(word >> 8);
+    payload[len++] = (uint8_t)(word >> 16);
+    payload[len++] = (uint8_t)(word >> 24);
+
+    return len;
+}
+
+/*****************************************************************
+ buildLogPayload
+
+ Moves as many whole records as fit from the ring into one frame
+ payload, starting with a LOG_LOST record if any were lost
+
+ Returns
+ the length of the payload, 0 if there was nothing to send
+*****************************************************************/
+static size_t buildLogPayload(void)
+{
+    uint32_t primask;
+    uint32_t lost;
+    uint32_t at = tail;
+    uint32_t end = head;
+    uint32_t words;
+    uint32_t i;
+    size_t len = 0;
+
+    LOG_LOCK(primask);
+    lost = lostPending;
+    lostPending = 0;
+    LOG_UNLOCK(primask);
+
+    if(lost > 0u)
+    {
+        len = putWord(len, LOG_HEADER(LOG_LOST, 1u));
+        len = putWord(len, LOG_TIME());
+        len = putWord(len, lost);
+    }
+
+    while(at != end)
+    {
+        words = LOG_RECORD_WORDS(LOG_HEADER_ARGS(ring[at & (LOG_RING_WORDS - 1u)]));
+
+        if((len + (4u * words)) > FRAME_MAX_PAYLOAD)
+        {
+            break;
+        }
+
+        for(i = 0; i < words; i++)
+        {
+            len = putWord(len, ring[(at + i) & (LOG_RING_WORDS - 1u)]);
+        }
+
+        at += words;
+    }
+
+    // HAND THE SPACE BACK TO THE LOG CALLS
+    tail = at;
+
+    return len;
+}
+
+/*****************************************************************
+ pumpLog
+
+ Sends the next frame of records through 'write' (normally
+ uartWrite) if it is sure to fit in 'room' (normally
+ uartTxFree()), so it never waits and never splits a frame. 'seq'
+ is the sequence number of the next frame on the link, shared
+ with the other frames sent, and is moved on when a frame goes.
+ Call from the main loop only, as frames are encoded with the CRC
+ unit
+
+ Returns
+ 1 if every record so far has been sent, 0 if some are waiting
+*****************************************************************/
+uint8_t pumpLog(LogWriter write, size_t room, uint8_t *seq)
+{
+    size_t len;
+
+    if(payloadLen == 0u)
+    {
+        payloadLen = buildLogPayload();
+
+        if(payloadLen == 0u)
+        {
+            return 1;
+        }
+    }
+
+    if(FRAME_ENCODED_MAX(payloadLen) > room)
+    {
+        return 0;
+    }
+
+    len = encodeFrame(encoded, (*seq)++, LOG_FRAME_TYPE, payload, payloadLen);
+    write(encoded, len);
+    payloadLen = 0;
+
+    return (tail == head) && (lostPending == 0u);
+}
+
+/*****************************************************************
+ logLost
+
+ Returns
+ the number of records lost because the ring was full
+*****************************************************************/
+uint32_t logLost(void)
+{
+    return lostTotal;
+}
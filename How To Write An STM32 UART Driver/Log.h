@@ -0,0 +1,109 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "LogMessages.h"
+
+/*****************************************************************
+ Deferred logging. A log call only stores the message ID, a time
+ stamp and its arguments as words in a ring buffer, which takes a
+ few cycles and is safe from interrupts. Nothing is formatted on
+ the STM32. pumpLog, called from the main loop, sends the records
+ over UART1 in frames (Frame.h) of type LOG_FRAME_TYPE and
+ host/logdecode prints them as text using the formats in
+ LogMessages.h.
+
+    LOG2(LOG_FRAME_BAD, result, good);
+
+ The number of arguments is checked against LogMessages.h when
+ the call is compiled.
+*****************************************************************/
+
+// 0 REMOVES EVERY LOG CALL
+#ifndef LOG_ENABLED
+#define LOG_ENABLED             1
+#endif
+
+// 1 BUILDS benchLog (LogBench.c) AND RUNS IT AT BOOT. IT LINKS
+// snprintf, SO IT STAYS OUT OF THE SHIPPED FIRMWARE
+#ifndef LOG_BENCH_ENABLED
+#define LOG_BENCH_ENABLED       0
+#endif
+
+// SIZE OF THE RING BUFFER IN WORDS. MUST BE A POWER OF 2
+#ifndef LOG_RING_WORDS
+#define LOG_RING_WORDS          256u
+#endif
+
+// MOST ARGUMENTS IN ONE MESSAGE
+#define LOG_MAX_ARGS            4u
+
+// FRAME TYPE OF LOG FRAMES
+#define LOG_FRAME_TYPE          0x4Cu
+
+// ONE RECORD IN THE RING AND IN A FRAME, ALL WORDS LITTLE-ENDIAN
+//  HEADER      ARGUMENT COUNT << 16 | ID
+//  TIME        DWT CYCLE COUNT WHEN THE CALL WAS MADE
+//  ARGUMENTS   0 TO LOG_MAX_ARGS WORDS
+#define LOG_HEADER(id, args)    (((uint32_t)(args) << 16) | (uint32_t)(id))
+#define LOG_HEADER_ID(header)   ((header) & 0xFFFFu)
+#define LOG_HEADER_ARGS(header) (((header) >> 16) & 0xFFu)
+#define LOG_RECORD_WORDS(args)  (2u + (args))
+
+// MESSAGE IDS, IN THE ORDER OF LogMessages.h
+#define LOG_ID_(id, args, format)       id,
+typedef enum
+{
+    LOG_MESSAGES(LOG_ID_)
+    LOG_MESSAGE_COUNT
+} LogId;
+
+// ARGUMENT COUNT OF EVERY MESSAGE, AS id_ARGS
+#define LOG_ARGS_(id, args, format)     id##_ARGS = (args),
+enum
+{
+    LOG_MESSAGES(LOG_ARGS_)
+    LOG_ARGS_END
+};
+
+// FAILS TO COMPILE IF MESSAGE 'id' DOESN'T TAKE 'count' ARGUMENTS
+#define LOG_CHECK(id, count)    ((void)sizeof(char[(id##_ARGS == (count)) ? 1 : -1]))
+
+// PASS A float TO A %f
+#define LOG_FLOAT(x)            logFloatBits(x)
+
+#if LOG_ENABLED
+#define LOG0(id)                do { LOG_CHECK(id, 0); recordLog0(id); } while(0)
+#define LOG1(id, a)             do { LOG_CHECK(id, 1); recordLog1(id, (uint32_t)(a)); } while(0)
+#define LOG2(id, a, b)          do { LOG_CHECK(id, 2); recordLog2(id, (uint32_t)(a), (uint32_t)(b)); } while(0)
+#define LOG3(id, a, b, c)       do { LOG_CHECK(id, 3); recordLog3(id, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c)); } while(0)
+#define LOG4(id, a, b, c, d)    do { LOG_CHECK(id, 4); recordLog4(id, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d)); } while(0)
+#else
+// THE ARGUMENTS ARE ONLY LOOKED AT BY sizeof, SO NEVER EVALUATED
+#define LOG0(id)                LOG_CHECK(id, 0)
+#define LOG1(id, a)             do { LOG_CHECK(id, 1); (void)sizeof(a); } while(0)
+#define LOG2(id, a, b)          do { LOG_CHECK(id, 2); (void)sizeof(a); (void)sizeof(b); } while(0)
+#define LOG3(id, a, b, c)       do { LOG_CHECK(id, 3); (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while(0)
+#define LOG4(id, a, b, c, d)    do { LOG_CHECK(id, 4); (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); (void)sizeof(d); } while(0)
+#endif
+
+// SAME SIGNATURE AS uartWrite. RETURNS HOW MANY BYTES WERE TAKEN
+typedef size_t (*LogWriter)(const uint8_t *buf, size_t len);
+
+void initLog(void);
+void recordLog0(uint32_t id);
+void recordLog1(uint32_t id, uint32_t a);
+void recordLog2(uint32_t id, uint32_t a, uint32_t b);
+void recordLog3(uint32_t id, uint32_t a, uint32_t b, uint32_t c);
+void recordLog4(uint32_t id, uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+uint32_t logFloatBits(float x);
+uint8_t pumpLog(LogWriter write, size_t room, uint8_t *seq);
+uint32_t logLost(void);
+
+#if LOG_BENCH_ENABLED
+// LogBench.c, STM32 ONLY
+void benchLog(void);
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+#include "stm32l432xx.h"
+#include "Log.h"
+
+// ONLY BUILT WITH LOG_BENCH_ENABLED SET, SEE Log.h
+#if LOG_BENCH_ENABLED
+
+#include <stdio.h>
+
+// NUMBER OF CALLS TIMED. THE RECORDS MUST ALL FIT IN THE RING
+#define LOG_BENCH_CALLS         16u
+
+typedef char log_bench_calls_check[((LOG_BENCH_CALLS * LOG_RECORD_WORDS(3u)) < LOG_RING_WORDS) ? 1 : -1];
+
+
+/*****************************************************************
+ benchLog
+
+ Times LOG_BENCH_CALLS log calls against formatting the same
+ message with snprintf on the STM32, and logs the average cycles
+ of each as a LOG_BENCH record. Sending the formatted text would
+ cost far more again: each character takes 86.8us at 115200 baud.
+ initLog must have been called first
+*****************************************************************/
+void benchLog(void)
+{
+    char text[64];
+    uint32_t start;
+    uint32_t logCycles;
+    uint32_t formatCycles;
+    int chars = 0;
+    int32_t i;
+
+    start = DWT->CYCCNT;
+
+    for(i = 0; i < (int32_t)LOG_BENCH_CALLS; i++)
+    {
+        LOG3(LOG_BENCH_SAMPLE, i, -i, i * 1000);
+    }
+
+    logCycles = DWT->CYCCNT - start;
+    start = DWT->CYCCNT;
+
+    for(i = 0; i < (int32_t)LOG_BENCH_CALLS; i++)
+    {
+        chars = snprintf(text, sizeof(text), LOG_BENCH_SAMPLE_FORMAT, (int)i, (int)-i, (int)(i * 1000));
+    }
+
+    formatCycles = DWT->CYCCNT - start;
+
+    LOG3(LOG_BENCH, logCycles / LOG_BENCH_CALLS, formatCycles / LOG_BENCH_CALLS, chars);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef LOG_MESSAGES_H
+#define LOG_MESSAGES_H
+
+/*****************************************************************
+ Every message the firmware can log, as
+    MSG(ID, NUMBER OF ARGUMENTS, FORMAT)
+
+ The firmware only ever sees the IDs and argument counts, the
+ format strings are used by host/logdecode to turn the records
+ back into text and never take up flash. Formats take up to
+ LOG_MAX_ARGS of %d %i %u %x %X %o %c and %f (pass floats with
+ LOG_FLOAT), with the usual flags and widths. No %s, the string
+ would not be there to read.
+
+ Add new messages at the end so older captures still decode.
+ LOG_LOST must stay first, Log.c sends it when records are lost.
+*****************************************************************/
+// FORMATTED ON THE STM32 BY benchLog WHEN LOG_BENCH_ENABLED IS SET
+#define LOG_BENCH_SAMPLE_FORMAT "sample x=%d y=%d z=%d"
+
+#define LOG_MESSAGES(MSG)                                                                       \
+    MSG(LOG_LOST,           1, "%u log records lost")                                           \
+    MSG(LOG_BOOT,           1, "boot, core clock %u Hz")                                        \
+    MSG(LOG_FRAME_OK,       3, "frame seq %u type 0x%02X, %u bytes")                            \
+    MSG(LOG_FRAME_BAD,      2, "bad frame, result %u, %u good so far")                          \
+    MSG(LOG_TX_WAIT,        2, "reply of %u bytes waiting, %u bytes free")                      \
+    MSG(LOG_BENCH,          3, "log call %u cycles, snprintf %u cycles for %u characters")     \
+    MSG(LOG_BENCH_SAMPLE,   3, LOG_BENCH_SAMPLE_FORMAT)
+
+#endif
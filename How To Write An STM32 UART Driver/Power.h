@@ -0,0 +1,49 @@
+#ifndef STM32L432KC
+#define STM32L432KC
+#include "stm32l432xx.h"
+#endif
+
+//LOW POWER MODES, FROM LIGHTEST TO DEEPEST
+#define POWER_MODE_RUN      0u      //NOT WORTH SLEEPING, THERE IS WORK OR A TIMER IS DUE
+#define POWER_MODE_SLEEP    1u      //CORE STOPPED, PERIPHERALS AND TIM2 RUNNING
+#define POWER_MODE_STOP1    2u      //ALL CLOCKS STOPPED, UART1 CAN STILL WAKE US
+#define POWER_MODE_STOP2    3u      //LOWEST POWER, ONLY EXTI LINES WAKE US
+#define POWER_MODES         4u
+
+//WAKE-UP SOURCES THE APPLICATION WANTS TO KEEP WORKING
+#define POWER_WAKE_UART1    (1u << 0)   //RECEIVED BYTES ON UART1
+#define POWER_WAKE_EXTI     (1u << 1)   //EXTI LINES (WORK IN EVERY MODE)
+
+//EVERYTHING THE MODE CHOICE DEPENDS ON
+typedef struct
+{
+    uint8_t timerPending;       //A TIMER THAT STOPS IN STOP MODE IS RUNNING
+    uint32_t ticksToDeadline;   //TICKS UNTIL IT FIRES
+    uint8_t busy;               //DMA, UART TX OR ANOTHER PERIPHERAL STILL RUNNING
+    uint8_t workPending;        //THE MAIN LOOP HAS SOMETHING TO DO ALREADY
+    uint32_t wakeSources;       //POWER_WAKE_... FLAGS
+    uint8_t uartStopWake;       //UART1 CAN WAKE FROM STOP (CLOCKED FROM HSI16)
+} PowerState;
+
+//FILLS IN EVERYTHING BUT wakeSources FOR THE DRIVERS THE APPLICATION
+//USES. CALLED WITH INTERRUPTS MASKED
+typedef void (*PowerQuery)(PowerState *state);
+
+//TIME SPENT IN EACH MODE, IN LPTIM1 TICKS OF LPTIME_HZ, WHICH KEEP
+//COUNTING IN STOP. ticks[POWER_MODE_RUN] IS THE TIME AWAKE. ALSO HOW
+//LONG PUTTING SYSCLK BACK TOOK ONCE WFI RETURNED. THE TIME FROM THE
+//WAKE-UP EVENT UNTIL WFI RETURNS IS NOT IN IT
+typedef struct
+{
+    uint32_t entries[POWER_MODES];              //TIMES EACH MODE WAS USED
+    uint64_t ticks[POWER_MODES];
+    uint64_t totalTicks;                        //SINCE initPower
+    uint32_t lastRestoreCycles[POWER_MODES];    //CYCLES FROM WFI RETURNING UNTIL SYSCLK IS BACK
+    uint32_t maxRestoreCycles[POWER_MODES];
+} PowerStats;
+
+void initPower(uint32_t wakeSources, PowerQuery query);
+uint8_t choosePowerMode(const PowerState *state);
+uint8_t enterLowPower(const volatile uint8_t *ready);
+void getPowerStats(PowerStats *stats);
+uint32_t getSleepPermille(void);
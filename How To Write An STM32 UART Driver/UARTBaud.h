@@ -0,0 +1,25 @@
+#ifndef UART_BAUD_H
+#define UART_BAUD_H
+
+// NO REGISTER ACCESS IN HERE SO THE SAME FILES BUILD ON THE HOST
+#include <stdint.h>
+
+// LARGEST BAUD RATE ERROR calcUartBaud ACCEPTS, IN PARTS PER
+// MILLION. BOTH ENDS TOGETHER SHOULD STAY UNDER ABOUT 3%
+#ifndef UART_BAUD_MAX_ERROR_PPM
+#define UART_BAUD_MAX_ERROR_PPM 15000
+#endif
+
+// BRR SETTINGS FOR ONE CLOCK AND BAUD RATE
+typedef struct
+{
+    uint16_t brr;               // VALUE FOR USART_BRR
+    uint8_t over8;              // 1 TO SET OVER8 (OVERSAMPLING BY 8)
+    uint32_t actualBaud;        // BAUD RATE THOSE SETTINGS REALLY GIVE
+    int32_t errorPpm;           // (actualBaud - baud) / baud, IN PPM
+} UartBaud;
+
+uint8_t calcUartBaud(uint32_t clockHz, uint32_t baud, UartBaud *result);
+uint32_t calcUartBaudFromBrr(uint32_t clockHz, uint16_t brr, uint8_t over8);
+
+#endif
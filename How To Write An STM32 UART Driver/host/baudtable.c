@@ -0,0 +1,133 @@
+/*****************************************************************
+ baudtable
+
+    Checks calcUartBaud from UARTBaud.c against every divider the
+    UART can use, for a table of UART clocks and baud rates, and
+    prints the settings it picks.
+
+    For each pair it checks that
+    - no other divider gives a smaller error
+    - oversampling by 8 is only used when 16 can't reach the rate
+    - decoding the BRR value the way the reference manual
+      describes gives back the same divider
+
+    Build:  cc -O2 -I.. -o baudtable baudtable.c ../UARTBaud.c -lm
+    Usage:  baudtable
+*****************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "UARTBaud.h"
+
+static const uint32_t clocks[] =
+{
+    4000000u, 8000000u, 16000000u, 24000000u, 32000000u, 48000000u, 64000000u, 80000000u
+};
+
+static const uint32_t bauds[] =
+{
+    1200u, 9600u, 19200u, 57600u, 115200u, 230400u, 460800u, 921600u,
+    1000000u, 1500000u, 2000000u, 3000000u, 4000000u, 5000000u, 6000000u, 8000000u, 10000000u
+};
+
+/*****************************************************************
+ errorPpm
+
+    Size of the error, done in floating point
+*****************************************************************/
+static double errorPpm(uint32_t clockHz, uint32_t baud, uint32_t div)
+{
+    return fabs((((double)clockHz / div) - baud) * 1e6 / baud);
+}
+
+/*****************************************************************
+ decodeBrr
+
+    Reference manual: OVER8 = 0 USARTDIV = BRR. OVER8 = 1
+    BRR[15:4] = USARTDIV[15:4], BRR[2:0] = USARTDIV[3:0] >> 1,
+    BRR[3] = 0 and the bit clock is fCK / (USARTDIV / 2)
+
+    Returns
+    the divider in UART clocks per bit, 0 if BRR is not valid
+*****************************************************************/
+static uint32_t decodeBrr(uint16_t brr, uint8_t over8)
+{
+    uint32_t usartdiv;
+
+    if(!over8)
+    {
+        return (brr >= 16u) ? brr : 0u;
+    }
+
+    if(brr & 8u)
+    {
+        return 0;
+    }
+
+    usartdiv = (brr & 0xFFF0u) | ((brr & 7u) << 1);
+
+    return (usartdiv >= 16u) ? (usartdiv / 2u) : 0u;
+}
+
+int main(void)
+{
+    unsigned failed = 0;
+    size_t c;
+    size_t b;
+
+    printf("%10s %10s %6s %7s %10s %10s %s\n", "clock", "baud", "over8", "brr", "actual", "error ppm", "");
+
+    for(c = 0; c < (sizeof(clocks) / sizeof(clocks[0])); c++)
+    {
+        for(b = 0; b < (sizeof(bauds) / sizeof(bauds[0])); b++)
+        {
+            UartBaud setting;
+            uint8_t ok = calcUartBaud(clocks[c], bauds[b], &setting);
+            uint32_t div = decodeBrr(setting.brr, setting.over8);
+            double best = 1e18;
+            uint32_t d;
+            const char *problem = "";
+
+            //SMALLEST ERROR OVER EVERY DIVIDER EITHER MODE ALLOWS
+            for(d = 8u; d <= 0xFFFFu; d++)
+            {
+                if(errorPpm(clocks[c], bauds[b], d) < best)
+                {
+                    best = errorPpm(clocks[c], bauds[b], d);
+                }
+            }
+
+            if(div == 0u)
+            {
+                problem = "BAD BRR";
+            }
+            else if((setting.over8 != 0u) != (div < 16u))
+            {
+                problem = "WRONG OVERSAMPLING";
+            }
+            else if(errorPpm(clocks[c], bauds[b], div) > (best + 1.0))
+            {
+                problem = "NOT THE BEST DIVIDER";
+            }
+            else if(calcUartBaudFromBrr(clocks[c], setting.brr, setting.over8) != setting.actualBaud)
+            {
+                problem = "BRR DECODES DIFFERENTLY";
+            }
+
+            if(*problem)
+            {
+                failed++;
+            }
+
+            printf("%10lu %10lu %6u 0x%04x %10lu %10ld %s%s\n",
+                   (unsigned long)clocks[c], (unsigned long)bauds[b], setting.over8, setting.brr,
+                   (unsigned long)setting.actualBaud, (long)setting.errorPpm,
+                   ok ? "" : "out of range ", problem);
+        }
+    }
+
+    printf("%s\n", failed ? "FAILED" : "all settings ok");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,255 @@
+/*****************************************************************
+ crcbench
+
+    Checks the CRC-32 used by CRC.c against known answers and
+    compares the speed of three ways of working it out:
+
+    table     the byte-at-a-time table in CRC.c (the fallback used
+              when CRC_USE_HARDWARE is 0)
+    slice8    slice-by-8, eight table lookups per 8 bytes
+    hardware  CRC.c's own CRC_USE_HARDWARE code, run against the
+              CRC unit model in host/sim/
+
+    The hardware answers prove the word feeding and the CR set up
+    in initCrc. Its speed is not measured on the host, where every
+    register access traps. It is worked out from the sim's AHB cost
+    of the DR writes at 80MHz instead.
+
+    Build:  cc -O2 -no-pie -DCRC_USE_HARDWARE=1 -I../../host/sim -I.. -o crcbench crcbench.c ../../host/sim/sim.c ../CRC.c
+    Usage:  crcbench [buffer bytes] [passes]
+*****************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+#include "CRC.h"
+
+static uint32_t slice[8][256];
+
+//KNOWN ANSWERS FOR THE ETHERNET/ZLIB CRC-32
+static const struct
+{
+    const char *text;
+    uint32_t crc;
+} vectors[] =
+{
+    { "",                                               0x00000000u },
+    { "a",                                              0xE8B7BE43u },
+    { "abc",                                            0x352441C2u },
+    { "123456789",                                      0xCBF43926u },
+    { "message digest",                                 0x20159D7Fu },
+    { "abcdefghijklmnopqrstuvwxyz",                     0x4C2750BDu },
+    { "The quick brown fox jumps over the lazy dog",    0x414FA339u },
+};
+
+/*****************************************************************
+ initSlice
+
+    Builds the slice-by-8 tables
+*****************************************************************/
+static void initSlice(void)
+{
+    uint32_t crc;
+    unsigned n;
+    unsigned k;
+
+    for(n = 0; n < 256u; n++)
+    {
+        crc = n;
+
+        for(k = 0; k < 8u; k++)
+        {
+            crc = (crc & 1u) ? ((crc >> 1) ^ 0xEDB88320u) : (crc >> 1);
+        }
+
+        slice[0][n] = crc;
+    }
+
+    for(n = 0; n < 256u; n++)
+    {
+        for(k = 1; k < 8u; k++)
+        {
+            slice[k][n] = (slice[k - 1u][n] >> 8) ^ slice[0][slice[k - 1u][n] & 0xFFu];
+        }
+    }
+}
+
+/*****************************************************************
+ crcSlice8
+*****************************************************************/
+static uint32_t crcSlice8(const uint8_t *p, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    uint32_t lo;
+    uint32_t hi;
+
+    while(len >= 8u)
+    {
+        lo = crc ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+        hi = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+
+        crc = slice[7][lo & 0xFFu] ^ slice[6][(lo >> 8) & 0xFFu]
+            ^ slice[5][(lo >> 16) & 0xFFu] ^ slice[4][lo >> 24]
+            ^ slice[3][hi & 0xFFu] ^ slice[2][(hi >> 8) & 0xFFu]
+            ^ slice[1][(hi >> 16) & 0xFFu] ^ slice[0][hi >> 24];
+
+        p += 8;
+        len -= 8u;
+    }
+
+    while(len--)
+    {
+        crc = (crc >> 8) ^ slice[0][(crc ^ *p++) & 0xFFu];
+    }
+
+    return ~crc;
+}
+
+/*****************************************************************
+ crcHardware
+
+    The CRC unit, fed by addCrc32 in pieces of 1 to 7 bytes so
+    byte and word writes are mixed
+*****************************************************************/
+static uint32_t crcHardware(const uint8_t *p, size_t len)
+{
+    size_t piece = 1;
+    size_t n;
+
+    startCrc32();
+
+    while(len)
+    {
+        n = (piece < len) ? piece : len;
+        addCrc32(p, n);
+        p += n;
+        len -= n;
+        piece = (piece % 7u) + 1u;
+    }
+
+    return finishCrc32();
+}
+
+/*****************************************************************
+ timeCrc
+
+    Returns
+    MB/s for one way of working out the CRC
+*****************************************************************/
+static double timeCrc(uint32_t (*crc)(const uint8_t *, size_t), const uint8_t *buf, size_t len, unsigned passes, uint32_t *result)
+{
+    clock_t start = clock();
+    double sec;
+    unsigned i;
+
+    for(i = 0; i < passes; i++)
+    {
+        *result ^= crc(buf, len);
+    }
+
+    sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return sec ? ((double)len * passes / sec / 1e6) : 0.0;
+}
+
+/*****************************************************************
+ hardwareSpeed
+
+    Returns
+    MB/s for the CRC unit at 80MHz, from the bus cycles the sim
+    charged for one calcCrc32 of the buffer
+*****************************************************************/
+static double hardwareSpeed(const uint8_t *buf, size_t len, uint32_t *result)
+{
+    SimStats before;
+    SimStats after;
+    uint64_t cycles;
+
+    simGetStats(&before);
+    *result ^= calcCrc32(buf, len);
+    simGetStats(&after);
+
+    cycles = after.periph[SIM_CRC].busCycles - before.periph[SIM_CRC].busCycles;
+
+    return cycles ? ((double)len * 80.0 / cycles) : 0.0;
+}
+
+static uint32_t crcTableRun(const uint8_t *p, size_t len)
+{
+    return calcCrc32Table(p, len);
+}
+
+int main(int argc, char **argv)
+{
+    size_t len = (argc > 1) ? (size_t)atoi(argv[1]) : 4096u;
+    unsigned passes = (argc > 2) ? (unsigned)atoi(argv[2]) : 2000u;
+    uint8_t *buf = malloc(len + 8u);
+    uint32_t sink = 0;
+    unsigned failed = 0;
+    size_t i;
+    size_t n;
+
+    if(!buf)
+    {
+        return 1;
+    }
+
+    initSlice();
+
+    simInit();
+    initCrc();
+
+    //KNOWN ANSWERS
+    for(i = 0; i < (sizeof(vectors) / sizeof(vectors[0])); i++)
+    {
+        const uint8_t *p = (const uint8_t *)vectors[i].text;
+        size_t textLen = strlen(vectors[i].text);
+        uint32_t t = calcCrc32Table(p, textLen);
+        uint32_t s = crcSlice8(p, textLen);
+        uint32_t h = crcHardware(p, textLen);
+
+        if((t != vectors[i].crc) || (s != vectors[i].crc) || (h != vectors[i].crc))
+        {
+            printf("FAIL \"%s\": want %08lx table %08lx slice8 %08lx hardware %08lx\n", vectors[i].text,
+                   (unsigned long)vectors[i].crc, (unsigned long)t, (unsigned long)s, (unsigned long)h);
+            failed++;
+        }
+    }
+
+    //RANDOM DATA AT EVERY LENGTH AND ALIGNMENT UP TO 64 BYTES
+    for(i = 0; i < (len + 8u); i++)
+    {
+        buf[i] = (uint8_t)rand();
+    }
+
+    for(n = 0; n <= 64u; n++)
+    {
+        for(i = 0; i < 8u; i++)
+        {
+            uint32_t t = calcCrc32Table(&buf[i], n);
+
+            if((crcSlice8(&buf[i], n) != t) || (crcHardware(&buf[i], n) != t) || (calcCrc32(&buf[i], n) != t))
+            {
+                printf("FAIL random length %u offset %u\n", (unsigned)n, (unsigned)i);
+                failed++;
+            }
+        }
+    }
+
+    printf("known answers and cross checks: %s\n", failed ? "FAILED" : "ok");
+
+    printf("%u byte buffer, %u passes\n", (unsigned)len, passes);
+    printf("table     %8.1f MB/s\n", timeCrc(crcTableRun, buf, len, passes, &sink));
+    printf("slice8    %8.1f MB/s\n", timeCrc(crcSlice8, buf, len, passes, &sink));
+    printf("hardware  %8.1f MB/s at 80MHz, DR writes only\n", hardwareSpeed(buf, len, &sink));
+
+    //PRINTED SO THE TIMED LOOPS CAN'T BE OPTIMISED AWAY
+    printf("(results xor %08lx)\n", (unsigned long)sink);
+
+    free(buf);
+
+    return failed ? 1 : 0;
+}
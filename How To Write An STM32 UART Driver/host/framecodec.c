@@ -0,0 +1,194 @@
+/*****************************************************************
+ framecodec
+
+    Host-side encoder/decoder for the UART frames built by
+    Frame.c, using the same source as the firmware.
+
+    decode  prints every frame in a raw UART capture with the
+            link counters at the end
+    encode  wraps stdin in frames of up to FRAME_MAX_PAYLOAD bytes
+            so it can be sent to the board
+    bench   encodes and decodes random sensor-sized records and
+            prints the payload efficiency and the time per byte
+
+    Build:  cc -O2 -I.. -o framecodec framecodec.c ../Frame.c ../CRC.c
+    Usage:  framecodec decode [capture.bin]
+            framecodec encode [type] < data > frames.bin
+            framecodec bench [payload bytes] [frames] [cpu MHz]
+*****************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Frame.h"
+
+/*****************************************************************
+ decodeStream
+
+    Decodes frames from 'in' and prints one line per frame
+*****************************************************************/
+static int decodeStream(FILE *in)
+{
+    FrameDecoder decoder;
+    Frame frame;
+    int c;
+    size_t i;
+
+    initFrameDecoder(&decoder);
+
+    while((c = getc(in)) != EOF)
+    {
+        if(decodeFrameByte(&decoder, (uint8_t)c, &frame) != FRAME_OK)
+        {
+            continue;
+        }
+
+        printf("seq %3u type %3u len %3u :", frame.seq, frame.type, (unsigned)frame.len);
+
+        for(i = 0; i < frame.len; i++)
+        {
+            printf(" %02x", frame.payload[i]);
+        }
+
+        printf("\n");
+    }
+
+    printf("good %lu, bad crc %lu, malformed %lu, lost %lu\n",
+           (unsigned long)decoder.good, (unsigned long)decoder.crcErrors,
+           (unsigned long)decoder.malformed, (unsigned long)decoder.lost);
+
+    return 0;
+}
+
+/*****************************************************************
+ encodeStream
+
+    Wraps everything on stdin in frames of type 'type'
+*****************************************************************/
+static int encodeStream(uint8_t type)
+{
+    static uint8_t out[FRAME_ENCODED_MAX(FRAME_MAX_PAYLOAD)];
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    uint8_t seq = 0;
+    size_t n;
+
+    while((n = fread(payload, 1, sizeof(payload), stdin)) > 0)
+    {
+        fwrite(out, 1, encodeFrame(out, seq++, type, payload, n), stdout);
+    }
+
+    return 0;
+}
+
+/*****************************************************************
+ bench
+
+    Encodes and decodes 'frames' frames of 'len' random bytes.
+    A third of the bytes are 0 as in packed sensor records
+*****************************************************************/
+static int bench(size_t len, unsigned long frames, double mhz)
+{
+    static uint8_t out[FRAME_ENCODED_MAX(FRAME_MAX_PAYLOAD)];
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    FrameDecoder decoder;
+    Frame frame;
+    unsigned long f;
+    unsigned long long encoded = 0;
+    size_t n;
+    size_t i;
+    clock_t start;
+    double encodeSec;
+    double decodeSec = 0.0;
+    double nsPerByte;
+
+    if(len > FRAME_MAX_PAYLOAD)
+    {
+        fprintf(stderr, "payload must be at most %u bytes\n", (unsigned)FRAME_MAX_PAYLOAD);
+        return 1;
+    }
+
+    for(i = 0; i < len; i++)
+    {
+        payload[i] = (rand() % 3) ? (uint8_t)rand() : 0u;
+    }
+
+    initFrameDecoder(&decoder);
+
+    //ENCODE ONLY
+    start = clock();
+
+    for(f = 0; f < frames; f++)
+    {
+        payload[0] = (uint8_t)f;
+        encoded += encodeFrame(out, (uint8_t)f, 1, payload, len);
+    }
+
+    encodeSec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    //DECODE THE SAME FRAME OVER AND OVER
+    n = encodeFrame(out, 0, 1, payload, len);
+    start = clock();
+
+    for(f = 0; f < frames; f++)
+    {
+        for(i = 0; i < n; i++)
+        {
+            decodeFrameByte(&decoder, out[i], &frame);
+        }
+    }
+
+    decodeSec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("payload %u bytes, encoded %.2f bytes per frame\n", (unsigned)len, (double)encoded / (double)frames);
+    printf("efficiency %.1f%%\n", 100.0 * (double)len * (double)frames / (double)encoded);
+
+    nsPerByte = 1e9 * encodeSec / ((double)len * (double)frames);
+    printf("encode %.2f ns/payload byte (%.1f cycles at %.0f MHz)\n", nsPerByte, nsPerByte * mhz / 1000.0, mhz);
+
+    nsPerByte = 1e9 * decodeSec / ((double)len * (double)frames);
+    printf("decode %.2f ns/payload byte (%.1f cycles at %.0f MHz)\n", nsPerByte, nsPerByte * mhz / 1000.0, mhz);
+
+    printf("decoded %lu frames, %lu bad\n", (unsigned long)decoder.good,
+           (unsigned long)(decoder.crcErrors + decoder.malformed));
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+
+    if((argc > 1) && !strcmp(argv[1], "decode"))
+    {
+        if((argc > 2) && strcmp(argv[2], "-"))
+        {
+            in = fopen(argv[2], "rb");
+
+            if(!in)
+            {
+                perror(argv[2]);
+                return 1;
+            }
+        }
+
+        return decodeStream(in);
+    }
+
+    if((argc > 1) && !strcmp(argv[1], "encode"))
+    {
+        return encodeStream((argc > 2) ? (uint8_t)atoi(argv[2]) : 0u);
+    }
+
+    if((argc > 1) && !strcmp(argv[1], "bench"))
+    {
+        return bench((argc > 2) ? (size_t)atoi(argv[2]) : 14u,
+                     (argc > 3) ? strtoul(argv[3], NULL, 10) : 1000000ul,
+                     (argc > 4) ? atof(argv[4]) : 3000.0);
+    }
+
+    fprintf(stderr, "usage: framecodec decode [capture] | encode [type] | bench [bytes] [frames] [cpu MHz]\n");
+
+    return 1;
+}
@@ -0,0 +1,308 @@
+/*****************************************************************
+ idlecheck
+
+    Checks the DMA receive mode of UART.c (initUART_DMA) against the
+    USART1 and DMA1 models in host/sim/. Byte streams with gaps are
+    sent to UART1 and every slice handed to the frame callback is
+    compared with the frame that was sent.
+
+      split    a gap of 10 bit times or more ends a frame, a shorter
+               one doesn't, whatever the bytes are
+      lengths  frames of 1 byte up to the whole DMA buffer come out
+               whole, including those that wrap around the end of
+               the buffer and those longer than half of it, which
+               need the half and full transfer interrupts
+      long     a frame longer than the DMA buffer is counted by
+               uartDmaFramesLost and the next frame is still right
+      random   a long run of random frames with random gaps
+      latency  how long after its last stop bit a frame is handed
+               over, which should be about one character time
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o idlecheck idlecheck.c ../../host/sim/sim.c ../UART.c ../UARTBaud.c ../Clock.c
+    Usage:  idlecheck [random frames]
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Clock.h"
+#include "UART.h"
+
+#define MAX_FRAMES      64u
+#define MAX_FRAME_LEN   (2u * UART_DMA_RX_BUFFER_SIZE)
+
+// ONE 10-BIT CHARACTER AT 115200 BAUD
+#define CHAR_PS         ((10u * SIM_PS_PER_S) / 115200u)
+
+// FRAMES HANDED OVER BY THE CALLBACK SINCE THE LAST clearFrames
+static uint8_t frames[MAX_FRAMES][MAX_FRAME_LEN];
+static size_t frameLens[MAX_FRAMES];
+static uint64_t frameTimes[MAX_FRAMES];
+static uint8_t frameWrapped[MAX_FRAMES];
+static uint32_t frameCount = 0;
+
+// WHEN THE LINE FINISHES SENDING EVERYTHING QUEUED SO FAR
+static uint64_t lineEnd = 0;
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+ /*****************************************************************
+ onFrame
+
+    Copies each slice straight away, as the callback must be done
+    with it before the DMA comes round again
+*****************************************************************/
+static void onFrame(const UartRxSlice *frame)
+{
+    if(frameCount >= MAX_FRAMES)
+    {
+        return;
+    }
+
+    memcpy(frames[frameCount], frame->data, frame->len);
+    if(frame->wrapLen > 0u)
+    {
+        memcpy(&frames[frameCount][frame->len], frame->wrapData, frame->wrapLen);
+    }
+    frameLens[frameCount] = frame->len + frame->wrapLen;
+    frameWrapped[frameCount] = (frame->wrapLen > 0u);
+    frameTimes[frameCount] = simTimePs();
+    frameCount++;
+}
+
+static void clearFrames(void)
+{
+    frameCount = 0;
+}
+
+ /*****************************************************************
+ sendFrame
+
+    Queues 'len' bytes on the line, each after 'gapBits' of idle
+    line, the first after 'idleBits'
+
+    Returns
+    the time the last stop bit ends
+*****************************************************************/
+static uint64_t sendFrame(const uint8_t *data, size_t len, uint32_t idleBits, uint32_t gapBits)
+{
+    uint64_t bitPs = SIM_PS_PER_S / 115200u;
+    size_t i;
+
+    lineEnd = (lineEnd > simTimePs()) ? lineEnd : simTimePs();
+    lineEnd += ((uint64_t)idleBits + ((uint64_t)(len - 1u) * gapBits)) * bitPs + ((uint64_t)len * CHAR_PS);
+
+    if(gapBits == 0u)
+    {
+        simUartRx(data, len, idleBits);
+    }
+    else
+    {
+        for(i = 0; i < len; i++)
+        {
+            simUartRx(&data[i], 1u, (i == 0u) ? idleBits : gapBits);
+        }
+    }
+
+    return lineEnd;
+}
+
+ /*****************************************************************
+ settle
+
+    Lets time run until everything queued has been received and
+    the line has been idle long enough to end the last frame
+*****************************************************************/
+static void settle(void)
+{
+    simRunPs(lineEnd + (4u * CHAR_PS) - simTimePs());
+}
+
+static void fill(uint8_t *data, size_t len, uint32_t seed)
+{
+    size_t i;
+
+    for(i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+static uint8_t sameFrame(uint32_t n, const uint8_t *data, size_t len)
+{
+    return (n < frameCount) && (frameLens[n] == len) && (memcmp(frames[n], data, len) == 0);
+}
+
+static void checkSplit(void)
+{
+    static uint8_t data[16];
+
+    fill(data, sizeof(data), 1u);
+
+    //9 IDLE BITS BETWEEN BYTES IS LESS THAN A CHARACTER, ONE FRAME
+    clearFrames();
+    sendFrame(data, sizeof(data), 20u, 9u);
+    settle();
+    check((frameCount == 1u) && sameFrame(0, data, sizeof(data)), "gaps of 9 bits don't split a frame");
+
+    //10 IDLE BITS IS A WHOLE CHARACTER, EVERY BYTE IS A FRAME
+    clearFrames();
+    sendFrame(data, 4u, 20u, 10u);
+    settle();
+    check(frameCount == 4u, "gaps of 10 bits split every byte");
+    check(sameFrame(0, &data[0], 1u) && sameFrame(3, &data[3], 1u), "single byte frames right");
+
+    //BACK TO BACK FRAMES WITH A 12 BIT GAP BETWEEN
+    clearFrames();
+    sendFrame(data, 5u, 20u, 0u);
+    sendFrame(&data[5], 11u, 12u, 0u);
+    settle();
+    check((frameCount == 2u) && sameFrame(0, data, 5u) && sameFrame(1, &data[5], 11u), "12 bit gap between two frames");
+}
+
+static void checkLengths(void)
+{
+    static const size_t lengths[] =
+    {
+        1u, 2u, 7u, 100u, UART_DMA_RX_BUFFER_SIZE / 2u - 1u, UART_DMA_RX_BUFFER_SIZE / 2u,
+        UART_DMA_RX_BUFFER_SIZE / 2u + 1u, 400u, UART_DMA_RX_BUFFER_SIZE - 1u, UART_DMA_RX_BUFFER_SIZE
+    };
+    static uint8_t data[UART_DMA_RX_BUFFER_SIZE];
+    uint32_t wrapped = 0;
+    uint32_t pass;
+    uint32_t i;
+    char what[64];
+
+    //TWICE ROUND SO THE FRAMES START AT DIFFERENT PLACES IN THE BUFFER
+    for(pass = 0; pass < 2u; pass++)
+    {
+        for(i = 0; i < (sizeof(lengths) / sizeof(lengths[0])); i++)
+        {
+            fill(data, lengths[i], 100u + i + pass);
+            clearFrames();
+            sendFrame(data, lengths[i], 30u, 0u);
+            settle();
+
+            snprintf(what, sizeof(what), "frame of %u bytes", (unsigned)lengths[i]);
+            check((frameCount == 1u) && sameFrame(0, data, lengths[i]), what);
+            wrapped += frameWrapped[0];
+        }
+    }
+
+    check(wrapped > 0u, "some frames wrapped round the buffer");
+    check(uartDmaFramesLost() == 0u, "no frames lost");
+}
+
+static void checkLong(void)
+{
+    static uint8_t data[MAX_FRAME_LEN];
+    uint32_t lost = uartDmaFramesLost();
+
+    fill(data, sizeof(data), 7u);
+
+    clearFrames();
+    sendFrame(data, UART_DMA_RX_BUFFER_SIZE + 10u, 30u, 0u);
+    sendFrame(&data[600], 33u, 30u, 0u);
+    settle();
+
+    check(uartDmaFramesLost() - lost == 1u, "frame longer than the buffer counted as lost");
+    check((frameCount == 1u) && sameFrame(0, &data[600], 33u), "next frame after a lost one right");
+}
+
+static void checkRandom(uint32_t count)
+{
+    static uint8_t data[MAX_FRAMES][UART_DMA_RX_BUFFER_SIZE];
+    static size_t lens[MAX_FRAMES];
+    static uint64_t ends[MAX_FRAMES];
+    uint32_t seed = 12345u;
+    uint64_t worst = 0;
+    uint64_t total = 0;
+    uint32_t batch;
+    uint32_t done = 0;
+    uint32_t n;
+    uint32_t gap;
+    uint8_t ok = 1;
+
+    while(done < count)
+    {
+        batch = ((count - done) < MAX_FRAMES) ? (count - done) : MAX_FRAMES;
+        clearFrames();
+
+        //ALL OF A BATCH IS QUEUED BEFORE TIME MOVES ON
+        for(n = 0; n < batch; n++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            lens[n] = 1u + ((seed >> 8) % (UART_DMA_RX_BUFFER_SIZE / 2u));
+            gap = 10u + ((seed >> 20) % 40u);
+            fill(data[n], lens[n], seed);
+
+            //A FEW FRAMES HAVE SHORT GAPS BETWEEN THEIR BYTES
+            ends[n] = sendFrame(data[n], lens[n], gap, ((seed & 7u) == 0u) ? 5u : 0u);
+        }
+
+        settle();
+
+        ok &= (frameCount == batch);
+        for(n = 0; (n < batch) && (n < frameCount); n++)
+        {
+            ok &= sameFrame(n, data[n], lens[n]);
+
+            if(frameTimes[n] > ends[n])
+            {
+                worst = ((frameTimes[n] - ends[n]) > worst) ? (frameTimes[n] - ends[n]) : worst;
+                total += frameTimes[n] - ends[n];
+            }
+        }
+
+        done += batch;
+    }
+
+    check(ok, "random frames come out whole");
+    check(worst < (2u * CHAR_PS), "frames handed over within two characters of the last byte");
+
+    printf("%u random frames, handed over %.1f us after the last stop bit on average, %.1f us at worst\n",
+           count, (double)total / count / SIM_PS_PER_US, (double)worst / SIM_PS_PER_US);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t count = (argc > 1) ? (uint32_t)strtoul(argv[1], 0, 0) : 2000u;
+    SimStats stats;
+
+    simInit();
+
+    configClock(&clockPll80MHz);
+    initUART_DMA(onFrame);
+
+    checkSplit();
+    checkLengths();
+    checkLong();
+    checkRandom(count);
+
+    simGetStats(&stats);
+    printf("%.1f ms simulated, %llu interrupts, %llu bytes moved by DMA\n",
+           (double)stats.timePs / 1e9, (unsigned long long)stats.interrupts,
+           (unsigned long long)stats.dmaTransfers);
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
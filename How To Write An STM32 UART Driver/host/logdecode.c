@@ -0,0 +1,710 @@
+/*****************************************************************
+ logdecode
+
+    Host-side half of the deferred logging in Log.c. The STM32 only
+    sends message IDs and argument words, this turns them back into
+    text with the formats in LogMessages.h, the same table the
+    firmware was built with.
+
+    decode  prints every log record in a raw UART capture with its
+            time in seconds. Other frames are listed by type
+    check   checks every format in LogMessages.h takes the number
+            of arguments its entry says
+    bench   times a log call against snprintf on the host, then
+            sends records through Log.c, Frame.c and back through
+            the decoder to check nothing is lost or changed
+
+    On the STM32 benchLog (LogBench.c) does the same timing in
+    cycles and logs the result as a LOG_BENCH record, in a build
+    with -DLOG_BENCH_ENABLED=1.
+
+    Build:  cc -O2 -I.. -o logdecode logdecode.c ../Log.c ../Frame.c ../CRC.c
+    Usage:  logdecode decode [capture.bin] [core clock Hz]
+            logdecode check
+            logdecode bench [calls]
+*****************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Log.h"
+#include "Frame.h"
+
+// ONE ENTRY OF LogMessages.h
+typedef struct
+{
+    const char *name;
+    unsigned args;
+    const char *format;
+} Message;
+
+#define LOG_ENTRY_(id, args, format)    { #id, (args), (format) },
+static const Message messages[LOG_MESSAGE_COUNT] = { LOG_MESSAGES(LOG_ENTRY_) };
+
+
+/**********************************************************************************/
+/*************************************Expanding************************************/
+/**********************************************************************************/
+
+
+/*****************************************************************
+ nextConversion
+
+    Finds the next conversion in 'format' and copies it, from the %
+    to the conversion letter, into 'spec'
+
+    Returns
+    the conversion letter, 0 at the end of the format or -1 if the
+    conversion isn't one LogMessages.h allows. 'format' is moved
+    past it and the text before it is in 'text'
+*****************************************************************/
+static int nextConversion(const char **format, char *text, size_t textSize, char *spec, size_t specSize)
+{
+    const char *p = *format;
+    size_t t = 0;
+    size_t s = 0;
+
+    // COPY PLAIN TEXT, WITH %% AS ONE %
+    while(*p)
+    {
+        if((p[0] == '%') && (p[1] == '%'))
+        {
+            p += 2;
+        }
+        else if(p[0] == '%')
+        {
+            break;
+        }
+        else
+        {
+            p++;
+        }
+
+        if(t + 1u < textSize)
+        {
+            text[t++] = p[-1];
+        }
+    }
+
+    text[t] = '\0';
+
+    if(!*p)
+    {
+        *format = p;
+        return 0;
+    }
+
+    // %, FLAGS, WIDTH AND PRECISION
+    spec[s++] = *p++;
+
+    while(*p && strchr("-+ #0123456789.", *p) && (s + 2u < specSize))
+    {
+        spec[s++] = *p++;
+    }
+
+    if(!*p || !strchr("diuxXocfFeEgG", *p))
+    {
+        *format = p;
+        return -1;
+    }
+
+    spec[s++] = *p;
+    spec[s] = '\0';
+    *format = p + 1;
+
+    return (unsigned char)spec[s - 1u];
+}
+
+/*****************************************************************
+ countConversions
+
+    Returns
+    the number of arguments 'format' takes, -1 if it isn't valid
+*****************************************************************/
+static int countConversions(const char *format)
+{
+    char text[256];
+    char spec[32];
+    int count = 0;
+    int c;
+
+    while((c = nextConversion(&format, text, sizeof(text), spec, sizeof(spec))) > 0)
+    {
+        count++;
+    }
+
+    return (c < 0) ? -1 : count;
+}
+
+/*****************************************************************
+ expandRecord
+
+    Formats one record the way printf would have on the STM32
+
+    Returns
+    the length of the text, -1 if the format and the arguments
+    don't match
+*****************************************************************/
+static int expandRecord(char *out, size_t size, const char *format, const uint32_t *args, unsigned count)
+{
+    char text[256];
+    char spec[32];
+    size_t len = 0;
+    unsigned used = 0;
+    int c;
+
+    out[0] = '\0';
+
+    do
+    {
+        c = nextConversion(&format, text, sizeof(text), spec, sizeof(spec));
+
+        if(c < 0)
+        {
+            return -1;
+        }
+
+        len += (size_t)snprintf(out + len, (len < size) ? (size - len) : 0, "%s", text);
+
+        if(c == 0)
+        {
+            break;
+        }
+
+        if(used >= count)
+        {
+            return -1;
+        }
+
+        // EACH ARGUMENT WAS SENT AS A WORD. TURN IT BACK INTO THE TYPE
+        // THE CONVERSION EXPECTS
+        if((c == 'd') || (c == 'i') || (c == 'c'))
+        {
+            len += (size_t)snprintf(out + len, (len < size) ? (size - len) : 0, spec, (int)(int32_t)args[used]);
+        }
+        else if(strchr("fFeEgG", c))
+        {
+            float x;
+
+            memcpy(&x, &args[used], sizeof(x));
+            len += (size_t)snprintf(out + len, (len < size) ? (size - len) : 0, spec, (double)x);
+        }
+        else
+        {
+            len += (size_t)snprintf(out + len, (len < size) ? (size - len) : 0, spec, (unsigned)args[used]);
+        }
+
+        used++;
+    } while(1);
+
+    return (used == count) ? (int)len : -1;
+}
+
+/*****************************************************************
+ checkMessages
+
+    Returns
+    the number of entries in LogMessages.h whose format doesn't
+    take the number of arguments the entry says
+*****************************************************************/
+static unsigned checkMessages(int verbose)
+{
+    unsigned bad = 0;
+    unsigned i;
+
+    for(i = 0; i < LOG_MESSAGE_COUNT; i++)
+    {
+        int count = countConversions(messages[i].format);
+
+        if((count != (int)messages[i].args) || (messages[i].args > LOG_MAX_ARGS))
+        {
+            printf("%s: format takes %d arguments, entry says %u\n", messages[i].name, count, messages[i].args);
+            bad++;
+        }
+        else if(verbose)
+        {
+            printf("%3u %-20s %u  \"%s\"\n", i, messages[i].name, messages[i].args, messages[i].format);
+        }
+    }
+
+    return bad;
+}
+
+
+/**********************************************************************************/
+/*************************************Decoding*************************************/
+/**********************************************************************************/
+
+
+// TURNS THE 32-BIT CYCLE COUNTS INTO A TIME THAT DOESN'T WRAP
+typedef struct
+{
+    uint8_t started;
+    uint32_t last;
+    uint64_t cycles;
+    uint32_t hz;                // CORE CLOCK OF THE STM32
+} Clock;
+
+static uint32_t getWord(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*****************************************************************
+ decodeRecords
+
+    Calls 'record' for every record in the payload of a log frame
+
+    Returns
+    the number of records, -1 if the payload is cut short
+*****************************************************************/
+typedef void (*RecordHandler)(uint32_t id, uint32_t time, const uint32_t *args, unsigned count, void *arg);
+
+static int decodeRecords(const uint8_t *payload, size_t len, RecordHandler record, void *arg)
+{
+    uint32_t args[LOG_MAX_ARGS];
+    size_t pos = 0;
+    int records = 0;
+    unsigned count;
+    unsigned i;
+
+    while(pos < len)
+    {
+        uint32_t header;
+
+        if((len - pos) < 8u)
+        {
+            return -1;
+        }
+
+        header = getWord(&payload[pos]);
+        count = LOG_HEADER_ARGS(header);
+
+        if((count > LOG_MAX_ARGS) || ((len - pos) < (4u * LOG_RECORD_WORDS(count))))
+        {
+            return -1;
+        }
+
+        for(i = 0; i < count; i++)
+        {
+            args[i] = getWord(&payload[pos + 8u + (4u * i)]);
+        }
+
+        record(LOG_HEADER_ID(header), getWord(&payload[pos + 4u]), args, count, arg);
+
+        pos += 4u * LOG_RECORD_WORDS(count);
+        records++;
+    }
+
+    return records;
+}
+
+/*****************************************************************
+ printRecord
+
+    Prints one record as text with its time
+*****************************************************************/
+static void printRecord(uint32_t id, uint32_t time, const uint32_t *args, unsigned count, void *arg)
+{
+    Clock *clock = (Clock *)arg;
+    char text[512];
+    unsigned i;
+
+    if(!clock->started)
+    {
+        clock->started = 1;
+        clock->last = time;
+    }
+
+    clock->cycles += (uint32_t)(time - clock->last);
+    clock->last = time;
+
+    printf("[%12.6f] ", (double)clock->cycles / clock->hz);
+
+    if((id < LOG_MESSAGE_COUNT) && (expandRecord(text, sizeof(text), messages[id].format, args, count) >= 0))
+    {
+        printf("%s\n", text);
+        return;
+    }
+
+    // NOT IN THIS TABLE, OR THE TABLE HAS CHANGED SINCE THE CAPTURE
+    printf("unknown message %lu:", (unsigned long)id);
+
+    for(i = 0; i < count; i++)
+    {
+        printf(" %08lX", (unsigned long)args[i]);
+    }
+
+    printf("\n");
+}
+
+/*****************************************************************
+ decodeStream
+
+    Decodes frames from 'in' and prints every log record
+*****************************************************************/
+static int decodeStream(FILE *in, uint32_t coreHz)
+{
+    FrameDecoder decoder;
+    Frame frame;
+    Clock clock = { 0, 0, 0, 0 };
+    int c;
+
+    initFrameDecoder(&decoder);
+    clock.hz = coreHz;
+
+    while((c = fgetc(in)) != EOF)
+    {
+        if(decodeFrameByte(&decoder, (uint8_t)c, &frame) != FRAME_OK)
+        {
+            continue;
+        }
+
+        if(frame.type != LOG_FRAME_TYPE)
+        {
+            printf("               frame seq %3u type 0x%02X, %lu bytes\n", frame.seq, frame.type, (unsigned long)frame.len);
+            continue;
+        }
+
+        if(decodeRecords(frame.payload, frame.len, printRecord, &clock) < 0)
+        {
+            printf("               log frame seq %3u cut short\n", frame.seq);
+        }
+    }
+
+    printf("frames: %lu good, %lu bad CRC, %lu malformed, %lu lost. Records lost on the STM32 show as \"log records lost\"\n",
+           (unsigned long)decoder.good, (unsigned long)decoder.crcErrors,
+           (unsigned long)decoder.malformed, (unsigned long)decoder.lost);
+
+    return 0;
+}
+
+
+/**********************************************************************************/
+/*************************************Bench****************************************/
+/**********************************************************************************/
+
+
+// BYTES "SENT" BY pumpLog
+static uint8_t link[1u << 20];
+static size_t linkLen = 0;
+
+static size_t writeLink(const uint8_t *buf, size_t len)
+{
+    if(len > (sizeof(link) - linkLen))
+    {
+        len = sizeof(link) - linkLen;
+    }
+
+    memcpy(&link[linkLen], buf, len);
+    linkLen += len;
+
+    return len;
+}
+
+static size_t dropLink(const uint8_t *buf, size_t len)
+{
+    (void)buf;
+
+    return len;
+}
+
+// WHAT THE ROUND TRIP SENT AND GOT BACK
+typedef struct
+{
+    uint32_t sent[4096][1u + LOG_MAX_ARGS];
+    unsigned sentCount;
+    unsigned received;
+    unsigned mismatched;
+    uint32_t lostReported;
+} RoundTrip;
+
+static RoundTrip trip;
+
+static void checkRecord(uint32_t id, uint32_t time, const uint32_t *args, unsigned count, void *arg)
+{
+    RoundTrip *r = (RoundTrip *)arg;
+    const uint32_t *want = r->sent[r->received];
+    unsigned i;
+
+    (void)time;
+
+    if(id == LOG_LOST)
+    {
+        r->lostReported += args[0];
+        return;
+    }
+
+    if((r->received >= r->sentCount) || (id != want[0]) || (count != messages[id].args))
+    {
+        r->mismatched++;
+        r->received++;
+        return;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if(args[i] != want[1u + i])
+        {
+            r->mismatched++;
+            break;
+        }
+    }
+
+    r->received++;
+}
+
+static double elapsedNs(const struct timespec *start, const struct timespec *stop)
+{
+    return ((stop->tv_sec - start->tv_sec) * 1e9) + (stop->tv_nsec - start->tv_nsec);
+}
+
+/*****************************************************************
+ checkExpand
+
+    Checks the expander against text printf gives for the same
+    values
+
+    Returns
+    the number of failures
+*****************************************************************/
+static unsigned checkExpand(void)
+{
+    static const struct
+    {
+        const char *format;
+        uint32_t args[LOG_MAX_ARGS];
+        unsigned count;
+        const char *want;
+    } cases[] =
+    {
+        { "%u log records lost", { 7 }, 1, "7 log records lost" },
+        { "x=%d y=%-5d|%+i", { (uint32_t)-12, 34, 5 }, 3, "x=-12 y=34   |+5" },
+        { "0x%08X %x %o 100%%", { 0xBEEFu, 255, 8 }, 3, "0x0000BEEF ff 10 100%" },
+        { "%c%c %.2f", { 'o', 'k', 0x3FC00000u }, 3, "ok 1.50" },
+        { "%u %u %u %u", { 0xFFFFFFFFu, 0, 1, 2 }, 4, "4294967295 0 1 2" },
+    };
+    char text[256];
+    unsigned bad = 0;
+    size_t i;
+
+    for(i = 0; i < (sizeof(cases) / sizeof(cases[0])); i++)
+    {
+        if((expandRecord(text, sizeof(text), cases[i].format, cases[i].args, cases[i].count) < 0)
+           || (strcmp(text, cases[i].want) != 0))
+        {
+            printf("  \"%s\" gave \"%s\", want \"%s\"\n", cases[i].format, text, cases[i].want);
+            bad++;
+        }
+    }
+
+    // WRONG ARGUMENT COUNTS MUST BE CAUGHT
+    if((expandRecord(text, sizeof(text), "%u %u", cases[0].args, 1) >= 0)
+       || (expandRecord(text, sizeof(text), "%u", cases[0].args, 2) >= 0)
+       || (countConversions("%s") >= 0))
+    {
+        printf("  bad argument counts not caught\n");
+        bad++;
+    }
+
+    return bad;
+}
+
+/*****************************************************************
+ roundTrip
+
+    Logs 'records' random records, pumping after a random number of
+    calls so that the ring sometimes fills, then decodes what was
+    sent
+
+    Returns
+    1 if every record came back unchanged or was reported lost
+*****************************************************************/
+static int roundTrip(unsigned records)
+{
+    FrameDecoder decoder;
+    Frame frame;
+    uint8_t seq = 0;
+    unsigned i;
+    size_t pos;
+
+    initLog();
+    memset(&trip, 0, sizeof(trip));
+    linkLen = 0;
+
+    if(records > (sizeof(trip.sent) / sizeof(trip.sent[0])))
+    {
+        records = sizeof(trip.sent) / sizeof(trip.sent[0]);
+    }
+
+    for(i = 0; i < records; i++)
+    {
+        uint32_t id = 1u + ((uint32_t)rand() % (LOG_MESSAGE_COUNT - 1u));
+        uint32_t a = (uint32_t)rand() * 2654435761u;
+        uint32_t b = ~a;
+        uint32_t c = a ^ 0x5A5A5A5Au;
+        uint32_t lostBefore = logLost();
+
+        switch(messages[id].args)
+        {
+            case 0: recordLog0(id); break;
+            case 1: recordLog1(id, a); break;
+            case 2: recordLog2(id, a, b); break;
+            case 3: recordLog3(id, a, b, c); break;
+            default: recordLog4(id, a, b, c, a + b); break;
+        }
+
+        // ONLY RECORDS THAT GOT INTO THE RING ARE EXPECTED BACK
+        if(logLost() == lostBefore)
+        {
+            trip.sent[trip.sentCount][0] = id;
+            trip.sent[trip.sentCount][1] = a;
+            trip.sent[trip.sentCount][2] = b;
+            trip.sent[trip.sentCount][3] = c;
+            trip.sent[trip.sentCount][4] = a + b;
+            trip.sentCount++;
+        }
+
+        // A SLOW LINK, ONE FRAME NOW AND THEN
+        if((rand() % 24) == 0)
+        {
+            pumpLog(writeLink, sizeof(link) - linkLen, &seq);
+        }
+    }
+
+    while(!pumpLog(writeLink, sizeof(link) - linkLen, &seq))
+    {
+    }
+
+    initFrameDecoder(&decoder);
+
+    for(pos = 0; pos < linkLen; pos++)
+    {
+        if(decodeFrameByte(&decoder, link[pos], &frame) == FRAME_OK)
+        {
+            decodeRecords(frame.payload, frame.len, checkRecord, &trip);
+        }
+    }
+
+    printf("  %u records logged, %lu lost and %lu reported lost, %u came back, %u changed, %lu bytes sent\n",
+           records, (unsigned long)logLost(), (unsigned long)trip.lostReported,
+           trip.received, trip.mismatched, (unsigned long)linkLen);
+
+    return (trip.received == trip.sentCount) && (trip.mismatched == 0u)
+           && (trip.lostReported == logLost()) && (decoder.lost == 0u)
+           && ((trip.sentCount + logLost()) == records);
+}
+
+static int bench(unsigned calls)
+{
+    char text[128];
+    struct timespec start;
+    struct timespec stop;
+    double logNs = 0;
+    double formatNs;
+    volatile int chars = 0;
+    uint8_t seq = 0;
+    unsigned failed = 0;
+    unsigned done;
+    unsigned i;
+
+    printf("expander\n");
+    failed += checkExpand();
+    failed += checkMessages(0);
+
+    printf("round trip\n");
+    failed += !roundTrip(4000);
+
+    // LOG CALLS IN BATCHES THAT FIT THE RING, PUMPED OUTSIDE THE TIMING
+    initLog();
+
+    for(done = 0; done < calls; done += i)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for(i = 0; (i < 40u) && ((done + i) < calls); i++)
+        {
+            LOG3(LOG_BENCH_SAMPLE, i, -(int32_t)i, i * 1000u);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        logNs += elapsedNs(&start, &stop);
+
+        while(!pumpLog(dropLink, sizeof(link), &seq))
+        {
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i = 0; i < calls; i++)
+    {
+        chars = snprintf(text, sizeof(text), messages[LOG_BENCH_SAMPLE].format, (int)i, -(int)i, (int)(i * 1000u));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    formatNs = elapsedNs(&start, &stop);
+
+    printf("host, %u calls of \"%s\"\n", calls, messages[LOG_BENCH_SAMPLE].format);
+    printf("  log call   %6.1f ns\n", logNs / calls);
+    printf("  snprintf   %6.1f ns for %d characters, %.1fx the log call\n", formatNs / calls, chars, formatNs / logNs);
+    printf("  record %u bytes on the wire against %d characters of text\n", 4u * LOG_RECORD_WORDS(3u), chars);
+
+    printf("%s\n", failed ? "FAILED" : "all checks ok");
+
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(checkMessages(0) != 0)
+    {
+        printf("fix LogMessages.h first\n");
+        return 1;
+    }
+
+    if((argc >= 2) && (strcmp(argv[1], "decode") == 0))
+    {
+        FILE *in = stdin;
+        uint32_t coreHz = (argc >= 4) ? (uint32_t)strtoul(argv[3], 0, 0) : 80000000u;
+        int result;
+
+        if((argc >= 3) && (strcmp(argv[2], "-") != 0))
+        {
+            in = fopen(argv[2], "rb");
+
+            if(!in)
+            {
+                perror(argv[2]);
+                return 1;
+            }
+        }
+
+        result = decodeStream(in, coreHz);
+
+        if(in != stdin)
+        {
+            fclose(in);
+        }
+
+        return result;
+    }
+
+    if((argc >= 2) && (strcmp(argv[1], "check") == 0))
+    {
+        return checkMessages(1) ? 1 : 0;
+    }
+
+    if((argc >= 2) && (strcmp(argv[1], "bench") == 0))
+    {
+        return bench((argc >= 3) ? (unsigned)strtoul(argv[2], 0, 0) : 1000000u);
+    }
+
+    printf("usage: logdecode decode [capture.bin] [core clock Hz]\n"
+           "       logdecode check\n"
+           "       logdecode bench [calls]\n");
+
+    return 1;
+}
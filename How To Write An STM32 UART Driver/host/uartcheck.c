@@ -0,0 +1,287 @@
+/*****************************************************************
+ uartcheck
+
+    Checks the interrupt-driven UART1 driver in UART.c (initUART_IT,
+    uartWrite, uartRead and USART1_IRQHandler) against the USART1
+    model in host/sim/, with the handler called by the simulated NVIC
+    exactly as the STM32 would call it.
+
+      tx       a long message written in pieces as room appears
+               comes out of the UART whole and in order, and
+               UART_EVENT_TX_EMPTY is raised once it has all gone
+      rx       every byte value, 0x00 included, reads back in order
+      full     bytes arriving with the RX ring buffer full are
+               counted by uartRxDropped, the first ones are kept
+      overrun  bytes arriving while interrupts are masked are lost
+               in the UART and counted by uartRxOverruns
+      echo     a main loop that does other work between passes
+               echoes a long stream at full line rate, wrapping
+               both ring buffers many times, without losing a byte
+
+    Build:  cc -O2 -no-pie -I../../host/sim -I.. -o uartcheck uartcheck.c ../../host/sim/sim.c ../UART.c ../UARTBaud.c ../Clock.c
+    Usage:  uartcheck
+*****************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "Clock.h"
+#include "UART.h"
+
+#define ECHO_BYTES      20000u
+
+// ONE 10-BIT CHARACTER AT 115200 BAUD, ROUNDED UP
+#define CHAR_US         87u
+
+// TIME FOR 'n' CHARACTERS AFTER A 20-BIT GAP, WITH SOME TO SPARE
+#define CHARS_US(n)     (((uint64_t)(n) + 4u) * CHAR_US)
+
+static uint8_t data[ECHO_BYTES];
+static uint8_t got[ECHO_BYTES];
+
+static uint32_t rxEvents = 0;
+static uint32_t txEmptyEvents = 0;
+
+static uint32_t errors = 0;
+
+
+static void check(int ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+static void onEvent(uint8_t event)
+{
+    if(event == UART_EVENT_RX)
+    {
+        rxEvents++;
+    }
+    else if(event == UART_EVENT_TX_EMPTY)
+    {
+        txEmptyEvents++;
+    }
+}
+
+ /*****************************************************************
+ drainTx
+
+    Lets the UART finish sending and takes everything it sent
+
+    Returns
+    the number of bytes taken
+*****************************************************************/
+static size_t drainTx(uint8_t *buf, size_t max, uint32_t chars)
+{
+    simRunUs(CHARS_US(chars));
+
+    return simUartTx(buf, max);
+}
+
+static void checkTx(void)
+{
+    size_t len = 3000u;
+    size_t sent = 0;
+    size_t taken;
+    uint32_t i;
+
+    for(i = 0; i < len; i++)
+    {
+        data[i] = (uint8_t)(i * 31u + 7u);
+    }
+
+    txEmptyEvents = 0;
+
+    //THE FIRST WRITE FILLS THE RING BUFFER AND NO MORE. THE HANDLER
+    //STRAIGHT AWAY MOVES A BYTE INTO THE SHIFT REGISTER AND ANOTHER
+    //INTO TDR, MAKING ROOM FOR TWO MORE
+    sent = uartWrite(data, len);
+    check(sent == UART_TX_BUFFER_SIZE, "uartWrite takes what fits");
+    check(uartTxFree() == 2u, "two bytes taken by the UART at once");
+    sent += uartWrite(&data[sent], len - sent);
+    check(uartTxFree() == 0u, "uartTxFree is 0 when full");
+    check(uartWrite(data, 1u) == 0u, "uartWrite takes nothing when full");
+
+    while(sent < len)
+    {
+        simRunUs(1000u);
+        check(uartTxFree() > 0u, "room appears as bytes go out");
+        sent += uartWrite(&data[sent], len - sent);
+    }
+
+    taken = drainTx(got, sizeof(got), UART_TX_BUFFER_SIZE);
+
+    check(taken == len, "every byte sent");
+    check(memcmp(got, data, len) == 0, "bytes sent in order");
+    check(txEmptyEvents == 1u, "UART_EVENT_TX_EMPTY once at the end");
+    check(uartTxFree() == UART_TX_BUFFER_SIZE, "ring buffer empty afterwards");
+    check(!(USART1->CR1 & USART_CR1_TXEIE), "TX interrupt off when idle");
+}
+
+static void checkRx(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < 256u; i++)
+    {
+        data[i] = (uint8_t)i;
+    }
+
+    rxEvents = 0;
+    check(uartRead(got, sizeof(got)) == 0u, "nothing to read at first");
+
+    simUartRx(data, 200u, 20u);
+    simRunUs(CHARS_US(200u));
+
+    check(uartRxAvailable() == 200u, "uartRxAvailable counts received bytes");
+    check(rxEvents == 200u, "UART_EVENT_RX for every byte");
+    check(uartRead(got, 50u) == 50u, "uartRead stops at maxLen");
+    check(uartRead(&got[50], sizeof(got)) == 150u, "uartRead takes the rest");
+    check(memcmp(got, data, 200u) == 0, "bytes received in order, 0x00 included");
+    check(uartRxDropped() == 0u, "nothing dropped");
+    check(uartRxOverruns() == 0u, "no overruns");
+}
+
+static void checkFull(void)
+{
+    uint32_t extra = 40u;
+    uint32_t total = UART_RX_BUFFER_SIZE + extra;
+    uint32_t dropped = uartRxDropped();
+    uint32_t i;
+
+    for(i = 0; i < total; i++)
+    {
+        data[i] = (uint8_t)(i ^ 0xA5u);
+    }
+
+    simUartRx(data, total, 20u);
+    simRunUs(CHARS_US(total));
+
+    check(uartRxDropped() - dropped == extra, "bytes past a full ring buffer counted as dropped");
+    check(uartRxAvailable() == UART_RX_BUFFER_SIZE, "ring buffer holds its size");
+    check(uartRead(got, sizeof(got)) == UART_RX_BUFFER_SIZE, "full ring buffer read out");
+    check(memcmp(got, data, UART_RX_BUFFER_SIZE) == 0, "the first bytes are kept");
+}
+
+static void checkOverrun(void)
+{
+    uint32_t overruns = uartRxOverruns();
+    uint32_t i;
+
+    for(i = 0; i < 5u; i++)
+    {
+        data[i] = (uint8_t)(0x40u + i);
+    }
+
+    //THE HANDLER CAN'T RUN, SO RDR ONLY HOLDS THE FIRST BYTE
+    __disable_irq();
+    simUartRx(data, 5u, 20u);
+    simRunUs(CHARS_US(5u));
+    __enable_irq();
+
+    check(uartRxOverruns() - overruns == 1u, "overrun counted once");
+    check(uartRead(got, sizeof(got)) == 1u, "only the byte in RDR is kept");
+    check(got[0] == data[0], "the byte in RDR is the first");
+    check(!(USART1->ISR & USART_ISR_ORE), "ORE cleared by the handler");
+
+    //RECEIVING CARRIES ON NORMALLY
+    simUartRx(&data[1], 2u, 20u);
+    simRunUs(CHARS_US(2u));
+    check((uartRead(got, sizeof(got)) == 2u) && (got[0] == data[1]) && (got[1] == data[2]),
+          "receiving goes on after an overrun");
+}
+
+ /*****************************************************************
+ checkEcho
+
+    The main loop reads whatever has arrived, does 200us of other
+    work and writes it back. The far end never pauses, so the
+    loop must keep up on average and the ring buffers soak up the
+    rest
+*****************************************************************/
+static void checkEcho(void)
+{
+    uint8_t chunk[64];
+    size_t received = 0;
+    size_t echoed = 0;
+    size_t taken = 0;
+    size_t count;
+    size_t n;
+    uint32_t dropped = uartRxDropped();
+    uint32_t overruns = uartRxOverruns();
+    uint32_t i;
+
+    for(i = 0; i < ECHO_BYTES; i++)
+    {
+        data[i] = (uint8_t)((i * 2654435761u) >> 24);
+    }
+
+    simUartRx(data, ECHO_BYTES, 20u);
+
+    while(echoed < ECHO_BYTES)
+    {
+        count = uartRead(chunk, sizeof(chunk));
+        received += count;
+
+        //A CHUNK THAT DOESN'T FIT IS WRITTEN AS ROOM APPEARS
+        n = 0;
+        while(n < count)
+        {
+            n += uartWrite(&chunk[n], count - n);
+
+            if(n < count)
+            {
+                simBusy(1000u);
+            }
+        }
+
+        echoed += count;
+        simBusy(16000u);
+
+        taken += simUartTx(&got[taken], sizeof(got) - taken);
+    }
+
+    taken += drainTx(&got[taken], sizeof(got) - taken, UART_TX_BUFFER_SIZE);
+
+    check(received == ECHO_BYTES, "echo: every byte received");
+    check(uartRxDropped() == dropped, "echo: nothing dropped");
+    check(uartRxOverruns() == overruns, "echo: no overruns");
+    check(taken == ECHO_BYTES, "echo: every byte sent back");
+    check(memcmp(got, data, ECHO_BYTES) == 0, "echo: bytes sent back in order");
+}
+
+int main(void)
+{
+    SimStats stats;
+
+    simInit();
+
+    configClock(&clockPll80MHz);
+    initUART_IT();
+    setUartEventCallback(onEvent);
+
+    checkTx();
+    checkRx();
+    checkFull();
+    checkOverrun();
+    checkEcho();
+
+    simGetStats(&stats);
+    printf("%.1f ms simulated, %llu interrupts, %llu bytes sent, %llu received\n",
+           (double)stats.timePs / 1e9, (unsigned long long)stats.interrupts,
+           (unsigned long long)stats.uartTxBytes, (unsigned long long)stats.uartRxBytes);
+
+    if(errors)
+    {
+        printf("%u check(s) failed\n", errors);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
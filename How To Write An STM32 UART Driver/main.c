@@ -1,209 +1,136 @@
 #include "stm32l432xx.h"
+#include "UART.h"
+#include "Clock.h"
+#include "Frame.h"
+#include "CRC.h"
+#include "Log.h"
+#include "Power.h"
 
+// RECEIVE STATE FOR FRAMES COMING IN ON UART1
+static FrameDecoder decoder;
 
-/*****************************************************************
- initClocks
-
- All clocks required are initialised here.
-*****************************************************************/
-void initClocks(void)
-{
-    RCC->AHB2ENR |= RCC_AHB2ENR_GPIOAEN;        // ENABLE GPIO PORT A CLOCK (BIT 0)
-    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;       // ENABLE UART1 CLOCK (BIT 14)
-}
+// HOLDS ONE ENCODED REPLY
+static uint8_t txFrame[FRAME_ENCODED_MAX(FRAME_MAX_PAYLOAD)];
 
+// TX BUFFER ROOM THE LOOP IS WAITING FOR, 0 WHEN IT ISN'T WAITING
+static size_t txWanted = 0;
 
 /*****************************************************************
- configPinMode
+ queryPower
 
- Configures the mode of the pins.
+ Tells the power layer what is running. UART1 TX stops in Stop
+ mode, and received bytes or TX room the loop is waiting for are
+ work to do straight away.
 *****************************************************************/
-void configPinMode(void)
+static void queryPower(PowerState *state)
 {
-    // RESET PIN MODES
-    GPIOA->MODER &= ~((3u << 18)    // CLEAR PA9
-                     |(3u << 20));  // CLEAR PA10
-
-    // SET PIN MODES
-    GPIOA->MODER |= ((2u << 18)     // SET PA9 TO AF
-                    |(2u << 20));   // SET PA10 TO AF
+    state->timerPending = 0;
+    state->ticksToDeadline = 0;
+    state->busy = (uartTxFree() < UART_TX_BUFFER_SIZE);
+    state->workPending = (uartRxAvailable() != 0)
+                      || ((txWanted != 0) && (uartTxFree() >= txWanted));
+    state->uartStopWake = UART1_CLOCK_HSI16;
 }
 
-/*****************************************************************
- setAF
-
- Configures alternate function of the pins to UART1.
-*****************************************************************/
-void setAF(void)
-{
-    // RESET ALTERNATE FUNCTION. AFR[1] IS THE
-    // ALTERNATE FUNCTION HIGH REGISTER
-    GPIOA->AFR[1] &= ~((15u << 4)       // CLEAR PA9 AF
-                      |(15u << 8));     // CLEAR PA10 AF
-
-    // SET ALTERNATE FUNCTION
-    GPIOA->AFR[1] |= ((7u << 4)         // SET PA9 AF
-                     |(7u << 8));       // SET PA10 AF
-}
-
-/*****************************************************************
- configUart1Pins
-
- Configures required pins to to be used as UART1 pins.
-*****************************************************************/
-void configUart1Pins(void)
+int main(void)
 {
-    // SET PIN MODE TO ALTERNATE FUNCTION
-    configPinMode();
+    // HOLDS THE BYTES TAKEN OUT OF THE RX RING BUFFER
+    uint8_t rxData[16];
 
-    // SET ALTERNATE FUNCTION TO BE UART1
-    setAF();
-}
+    // NUMBER OF BYTES IN rxData
+    size_t rxCount = 0;
 
-/*****************************************************************
- configUart1
+    // THE FRAME THAT HAS JUST BEEN DECODED
+    Frame frame;
 
- This function configures the UART1 related registers to set up
- the peripheral.
-*****************************************************************/
-void configUart1(void)
-{
-    // CONFIGURE USART1 CR1 REGISTER
-    // CLEAR BITS
-    USART1->CR1 &= ~(USART_CR1_M1       // CLEAR M1 FOR 1 START BIT AND 8 DATA BITS (28)
-                    |(0x03 << 26)       // INHIBIT INTERRUPTS AT BITS 26 AND 27     (27/26)
-                    |USART_CR1_OVER8    // OVERSAMPLING BY 16                       (15)
-                    |USART_CR1_CMIE     // INHIBIT CHARACTER MATCH INTERRUPT        (14)
-                    |USART_CR1_MME      // DON'T ENABLE MUTE MODE                   (13)
-                    |USART_CR1_M0       // CLEAR M0 FOR 1 START BIT AND 8 DATA BITS (12)
-                    |USART_CR1_PCE      // NOT IMPLEMENTING PARITY CONTROL          (10)
-                    |(0x1F << 3)        // INHIBIT INTERRUPTS AT BITS 4 TO 8        (4-8)
-                    |USART_CR1_TE       // DON'T ENABLE TRANSMITTER JUST YET        (3)
-                    |USART_CR1_RE       // DON'T ENABLE RECEIVER JUST YET           (2)
-                    |USART_CR1_UE);     // DON'T ENABLE UART1 JUST YET              (0)
-
-    // CONFIGURE USART CR2 REGISTER
-    // CLEAR BITS
-    USART1->CR2 &= ~(USART_CR2_RTOEN    // DISABLE RECEIVER TIMEOUT             (23)
-                    |USART_CR2_ABREN    // NO AUTOMATIC BAUD RATE DETECTION     (20)
-                    |USART_CR2_MSBFIRST // TRANSMIT/RECEIVE LSB FIRST           (19)
-                    |(0x03 << 16)       // IDLE STATE HIGH FOR RX/TX PINS       (17/16)
-                    |USART_CR2_SWAP     // DON'T SWAP FUNCTION OF RX/TX PINS    (15)
-                    |USART_CR2_LINEN    // NO LIN MODE                          (14)
-                    |(0x03 << 12)       // 1 STOP BIT                           (13/12)
-                    |USART_CR2_CLKEN    // DON'T USE CLOCK WITH UART            (11)
-                    |USART_CR2_LBDIE);  // NO LIN BREAK DETECTION INTERRUPT     (6)
-
-    // CONFIGURE USART CR3 REGISTER
-    // CLEAR BITS
-    USART1->CR3 &= ~(USART_CR3_TCBGTIE  // NO TRANSMISSION COMPLETE BEFORE GUART TIME INTERRUPT (24)
-                    |USART_CR3_DEM      // NO DRIVER ENABLE MODE                                (14)
-                    |(0x7F << 3)        // DISABLE VARIOUS IRRELEVANT MODES                     (9-3)
-                    |USART_CR3_IREN     // NO IrDA MODE                                         (1)
-                    |USART_CR3_EIE);    // INHIBIT ERROR INTERRUPT                              (0)
-
-    // SET BITS
-    USART1->CR3 |= (USART_CR3_OVRDIS    // DISABLE OVERRUN FUNCTIONALITY (12)
-                   |USART_CR3_ONEBIT);  // USE ONE SAMPLE BIT METHOD     (11)
-
-    // SET BAUD RATE IN BRR REGISTER
-    USART1->BRR = 35;                   // VALUE THAT SETS BAUD RATE TO 115,200 AT INPUT FREQUENCY OF 4MHZ
-
-    // ENABLE UART
-    USART1->CR1 |= (USART_CR1_TE        // ENABLE TRANSMITTER (3)
-                   |USART_CR1_RE        // ENABLE RECEIVER    (2)
-                   |USART_CR1_UE);      // ENABLE UART1       (0)
+    // SEQUENCE NUMBER OF THE NEXT REPLY
+    uint8_t txSeq = 0;
 
-}
-
-/*****************************************************************
- initUART
+    // LENGTH OF THE ENCODED REPLY
+    size_t txLen;
 
- This function encapsulates all the code and function calls
- related to setting up the UART.
-*****************************************************************/
-void initUART(void)
-{
-    // INITIALISE REQUIRED CLOCKS. MUST ALWAYS BE DONE FIRST
-    // AS WITHOUT ENABLING THE CLOCKS THE PERIPHERALS CANNOT
-    // BE CONFIGURED OR USED.
-    initClocks();
+    // RESULT OF decodeFrameByte
+    uint8_t result;
 
-    // CONFIGURE PINS FOR UART1
-    configUart1Pins();
+    size_t i;
 
-    // CONFIGURE UART1
-    configUart1();
-}
+    // RUN THE CORE AT 80MHZ BEFORE SETTING UP THE UART SO THE
+    // BAUD RATE IS WORKED OUT FROM THE NEW CLOCK
+    configClock(&clockPll80MHz);
 
-/*****************************************************************
- transmitUart
-
- This function sends a byte of data over UART.
-*****************************************************************/
-void transmitUart(uint8_t data)     // BYTE OF DATA TO BE TRANSMITTED
-{
-    // WAIT UNTIL TRANSMIT DATA REGISTER IS READY TO TAKE DATA
-    // USART_ISR_TXE EXPANDS TO (1 << 7);
-    while(!(USART1->ISR & USART_ISR_TXE));
-
-    // LOAD DATA TO TRANSMIT REGISTER
-    USART1->TDR = data;
-}
-
-/*****************************************************************
- transmitStrUart
-
- This function transmits a string over UART.
-*****************************************************************/
-void transmitStrUart(char* str) // POINTER TO A STRING TO BE TRANSMITTED
-{
-    // WHILE NOT END OF STRING
-    while(*str)
+    // SET UP UART. NOTHING TO DO WITHOUT IT
+    if(!initUART_IT())
     {
-        // TRANSMIT CHARACTER THEN INCREMENT POINTER TO NEXT CHARACTER
-        transmitUart(*str++);
+        while(1);
     }
-}
 
-/*****************************************************************
- receiveUart
+    // FRAME CRCS ARE WORKED OUT BY THE CRC UNIT
+    initCrc();
+    initFrameDecoder(&decoder);
 
- This function reads a byte of data from the receive data register
- if there is data to be read.
+    // RECEIVED BYTES WAKE US. FROM STOP 1 TOO WHEN UART1 RUNS ON HSI16
+#if UART1_CLOCK_HSI16
+    enableUart1WakeFromStop();
+#endif
+    initPower(POWER_WAKE_UART1, queryPower);
 
- Returns
- a byte of data read from the receive data register
-*****************************************************************/
-uint8_t receiveUart(void)
-{
-    uint8_t rxData = 0;
+    // LOG RECORDS GO OUT AS FRAMES BETWEEN THE REPLIES
+    initLog();
+    LOG1(LOG_BOOT, getHclkHz());
+#if LOG_BENCH_ENABLED
+    benchLog();
+#endif
 
-    // IF THERE IS DATA IN THE RECEIVE DATA REGISTER
-    // USART_ISR_RXNE EXPANDS TO (1 << 5)
-    if(USART1->ISR & USART_ISR_RXNE)
+    while(1)
     {
-        // READ DATA FROM THE REGISTER
-        rxData = USART1->RDR;
-    }
-
-    return rxData;
-}
+        // SEND A FRAME OF LOG RECORDS IF THE TX BUFFER HAS ROOM FOR IT.
+        // WHILE ANY ARE WAITING THE TX INTERRUPT KEEPS WAKING THE LOOP
+        pumpLog(uartWrite, uartTxFree(), &txSeq);
 
-int main(void)
-{
-    //SET UP UART
-    initUART();
+        // FETCH WHATEVER ARRIVED SINCE THE LAST PASS
+        rxCount = uartRead(rxData, sizeof(rxData));
 
-    while(1)
-    {
-        // IF DATA WAS RECEIVED
-        if(receiveUart() > 0)
+        // NOTHING TO DO, SLEEP UNTIL THE NEXT UART INTERRUPT. queryPower
+        // IS ASKED WITH INTERRUPTS MASKED SO A BYTE ARRIVING AFTER THE
+        // CHECK STILL KEEPS US AWAKE
+        if(rxCount == 0)
         {
-            //transmitStrUart("Character Received\n\r");
+            enterLowPower(0);
+            continue;
+        }
 
-            // TRANSMIT AN ARBITRARY 'U' (ASCII 85) OVER UART
-            transmitUart(85);
+        for(i = 0; i < rxCount; i++)
+        {
+            result = decodeFrameByte(&decoder, rxData[i], &frame);
+
+            if(result != FRAME_OK)
+            {
+                if(result != FRAME_NONE)
+                {
+                    LOG2(LOG_FRAME_BAD, result, decoder.good);
+                }
+                continue;
+            }
+
+            LOG3(LOG_FRAME_OK, frame.seq, frame.type, frame.len);
+
+            // SEND THE PAYLOAD STRAIGHT BACK WITH OUR OWN SEQUENCE NUMBER
+            txLen = encodeFrame(txFrame, txSeq++, frame.type, frame.payload, frame.len);
+
+            if(uartTxFree() < txLen)
+            {
+                LOG2(LOG_TX_WAIT, txLen, uartTxFree());
+            }
+
+            // ONLY WHOLE FRAMES GO INTO THE TX BUFFER. WAIT FOR ROOM
+            txWanted = txLen;
+            while(uartTxFree() < txLen)
+            {
+                enterLowPower(0);
+            }
+            txWanted = 0;
+
+            uartWrite(txFrame, txLen);
         }
     }
 }
@@ -0,0 +1,3200 @@
+/*****************************************************************
+ sim
+
+    Peripheral models behind sim.h. The register space is mapped
+    twice from one memory file: at the real addresses, where the
+    drivers see it, and at an alias the models use. The pages
+    holding modelled registers are kept inaccessible, so every
+    driver access faults. The fault handler decodes the x86-64
+    instruction to find the access size and direction, moves
+    simulated time on by the bus cost, lets the model fill in the
+    value about to be read, then opens the page and single-steps
+    the instruction. The trap after the step applies the side
+    effects of a write, closes the page again and takes any
+    interrupts that are due.
+
+    Bus cost of one access, an estimate rather than a datasheet
+    figure:
+        AHB (RCC, GPIO, DMA1, CRC)  2 HCLK cycles
+        APB (TIM2, TIM6, TIM7,      1 + 2 x APB prescaler HCLK cycles
+             LPTIM1, SPI1, USART1)
+*****************************************************************/
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "sim.c traps register accesses on x86-64 Linux only"
+#endif
+
+#define SIM_NEVER               UINT64_MAX
+#define SIM_PAGE                4096u
+
+//TRAP FLAG IN EFLAGS, SINGLE-STEPS ONE INSTRUCTION
+#define SIM_EFLAGS_TF           0x100u
+
+//WHAT AN INSTRUCTION DOES TO MEMORY
+#define SIM_READ                1u
+#define SIM_WRITE               2u
+
+//BUSES, FOR THE COST OF AN ACCESS
+#define SIM_BUS_AHB             0u
+#define SIM_BUS_APB1            1u
+#define SIM_BUS_APB2            2u
+#define SIM_BUS_PPB             3u              //CORTEX-M4 PRIVATE PERIPHERAL BUS
+
+//CYCLES TO ENTER AND LEAVE AN INTERRUPT HANDLER ON THE CORTEX-M4
+#define SIM_IRQ_ENTRY_CYCLES    12u
+#define SIM_IRQ_EXIT_CYCLES     10u
+
+//HANDLERS RUN BACK TO BACK BEFORE AN INTERRUPT IS TAKEN TO BE STUCK
+#define SIM_IRQ_STORM           1000000u
+
+//RX BYTES THAT CAN BE QUEUED ON THE USART1 LINE. POWER OF 2
+#define SIM_UART_LINE_SIZE      262144u
+
+//TX BYTES KEPT UNTIL simUartTx TAKES THEM. POWER OF 2
+#define SIM_UART_TX_SIZE        65536u
+
+//OUTPUT PINS THAT CAN BE WATCHED
+#define SIM_MAX_WATCHES         8u
+
+//DMA1 CHANNELS. CHANNEL n's REGISTERS START AT SIM_DMA_CHANNEL(n)
+#define SIM_DMA_CHANNELS        7u
+#define SIM_DMA_CHANNEL(n)      (DMA1_BASE + 0x08u + (0x14u * ((n) - 1u)))
+
+//TRANSFERS DMA1 CAN MAKE IN A ROW BEFORE IT IS TAKEN TO BE STUCK
+#define SIM_DMA_STORM           1000000u
+
+//LSI FREQUENCY, LPTIM1'S ONLY MODELLED CLOCK
+#define SIM_LSI_HZ              32000u
+
+
+//ADDRESS RANGES MAPPED AT THE REAL ADDRESSES
+typedef struct
+{
+    uintptr_t base;
+    size_t size;
+    uint8_t *alias;             //SAME MEMORY, NEVER PROTECTED
+} SimSpace;
+
+//A MODELLED REGISTER BLOCK. 'read' PUTS THE VALUE ABOUT TO BE READ
+//IN PLACE, 'write' APPLIES A WRITE THAT HAS JUST BEEN MADE, 'old'
+//BEING THE WORD BEFORE IT
+typedef struct SimBlock
+{
+    uintptr_t base;
+    uint32_t size;
+    SimPeriph periph;
+    uint8_t bus;
+    void (*read)(const struct SimBlock *block, uint32_t offset, uint8_t size);
+    void (*write)(const struct SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+} SimBlock;
+
+//THE ACCESS BETWEEN THE FAULT AND THE SINGLE-STEP TRAP
+typedef struct
+{
+    uint8_t active;
+    const SimBlock *block;
+    uintptr_t addr;
+    uint8_t size;
+    uint8_t kind;
+    uint32_t old;
+} SimAccess;
+
+//ONE TIMER. COUNTS ARE WORKED OUT FROM THE TIME SO NOTHING HAS TO
+//HAPPEN ON EVERY TICK
+typedef struct
+{
+    uintptr_t base;
+    uint8_t apb;                //WHICH APB TIMER CLOCK DRIVES IT
+    uint8_t channels;           //COMPARE CHANNELS
+    uint32_t cntMask;           //0xFFFFFFFF FOR 32-BIT TIMERS
+    uint8_t running;
+    uint32_t psc;               //PRESCALER IN USE, PSC IS PRELOADED
+    uint32_t arr;               //AUTO-RELOAD IN USE
+    uint64_t baseTime;          //TIME OF TICK 0
+    uint32_t baseCnt;           //COUNT AT TICK 0, OR THE COUNT WHILE STOPPED
+    uint64_t lastK;             //TICKS ALREADY LOOKED AT FOR EVENTS
+} SimTimer;
+
+typedef struct
+{
+    uint64_t at;                //TIME THE STOP BIT ENDS
+    uint8_t data;
+} SimLineByte;
+
+typedef struct
+{
+    GPIO_TypeDef *port;
+    uint8_t pin;
+    SimPinWatch watch;
+    void *ctx;
+} SimWatch;
+
+
+static void updateClocks(void);
+static void rccRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void rccWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void gpioRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void gpioWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void spiRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void spiWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void usartRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void usartWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void timRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void timWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void dmaRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void dmaWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void extiRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void extiWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void dwtRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void dwtWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void lptimRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void lptimWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+static void crcRead(const SimBlock *block, uint32_t offset, uint8_t size);
+static void crcWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old);
+
+static SimSpace spaces[] =
+{
+    {0x40000000u, 0x00030000u, 0},      //APB1, APB2 AND AHB1
+    {0x48000000u, 0x00002000u, 0},      //GPIO PORTS ON AHB2
+    {0xE0000000u, 0x00100000u, 0},      //CORTEX-M4 PRIVATE PERIPHERALS
+};
+
+#define SIM_SPACES              (sizeof(spaces) / sizeof(spaces[0]))
+
+static const SimBlock blocks[] =
+{
+    {RCC_BASE,    0x400u, SIM_RCC,    SIM_BUS_AHB,  rccRead,   rccWrite},
+    {GPIOA_BASE,  0x400u, SIM_GPIOA,  SIM_BUS_AHB,  gpioRead,  gpioWrite},
+    {GPIOB_BASE,  0x400u, SIM_GPIOB,  SIM_BUS_AHB,  gpioRead,  gpioWrite},
+    {SPI1_BASE,   0x400u, SIM_SPI1,   SIM_BUS_APB2, spiRead,   spiWrite},
+    {USART1_BASE, 0x400u, SIM_USART1, SIM_BUS_APB2, usartRead, usartWrite},
+    {TIM2_BASE,   0x400u, SIM_TIM2,   SIM_BUS_APB1, timRead,   timWrite},
+    {TIM6_BASE,   0x400u, SIM_TIM6,   SIM_BUS_APB1, timRead,   timWrite},
+    {TIM7_BASE,   0x400u, SIM_TIM7,   SIM_BUS_APB1, timRead,   timWrite},
+    {DMA1_BASE,   0x400u, SIM_DMA1,   SIM_BUS_AHB,  dmaRead,   dmaWrite},
+    {EXTI_BASE,   0x400u, SIM_EXTI,   SIM_BUS_APB2, extiRead,  extiWrite},
+    {DWT_BASE,    0x400u, SIM_DWT,    SIM_BUS_PPB,  dwtRead,   dwtWrite},
+    {LPTIM1_BASE, 0x400u, SIM_LPTIM1, SIM_BUS_APB1, lptimRead, lptimWrite},
+    {CRC_BASE,    0x400u, SIM_CRC,    SIM_BUS_AHB,  crcRead,   crcWrite},
+};
+
+#define SIM_BLOCKS              (sizeof(blocks) / sizeof(blocks[0]))
+
+static const char *const periphNames[SIM_PERIPH_COUNT] =
+{
+    "RCC", "GPIOA", "GPIOB", "SPI1", "USART1", "TIM2", "TIM6", "TIM7", "DMA1", "EXTI", "DWT", "LPTIM1", "CRC"
+};
+
+//HANDLERS THE DRIVERS DEFINE. WEAK SO ANY THAT ARE NOT LINKED ARE 0
+#define SIM_HANDLERS(X)                                             \
+    X(WWDG) X(RTC_WKUP) X(EXTI0) X(EXTI1) X(EXTI2) X(EXTI3) X(EXTI4) \
+    X(DMA1_Channel1) X(DMA1_Channel2) X(DMA1_Channel3)              \
+    X(DMA1_Channel4) X(DMA1_Channel5) X(DMA1_Channel6)              \
+    X(DMA1_Channel7) X(EXTI9_5) X(TIM1_BRK_TIM15) X(TIM1_UP_TIM16)  \
+    X(TIM1_TRG_COM) X(TIM1_CC) X(TIM2) X(SPI1) X(USART1) X(USART2)  \
+    X(EXTI15_10) X(TIM6_DAC) X(TIM7) X(LPTIM1)
+
+#define SIM_DECLARE_(name)      void name##_IRQHandler(void) __attribute__((weak));
+#define SIM_VECTOR_(name)       [name##_IRQn] = name##_IRQHandler,
+
+SIM_HANDLERS(SIM_DECLARE_)
+
+static void (*const vectors[SIM_IRQ_COUNT])(void) = { SIM_HANDLERS(SIM_VECTOR_) };
+
+//MSI FREQUENCY FOR EACH MSIRANGE VALUE
+static const uint32_t msiRangeHz[16] =
+{
+    100000u, 200000u, 400000u, 800000u, 1000000u, 2000000u,
+    4000000u, 8000000u, 16000000u, 24000000u, 32000000u, 48000000u,
+    48000000u, 48000000u, 48000000u, 48000000u
+};
+
+//SYSCLK SOURCES BY RCC_CFGR SWS VALUE
+static const char *const sysclkNames[4] = {"MSI", "HSI16", "HSE", "the PLL"};
+
+static uint8_t mapped = 0;
+static SimAccess trap;
+static SimStats stats;
+static uint64_t now = 0;
+
+//CLOCK TREE, WORKED OUT FROM THE RCC REGISTERS
+static uint32_t sysclkHz;
+static uint32_t hclkHz;
+static uint32_t pclk1Hz;
+static uint32_t pclk2Hz;
+static uint32_t apb1Div;
+static uint32_t apb2Div;
+
+//CORE AND NVIC
+static uint32_t primask = 0;
+static uint32_t handlerDepth = 0;
+static uint8_t eventFlag = 0;
+static uint8_t inStop = 0;              //TIM2, TIM6 AND TIM7 HAVE NO CLOCK
+static uint8_t irqEnabled[SIM_IRQ_COUNT];
+static uint8_t irqPending[SIM_IRQ_COUNT];
+static uint8_t irqPriority[SIM_IRQ_COUNT];
+
+//GPIO. INPUT LEVELS SET BY simSetPin FOR PORTS A AND B
+static uint32_t pinInputs[2];
+static uint32_t pinInputsSet[2];
+static SimWatch watches[SIM_MAX_WATCHES];
+static uint32_t watchCount = 0;
+
+//SPI1
+static SimSpiSlave spiSlave = 0;
+static void *spiSlaveCtx = 0;
+static uint8_t spiTxFifo[4];
+static uint8_t spiTxLevel;
+static uint8_t spiRxFifo[4];
+static uint8_t spiRxLevel;
+static uint8_t spiShifting;
+static uint64_t spiShiftEnd;
+static uint16_t spiShiftData;
+static uint8_t spiShiftBits;
+static uint8_t spiOvr;
+static uint8_t spiOvrDrRead;
+
+//USART1
+static uint32_t usartIsr;
+static uint8_t usartRdr;
+static uint8_t usartTxShifting;
+static uint64_t usartTxEnd;
+static uint8_t usartTxShift;
+static uint8_t usartTdrFull;
+static uint8_t usartTdr;
+static uint8_t usartIdlePending;
+static uint64_t usartLastRx;
+static uint8_t usartAbrArmed;
+static uint32_t lineBaud = 115200u;
+static SimLineByte line[SIM_UART_LINE_SIZE];
+static uint32_t lineHead;
+static uint32_t lineTail;
+static uint64_t lineEnd;
+static uint8_t txLog[SIM_UART_TX_SIZE];
+static uint32_t txLogHead;
+static uint32_t txLogTail;
+
+//DMA1. ISR IS KEPT HERE, THE CHANNEL REGISTERS IN THE REGISTER SPACE
+static uint32_t dmaIsr;
+static uint32_t dmaReload[SIM_DMA_CHANNELS];   //CNDTR WHEN THE CHANNEL WAS ENABLED
+static uint32_t dmaDone[SIM_DMA_CHANNELS];     //ITEMS MOVED SINCE THEN
+
+//EXTI LINES WITH AN EDGE PENDING. PR1 IS KEPT HERE
+static uint32_t extiPending;
+
+//DWT CYCCNT. WORKED OUT FROM THE TIME LIKE THE TIMER COUNTS
+static uint8_t dwtRunning;
+static uint64_t dwtBaseTime;            //TIME CYCCNT WAS dwtBaseCnt
+static uint32_t dwtBaseCnt;
+
+//LPTIM1 ON LSI. THE COUNT IS WORKED OUT FROM THE TIME LIKE THE TIMERS'
+static uint8_t lptimRunning;
+static uint32_t lptimPresc;             //LSI DIVIDER, 1 TO 128
+static uint32_t lptimArr;
+static uint64_t lptimBaseTime;          //TIME OF TICK 0
+static uint32_t lptimBaseCnt;           //COUNT AT TICK 0, OR THE COUNT WHILE STOPPED
+static uint64_t lptimLastK;             //TICKS ALREADY LOOKED AT FOR ARRM
+
+//CRC UNIT. THE REGISTER BEFORE REV_OUT, DR READS GIVE IT REVERSED
+static uint32_t crcValue;
+
+//TIMERS. TIM6 AND TIM7 ARE BASIC 16-BIT TIMERS WITHOUT CHANNELS
+static SimTimer tim2 = {TIM2_BASE, 1u, 4u, 0xFFFFFFFFu, 0, 0, 0, 0, 0, 0};
+static SimTimer tim6 = {TIM6_BASE, 1u, 0u, 0xFFFFu, 0, 0, 0, 0, 0, 0};
+static SimTimer tim7 = {TIM7_BASE, 1u, 0u, 0xFFFFu, 0, 0, 0, 0, 0, 0};
+static SimTimer *const simTimers[] = {&tim2, &tim6, &tim7};
+
+#define SIM_TIMERS              (sizeof(simTimers) / sizeof(simTimers[0]))
+
+
+/**********************************************************************************/
+/****************************************Memory************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ aliasOf
+
+    Returns
+    the model's view of the register at 'addr'
+*****************************************************************/
+static volatile uint32_t *aliasOf(uintptr_t addr)
+{
+    uint32_t i;
+
+    for(i = 0; i < SIM_SPACES; i++)
+    {
+        if((addr >= spaces[i].base) && (addr < (spaces[i].base + spaces[i].size)))
+        {
+            return (volatile uint32_t *)(spaces[i].alias + (addr - spaces[i].base));
+        }
+    }
+
+    fprintf(stderr, "sim: 0x%08lx is outside the register space\n", (unsigned long)addr);
+    abort();
+}
+
+//REGISTER 'offset' OF A BLOCK, AS THE MODELS SEE IT
+#define REG(base, offset)       (*aliasOf((base) + (offset)))
+#define REG8(base, offset)      (*(volatile uint8_t *)aliasOf((base) + (offset)))
+#define REG16(base, offset)     (*(volatile uint16_t *)aliasOf((base) + (offset)))
+
+ /*****************************************************************
+ findBlock
+
+    Returns
+    the modelled block holding 'addr', 0 if there is none
+*****************************************************************/
+static const SimBlock *findBlock(uintptr_t addr)
+{
+    uint32_t i;
+
+    for(i = 0; i < SIM_BLOCKS; i++)
+    {
+        if((addr >= blocks[i].base) && (addr < (blocks[i].base + blocks[i].size)))
+        {
+            return &blocks[i];
+        }
+    }
+
+    return 0;
+}
+
+ /*****************************************************************
+ isTrapped
+
+    Returns
+    1 if 'addr' is on a page shared with a modelled block
+*****************************************************************/
+static uint8_t isTrapped(uintptr_t addr)
+{
+    uint32_t i;
+
+    for(i = 0; i < SIM_BLOCKS; i++)
+    {
+        if((addr & ~(uintptr_t)(SIM_PAGE - 1u)) == (blocks[i].base & ~(uintptr_t)(SIM_PAGE - 1u)))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+ /*****************************************************************
+ protectPage
+
+    Opens or closes the page holding 'addr' to the drivers
+*****************************************************************/
+static void protectPage(uintptr_t addr, int prot)
+{
+    if(mprotect((void *)(addr & ~(uintptr_t)(SIM_PAGE - 1u)), SIM_PAGE, prot) != 0)
+    {
+        perror("sim: mprotect");
+        abort();
+    }
+}
+
+ /*****************************************************************
+ mapSpaces
+
+    Maps every register range at its real address and at an alias,
+    both backed by one memory file
+*****************************************************************/
+static void mapSpaces(void)
+{
+    size_t total = 0;
+    size_t offset = 0;
+    uint32_t i;
+    void *at;
+    int fd;
+
+    for(i = 0; i < SIM_SPACES; i++)
+    {
+        total += spaces[i].size;
+    }
+
+    fd = memfd_create("stm32l432", 0);
+
+    if((fd < 0) || (ftruncate(fd, (off_t)total) != 0))
+    {
+        perror("sim: memfd");
+        exit(1);
+    }
+
+    for(i = 0; i < SIM_SPACES; i++)
+    {
+        at = mmap((void *)spaces[i].base, spaces[i].size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_FIXED_NOREPLACE, fd, (off_t)offset);
+
+        if(at != (void *)spaces[i].base)
+        {
+            fprintf(stderr, "sim: can't map 0x%08lx, build with -no-pie\n", (unsigned long)spaces[i].base);
+            exit(1);
+        }
+
+        at = mmap(0, spaces[i].size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)offset);
+
+        if(at == MAP_FAILED)
+        {
+            perror("sim: mmap");
+            exit(1);
+        }
+
+        spaces[i].alias = (uint8_t *)at;
+        offset += spaces[i].size;
+    }
+
+    close(fd);
+}
+
+
+/**********************************************************************************/
+/*****************************************Time*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ cyclesToPs
+
+    Returns
+    how long 'cycles' cycles of a 'hz' clock take
+*****************************************************************/
+static uint64_t cyclesToPs(uint64_t cycles, uint32_t hz)
+{
+    return (uint64_t)(((unsigned __int128)cycles * SIM_PS_PER_S) / hz);
+}
+
+static uint64_t timerNext(const SimTimer *tim);
+static void timerUpdate(SimTimer *tim);
+static void timerRebase(SimTimer *tim);
+static uint64_t spiNext(void);
+static void spiEvent(void);
+static uint64_t usartNext(void);
+static void usartEvent(void);
+static void serviceDma(void);
+static void dwtRebase(void);
+static uint64_t lptimNext(void);
+static void lptimUpdate(void);
+
+ /*****************************************************************
+ nextEvent
+
+    Returns
+    the time of the next thing any model has to do
+*****************************************************************/
+static uint64_t nextEvent(void)
+{
+    uint64_t at = SIM_NEVER;
+    uint64_t t;
+    uint32_t i;
+
+    for(i = 0; i < SIM_TIMERS; i++)
+    {
+        t = timerNext(simTimers[i]);
+        at = (t < at) ? t : at;
+    }
+    t = spiNext();
+    at = (t < at) ? t : at;
+    t = usartNext();
+    at = (t < at) ? t : at;
+    t = lptimNext();
+    at = (t < at) ? t : at;
+
+    return at;
+}
+
+ /*****************************************************************
+ runEvents
+
+    Lets every model catch up to 'now'
+*****************************************************************/
+static void runEvents(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < SIM_TIMERS; i++)
+    {
+        timerUpdate(simTimers[i]);
+    }
+    spiEvent();
+    usartEvent();
+    lptimUpdate();
+    serviceDma();
+}
+
+ /*****************************************************************
+ advanceTo
+
+    Moves simulated time on to 'target', running model events in
+    time order on the way. Interrupts are not taken
+*****************************************************************/
+static void advanceTo(uint64_t target)
+{
+    uint64_t at;
+
+    while((at = nextEvent()) <= target)
+    {
+        if(at > now)
+        {
+            now = at;
+        }
+
+        runEvents();
+    }
+
+    if(target > now)
+    {
+        now = target;
+    }
+
+    runEvents();
+}
+
+
+/**********************************************************************************/
+/*************************************Interrupts***********************************/
+/**********************************************************************************/
+
+static uint8_t timerLine(const SimTimer *tim);
+static uint8_t spiLine(void);
+static uint8_t usartLine(void);
+static uint8_t dmaLine(uint32_t channel);
+static uint8_t extiLine(uint32_t lines);
+static uint8_t lptimLine(void);
+
+ /*****************************************************************
+ irqLine
+
+    Returns
+    1 while a peripheral holds interrupt 'irq' up
+*****************************************************************/
+static uint8_t irqLine(uint32_t irq)
+{
+    switch(irq)
+    {
+        case TIM2_IRQn:     return timerLine(&tim2);
+        case TIM6_DAC_IRQn: return timerLine(&tim6);
+        case TIM7_IRQn:     return timerLine(&tim7);
+        case SPI1_IRQn:     return spiLine();
+        case USART1_IRQn:   return usartLine();
+        case LPTIM1_IRQn:   return lptimLine();
+        case EXTI0_IRQn: case EXTI1_IRQn: case EXTI2_IRQn: case EXTI3_IRQn:
+        case EXTI4_IRQn:
+                            return extiLine(1u << (irq - EXTI0_IRQn));
+        case EXTI9_5_IRQn:  return extiLine(0x03E0u);
+        case EXTI15_10_IRQn: return extiLine(0xFC00u);
+        case DMA1_Channel1_IRQn: case DMA1_Channel2_IRQn: case DMA1_Channel3_IRQn:
+        case DMA1_Channel4_IRQn: case DMA1_Channel5_IRQn: case DMA1_Channel6_IRQn:
+        case DMA1_Channel7_IRQn:
+                            return dmaLine(irq - DMA1_Channel1_IRQn + 1u);
+        default:            return 0;
+    }
+}
+
+ /*****************************************************************
+ pendingIrq
+
+    Returns
+    the enabled interrupt to take next, SIM_IRQ_COUNT if none is
+    pending. Lowest priority value first, then lowest number
+*****************************************************************/
+static uint32_t pendingIrq(void)
+{
+    uint32_t best = SIM_IRQ_COUNT;
+    uint32_t irq;
+
+    for(irq = 0; irq < SIM_IRQ_COUNT; irq++)
+    {
+        if(irqEnabled[irq] && (irqPending[irq] || irqLine(irq)))
+        {
+            if((best == SIM_IRQ_COUNT) || (irqPriority[irq] < irqPriority[best]))
+            {
+                best = irq;
+            }
+        }
+    }
+
+    return best;
+}
+
+ /*****************************************************************
+ takeInterrupts
+
+    Runs the handler of every pending enabled interrupt, unless
+    PRIMASK is set or a handler is already running
+*****************************************************************/
+static void takeInterrupts(void)
+{
+    uint32_t storm = 0;
+    uint32_t irq;
+
+    if(primask || (handlerDepth > 0u))
+    {
+        return;
+    }
+
+    while((irq = pendingIrq()) < SIM_IRQ_COUNT)
+    {
+        if(vectors[irq] == 0)
+        {
+            fprintf(stderr, "sim: interrupt %u is enabled and pending but has no handler\n", irq);
+            abort();
+        }
+
+        if(++storm > SIM_IRQ_STORM)
+        {
+            fprintf(stderr, "sim: interrupt %u is never cleared\n", irq);
+            abort();
+        }
+
+        irqPending[irq] = 0;
+        advanceTo(now + cyclesToPs(SIM_IRQ_ENTRY_CYCLES, hclkHz));
+
+        handlerDepth++;
+        stats.interrupts++;
+        vectors[irq]();
+        handlerDepth--;
+
+        advanceTo(now + cyclesToPs(SIM_IRQ_EXIT_CYCLES, hclkHz));
+    }
+}
+
+void __disable_irq(void)
+{
+    primask = 1;
+}
+
+void __enable_irq(void)
+{
+    primask = 0;
+    takeInterrupts();
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+    primask = priMask & 1u;
+    takeInterrupts();
+}
+
+ /*****************************************************************
+ __WFI
+
+    Sleeps until an enabled interrupt is pending, even with
+    PRIMASK set, then takes it if PRIMASK allows. Stops the tool
+    if nothing is left that could ever wake the core.
+    With SLEEPDEEP set the core wakes from Stop as the STM32 does,
+    with the PLL off and SYSCLK on MSI, or on HSI16 if STOPWUCK is
+    set. TIM2, TIM6, TIM7 and CYCCNT count through Sleep but not
+    Stop, where their clocks are off. LPTIM1 on LSI keeps counting
+*****************************************************************/
+void __WFI(void)
+{
+    uint8_t deep = (SCB->SCR & SCB_SCR_SLEEPDEEP_Msk) != 0u;
+    uint64_t start = now;
+    uint32_t wakeHsi;
+    uint64_t at;
+    uint32_t i;
+
+    if(deep)
+    {
+        dwtRebase();
+
+        for(i = 0; i < SIM_TIMERS; i++)
+        {
+            timerRebase(simTimers[i]);
+        }
+        inStop = 1;
+    }
+
+    while(pendingIrq() >= SIM_IRQ_COUNT)
+    {
+        at = nextEvent();
+
+        if(at == SIM_NEVER)
+        {
+            fprintf(stderr, "sim: __WFI at %.3f ms with nothing left to wake the core\n", (double)now / 1e9);
+            exit(1);
+        }
+
+        advanceTo(at);
+    }
+
+    if(deep)
+    {
+        //THE TIMERS CARRY ON FROM WHERE THEY STOPPED
+        inStop = 0;
+
+        for(i = 0; i < SIM_TIMERS; i++)
+        {
+            simTimers[i]->baseTime += now - start;
+        }
+
+        stats.stopPs += now - start;
+        dwtBaseTime = now;
+
+        wakeHsi = (REG(RCC_BASE, 0x08u) >> 15) & 1u;
+        REG(RCC_BASE, 0x00u) = (REG(RCC_BASE, 0x00u) & ~((1u << 24) | (1u << 25)))
+                             | (wakeHsi ? ((1u << 8) | (1u << 10)) : ((1u << 0) | (1u << 1)));
+        REG(RCC_BASE, 0x08u) = (REG(RCC_BASE, 0x08u) & ~15u) | wakeHsi | (wakeHsi << 2);
+        updateClocks();
+    }
+    else
+    {
+        stats.sleepPs += now - start;
+    }
+
+    takeInterrupts();
+}
+
+void __WFE(void)
+{
+    if(eventFlag)
+    {
+        eventFlag = 0;
+        return;
+    }
+
+    __WFI();
+}
+
+void __SEV(void)
+{
+    eventFlag = 1;
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    irqEnabled[IRQn] = 1;
+    takeInterrupts();
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    irqEnabled[IRQn] = 0;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    irqPending[IRQn] = 1;
+    takeInterrupts();
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    irqPending[IRQn] = 0;
+}
+
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)
+{
+    return irqPending[IRQn] || irqLine((uint32_t)IRQn);
+}
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    irqPriority[IRQn] = (uint8_t)priority;
+}
+
+
+/**********************************************************************************/
+/*************************************Trapping*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ decodeAccess
+
+    Works out what the x86-64 instruction at 'ip' does to memory.
+    Only the forms compilers use for volatile accesses need to be
+    right, anything else falls back on the fault's write bit
+
+    Returns
+    SIM_READ, SIM_WRITE OR BOTH, with the size in bytes in 'size'
+*****************************************************************/
+static uint8_t decodeAccess(const uint8_t *ip, uint8_t *size, uint8_t faultWrite)
+{
+    uint8_t opSize = 4;
+    uint8_t reg;
+    uint8_t op;
+
+    //LEGACY PREFIXES
+    while(1)
+    {
+        if(*ip == 0x66u)
+        {
+            opSize = 2;
+        }
+        else if((*ip != 0xF0u) && (*ip != 0xF2u) && (*ip != 0xF3u) && (*ip != 0x67u)
+              &&(*ip != 0x2Eu) && (*ip != 0x3Eu) && (*ip != 0x26u) && (*ip != 0x36u)
+              &&(*ip != 0x64u) && (*ip != 0x65u))
+        {
+            break;
+        }
+
+        ip++;
+    }
+
+    //REX
+    if((*ip & 0xF0u) == 0x40u)
+    {
+        if(*ip & 0x08u)
+        {
+            opSize = 8;
+        }
+
+        ip++;
+    }
+
+    op = ip[0];
+    reg = (ip[1] >> 3) & 7u;
+
+    if(op == 0x0Fu)
+    {
+        switch(ip[1])
+        {
+            case 0xB6u: case 0xBEu: *size = 1; return SIM_READ;     //MOVZX, MOVSX BYTE
+            case 0xB7u: case 0xBFu: *size = 2; return SIM_READ;     //MOVZX, MOVSX WORD
+            default:    *size = opSize; return faultWrite ? SIM_WRITE : SIM_READ;
+        }
+    }
+
+    switch(op)
+    {
+        //MOV TO MEMORY
+        case 0x88u: case 0xC6u:
+            *size = 1;
+            return SIM_WRITE;
+
+        case 0x89u: case 0xC7u:
+            *size = opSize;
+            return SIM_WRITE;
+
+        //LOADS, COMPARES AND TESTS
+        case 0x8Au: case 0x84u: case 0x38u: case 0x3Au:
+        case 0x02u: case 0x0Au: case 0x12u: case 0x1Au: case 0x22u: case 0x2Au: case 0x32u:
+            *size = 1;
+            return SIM_READ;
+
+        case 0x8Bu: case 0x85u: case 0x39u: case 0x3Bu:
+        case 0x03u: case 0x0Bu: case 0x13u: case 0x1Bu: case 0x23u: case 0x2Bu: case 0x33u:
+            *size = opSize;
+            return SIM_READ;
+
+        //ARITHMETIC WITH MEMORY AS THE DESTINATION
+        case 0x00u: case 0x08u: case 0x10u: case 0x18u: case 0x20u: case 0x28u: case 0x30u:
+        case 0x86u: case 0xFEu:
+            *size = 1;
+            return SIM_READ | SIM_WRITE;
+
+        case 0x01u: case 0x09u: case 0x11u: case 0x19u: case 0x21u: case 0x29u: case 0x31u:
+        case 0x87u:
+            *size = opSize;
+            return SIM_READ | SIM_WRITE;
+
+        //IMMEDIATE GROUP, /7 IS CMP
+        case 0x80u:
+            *size = 1;
+            return (reg == 7u) ? SIM_READ : (SIM_READ | SIM_WRITE);
+
+        case 0x81u: case 0x83u:
+            *size = opSize;
+            return (reg == 7u) ? SIM_READ : (SIM_READ | SIM_WRITE);
+
+        //UNARY GROUP, /2 NOT AND /3 NEG WRITE BACK
+        case 0xF6u:
+            *size = 1;
+            return ((reg == 2u) || (reg == 3u)) ? (SIM_READ | SIM_WRITE) : SIM_READ;
+
+        case 0xF7u:
+            *size = opSize;
+            return ((reg == 2u) || (reg == 3u)) ? (SIM_READ | SIM_WRITE) : SIM_READ;
+
+        //INC AND DEC
+        case 0xFFu:
+            *size = opSize;
+            return (reg <= 1u) ? (SIM_READ | SIM_WRITE) : SIM_READ;
+
+        default:
+            *size = opSize;
+            return faultWrite ? SIM_WRITE : SIM_READ;
+    }
+}
+
+ /*****************************************************************
+ busCycles
+
+    Returns
+    the HCLK cycles one access to a block keeps the bus
+*****************************************************************/
+static uint32_t busCycles(const SimBlock *block)
+{
+    switch(block->bus)
+    {
+        case SIM_BUS_APB1:  return 1u + (2u * apb1Div);
+        case SIM_BUS_APB2:  return 1u + (2u * apb2Div);
+        case SIM_BUS_PPB:   return 1u;
+        default:            return 2u;
+    }
+}
+
+ /*****************************************************************
+ countAccess
+
+    Counts one read or write and lets its bus cycles pass
+*****************************************************************/
+static void countAccess(const SimBlock *block, uint8_t write)
+{
+    uint32_t cycles = busCycles(block);
+    SimAccesses *periph = &stats.periph[block->periph];
+
+    if(write)
+    {
+        periph->writes++;
+        stats.total.writes++;
+    }
+    else
+    {
+        periph->reads++;
+        stats.total.reads++;
+    }
+
+    periph->busCycles += cycles;
+    stats.total.busCycles += cycles;
+
+    advanceTo(now + cyclesToPs(cycles, hclkHz));
+}
+
+ /*****************************************************************
+ onFault
+
+    SIGSEGV. A driver touched a trapped page
+*****************************************************************/
+static void onFault(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    uint8_t faultWrite = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+    const SimBlock *block;
+
+    (void)sig;
+
+    //A REAL CRASH. PUT BACK THE DEFAULT ACTION AND LET IT HAPPEN AGAIN
+    if(!isTrapped(addr) || trap.active)
+    {
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    block = findBlock(addr);
+
+    trap.active = 1;
+    trap.block = block;
+    trap.addr = addr;
+    trap.kind = decodeAccess((const uint8_t *)uc->uc_mcontext.gregs[REG_RIP], &trap.size, faultWrite);
+
+    if(block)
+    {
+        if(trap.kind & SIM_READ)
+        {
+            countAccess(block, 0);
+            block->read(block, (uint32_t)(addr - block->base), trap.size);
+        }
+
+        if(trap.kind & SIM_WRITE)
+        {
+            countAccess(block, 1);
+        }
+    }
+
+    trap.old = *aliasOf(addr & ~(uintptr_t)3u);
+
+    protectPage(addr, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= SIM_EFLAGS_TF;
+}
+
+ /*****************************************************************
+ onStep
+
+    SIGTRAP. The trapped instruction has run
+*****************************************************************/
+static void onStep(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    const SimBlock *block = trap.block;
+
+    (void)sig;
+    (void)info;
+
+    if(!trap.active)
+    {
+        signal(SIGTRAP, SIG_DFL);
+        raise(SIGTRAP);
+        return;
+    }
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~(greg_t)SIM_EFLAGS_TF;
+    protectPage(trap.addr, PROT_NONE);
+    trap.active = 0;
+
+    if(block && (trap.kind & SIM_WRITE))
+    {
+        block->write(block, (uint32_t)(trap.addr - block->base), trap.size, trap.old);
+    }
+
+    serviceDma();
+
+    takeInterrupts();
+}
+
+
+/**********************************************************************************/
+/******************************************RCC*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ ahbDivider / apbDivider
+
+    Return
+    the divider for the CFGR HPRE and PPRE fields
+*****************************************************************/
+static uint32_t ahbDivider(uint32_t hpre)
+{
+    static const uint32_t div[8] = {2u, 4u, 8u, 16u, 64u, 128u, 256u, 512u};
+
+    return (hpre & 8u) ? div[hpre & 7u] : 1u;
+}
+
+static uint32_t apbDivider(uint32_t ppre)
+{
+    return (ppre & 4u) ? (2u << (ppre & 3u)) : 1u;
+}
+
+ /*****************************************************************
+ msiHz
+
+    Returns
+    the MSI frequency, from RCC_CR or from RCC_CSR after reset
+*****************************************************************/
+static uint32_t msiHz(void)
+{
+    uint32_t cr = REG(RCC_BASE, 0x00u);
+
+    if(cr & (1u << 3))
+    {
+        return msiRangeHz[(cr >> 4) & 15u];
+    }
+
+    return msiRangeHz[(REG(RCC_BASE, 0x94u) >> 8) & 15u];
+}
+
+ /*****************************************************************
+ updateClocks
+
+    Works the clock tree out again after an RCC write. The timers
+    are caught up on the old clocks first
+*****************************************************************/
+static void updateClocks(void)
+{
+    uint32_t cr = REG(RCC_BASE, 0x00u);
+    uint32_t cfgr = REG(RCC_BASE, 0x08u);
+    uint32_t pllcfgr = REG(RCC_BASE, 0x0Cu);
+    uint32_t inputHz;
+    uint64_t vcoHz;
+    uint32_t hz;
+    uint32_t i;
+
+    //A RUNNING PLL MUST KEEP ITS INPUT AND VCO IN RANGE, WHATEVER
+    //SYSCLK IS ON, SO CHANGING MSIRANGE UNDER IT IS CAUGHT
+    if(cr & (1u << 24))
+    {
+        inputHz = ((pllcfgr & 3u) == 1u) ? msiHz() : (((pllcfgr & 3u) == 2u) ? 16000000u : 0u);
+        inputHz /= ((pllcfgr >> 4) & 7u) + 1u;
+        vcoHz = (uint64_t)inputHz * ((pllcfgr >> 8) & 0x7Fu);
+
+        if((inputHz < 4000000u) || (inputHz > 16000000u) || (vcoHz < 64000000u) || (vcoHz > 344000000u))
+        {
+            fprintf(stderr, "sim: PLL running from %u Hz with a %llu Hz VCO\n", inputHz, (unsigned long long)vcoHz);
+            abort();
+        }
+    }
+
+    //SYSCLK CAN ONLY RUN FROM AN OSCILLATOR THAT IS ON
+    if(!(cr & (1u << (((cfgr >> 2) & 3u) * 8u))))
+    {
+        fprintf(stderr, "sim: SYSCLK on %s, which is off\n", sysclkNames[(cfgr >> 2) & 3u]);
+        abort();
+    }
+
+    switch((cfgr >> 2) & 3u)
+    {
+        case 0u:
+            hz = msiHz();
+            break;
+
+        case 1u:
+            hz = 16000000u;
+            break;
+
+        case 3u:
+            inputHz = ((pllcfgr & 3u) == 1u) ? msiHz() : 16000000u;
+            hz = (uint32_t)(((uint64_t)inputHz / (((pllcfgr >> 4) & 7u) + 1u)) * ((pllcfgr >> 8) & 0x7Fu)
+                          / (2u * (((pllcfgr >> 25) & 3u) + 1u)));
+            break;
+
+        default:
+            fprintf(stderr, "sim: HSE is not modelled\n");
+            abort();
+    }
+
+    if(hz == 0u)
+    {
+        fprintf(stderr, "sim: SYSCLK switched to a PLL giving 0 Hz\n");
+        abort();
+    }
+
+    if(hz > 80000000u)
+    {
+        fprintf(stderr, "sim: SYSCLK at %u Hz, above 80 MHz\n", hz);
+        abort();
+    }
+
+    for(i = 0; i < SIM_TIMERS; i++)
+    {
+        timerRebase(simTimers[i]);
+    }
+    dwtRebase();
+
+    sysclkHz = hz;
+    hclkHz = hz / ahbDivider((cfgr >> 4) & 15u);
+    apb1Div = apbDivider((cfgr >> 8) & 7u);
+    apb2Div = apbDivider((cfgr >> 11) & 7u);
+    pclk1Hz = hclkHz / apb1Div;
+    pclk2Hz = hclkHz / apb2Div;
+}
+
+static void rccRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    (void)block;
+    (void)offset;
+    (void)size;
+}
+
+ /*****************************************************************
+ rccWrite
+
+    Oscillators and the PLL are ready as soon as they are turned
+    on and SYSCLK switches straight away. Reprogramming the PLL
+    while it is on stops the run
+*****************************************************************/
+static void rccWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uint32_t cr;
+
+    (void)block;
+    (void)size;
+    (void)old;
+
+    switch(offset & ~3u)
+    {
+        case 0x00u:
+            cr = REG(RCC_BASE, 0x00u) & ~((1u << 1) | (1u << 10) | (1u << 25));
+            cr |= ((cr & (1u << 0)) << 1)                   //MSIRDY FOLLOWS MSION
+                | ((cr & (1u << 8)) << 2)                   //HSIRDY FOLLOWS HSION
+                | ((cr & (1u << 24)) << 1);                 //PLLRDY FOLLOWS PLLON
+            REG(RCC_BASE, 0x00u) = cr;
+            break;
+
+        case 0x08u:
+            //SWS FOLLOWS SW
+            REG(RCC_BASE, 0x08u) = (REG(RCC_BASE, 0x08u) & ~(3u << 2)) | ((REG(RCC_BASE, 0x08u) & 3u) << 2);
+            break;
+
+        case 0x0Cu:
+            if(REG(RCC_BASE, 0x00u) & (1u << 24))
+            {
+                fprintf(stderr, "sim: PLLCFGR written with the PLL on\n");
+                abort();
+            }
+            break;
+
+        case 0x94u:
+            //LSIRDY FOLLOWS LSION
+            REG(RCC_BASE, 0x94u) = (REG(RCC_BASE, 0x94u) & ~(1u << 1)) | ((REG(RCC_BASE, 0x94u) & 1u) << 1);
+            return;
+
+        default:
+            return;
+    }
+
+    updateClocks();
+}
+
+
+/**********************************************************************************/
+/*****************************************GPIO*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ portIndex
+
+    Returns
+    0 for GPIOA, 1 for GPIOB
+*****************************************************************/
+static uint32_t portIndex(uintptr_t base)
+{
+    return (base == GPIOB_BASE) ? 1u : 0u;
+}
+
+ /*****************************************************************
+ setOdr
+
+    Changes a port's output register and tells the watchers of
+    any pin that changed
+*****************************************************************/
+static void setOdr(uintptr_t base, uint32_t odr, uint32_t old)
+{
+    uint32_t changed;
+    uint32_t i;
+
+    odr &= 0xFFFFu;
+    REG(base, 0x14u) = odr;
+    changed = (odr ^ old) & 0xFFFFu;
+
+    for(i = 0; i < watchCount; i++)
+    {
+        if(((uintptr_t)watches[i].port == base) && (changed & (1u << watches[i].pin)))
+        {
+            watches[i].watch(watches[i].ctx, (uint8_t)((odr >> watches[i].pin) & 1u));
+        }
+    }
+}
+
+ /*****************************************************************
+ pinLevel
+
+    Returns
+    the output level of an output pin, or the level given by
+    simSetPin, or the pull, of any other
+*****************************************************************/
+static uint32_t pinLevel(uintptr_t base, uint32_t pin)
+{
+    uint32_t port = portIndex(base);
+
+    if(((REG(base, 0x00u) >> (2u * pin)) & 3u) == 1u)
+    {
+        return (REG(base, 0x14u) >> pin) & 1u;
+    }
+
+    if(pinInputsSet[port] & (1u << pin))
+    {
+        return (pinInputs[port] >> pin) & 1u;
+    }
+
+    return (((REG(base, 0x0Cu) >> (2u * pin)) & 3u) == 1u);
+}
+
+static void gpioRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    uint32_t idr = 0;
+    uint32_t pin;
+
+    (void)size;
+
+    if((offset & ~3u) != 0x10u)
+    {
+        return;
+    }
+
+    for(pin = 0; pin < 16u; pin++)
+    {
+        idr |= pinLevel(block->base, pin) << pin;
+    }
+
+    REG(block->base, 0x10u) = idr;
+}
+
+static void gpioWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uintptr_t base = block->base;
+    uint32_t odr = REG(base, 0x14u);
+    uint32_t value = REG(base, offset & ~3u);
+
+    (void)size;
+
+    switch(offset & ~3u)
+    {
+        case 0x14u:                                         //ODR
+            setOdr(base, value, old);
+            break;
+
+        case 0x18u:                                         //BSRR, RESET WINS
+            REG(base, 0x18u) = 0;
+            setOdr(base, (odr | (value & 0xFFFFu)) & ~(value >> 16), odr);
+            break;
+
+        case 0x28u:                                         //BRR
+            REG(base, 0x28u) = 0;
+            setOdr(base, odr & ~value, odr);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************************************/
+/*****************************************SPI1*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ spiFrameBits
+
+    Returns
+    the frame size set by CR2 DS. Sizes below 4 bits read as 8
+*****************************************************************/
+static uint8_t spiFrameBits(void)
+{
+    uint8_t bits = (uint8_t)(((REG(SPI1_BASE, 0x04u) >> 8) & 15u) + 1u);
+
+    return (bits < 4u) ? 8u : bits;
+}
+
+ /*****************************************************************
+ fifoLevel
+
+    Returns
+    a FIFO level as the FRLVL and FTLVL fields show it
+*****************************************************************/
+static uint32_t fifoLevel(uint8_t bytes)
+{
+    return (bytes >= 3u) ? 3u : bytes;
+}
+
+ /*****************************************************************
+ spiStart
+
+    Starts shifting the next frame if the master is enabled, idle
+    and has a whole frame in the TX FIFO
+*****************************************************************/
+static void spiStart(void)
+{
+    uint32_t cr1 = REG(SPI1_BASE, 0x00u);
+    uint8_t bits = spiFrameBits();
+    uint8_t bytes = (bits > 8u) ? 2u : 1u;
+    uint32_t div = 2u << ((cr1 >> 3) & 7u);
+
+    if(spiShifting || !(cr1 & (1u << 6)) || !(cr1 & (1u << 2)) || (spiTxLevel < bytes))
+    {
+        return;
+    }
+
+    spiShiftData = spiTxFifo[0];
+    if(bytes == 2u)
+    {
+        spiShiftData |= (uint16_t)(spiTxFifo[1] << 8);
+    }
+
+    spiShiftData &= (uint16_t)((1u << bits) - 1u);
+    memmove(spiTxFifo, &spiTxFifo[bytes], (size_t)(4u - bytes));
+    spiTxLevel -= bytes;
+
+    spiShifting = 1;
+    spiShiftBits = bits;
+    spiShiftEnd = now + cyclesToPs((uint64_t)bits * div, pclk2Hz);
+}
+
+static uint64_t spiNext(void)
+{
+    return spiShifting ? spiShiftEnd : SIM_NEVER;
+}
+
+ /*****************************************************************
+ spiEvent
+
+    Ends the frame being shifted. The slave's reply goes into the
+    RX FIFO, or is lost with OVR set if there is no room
+*****************************************************************/
+static void spiEvent(void)
+{
+    uint8_t bytes;
+    uint16_t miso;
+
+    if(!spiShifting || (spiShiftEnd > now))
+    {
+        return;
+    }
+
+    miso = spiSlave ? spiSlave(spiSlaveCtx, spiShiftData, spiShiftBits) : 0xFFFFu;
+    miso &= (uint16_t)((1u << spiShiftBits) - 1u);
+    bytes = (spiShiftBits > 8u) ? 2u : 1u;
+
+    if((spiRxLevel + bytes) > 4u)
+    {
+        spiOvr = 1;
+    }
+    else
+    {
+        spiRxFifo[spiRxLevel++] = (uint8_t)miso;
+        if(bytes == 2u)
+        {
+            spiRxFifo[spiRxLevel++] = (uint8_t)(miso >> 8);
+        }
+    }
+
+    spiShifting = 0;
+    stats.spiFrames++;
+    spiStart();
+}
+
+ /*****************************************************************
+ spiStatus
+
+    Returns
+    SR as it reads now
+*****************************************************************/
+static uint32_t spiStatus(void)
+{
+    uint32_t cr1 = REG(SPI1_BASE, 0x00u);
+    uint32_t cr2 = REG(SPI1_BASE, 0x04u);
+    uint32_t sr = 0;
+
+    if(spiRxLevel >= ((cr2 & (1u << 12)) ? 1u : 2u))
+    {
+        sr |= (1u << 0);                                    //RXNE
+    }
+
+    if(spiTxLevel <= 2u)
+    {
+        sr |= (1u << 1);                                    //TXE
+    }
+
+    if(spiOvr)
+    {
+        sr |= (1u << 6);                                    //OVR
+    }
+
+    if(spiShifting || ((spiTxLevel > 0u) && (cr1 & (1u << 6)) && (cr1 & (1u << 2))))
+    {
+        sr |= (1u << 7);                                    //BSY
+    }
+
+    sr |= fifoLevel(spiRxLevel) << 9;                       //FRLVL
+    sr |= fifoLevel(spiTxLevel) << 11;                      //FTLVL
+
+    return sr;
+}
+
+static uint8_t spiLine(void)
+{
+    uint32_t cr2 = REG(SPI1_BASE, 0x04u);
+    uint32_t sr = spiStatus();
+
+    return ((cr2 & (1u << 6)) && (sr & (1u << 0)))          //RXNEIE
+        || ((cr2 & (1u << 7)) && (sr & (1u << 1)))          //TXEIE
+        || ((cr2 & (1u << 5)) && (sr & (1u << 6)));         //ERRIE
+}
+
+ /*****************************************************************
+ spiRead
+
+    A byte read of DR takes one byte from the RX FIFO, a wider one
+    takes two. Reading SR after DR clears OVR
+*****************************************************************/
+static void spiRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    uint16_t data = 0;
+    uint8_t take = (size == 1u) ? 1u : 2u;
+    uint8_t i;
+
+    (void)block;
+    switch(offset & ~3u)
+    {
+        case 0x08u:
+            REG(SPI1_BASE, 0x08u) = spiStatus();
+            if(spiOvrDrRead)
+            {
+                spiOvr = 0;
+                spiOvrDrRead = 0;
+            }
+            break;
+
+        case 0x0Cu:
+            take = (take > spiRxLevel) ? spiRxLevel : take;
+            for(i = 0; i < take; i++)
+            {
+                data |= (uint16_t)(spiRxFifo[i] << (8u * i));
+            }
+
+            memmove(spiRxFifo, &spiRxFifo[take], (size_t)(4u - take));
+            spiRxLevel -= take;
+            spiOvrDrRead = spiOvr;
+            REG(SPI1_BASE, 0x0Cu) = data;
+            break;
+
+        default:
+            break;
+    }
+}
+
+ /*****************************************************************
+ spiWrite
+
+    A byte write of DR puts one byte in the TX FIFO, a wider one
+    puts two, which is two frames when frames are 8 bits or less
+*****************************************************************/
+static void spiWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uint16_t data = REG16(SPI1_BASE, 0x0Cu);
+    uint8_t put = (size == 1u) ? 1u : 2u;
+    uint8_t i;
+
+    (void)block;
+    (void)old;
+
+    if((offset & ~3u) == 0x0Cu)
+    {
+        for(i = 0; (i < put) && (spiTxLevel < 4u); i++)
+        {
+            spiTxFifo[spiTxLevel++] = (uint8_t)(data >> (8u * i));
+        }
+    }
+
+    spiStart();
+}
+
+
+/**********************************************************************************/
+/****************************************USART1************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ usartClockHz
+
+    Returns
+    the kernel clock picked by CCIPR USART1SEL
+*****************************************************************/
+static uint32_t usartClockHz(void)
+{
+    switch(REG(RCC_BASE, 0x88u) & 3u)
+    {
+        case 1u:    return sysclkHz;
+        case 2u:    return 16000000u;
+        case 3u:    return 32768u;
+        default:    return pclk2Hz;
+    }
+}
+
+ /*****************************************************************
+ usartFramePs
+
+    Returns
+    how long one 10-bit frame takes at the rate BRR and OVER8 set
+*****************************************************************/
+static uint64_t usartFramePs(void)
+{
+    uint32_t brr = REG16(USART1_BASE, 0x0Cu);
+    uint64_t halfBits;
+
+    //OVER8 KEEPS BRR[2:0] AS USARTDIV[3:1] AND HALVES THE BIT TIME
+    if(REG(USART1_BASE, 0x00u) & USART_CR1_OVER8)
+    {
+        halfBits = 10u * ((brr & 0xFFF0u) | ((brr & 7u) << 1));
+    }
+    else
+    {
+        halfBits = 20u * brr;
+    }
+
+    if(halfBits == 0u)
+    {
+        halfBits = 320u;
+    }
+
+    return cyclesToPs(halfBits, usartClockHz()) / 2u;
+}
+
+ /*****************************************************************
+ lineFramePs
+
+    Returns
+    how long the far end takes to send one 10-bit frame
+*****************************************************************/
+static uint64_t lineFramePs(void)
+{
+    return (10u * SIM_PS_PER_S) / lineBaud;
+}
+
+ /*****************************************************************
+ usartStartTx
+
+    Moves a byte into the transmit shift register
+*****************************************************************/
+static void usartStartTx(uint8_t data)
+{
+    usartTxShifting = 1;
+    usartTxShift = data;
+    usartTxEnd = now + usartFramePs();
+    usartIsr &= ~USART_ISR_TC;
+}
+
+static uint64_t usartNext(void)
+{
+    uint64_t at = usartTxShifting ? usartTxEnd : SIM_NEVER;
+    uint64_t idleAt;
+
+    if((lineHead != lineTail) && (line[lineTail].at < at))
+    {
+        at = line[lineTail].at;
+    }
+
+    if(usartIdlePending)
+    {
+        idleAt = usartLastRx + usartFramePs();
+        at = (idleAt < at) ? idleAt : at;
+    }
+
+    return at;
+}
+
+ /*****************************************************************
+ usartReceive
+
+    A byte's stop bit has arrived. Auto baud rate detection, if
+    armed, measures it and loads BRR. The byte is lost with ORE
+    set if RDR is still full, unless OVRDIS is set, when it
+    overwrites RDR
+*****************************************************************/
+static void usartReceive(uint8_t data)
+{
+    uint32_t cr1 = REG(USART1_BASE, 0x00u);
+    uint32_t cr3 = REG(USART1_BASE, 0x08u);
+    uint32_t div;
+
+    if(!(cr1 & USART_CR1_UE) || !(cr1 & USART_CR1_RE))
+    {
+        return;
+    }
+
+    stats.uartRxBytes++;
+    usartLastRx = now;
+    usartIdlePending = 1;
+
+    if(usartAbrArmed && (REG(USART1_BASE, 0x04u) & USART_CR2_ABREN))
+    {
+        usartAbrArmed = 0;
+
+        if(cr1 & USART_CR1_OVER8)
+        {
+            div = ((2u * usartClockHz()) + (lineBaud / 2u)) / lineBaud;
+            REG16(USART1_BASE, 0x0Cu) = (uint16_t)((div & 0xFFF0u) | ((div & 0xFu) >> 1));
+        }
+        else
+        {
+            div = (usartClockHz() + (lineBaud / 2u)) / lineBaud;
+            REG16(USART1_BASE, 0x0Cu) = (uint16_t)div;
+        }
+
+        usartIsr |= USART_ISR_ABRF;
+    }
+
+    if(usartIsr & USART_ISR_RXNE)
+    {
+        if(cr3 & USART_CR3_OVRDIS)
+        {
+            usartRdr = data;
+        }
+        else
+        {
+            usartIsr |= USART_ISR_ORE;
+        }
+
+        return;
+    }
+
+    usartRdr = data;
+    usartIsr |= USART_ISR_RXNE;
+}
+
+ /*****************************************************************
+ usartEvent
+
+    Ends frames on the TX and RX lines and spots an idle line one
+    frame after the last byte received
+*****************************************************************/
+static void usartEvent(void)
+{
+    uint64_t idleAt;
+
+    if(usartTxShifting && (usartTxEnd <= now))
+    {
+        usartTxShifting = 0;
+        stats.uartTxBytes++;
+
+        if((txLogHead - txLogTail) < SIM_UART_TX_SIZE)
+        {
+            txLog[txLogHead++ & (SIM_UART_TX_SIZE - 1u)] = usartTxShift;
+        }
+
+        if(usartTdrFull)
+        {
+            usartTdrFull = 0;
+            usartIsr |= USART_ISR_TXE;
+            usartStartTx(usartTdr);
+        }
+        else
+        {
+            usartIsr |= USART_ISR_TC;
+        }
+    }
+
+    while((lineHead != lineTail) && (line[lineTail].at <= now))
+    {
+        usartReceive(line[lineTail].data);
+        lineTail = (lineTail + 1u) & (SIM_UART_LINE_SIZE - 1u);
+    }
+
+    if(usartIdlePending)
+    {
+        idleAt = usartLastRx + usartFramePs();
+
+        //A BYTE STARTING BEFORE THEN KEEPS THE LINE BUSY. ITS STOP
+        //BIT STARTS THE WAIT FOR IDLE AGAIN
+        if((lineHead != lineTail) && ((line[lineTail].at - lineFramePs()) < idleAt))
+        {
+            usartIdlePending = 0;
+        }
+        else if(idleAt <= now)
+        {
+            usartIdlePending = 0;
+            usartIsr |= USART_ISR_IDLE;
+        }
+    }
+}
+
+static uint8_t usartLine(void)
+{
+    uint32_t cr1 = REG(USART1_BASE, 0x00u);
+    uint32_t cr3 = REG(USART1_BASE, 0x08u);
+
+    return ((cr1 & USART_CR1_RXNEIE) && (usartIsr & (USART_ISR_RXNE | USART_ISR_ORE)))
+        || ((cr1 & USART_CR1_TXEIE) && (usartIsr & USART_ISR_TXE))
+        || ((cr1 & USART_CR1_TCIE) && (usartIsr & USART_ISR_TC))
+        || ((cr1 & USART_CR1_IDLEIE) && (usartIsr & USART_ISR_IDLE))
+        || ((cr3 & USART_CR3_EIE) && (usartIsr & (USART_ISR_FE | USART_ISR_NE | USART_ISR_ORE)))
+        || ((cr3 & USART_CR3_WUFIE) && (usartIsr & USART_ISR_WUF));
+}
+
+static void usartRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    uint32_t cr1 = REG(USART1_BASE, 0x00u);
+
+    (void)block;
+    (void)size;
+
+    switch(offset & ~3u)
+    {
+        case 0x1Cu:                                         //ISR
+            usartIsr &= ~(USART_ISR_TEACK | USART_ISR_REACK);
+            if(cr1 & USART_CR1_UE)
+            {
+                usartIsr |= ((cr1 & USART_CR1_TE) ? USART_ISR_TEACK : 0u)
+                          | ((cr1 & USART_CR1_RE) ? USART_ISR_REACK : 0u);
+            }
+            REG(USART1_BASE, 0x1Cu) = usartIsr;
+            break;
+
+        case 0x24u:                                         //RDR
+            REG(USART1_BASE, 0x24u) = usartRdr;
+            usartIsr &= ~USART_ISR_RXNE;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void usartWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uint32_t cr1 = REG(USART1_BASE, 0x00u);
+    uint32_t value = REG(USART1_BASE, offset & ~3u);
+
+    (void)block;
+    (void)size;
+
+    switch(offset & ~3u)
+    {
+        case 0x00u:                                         //CR1
+            //CLEARING UE STOPS EVERYTHING AND RESETS THE FLAGS
+            if(!(cr1 & USART_CR1_UE) && (old & USART_CR1_UE))
+            {
+                usartIsr = USART_ISR_TXE | USART_ISR_TC;
+                usartTxShifting = 0;
+                usartTdrFull = 0;
+                usartIdlePending = 0;
+            }
+            break;
+
+        case 0x18u:                                         //RQR
+            if(value & USART_RQR_ABRRQ)
+            {
+                usartIsr &= ~(USART_ISR_ABRF | USART_ISR_ABRE);
+                usartAbrArmed = 1;
+            }
+            if(value & USART_RQR_RXFRQ)
+            {
+                usartIsr &= ~USART_ISR_RXNE;
+            }
+            REG(USART1_BASE, 0x18u) = 0;
+            break;
+
+        case 0x20u:                                         //ICR
+            usartIsr &= ~(value & 0x00121B5Fu);
+            REG(USART1_BASE, 0x20u) = 0;
+            break;
+
+        case 0x28u:                                         //TDR
+            if(!(cr1 & USART_CR1_UE) || !(cr1 & USART_CR1_TE))
+            {
+                break;
+            }
+
+            if(!usartTxShifting)
+            {
+                usartStartTx((uint8_t)value);
+            }
+            else
+            {
+                usartTdrFull = 1;
+                usartTdr = (uint8_t)value;
+                usartIsr &= ~USART_ISR_TXE;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************************************/
+/****************************************Timers************************************/
+/**********************************************************************************/
+
+static uint32_t timerClockHz(const SimTimer *tim)
+{
+    uint32_t div = (tim->apb == 1u) ? apb1Div : apb2Div;
+    uint32_t pclk = (tim->apb == 1u) ? pclk1Hz : pclk2Hz;
+
+    //DOUBLED WHENEVER THE APB PRESCALER IS NOT 1
+    return (div == 1u) ? pclk : (2u * pclk);
+}
+
+ /*****************************************************************
+ timerTicksAt / timerTickTime
+
+    Convert between time and ticks since the timer's tick 0
+*****************************************************************/
+static uint64_t timerTicksAt(const SimTimer *tim, uint64_t t)
+{
+    unsigned __int128 num = (unsigned __int128)(t - tim->baseTime) * timerClockHz(tim);
+
+    return (uint64_t)(num / ((unsigned __int128)(tim->psc + 1u) * SIM_PS_PER_S));
+}
+
+static uint64_t timerTickTime(const SimTimer *tim, uint64_t k)
+{
+    unsigned __int128 hz = timerClockHz(tim);
+    unsigned __int128 num = (unsigned __int128)k * (tim->psc + 1u) * SIM_PS_PER_S;
+
+    return tim->baseTime + (uint64_t)((num + hz - 1u) / hz);
+}
+
+static uint32_t timerCount(const SimTimer *tim)
+{
+    if(!tim->running)
+    {
+        return tim->baseCnt;
+    }
+
+    return (uint32_t)((tim->baseCnt + tim->lastK) % ((uint64_t)tim->arr + 1u));
+}
+
+ /*****************************************************************
+ timerTicksTo
+
+    Returns
+    the ticks after 'lastK' until the counter next reads 'value'
+*****************************************************************/
+static uint64_t timerTicksTo(const SimTimer *tim, uint32_t value)
+{
+    uint64_t period = (uint64_t)tim->arr + 1u;
+    uint64_t d = ((uint64_t)value + period - timerCount(tim)) % period;
+
+    return (d == 0u) ? period : d;
+}
+
+static uint64_t timerNext(const SimTimer *tim)
+{
+    uint64_t k;
+    uint64_t d;
+    uint32_t ccr;
+    uint8_t ch;
+
+    if(!tim->running || inStop)
+    {
+        return SIM_NEVER;
+    }
+
+    k = timerTicksTo(tim, 0u);
+
+    for(ch = 0; ch < tim->channels; ch++)
+    {
+        ccr = REG(tim->base, 0x34u + (4u * ch));
+
+        if(ccr <= tim->arr)
+        {
+            d = timerTicksTo(tim, ccr);
+            k = (d < k) ? d : k;
+        }
+    }
+
+    return timerTickTime(tim, tim->lastK + k);
+}
+
+ /*****************************************************************
+ timerUpdate
+
+    Sets the flags of every overflow and compare match up to now.
+    An overflow loads a new prescaler written since the last one
+*****************************************************************/
+static void timerUpdate(SimTimer *tim)
+{
+    uint32_t sr = 0;
+    uint64_t k;
+    uint64_t end;
+    uint64_t wrap;
+    uint32_t ccr;
+    uint8_t ch;
+
+    while(tim->running && !inStop && ((k = timerTicksAt(tim, now)) > tim->lastK))
+    {
+        wrap = tim->lastK + timerTicksTo(tim, 0u);
+        end = (wrap <= k) ? wrap : k;
+
+        for(ch = 0; ch < tim->channels; ch++)
+        {
+            ccr = REG(tim->base, 0x34u + (4u * ch));
+
+            if((ccr <= tim->arr) && ((tim->lastK + timerTicksTo(tim, ccr)) <= end))
+            {
+                sr |= 1u << (ch + 1u);                      //CCxIF
+            }
+        }
+
+        if(wrap <= k)
+        {
+            sr |= (1u << 0);                                //UIF
+
+            if(REG(tim->base, 0x28u) != tim->psc)
+            {
+                tim->baseTime = timerTickTime(tim, wrap);
+                tim->baseCnt = 0;
+                tim->lastK = 0;
+                tim->psc = REG(tim->base, 0x28u);
+                continue;
+            }
+        }
+
+        tim->lastK = end;
+    }
+
+    REG(tim->base, 0x10u) |= sr;
+}
+
+ /*****************************************************************
+ timerRebase
+
+    Makes the current tick tick 0, before anything the count is
+    worked out from changes
+*****************************************************************/
+static void timerRebase(SimTimer *tim)
+{
+    if(!tim->running)
+    {
+        return;
+    }
+
+    timerUpdate(tim);
+    tim->baseCnt = timerCount(tim);
+    tim->baseTime = timerTickTime(tim, tim->lastK);
+    tim->lastK = 0;
+}
+
+static uint8_t timerLine(const SimTimer *tim)
+{
+    return (REG(tim->base, 0x10u) & REG(tim->base, 0x0Cu) & 0x1Fu) != 0u;
+}
+
+ /*****************************************************************
+ timerReset
+
+    Puts a timer back to its reset state
+*****************************************************************/
+static void timerReset(SimTimer *tim)
+{
+    tim->running = 0;
+    tim->psc = 0;
+    tim->arr = tim->cntMask;
+    tim->baseTime = 0;
+    tim->baseCnt = 0;
+    tim->lastK = 0;
+    REG(tim->base, 0x2Cu) = tim->cntMask;
+}
+
+static void timerRead(SimTimer *tim, uint32_t offset)
+{
+    if((offset & ~3u) == 0x24u)
+    {
+        REG(tim->base, 0x24u) = timerCount(tim);
+    }
+}
+
+static void timerWrite(SimTimer *tim, uint32_t offset, uint32_t old)
+{
+    uint32_t value = REG(tim->base, offset & ~3u);
+
+    switch(offset & ~3u)
+    {
+        case 0x00u:                                         //CR1 CEN
+            if((value & 1u) && !tim->running)
+            {
+                tim->running = 1;
+                tim->baseTime = now;
+                tim->lastK = 0;
+            }
+            else if(!(value & 1u) && tim->running)
+            {
+                timerUpdate(tim);
+                tim->baseCnt = timerCount(tim);
+                tim->running = 0;
+            }
+            break;
+
+        case 0x10u:                                         //SR, WRITE 0 TO CLEAR
+            REG(tim->base, 0x10u) = old & value;
+            break;
+
+        case 0x14u:                                         //EGR
+            if(value & 1u)
+            {
+                //UG RESTARTS THE COUNT AND PRESCALER WITH THE NEW PSC
+                tim->baseCnt = 0;
+                tim->baseTime = now;
+                tim->lastK = 0;
+                tim->psc = REG(tim->base, 0x28u);
+
+                if(!(REG(tim->base, 0x00u) & (1u << 2)))    //URS
+                {
+                    REG(tim->base, 0x10u) |= (1u << 0);
+                }
+            }
+            REG(tim->base, 0x10u) |= value & (0xFu << 1);   //CCxG
+            REG(tim->base, 0x14u) = 0;
+            break;
+
+        case 0x28u:                                         //PSC, 16 BITS ON EVERY TIMER
+            REG(tim->base, 0x28u) = value & 0xFFFFu;
+            break;
+
+        case 0x24u:                                         //CNT
+            timerRebase(tim);
+            tim->baseCnt = value & tim->cntMask;
+            break;
+
+        case 0x2Cu:                                         //ARR, NO PRELOAD MODELLED
+            timerRebase(tim);
+            tim->arr = value & tim->cntMask;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static SimTimer *timerOf(const SimBlock *block)
+{
+    switch(block->periph)
+    {
+        case SIM_TIM6:      return &tim6;
+        case SIM_TIM7:      return &tim7;
+        default:            return &tim2;
+    }
+}
+
+static void timRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    (void)size;
+    timerRead(timerOf(block), offset);
+}
+
+static void timWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    (void)size;
+    timerWrite(timerOf(block), offset, old);
+}
+
+
+/**********************************************************************************/
+/*****************************************DMA1*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ dmaRequest
+
+    Returns
+    1 while the peripheral CSELR routes to 'channel' is asking
+    for a transfer. Only the SPI1 and USART1 requests are modelled
+*****************************************************************/
+static uint8_t dmaRequest(uint32_t channel)
+{
+    uint32_t select = (REG(DMA1_BASE, 0xA8u) >> (4u * (channel - 1u))) & 15u;
+    uint32_t spiCr2 = REG(SPI1_BASE, 0x04u);
+    uint32_t usartCr3 = REG(USART1_BASE, 0x08u);
+
+    switch((channel << 4) | select)
+    {
+        case 0x21u: return (spiCr2 & (1u << 0)) && (spiStatus() & (1u << 0));         //SPI1_RX
+        case 0x31u: return (spiCr2 & (1u << 1)) && (spiStatus() & (1u << 1));         //SPI1_TX
+        case 0x42u: return (usartCr3 & USART_CR3_DMAT) && (usartIsr & USART_ISR_TXE);  //USART1_TX
+        case 0x52u: return (usartCr3 & USART_CR3_DMAR) && (usartIsr & USART_ISR_RXNE); //USART1_RX
+        default:    return 0;
+    }
+}
+
+ /*****************************************************************
+ dmaPeriphRead / dmaPeriphWrite
+
+    Access a modelled register for DMA1, with the same side
+    effects as a CPU access but without counting it
+
+    Returns
+    0 if 'addr' is not a modelled register
+*****************************************************************/
+static uint8_t dmaPeriphRead(uint32_t addr, uint8_t size, uint32_t *value)
+{
+    const SimBlock *block = findBlock(addr);
+
+    if(!block)
+    {
+        return 0;
+    }
+
+    block->read(block, addr - (uint32_t)block->base, size);
+
+    switch(size)
+    {
+        case 1u:    *value = *(volatile uint8_t *)aliasOf(addr);    break;
+        case 2u:    *value = *(volatile uint16_t *)aliasOf(addr);   break;
+        default:    *value = *aliasOf(addr);                        break;
+    }
+
+    return 1;
+}
+
+static uint8_t dmaPeriphWrite(uint32_t addr, uint8_t size, uint32_t value)
+{
+    const SimBlock *block = findBlock(addr);
+    uint32_t old;
+
+    if(!block)
+    {
+        return 0;
+    }
+
+    old = *aliasOf(addr & ~3u);
+
+    switch(size)
+    {
+        case 1u:    *(volatile uint8_t *)aliasOf(addr) = (uint8_t)value;    break;
+        case 2u:    *(volatile uint16_t *)aliasOf(addr) = (uint16_t)value;  break;
+        default:    *aliasOf(addr) = value;                                 break;
+    }
+
+    block->write(block, addr - (uint32_t)block->base, size, old);
+
+    return 1;
+}
+
+ /*****************************************************************
+ dmaTransfer
+
+    Moves one item on 'channel'. PSIZE and MSIZE may differ, the
+    item is cut down or padded with zeros. A peripheral address
+    that isn't modelled or a memory address of 0 is a transfer
+    error, which sets TEIF and turns the channel off
+*****************************************************************/
+static void dmaTransfer(uint32_t channel)
+{
+    uintptr_t regs = SIM_DMA_CHANNEL(channel);
+    uint32_t ccr = REG(regs, 0x00u);
+    uint32_t cndtr = REG(regs, 0x04u) & 0xFFFFu;
+    uint8_t pSize = (uint8_t)(1u << ((ccr >> 8) & 3u));
+    uint8_t mSize = (uint8_t)(1u << ((ccr >> 10) & 3u));
+    uint32_t done = dmaDone[channel - 1u];
+    uint32_t pAddr = REG(regs, 0x08u) + ((ccr & DMA_CCR_PINC) ? (done * pSize) : 0u);
+    uint32_t mAddr = REG(regs, 0x0Cu) + ((ccr & DMA_CCR_MINC) ? (done * mSize) : 0u);
+    uint32_t shift = 4u * (channel - 1u);
+    uint32_t value = 0;
+    uint8_t ok;
+
+    if(REG(regs, 0x0Cu) == 0u)
+    {
+        ok = 0;
+    }
+    else if(ccr & DMA_CCR_DIR)
+    {
+        memcpy(&value, (const void *)(uintptr_t)mAddr, mSize);
+        ok = dmaPeriphWrite(pAddr, pSize, value);
+    }
+    else
+    {
+        ok = dmaPeriphRead(pAddr, pSize, &value);
+        value &= (pSize == 4u) ? 0xFFFFFFFFu : ((1u << (8u * pSize)) - 1u);
+        memcpy((void *)(uintptr_t)mAddr, &value, mSize);
+    }
+
+    if(!ok)
+    {
+        dmaIsr |= (1u << 3) << shift;                       //TEIF
+        REG(regs, 0x00u) = ccr & ~DMA_CCR_EN;
+        return;
+    }
+
+    stats.dmaTransfers++;
+    dmaDone[channel - 1u] = ++done;
+    REG(regs, 0x04u) = --cndtr;
+
+    if(done == (dmaReload[channel - 1u] / 2u))
+    {
+        dmaIsr |= (1u << 2) << shift;                       //HTIF
+    }
+
+    if(cndtr == 0u)
+    {
+        dmaIsr |= (1u << 1) << shift;                       //TCIF
+
+        if(ccr & DMA_CCR_CIRC)
+        {
+            REG(regs, 0x04u) = dmaReload[channel - 1u];
+            dmaDone[channel - 1u] = 0;
+        }
+    }
+}
+
+ /*****************************************************************
+ serviceDma
+
+    Makes every transfer that has been asked for, one at a time,
+    highest priority channel first and the lowest channel number
+    between equals. A transfer can raise new requests, so this
+    goes on until none are left
+*****************************************************************/
+static void serviceDma(void)
+{
+    static uint8_t busy = 0;
+    uint32_t storm = 0;
+    uint32_t best;
+    uint32_t channel;
+    uint32_t ccr;
+
+    //A TRANSFER'S OWN SIDE EFFECTS END UP BACK HERE
+    if(busy)
+    {
+        return;
+    }
+
+    busy = 1;
+
+    while(1)
+    {
+        best = 0;
+
+        for(channel = 1; channel <= SIM_DMA_CHANNELS; channel++)
+        {
+            ccr = REG(SIM_DMA_CHANNEL(channel), 0x00u);
+
+            if((ccr & DMA_CCR_EN) && (REG(SIM_DMA_CHANNEL(channel), 0x04u) & 0xFFFFu) && dmaRequest(channel))
+            {
+                if((best == 0u) || (((ccr >> 12) & 3u) > ((REG(SIM_DMA_CHANNEL(best), 0x00u) >> 12) & 3u)))
+                {
+                    best = channel;
+                }
+            }
+        }
+
+        if(best == 0u)
+        {
+            break;
+        }
+
+        if(++storm > SIM_DMA_STORM)
+        {
+            fprintf(stderr, "sim: DMA1 channel %u never stops asking\n", best);
+            abort();
+        }
+
+        dmaTransfer(best);
+    }
+
+    busy = 0;
+}
+
+static uint8_t dmaLine(uint32_t channel)
+{
+    uint32_t ccr = REG(SIM_DMA_CHANNEL(channel), 0x00u);
+
+    //TCIE, HTIE AND TEIE LINE UP WITH TCIF, HTIF AND TEIF
+    return (((dmaIsr >> (4u * (channel - 1u))) & ccr & 0xEu) != 0u);
+}
+
+ /*****************************************************************
+ dmaRead
+
+    ISR shows every channel's flags, GIF being set while any of
+    the other three are
+*****************************************************************/
+static void dmaRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    uint32_t isr = dmaIsr;
+    uint32_t channel;
+
+    (void)block;
+    (void)size;
+
+    if((offset & ~3u) != 0x00u)
+    {
+        return;
+    }
+
+    for(channel = 0; channel < SIM_DMA_CHANNELS; channel++)
+    {
+        if(isr & (0xEu << (4u * channel)))
+        {
+            isr |= 1u << (4u * channel);
+        }
+    }
+
+    REG(DMA1_BASE, 0x00u) = isr;
+}
+
+ /*****************************************************************
+ dmaWrite
+
+    IFCR clears flags, CGIF clearing all of a channel's. Enabling
+    a channel starts counting from the CNDTR it was given
+*****************************************************************/
+static void dmaWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uint32_t value = REG(DMA1_BASE, offset & ~3u);
+    uint32_t channel;
+    uintptr_t regs;
+
+    (void)block;
+    (void)size;
+
+    if((offset & ~3u) == 0x04u)
+    {
+        for(channel = 0; channel < SIM_DMA_CHANNELS; channel++)
+        {
+            if(value & (1u << (4u * channel)))
+            {
+                value |= 0xFu << (4u * channel);
+            }
+        }
+
+        dmaIsr &= ~value;
+        REG(DMA1_BASE, 0x04u) = 0;
+        return;
+    }
+
+    for(channel = 1; channel <= SIM_DMA_CHANNELS; channel++)
+    {
+        regs = SIM_DMA_CHANNEL(channel);
+
+        if((DMA1_BASE + (offset & ~3u)) == regs)
+        {
+            if((value & DMA_CCR_EN) && !(old & DMA_CCR_EN))
+            {
+                dmaReload[channel - 1u] = REG(regs, 0x04u) & 0xFFFFu;
+                dmaDone[channel - 1u] = 0;
+            }
+        }
+    }
+}
+
+
+/**********************************************************************************/
+/*****************************************EXTI*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ extiEdge
+
+    A pin has changed level. Sets its line pending if SYSCFG routes
+    the pin's port to the line and the line is set for the edge.
+    The pending bit is set whether or not the line is masked
+*****************************************************************/
+static void extiEdge(uintptr_t base, uint32_t pin, uint32_t level)
+{
+    uint32_t routed = (REG(SYSCFG_BASE, 0x08u + (4u * (pin / 4u))) >> (4u * (pin % 4u))) & 15u;
+    uint32_t edges = level ? REG(EXTI_BASE, 0x08u) : REG(EXTI_BASE, 0x0Cu);
+
+    if((routed == portIndex(base)) && (edges & (1u << pin)))
+    {
+        extiPending |= 1u << pin;
+    }
+}
+
+static uint8_t extiLine(uint32_t lines)
+{
+    return (extiPending & REG(EXTI_BASE, 0x00u) & lines) != 0u;
+}
+
+static void extiRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    (void)block;
+    (void)size;
+
+    if((offset & ~3u) == 0x14u)
+    {
+        REG(EXTI_BASE, 0x14u) = extiPending;
+    }
+}
+
+ /*****************************************************************
+ extiWrite
+
+    PR1 bits clear when 1 is written. SWIER1 bits set the lines
+    that are unmasked pending, and clear with them
+*****************************************************************/
+static void extiWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uint32_t value = REG(EXTI_BASE, offset & ~3u);
+
+    (void)block;
+    (void)size;
+
+    switch(offset & ~3u)
+    {
+        case 0x10u:                                         //SWIER1
+            extiPending |= value & ~old & REG(EXTI_BASE, 0x00u);
+            break;
+
+        case 0x14u:                                         //PR1
+            extiPending &= ~value;
+            REG(EXTI_BASE, 0x10u) &= ~value;
+            break;
+
+        default:
+            return;
+    }
+
+    REG(EXTI_BASE, 0x14u) = extiPending;
+}
+
+
+/**********************************************************************************/
+/******************************************DWT*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ dwtCount
+
+    Returns
+    CYCCNT now. It counts HCLK cycles while CYCCNTENA is set, as
+    long as TRCENA was set when it was
+*****************************************************************/
+static uint32_t dwtCount(void)
+{
+    if(!dwtRunning)
+    {
+        return REG(DWT_BASE, 0x04u);
+    }
+
+    return dwtBaseCnt + (uint32_t)(((unsigned __int128)(now - dwtBaseTime) * hclkHz) / SIM_PS_PER_S);
+}
+
+ /*****************************************************************
+ dwtRebase
+
+    Starts counting again from now, before HCLK changes or stops
+*****************************************************************/
+static void dwtRebase(void)
+{
+    dwtBaseCnt = dwtCount();
+    dwtBaseTime = now;
+}
+
+static void dwtRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    (void)block;
+    (void)size;
+
+    if((offset & ~3u) == 0x04u)
+    {
+        REG(DWT_BASE, 0x04u) = dwtCount();
+    }
+}
+
+ /*****************************************************************
+ dwtWrite
+
+    A write to CYCCNT starts the count from the value written.
+    Setting CYCCNTENA starts it from where it stopped, clearing it
+    leaves CYCCNT where it got to
+*****************************************************************/
+static void dwtWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uint8_t enable = (REG(DWT_BASE, 0x00u) & DWT_CTRL_CYCCNTENA_Msk)
+                  && (REG(CoreDebug_BASE, 0x0Cu) & CoreDebug_DEMCR_TRCENA_Msk);
+
+    (void)block;
+    (void)size;
+    (void)old;
+
+    switch(offset & ~3u)
+    {
+        case 0x00u:                                         //CTRL
+            if(enable != dwtRunning)
+            {
+                REG(DWT_BASE, 0x04u) = dwtCount();
+                dwtRunning = enable;
+                dwtBaseCnt = REG(DWT_BASE, 0x04u);
+                dwtBaseTime = now;
+            }
+            break;
+
+        case 0x04u:                                         //CYCCNT
+            dwtBaseCnt = REG(DWT_BASE, 0x04u);
+            dwtBaseTime = now;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************************************/
+/****************************************LPTIM1************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ lptimTicksAt / lptimTickTime
+
+    Convert between time and ticks since LPTIM1's tick 0
+*****************************************************************/
+static uint64_t lptimTicksAt(uint64_t t)
+{
+    unsigned __int128 num = (unsigned __int128)(t - lptimBaseTime) * SIM_LSI_HZ;
+
+    return (uint64_t)(num / ((unsigned __int128)lptimPresc * SIM_PS_PER_S));
+}
+
+static uint64_t lptimTickTime(uint64_t k)
+{
+    unsigned __int128 num = (unsigned __int128)k * lptimPresc * SIM_PS_PER_S;
+
+    return lptimBaseTime + (uint64_t)((num + SIM_LSI_HZ - 1u) / SIM_LSI_HZ);
+}
+
+static uint32_t lptimCount(void)
+{
+    if(!lptimRunning)
+    {
+        return lptimBaseCnt;
+    }
+
+    return (uint32_t)((lptimBaseCnt + lptimLastK) % ((uint64_t)lptimArr + 1u));
+}
+
+ /*****************************************************************
+ lptimTicksToArr
+
+    Returns
+    the ticks after 'lptimLastK' until the count next reads ARR
+*****************************************************************/
+static uint64_t lptimTicksToArr(void)
+{
+    uint64_t period = (uint64_t)lptimArr + 1u;
+    uint64_t d = ((uint64_t)lptimArr + period - lptimCount()) % period;
+
+    return (d == 0u) ? period : d;
+}
+
+static uint64_t lptimNext(void)
+{
+    if(!lptimRunning)
+    {
+        return SIM_NEVER;
+    }
+
+    return lptimTickTime(lptimLastK + lptimTicksToArr());
+}
+
+ /*****************************************************************
+ lptimUpdate
+
+    Sets ARRM for every ARR match up to now. Compare matches are
+    not modelled
+*****************************************************************/
+static void lptimUpdate(void)
+{
+    uint64_t k;
+    uint64_t match;
+
+    while(lptimRunning && ((k = lptimTicksAt(now)) > lptimLastK))
+    {
+        match = lptimLastK + lptimTicksToArr();
+
+        if(match <= k)
+        {
+            REG(LPTIM1_BASE, 0x00u) |= (1u << 1);          //ARRM
+            lptimLastK = match;
+        }
+        else
+        {
+            lptimLastK = k;
+        }
+    }
+}
+
+static uint8_t lptimLine(void)
+{
+    return (REG(LPTIM1_BASE, 0x00u) & REG(LPTIM1_BASE, 0x08u) & 0x7Fu) != 0u;
+}
+
+static void lptimRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    (void)block;
+    (void)size;
+
+    if((offset & ~3u) == 0x1Cu)
+    {
+        lptimUpdate();
+        REG(LPTIM1_BASE, 0x1Cu) = lptimCount();
+    }
+}
+
+ /*****************************************************************
+ lptimWrite
+
+    Only continuous counting of LSI through the prescaler is
+    modelled. Writes the reference manual doesn't allow in the
+    state LPTIM1 is in stop the run
+*****************************************************************/
+static void lptimWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uint32_t value = REG(LPTIM1_BASE, offset & ~3u);
+    uint32_t cr = REG(LPTIM1_BASE, 0x10u);
+    uint32_t cfgr = REG(LPTIM1_BASE, 0x0Cu);
+
+    (void)block;
+    (void)size;
+
+    switch(offset & ~3u)
+    {
+        case 0x00u:                                         //ISR IS READ ONLY
+        case 0x1Cu:                                         //SO IS CNT
+            REG(LPTIM1_BASE, offset & ~3u) = old;
+            break;
+
+        case 0x04u:                                         //ICR CLEARS ISR FLAGS
+            lptimUpdate();
+            REG(LPTIM1_BASE, 0x00u) &= ~value;
+            REG(LPTIM1_BASE, 0x04u) = 0;
+            break;
+
+        case 0x08u:                                         //IER
+        case 0x0Cu:                                         //CFGR
+            if(cr & (1u << 0))
+            {
+                fprintf(stderr, "sim: LPTIM1 IER or CFGR written while it is enabled\n");
+                abort();
+            }
+            break;
+
+        case 0x10u:                                         //CR
+            if(!(cr & (1u << 0)))
+            {
+                //DISABLING RESETS THE COUNTER
+                lptimRunning = 0;
+                lptimBaseCnt = 0;
+                lptimLastK = 0;
+                break;
+            }
+
+            if(cr & (1u << 1))
+            {
+                fprintf(stderr, "sim: LPTIM1 single mode is not modelled\n");
+                abort();
+            }
+
+            if((cr & (1u << 2)) && !lptimRunning)
+            {
+                if(!(REG(RCC_BASE, 0x94u) & (1u << 1)) || (((REG(RCC_BASE, 0x88u) >> 18) & 3u) != 1u) || (cfgr & 1u))
+                {
+                    fprintf(stderr, "sim: LPTIM1 is only modelled counting a running LSI\n");
+                    abort();
+                }
+
+                lptimPresc = 1u << ((cfgr >> 9) & 7u);
+                lptimRunning = 1;
+                lptimBaseTime = now;
+                lptimLastK = 0;
+            }
+            break;
+
+        case 0x14u:                                         //CMP
+            REG(LPTIM1_BASE, 0x00u) |= (1u << 3);           //CMPOK
+            break;
+
+        case 0x18u:                                         //ARR
+            if(!(cr & (1u << 0)))
+            {
+                fprintf(stderr, "sim: LPTIM1 ARR written while it is disabled\n");
+                abort();
+            }
+
+            if(lptimRunning)
+            {
+                lptimUpdate();
+                lptimBaseCnt = lptimCount();
+                lptimBaseTime = lptimTickTime(lptimLastK);
+                lptimLastK = 0;
+            }
+
+            lptimArr = value & 0xFFFFu;
+            lptimBaseCnt = (lptimBaseCnt <= lptimArr) ? lptimBaseCnt : 0u;
+            REG(LPTIM1_BASE, 0x00u) |= (1u << 4);           //ARROK
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************************************/
+/******************************************CRC*************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ crcReverse
+
+    Returns
+    'value' with the order of its bottom 'bits' bits reversed
+*****************************************************************/
+static uint32_t crcReverse(uint32_t value, uint32_t bits)
+{
+    uint32_t out = 0;
+
+    while(bits--)
+    {
+        out = (out << 1) | (value & 1u);
+        value >>= 1;
+    }
+
+    return out;
+}
+
+static void crcRead(const SimBlock *block, uint32_t offset, uint8_t size)
+{
+    (void)block;
+    (void)size;
+
+    if((offset & ~3u) == 0x00u)
+    {
+        REG(CRC_BASE, 0x00u) = (REG(CRC_BASE, 0x08u) & (1u << 7)) ? crcReverse(crcValue, 32u) : crcValue;
+    }
+}
+
+ /*****************************************************************
+ crcWrite
+
+    A write to DR feeds the unit as many bits as the access is
+    wide, after REV_IN has reversed them by byte, half-word or
+    word, most significant bit first. Only the 32-bit polynomial
+    size is modelled. RESET in CR loads INIT
+*****************************************************************/
+static void crcWrite(const SimBlock *block, uint32_t offset, uint8_t size, uint32_t old)
+{
+    uint32_t cr = REG(CRC_BASE, 0x08u);
+    uint32_t bits = 8u * size;
+    uint32_t unit;
+    uint32_t data;
+    uint32_t b;
+
+    (void)block;
+    (void)old;
+
+    switch(offset & ~3u)
+    {
+        case 0x00u:                                         //DR
+            if(cr & (3u << 3))
+            {
+                fprintf(stderr, "sim: CRC polynomial sizes other than 32 bits are not modelled\n");
+                abort();
+            }
+
+            data = (REG(CRC_BASE, 0x00u) >> (8u * (offset & 3u))) & (0xFFFFFFFFu >> (32u - bits));
+
+            //REV_IN 01, 10 AND 11 REVERSE EACH BYTE, HALF-WORD OR WORD
+            if((cr >> 5) & 3u)
+            {
+                unit = 4u << ((cr >> 5) & 3u);
+                unit = (unit < bits) ? unit : bits;
+
+                for(b = 0; b < bits; b += unit)
+                {
+                    data = (data & ~((0xFFFFFFFFu >> (32u - unit)) << b))
+                         | (crcReverse(data >> b, unit) << b);
+                }
+            }
+
+            crcValue ^= data << (32u - bits);
+
+            for(b = 0; b < bits; b++)
+            {
+                crcValue = (crcValue & 0x80000000u) ? ((crcValue << 1) ^ REG(CRC_BASE, 0x14u)) : (crcValue << 1);
+            }
+            break;
+
+        case 0x08u:                                         //CR
+            if(cr & (1u << 0))
+            {
+                crcValue = REG(CRC_BASE, 0x10u);
+                REG(CRC_BASE, 0x08u) = cr & ~(1u << 0);     //RESET CLEARS ITSELF
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************************************/
+/****************************************Set up************************************/
+/**********************************************************************************/
+
+ /*****************************************************************
+ resetRegisters
+
+    Clears the register space and loads the reset values the
+    drivers can see
+*****************************************************************/
+static void resetRegisters(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < SIM_SPACES; i++)
+    {
+        memset(spaces[i].alias, 0, spaces[i].size);
+    }
+
+    REG(RCC_BASE, 0x00u) = 0x00000063u;                     //MSI ON AND READY, 4MHZ
+    REG(RCC_BASE, 0x0Cu) = 0x00001000u;                     //PLLCFGR
+    REG(RCC_BASE, 0x48u) = 0x00000100u;                     //AHB1ENR, FLASH
+    REG(RCC_BASE, 0x94u) = 0x0C000600u;                     //CSR, MSISRANGE 4MHZ
+    REG(GPIOA_BASE, 0x00u) = 0xABFFFFFFu;
+    REG(GPIOA_BASE, 0x08u) = 0x0C000000u;
+    REG(GPIOA_BASE, 0x0Cu) = 0x64000000u;
+    REG(GPIOB_BASE, 0x00u) = 0xFFFFFEBFu;
+    REG(GPIOB_BASE, 0x0Cu) = 0x00000100u;
+    REG(SPI1_BASE, 0x04u) = 0x00000700u;                    //8-BIT FRAMES
+    REG(FLASH_R_BASE, 0x00u) = 0x00000600u;
+    REG(LPTIM1_BASE, 0x18u) = 0x00000001u;                  //ARR
+    REG(CRC_BASE, 0x00u) = 0xFFFFFFFFu;                     //DR
+    REG(CRC_BASE, 0x10u) = 0xFFFFFFFFu;                     //INIT
+    REG(CRC_BASE, 0x14u) = 0x04C11DB7u;                     //POL
+}
+
+ /*****************************************************************
+ simInit
+
+    Maps the register space the first time, then puts every model
+    and register back to its reset state with time at 0. Safe to
+    call again between tests, though the drivers keep their own
+    state
+*****************************************************************/
+void simInit(void)
+{
+    struct sigaction action;
+    uint32_t i;
+
+    if(!mapped)
+    {
+        mapSpaces();
+
+        memset(&action, 0, sizeof(action));
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        action.sa_sigaction = onFault;
+        sigaction(SIGSEGV, &action, 0);
+        action.sa_sigaction = onStep;
+        sigaction(SIGTRAP, &action, 0);
+
+        mapped = 1;
+    }
+    else
+    {
+        for(i = 0; i < SIM_BLOCKS; i++)
+        {
+            protectPage(blocks[i].base, PROT_READ | PROT_WRITE);
+        }
+    }
+
+    resetRegisters();
+
+    memset(&trap, 0, sizeof(trap));
+    memset(&stats, 0, sizeof(stats));
+    memset(irqEnabled, 0, sizeof(irqEnabled));
+    memset(irqPending, 0, sizeof(irqPending));
+    memset(irqPriority, 0, sizeof(irqPriority));
+    now = 0;
+    primask = 0;
+    handlerDepth = 0;
+    eventFlag = 0;
+
+    memset(pinInputs, 0, sizeof(pinInputs));
+    memset(pinInputsSet, 0, sizeof(pinInputsSet));
+    watchCount = 0;
+
+    spiSlave = 0;
+    spiTxLevel = 0;
+    spiRxLevel = 0;
+    spiShifting = 0;
+    spiOvr = 0;
+    spiOvrDrRead = 0;
+
+    usartIsr = USART_ISR_TXE | USART_ISR_TC;
+    usartTxShifting = 0;
+    usartTdrFull = 0;
+    usartIdlePending = 0;
+    usartAbrArmed = 0;
+    lineBaud = 115200u;
+    lineHead = 0;
+    lineTail = 0;
+    lineEnd = 0;
+    txLogHead = 0;
+    txLogTail = 0;
+
+    dmaIsr = 0;
+    memset(dmaReload, 0, sizeof(dmaReload));
+    memset(dmaDone, 0, sizeof(dmaDone));
+
+    extiPending = 0;
+
+    dwtRunning = 0;
+    dwtBaseTime = 0;
+    dwtBaseCnt = 0;
+
+    lptimRunning = 0;
+    lptimPresc = 1;
+    lptimArr = 1;
+    lptimBaseTime = 0;
+    lptimBaseCnt = 0;
+    lptimLastK = 0;
+    inStop = 0;
+
+    crcValue = 0xFFFFFFFFu;
+
+    for(i = 0; i < SIM_TIMERS; i++)
+    {
+        timerReset(simTimers[i]);
+    }
+
+    sysclkHz = 4000000u;
+    updateClocks();
+
+    for(i = 0; i < SIM_BLOCKS; i++)
+    {
+        protectPage(blocks[i].base, PROT_NONE);
+    }
+}
+
+uint64_t simTimePs(void)
+{
+    return now;
+}
+
+uint32_t simHclkHz(void)
+{
+    return hclkHz;
+}
+
+ /*****************************************************************
+ simRunPs / simRunUs
+
+    Let time pass outside the drivers, taking interrupts as they
+    come up
+*****************************************************************/
+void simRunPs(uint64_t ps)
+{
+    uint64_t target = now + ps;
+    uint64_t at;
+
+    takeInterrupts();
+
+    while((at = nextEvent()) <= target)
+    {
+        advanceTo(at);
+        takeInterrupts();
+    }
+
+    advanceTo(target);
+    takeInterrupts();
+}
+
+void simRunUs(uint64_t us)
+{
+    simRunPs(us * SIM_PS_PER_US);
+}
+
+ /*****************************************************************
+ simBusy
+
+    Stands for 'cycles' HCLK cycles of work on the CPU
+*****************************************************************/
+void simBusy(uint32_t cycles)
+{
+    simRunPs(cyclesToPs(cycles, hclkHz));
+}
+
+void simGetStats(SimStats *out)
+{
+    *out = stats;
+    out->timePs = now;
+}
+
+const char *simPeriphName(SimPeriph periph)
+{
+    return (periph < SIM_PERIPH_COUNT) ? periphNames[periph] : "?";
+}
+
+void simSetSpiSlave(SimSpiSlave slave, void *ctx)
+{
+    spiSlave = slave;
+    spiSlaveCtx = ctx;
+}
+
+void simWatchPin(GPIO_TypeDef *port, uint8_t pin, SimPinWatch watch, void *ctx)
+{
+    if(watchCount >= SIM_MAX_WATCHES)
+    {
+        fprintf(stderr, "sim: more than %u pins watched\n", SIM_MAX_WATCHES);
+        abort();
+    }
+
+    watches[watchCount].port = port;
+    watches[watchCount].pin = pin;
+    watches[watchCount].watch = watch;
+    watches[watchCount].ctx = ctx;
+    watchCount++;
+}
+
+ /*****************************************************************
+ simSetPin / simGetPin
+
+    Drive the level of an input pin, read the level of an output.
+    An edge simSetPin makes is passed to EXTI, and its interrupt
+    is taken at the next register access or simRun
+*****************************************************************/
+void simSetPin(GPIO_TypeDef *port, uint8_t pin, uint8_t level)
+{
+    uintptr_t base = (uintptr_t)port;
+    uint32_t index = portIndex(base);
+    uint32_t old = pinLevel(base, pin);
+
+    pinInputsSet[index] |= 1u << pin;
+    pinInputs[index] = (pinInputs[index] & ~(1u << pin)) | ((uint32_t)(level & 1u) << pin);
+
+    if(pinLevel(base, pin) != old)
+    {
+        extiEdge(base, pin, level & 1u);
+    }
+}
+
+uint8_t simGetPin(GPIO_TypeDef *port, uint8_t pin)
+{
+    return (uint8_t)((REG((uintptr_t)port, 0x14u) >> pin) & 1u);
+}
+
+void simSetUartLineBaud(uint32_t baud)
+{
+    lineBaud = baud;
+}
+
+ /*****************************************************************
+ simUartRx
+
+    The far end sends 'data' back to back to USART1 at the line
+    baud rate, after 'idleBits' bit times of idle line following
+    whatever was queued before
+*****************************************************************/
+void simUartRx(const uint8_t *data, size_t len, uint32_t idleBits)
+{
+    uint64_t at = (lineEnd > now) ? lineEnd : now;
+    size_t i;
+
+    at += ((uint64_t)idleBits * SIM_PS_PER_S) / lineBaud;
+
+    for(i = 0; i < len; i++)
+    {
+        if(((lineHead + 1u) & (SIM_UART_LINE_SIZE - 1u)) == lineTail)
+        {
+            fprintf(stderr, "sim: more than %u bytes queued on the USART1 line\n", SIM_UART_LINE_SIZE - 1u);
+            abort();
+        }
+
+        at += lineFramePs();
+        line[lineHead].at = at;
+        line[lineHead].data = data[i];
+        lineHead = (lineHead + 1u) & (SIM_UART_LINE_SIZE - 1u);
+    }
+
+    lineEnd = at;
+}
+
+ /*****************************************************************
+ simUartTx
+
+    Takes up to 'max' of the bytes USART1 has finished sending
+
+    Returns
+    the number of bytes taken
+*****************************************************************/
+size_t simUartTx(uint8_t *buf, size_t max)
+{
+    size_t count = 0;
+
+    while((count < max) && (txLogTail != txLogHead))
+    {
+        buf[count++] = txLog[txLogTail++ & (SIM_UART_TX_SIZE - 1u)];
+    }
+
+    return count;
+}
@@ -0,0 +1,104 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "stm32l432xx.h"
+
+/*****************************************************************
+ sim
+
+    Runs the drivers on the host against behavioural models of the
+    STM32L432 peripherals. The register blocks are mapped at their
+    real addresses with every access trapped, so the driver code
+    is built exactly as it is for the STM32 and each register read
+    and write is seen by a model, counted and charged bus cycles
+    on a simulated clock.
+    DMA1 moves data between the peripherals and memory without
+    the CPU, as soon as a request comes up, and takes no time.
+    EXTI sees the edges simSetPin makes on the pins SYSCFG routes
+    to it. DWT CYCCNT counts HCLK cycles of simulated time.
+    LPTIM1 counts LSI and keeps going in Stop, where TIM2, TIM6,
+    TIM7 and CYCCNT stop. The CRC unit works out the CRC of each
+    write to DR as it is made.
+    Time only moves on when a register is accessed, the core
+    sleeps, or a tool calls simRun or simBusy. Interrupt handlers
+    are taken between register accesses whenever they are enabled,
+    pending and PRIMASK is clear. Handlers do not preempt each
+    other.
+    x86-64 Linux only. Link with -no-pie so the static buffers
+    the drivers give the DMA have 32-bit addresses.
+*****************************************************************/
+
+//PERIPHERALS WITH A MODEL. ACCESSES ARE COUNTED FOR EACH
+typedef enum
+{
+    SIM_RCC,
+    SIM_GPIOA,
+    SIM_GPIOB,
+    SIM_SPI1,
+    SIM_USART1,
+    SIM_TIM2,
+    SIM_TIM6,
+    SIM_TIM7,
+    SIM_DMA1,
+    SIM_EXTI,
+    SIM_DWT,
+    SIM_LPTIM1,
+    SIM_CRC,
+    SIM_PERIPH_COUNT
+} SimPeriph;
+
+//REGISTER ACCESSES MADE BY THE CPU
+typedef struct
+{
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t busCycles;         //HCLK CYCLES SPENT ON THE BUS
+} SimAccesses;
+
+typedef struct
+{
+    SimAccesses periph[SIM_PERIPH_COUNT];
+    SimAccesses total;
+    uint64_t timePs;            //SIMULATED TIME SINCE simInit
+    uint64_t sleepPs;           //TIME SPENT IN __WFI WITH SLEEPDEEP CLEAR
+    uint64_t stopPs;            //TIME SPENT IN __WFI WITH SLEEPDEEP SET
+    uint64_t interrupts;        //HANDLERS RUN
+    uint64_t spiFrames;         //FRAMES SHIFTED BY SPI1
+    uint64_t dmaTransfers;      //ITEMS MOVED BY DMA1
+    uint64_t uartTxBytes;       //BYTES SENT BY USART1
+    uint64_t uartRxBytes;       //BYTES THAT REACHED THE USART1 RECEIVER
+} SimStats;
+
+//PICOSECONDS IN A SECOND, THE UNIT OF SIMULATED TIME
+#define SIM_PS_PER_S            1000000000000ull
+#define SIM_PS_PER_US           1000000ull
+
+//CALLED FOR EVERY FRAME SPI1 SHIFTS OUT WITH THE FRAME SENT ON
+//MOSI. RETURNS THE FRAME THE SLAVE SENDS BACK ON MISO
+typedef uint16_t (*SimSpiSlave)(void *ctx, uint16_t mosi, uint8_t bits);
+
+//CALLED WHEN A WATCHED OUTPUT PIN CHANGES LEVEL
+typedef void (*SimPinWatch)(void *ctx, uint8_t level);
+
+void simInit(void);
+uint64_t simTimePs(void);
+void simRunPs(uint64_t ps);
+void simRunUs(uint64_t us);
+void simBusy(uint32_t cycles);
+uint32_t simHclkHz(void);
+void simGetStats(SimStats *stats);
+const char *simPeriphName(SimPeriph periph);
+
+void simSetSpiSlave(SimSpiSlave slave, void *ctx);
+
+void simWatchPin(GPIO_TypeDef *port, uint8_t pin, SimPinWatch watch, void *ctx);
+void simSetPin(GPIO_TypeDef *port, uint8_t pin, uint8_t level);
+uint8_t simGetPin(GPIO_TypeDef *port, uint8_t pin);
+
+void simSetUartLineBaud(uint32_t baud);
+void simUartRx(const uint8_t *data, size_t len, uint32_t idleBits);
+size_t simUartTx(uint8_t *buf, size_t max);
+
+#endif
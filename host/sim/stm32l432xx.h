@@ -0,0 +1,573 @@
+#ifndef SIM_STM32L432XX_H
+#define SIM_STM32L432XX_H
+
+/*****************************************************************
+ stm32l432xx.h FOR THE HOST
+
+    Stands in for the CMSIS device header when the drivers are
+    built on the host against sim.c. The register blocks sit at
+    their real addresses, which sim.c maps into the process, so
+    the drivers build unchanged. Only the registers, bits and core
+    functions the drivers in this repository use are here, laid
+    out as in RM0394 and the CMSIS headers.
+*****************************************************************/
+#include <stdint.h>
+
+#define __IO    volatile
+#define __I     volatile const
+
+//INTERRUPT NUMBERS
+typedef enum
+{
+    WWDG_IRQn               = 0,
+    RTC_WKUP_IRQn           = 3,
+    EXTI0_IRQn              = 6,
+    EXTI1_IRQn              = 7,
+    EXTI2_IRQn              = 8,
+    EXTI3_IRQn              = 9,
+    EXTI4_IRQn              = 10,
+    DMA1_Channel1_IRQn      = 11,
+    DMA1_Channel2_IRQn      = 12,
+    DMA1_Channel3_IRQn      = 13,
+    DMA1_Channel4_IRQn      = 14,
+    DMA1_Channel5_IRQn      = 15,
+    DMA1_Channel6_IRQn      = 16,
+    DMA1_Channel7_IRQn      = 17,
+    EXTI9_5_IRQn            = 23,
+    TIM1_BRK_TIM15_IRQn     = 24,
+    TIM1_UP_TIM16_IRQn      = 25,
+    TIM1_TRG_COM_IRQn       = 26,
+    TIM1_CC_IRQn            = 27,
+    TIM2_IRQn               = 28,
+    SPI1_IRQn               = 35,
+    USART1_IRQn             = 37,
+    USART2_IRQn             = 38,
+    EXTI15_10_IRQn          = 40,
+    TIM6_DAC_IRQn           = 54,
+    TIM7_IRQn               = 55,
+    LPTIM1_IRQn             = 65
+} IRQn_Type;
+
+//NUMBER OF INTERRUPT LINES THE SIMULATED NVIC HAS
+#define SIM_IRQ_COUNT           82u
+
+
+/**********************************************************************************/
+/*************************************Registers************************************/
+/**********************************************************************************/
+
+typedef struct
+{
+    __IO uint32_t MODER;
+    __IO uint32_t OTYPER;
+    __IO uint32_t OSPEEDR;
+    __IO uint32_t PUPDR;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t LCKR;
+    __IO uint32_t AFR[2];
+    __IO uint32_t BRR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SR;
+    __IO uint32_t DR;
+    __IO uint32_t CRCPR;
+    __IO uint32_t RXCRCR;
+    __IO uint32_t TXCRCR;
+} SPI_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t CR3;
+    __IO uint16_t BRR;
+    uint16_t      RESERVED2;
+    __IO uint16_t GTPR;
+    uint16_t      RESERVED3;
+    __IO uint32_t RTOR;
+    __IO uint16_t RQR;
+    uint16_t      RESERVED4;
+    __IO uint32_t ISR;
+    __IO uint32_t ICR;
+    __IO uint16_t RDR;
+    uint16_t      RESERVED5;
+    __IO uint16_t TDR;
+    uint16_t      RESERVED6;
+} USART_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CCMR1;
+    __IO uint32_t CCMR2;
+    __IO uint32_t CCER;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+    __IO uint32_t RCR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+    __IO uint32_t BDTR;
+    __IO uint32_t DCR;
+    __IO uint32_t DMAR;
+    __IO uint32_t OR1;
+    __IO uint32_t CCMR3;
+    __IO uint32_t CCR5;
+    __IO uint32_t CCR6;
+    __IO uint32_t OR2;
+    __IO uint32_t OR3;
+} TIM_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t ISR;
+    __IO uint32_t ICR;
+    __IO uint32_t IER;
+    __IO uint32_t CFGR;
+    __IO uint32_t CR;
+    __IO uint32_t CMP;
+    __IO uint32_t ARR;
+    __IO uint32_t CNT;
+    __IO uint32_t OR;
+} LPTIM_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t CCR;
+    __IO uint32_t CNDTR;
+    __IO uint32_t CPAR;
+    __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t ISR;
+    __IO uint32_t IFCR;
+} DMA_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t CSELR;
+} DMA_Request_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t CR;
+    __IO uint32_t ICSCR;
+    __IO uint32_t CFGR;
+    __IO uint32_t PLLCFGR;
+    __IO uint32_t PLLSAI1CFGR;
+    uint32_t      RESERVED;
+    __IO uint32_t CIER;
+    __IO uint32_t CIFR;
+    __IO uint32_t CICR;
+    uint32_t      RESERVED0;
+    __IO uint32_t AHB1RSTR;
+    __IO uint32_t AHB2RSTR;
+    __IO uint32_t AHB3RSTR;
+    uint32_t      RESERVED1;
+    __IO uint32_t APB1RSTR1;
+    __IO uint32_t APB1RSTR2;
+    __IO uint32_t APB2RSTR;
+    uint32_t      RESERVED2;
+    __IO uint32_t AHB1ENR;
+    __IO uint32_t AHB2ENR;
+    __IO uint32_t AHB3ENR;
+    uint32_t      RESERVED3;
+    __IO uint32_t APB1ENR1;
+    __IO uint32_t APB1ENR2;
+    __IO uint32_t APB2ENR;
+    uint32_t      RESERVED4;
+    __IO uint32_t AHB1SMENR;
+    __IO uint32_t AHB2SMENR;
+    __IO uint32_t AHB3SMENR;
+    uint32_t      RESERVED5;
+    __IO uint32_t APB1SMENR1;
+    __IO uint32_t APB1SMENR2;
+    __IO uint32_t APB2SMENR;
+    uint32_t      RESERVED6;
+    __IO uint32_t CCIPR;
+    uint32_t      RESERVED7;
+    __IO uint32_t BDCR;
+    __IO uint32_t CSR;
+    __IO uint32_t CRRCR;
+    __IO uint32_t CCIPR2;
+} RCC_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t ACR;
+    __IO uint32_t PDKEYR;
+    __IO uint32_t KEYR;
+    __IO uint32_t OPTKEYR;
+    __IO uint32_t SR;
+    __IO uint32_t CR;
+} FLASH_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t CR3;
+    __IO uint32_t CR4;
+    __IO uint32_t SR1;
+    __IO uint32_t SR2;
+    __IO uint32_t SCR;
+} PWR_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t IMR1;
+    __IO uint32_t EMR1;
+    __IO uint32_t RTSR1;
+    __IO uint32_t FTSR1;
+    __IO uint32_t SWIER1;
+    __IO uint32_t PR1;
+} EXTI_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t MEMRMP;
+    __IO uint32_t CFGR1;
+    __IO uint32_t EXTICR[4];
+    __IO uint32_t SCSR;
+    __IO uint32_t CFGR2;
+    __IO uint32_t SWPR;
+    __IO uint32_t SKR;
+} SYSCFG_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t DR;
+    __IO uint32_t IDR;
+    __IO uint32_t CR;
+    uint32_t      RESERVED;
+    __IO uint32_t INIT;
+    __IO uint32_t POL;
+} CRC_TypeDef;
+
+typedef struct
+{
+    __I  uint32_t CPUID;
+    __IO uint32_t ICSR;
+    __IO uint32_t VTOR;
+    __IO uint32_t AIRCR;
+    __IO uint32_t SCR;
+    __IO uint32_t CCR;
+} SCB_Type;
+
+typedef struct
+{
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+    __IO uint32_t CPICNT;
+    __IO uint32_t EXCCNT;
+    __IO uint32_t SLEEPCNT;
+    __IO uint32_t LSUCNT;
+    __IO uint32_t FOLDCNT;
+} DWT_Type;
+
+typedef struct
+{
+    __IO uint32_t DHCSR;
+    __IO uint32_t DCRSR;
+    __IO uint32_t DCRDR;
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct
+{
+    __IO uint32_t CTRL;
+    __IO uint32_t LOAD;
+    __IO uint32_t VAL;
+    __I  uint32_t CALIB;
+} SysTick_Type;
+
+
+/**********************************************************************************/
+/*************************************Addresses************************************/
+/**********************************************************************************/
+
+#define TIM2_BASE               0x40000000UL
+#define TIM6_BASE               0x40001000UL
+#define TIM7_BASE               0x40001400UL
+#define PWR_BASE                0x40007000UL
+#define LPTIM1_BASE             0x40007C00UL
+#define SYSCFG_BASE             0x40010000UL
+#define EXTI_BASE               0x40010400UL
+#define TIM1_BASE               0x40012C00UL
+#define SPI1_BASE               0x40013000UL
+#define USART1_BASE             0x40013800UL
+#define TIM15_BASE              0x40014000UL
+#define TIM16_BASE              0x40014400UL
+#define DMA1_BASE               0x40020000UL
+#define DMA1_Channel1_BASE      0x40020008UL
+#define DMA1_Channel2_BASE      0x4002001CUL
+#define DMA1_Channel3_BASE      0x40020030UL
+#define DMA1_Channel4_BASE      0x40020044UL
+#define DMA1_Channel5_BASE      0x40020058UL
+#define DMA1_Channel6_BASE      0x4002006CUL
+#define DMA1_Channel7_BASE      0x40020080UL
+#define DMA1_CSELR_BASE         0x400200A8UL
+#define RCC_BASE                0x40021000UL
+#define FLASH_R_BASE            0x40022000UL
+#define CRC_BASE                0x40023000UL
+#define GPIOA_BASE              0x48000000UL
+#define GPIOB_BASE              0x48000400UL
+#define GPIOC_BASE              0x48000800UL
+#define GPIOH_BASE              0x48001C00UL
+#define DWT_BASE                0xE0001000UL
+#define SysTick_BASE            0xE000E010UL
+#define SCB_BASE                0xE000ED00UL
+#define CoreDebug_BASE          0xE000EDF0UL
+
+#define TIM2                    ((TIM_TypeDef *)TIM2_BASE)
+#define TIM6                    ((TIM_TypeDef *)TIM6_BASE)
+#define TIM7                    ((TIM_TypeDef *)TIM7_BASE)
+#define PWR                     ((PWR_TypeDef *)PWR_BASE)
+#define LPTIM1                  ((LPTIM_TypeDef *)LPTIM1_BASE)
+#define SYSCFG                  ((SYSCFG_TypeDef *)SYSCFG_BASE)
+#define EXTI                    ((EXTI_TypeDef *)EXTI_BASE)
+#define TIM1                    ((TIM_TypeDef *)TIM1_BASE)
+#define SPI1                    ((SPI_TypeDef *)SPI1_BASE)
+#define USART1                  ((USART_TypeDef *)USART1_BASE)
+#define TIM15                   ((TIM_TypeDef *)TIM15_BASE)
+#define TIM16                   ((TIM_TypeDef *)TIM16_BASE)
+#define DMA1                    ((DMA_TypeDef *)DMA1_BASE)
+#define DMA1_Channel1           ((DMA_Channel_TypeDef *)DMA1_Channel1_BASE)
+#define DMA1_Channel2           ((DMA_Channel_TypeDef *)DMA1_Channel2_BASE)
+#define DMA1_Channel3           ((DMA_Channel_TypeDef *)DMA1_Channel3_BASE)
+#define DMA1_Channel4           ((DMA_Channel_TypeDef *)DMA1_Channel4_BASE)
+#define DMA1_Channel5           ((DMA_Channel_TypeDef *)DMA1_Channel5_BASE)
+#define DMA1_Channel6           ((DMA_Channel_TypeDef *)DMA1_Channel6_BASE)
+#define DMA1_Channel7           ((DMA_Channel_TypeDef *)DMA1_Channel7_BASE)
+#define DMA1_CSELR              ((DMA_Request_TypeDef *)DMA1_CSELR_BASE)
+#define RCC                     ((RCC_TypeDef *)RCC_BASE)
+#define FLASH                   ((FLASH_TypeDef *)FLASH_R_BASE)
+#define CRC                     ((CRC_TypeDef *)CRC_BASE)
+#define GPIOA                   ((GPIO_TypeDef *)GPIOA_BASE)
+#define GPIOB                   ((GPIO_TypeDef *)GPIOB_BASE)
+#define GPIOC                   ((GPIO_TypeDef *)GPIOC_BASE)
+#define GPIOH                   ((GPIO_TypeDef *)GPIOH_BASE)
+#define DWT                     ((DWT_Type *)DWT_BASE)
+#define SysTick                 ((SysTick_Type *)SysTick_BASE)
+#define SCB                     ((SCB_Type *)SCB_BASE)
+#define CoreDebug               ((CoreDebug_Type *)CoreDebug_BASE)
+
+
+/**********************************************************************************/
+/****************************************Bits**************************************/
+/**********************************************************************************/
+
+#define RCC_CR_MSION                (1UL << 0)
+#define RCC_CR_MSIRDY               (1UL << 1)
+#define RCC_CR_HSION                (1UL << 8)
+#define RCC_CR_HSIKERON             (1UL << 9)
+#define RCC_CR_HSIRDY               (1UL << 10)
+#define RCC_CR_PLLON                (1UL << 24)
+#define RCC_CR_PLLRDY               (1UL << 25)
+#define RCC_AHB1ENR_DMA1EN          (1UL << 0)
+#define RCC_AHB1ENR_CRCEN           (1UL << 12)
+#define RCC_AHB2ENR_GPIOAEN         (1UL << 0)
+#define RCC_AHB2ENR_GPIOBEN         (1UL << 1)
+#define RCC_APB1ENR1_TIM2EN         (1UL << 0)
+#define RCC_APB1ENR1_TIM6EN         (1UL << 4)
+#define RCC_APB1ENR1_TIM7EN         (1UL << 5)
+#define RCC_APB1ENR1_PWREN          (1UL << 28)
+#define RCC_APB1ENR1_LPTIM1EN       (1UL << 31)
+#define RCC_APB2ENR_SYSCFGEN        (1UL << 0)
+#define RCC_APB2ENR_TIM1EN          (1UL << 11)
+#define RCC_APB2ENR_SPI1EN          (1UL << 12)
+#define RCC_APB2ENR_USART1EN        (1UL << 14)
+#define RCC_APB2ENR_TIM15EN         (1UL << 16)
+#define RCC_APB2ENR_TIM16EN         (1UL << 17)
+#define RCC_CCIPR_USART1SEL         (3UL << 0)
+#define RCC_CCIPR_USART1SEL_0       (1UL << 0)
+#define RCC_CCIPR_USART1SEL_1       (1UL << 1)
+
+#define PWR_CR1_LPMS                (7UL << 0)
+#define PWR_CR1_LPMS_STOP1          (1UL << 0)
+#define PWR_CR1_LPMS_STOP2          (1UL << 1)
+
+#define SPI_CR1_CPHA                (1UL << 0)
+#define SPI_CR1_CPOL                (1UL << 1)
+#define SPI_CR1_MSTR                (1UL << 2)
+#define SPI_CR1_SPE                 (1UL << 6)
+#define SPI_CR2_SSOE                (1UL << 2)
+
+#define USART_CR1_UE                (1UL << 0)
+#define USART_CR1_UESM              (1UL << 1)
+#define USART_CR1_RE                (1UL << 2)
+#define USART_CR1_TE                (1UL << 3)
+#define USART_CR1_IDLEIE            (1UL << 4)
+#define USART_CR1_RXNEIE            (1UL << 5)
+#define USART_CR1_TCIE              (1UL << 6)
+#define USART_CR1_TXEIE             (1UL << 7)
+#define USART_CR1_PEIE              (1UL << 8)
+#define USART_CR1_PCE               (1UL << 10)
+#define USART_CR1_M0                (1UL << 12)
+#define USART_CR1_MME               (1UL << 13)
+#define USART_CR1_CMIE              (1UL << 14)
+#define USART_CR1_OVER8             (1UL << 15)
+#define USART_CR1_M1                (1UL << 28)
+#define USART_CR2_LBDIE             (1UL << 6)
+#define USART_CR2_CLKEN             (1UL << 11)
+#define USART_CR2_LINEN             (1UL << 14)
+#define USART_CR2_SWAP              (1UL << 15)
+#define USART_CR2_MSBFIRST          (1UL << 19)
+#define USART_CR2_ABREN             (1UL << 20)
+#define USART_CR2_ABRMODE_0         (1UL << 21)
+#define USART_CR2_ABRMODE_1         (1UL << 22)
+#define USART_CR2_ABRMODE           (3UL << 21)
+#define USART_CR2_RTOEN             (1UL << 23)
+#define USART_CR3_EIE               (1UL << 0)
+#define USART_CR3_IREN              (1UL << 1)
+#define USART_CR3_DMAR              (1UL << 6)
+#define USART_CR3_DMAT              (1UL << 7)
+#define USART_CR3_ONEBIT            (1UL << 11)
+#define USART_CR3_OVRDIS            (1UL << 12)
+#define USART_CR3_DEM               (1UL << 14)
+#define USART_CR3_WUS               (3UL << 20)
+#define USART_CR3_WUFIE             (1UL << 22)
+#define USART_CR3_UCESM             (1UL << 23)
+#define USART_CR3_TCBGTIE           (1UL << 24)
+#define USART_RQR_ABRRQ             (1UL << 0)
+#define USART_RQR_RXFRQ             (1UL << 3)
+#define USART_ISR_PE                (1UL << 0)
+#define USART_ISR_FE                (1UL << 1)
+#define USART_ISR_NE                (1UL << 2)
+#define USART_ISR_ORE               (1UL << 3)
+#define USART_ISR_IDLE              (1UL << 4)
+#define USART_ISR_RXNE              (1UL << 5)
+#define USART_ISR_TC                (1UL << 6)
+#define USART_ISR_TXE               (1UL << 7)
+#define USART_ISR_ABRE              (1UL << 14)
+#define USART_ISR_ABRF              (1UL << 15)
+#define USART_ISR_BUSY              (1UL << 16)
+#define USART_ISR_WUF               (1UL << 20)
+#define USART_ISR_TEACK             (1UL << 21)
+#define USART_ISR_REACK             (1UL << 22)
+#define USART_ICR_PECF              (1UL << 0)
+#define USART_ICR_FECF              (1UL << 1)
+#define USART_ICR_NCF               (1UL << 2)
+#define USART_ICR_ORECF             (1UL << 3)
+#define USART_ICR_IDLECF            (1UL << 4)
+#define USART_ICR_TCCF              (1UL << 6)
+#define USART_ICR_WUCF              (1UL << 20)
+
+#define DMA_CCR_EN                  (1UL << 0)
+#define DMA_CCR_TCIE                (1UL << 1)
+#define DMA_CCR_HTIE                (1UL << 2)
+#define DMA_CCR_TEIE                (1UL << 3)
+#define DMA_CCR_DIR                 (1UL << 4)
+#define DMA_CCR_CIRC                (1UL << 5)
+#define DMA_CCR_PINC                (1UL << 6)
+#define DMA_CCR_MINC                (1UL << 7)
+#define DMA_CCR_PSIZE_0             (1UL << 8)
+#define DMA_CCR_PSIZE_1             (1UL << 9)
+#define DMA_CCR_MSIZE_0             (1UL << 10)
+#define DMA_CCR_MSIZE_1             (1UL << 11)
+#define DMA_CCR_PL_0                (1UL << 12)
+#define DMA_CCR_PL_1                (1UL << 13)
+#define DMA_CCR_MEM2MEM             (1UL << 14)
+#define DMA_CSELR_C1S_Pos           0U
+#define DMA_CSELR_C1S               (15UL << 0)
+#define DMA_CSELR_C2S_Pos           4U
+#define DMA_CSELR_C2S               (15UL << 4)
+#define DMA_CSELR_C3S_Pos           8U
+#define DMA_CSELR_C3S               (15UL << 8)
+#define DMA_CSELR_C4S_Pos           12U
+#define DMA_CSELR_C4S               (15UL << 12)
+#define DMA_CSELR_C5S_Pos           16U
+#define DMA_CSELR_C5S               (15UL << 16)
+#define DMA_CSELR_C6S_Pos           20U
+#define DMA_CSELR_C6S               (15UL << 20)
+#define DMA_CSELR_C7S_Pos           24U
+#define DMA_CSELR_C7S               (15UL << 24)
+#define DMA_ISR_GIF5                (1UL << 16)
+#define DMA_ISR_TCIF5               (1UL << 17)
+#define DMA_ISR_HTIF5               (1UL << 18)
+#define DMA_ISR_TEIF5               (1UL << 19)
+#define DMA_IFCR_CGIF1              (1UL << 0)
+#define DMA_IFCR_CGIF2              (1UL << 4)
+#define DMA_IFCR_CGIF3              (1UL << 8)
+#define DMA_IFCR_CGIF4              (1UL << 12)
+#define DMA_IFCR_CGIF5              (1UL << 16)
+#define DMA_IFCR_CGIF6              (1UL << 20)
+#define DMA_IFCR_CGIF7              (1UL << 24)
+
+#define SCB_SCR_SLEEPONEXIT_Msk     (1UL << 1)
+#define SCB_SCR_SLEEPDEEP_Msk       (1UL << 2)
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+
+
+/**********************************************************************************/
+/**********************************Core functions**********************************/
+/**********************************************************************************/
+
+//INTERRUPT MASKING, SLEEP AND THE NVIC ARE MODELLED BY sim.c
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __WFI(void);
+void __WFE(void);
+void __SEV(void);
+
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+void NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+
+//BARRIERS HAVE NOTHING TO DO ON ONE HOST THREAD BUT STOP THE
+//COMPILER MOVING MEMORY ACCESSES ACROSS THEM
+#define __DSB()                 __asm__ volatile("" ::: "memory")
+#define __ISB()                 __asm__ volatile("" ::: "memory")
+#define __DMB()                 __asm__ volatile("" ::: "memory")
+#define __NOP()                 __asm__ volatile("nop")
+
+//EXCLUSIVE ACCESSES. ONLY ONE HOST THREAD RUNS THE DRIVERS AND
+//INTERRUPTS ARE TAKEN BETWEEN REGISTER ACCESSES, SO A STORE
+//ALWAYS SUCCEEDS
+static inline uint32_t __LDREXW(volatile uint32_t *addr)
+{
+    return *addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+    *addr = value;
+    return 0;
+}
+
+static inline void __CLREX(void)
+{
+}
+
+static inline uint8_t __CLZ(uint32_t value)
+{
+    return (value == 0u) ? 32u : (uint8_t)__builtin_clz(value);
+}
+
+static inline uint32_t __REV(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+#endif